@@ -0,0 +1,11 @@
+#version 450
+
+layout(location = 0) in float height;
+
+layout(location = 0) out vec4 color;
+
+void main() {
+    // low ground green, high ground grey, over the N40W106 elevation range (m)
+    float t = clamp((height - 1500.0) / 3000.0, 0.0, 1.0);
+    color = vec4(mix(vec3(0.22, 0.40, 0.18), vec3(0.85, 0.85, 0.85), t), 1.0);
+}
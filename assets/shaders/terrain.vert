@@ -0,0 +1,34 @@
+#version 450
+
+// shared grid mesh: sample coordinates within a chunk, skirt vertices flagged on x
+layout(location = 0) in uint gridX;
+layout(location = 1) in uint gridZ;
+
+// per chunk instance
+layout(location = 2) in vec2 origin;
+layout(location = 3) in uint layer;
+layout(location = 4) in float minHeight;
+
+const uint SKIRT_BIT = 0x8000u;
+
+// set 0 is the descriptor heap, its image array sized by the heap's capacity
+layout(constant_id = 0) const uint HEAP_IMAGES = 1u;
+layout(set = 0, binding = 0) uniform isampler2DArray images[HEAP_IMAGES];
+
+layout(push_constant) uniform Constants {
+    mat4 viewProj;
+    float sampleSpacing;
+    // heap index of the heightmap array, one layer per chunk pool slot
+    uint heightmaps;
+} constants;
+
+layout(location = 0) out float height;
+
+void main() {
+    uint x = gridX & ~SKIRT_BIT;
+    height = float(texelFetch(images[constants.heightmaps], ivec3(int(x), int(gridZ), int(layer)), 0).r);
+    // skirts hang down to the lowest point of the chunk, under any crack a coarser neighbour leaves
+    float y = (gridX & SKIRT_BIT) != 0u ? minHeight : height;
+    vec2 positionXZ = origin + vec2(x, gridZ) * constants.sampleSpacing;
+    gl_Position = constants.viewProj * vec4(positionXZ.x, y, positionXZ.y, 1.0);
+}
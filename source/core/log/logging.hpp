@@ -1,15 +1,39 @@
+// logging.hpp: defines the Logger, an asynchronous pub-sub logger
+//     producers format their message straight into a Log slot of their own thread's single producer,
+//     single consumer LogRing and publish it, and a background sink thread pulls every ring, prefixes
+//     level + timestamp and writes them out in batches; a full ring drops (and counts) new records
+//     rather than block the producer, and logs below the runtime level cost one relaxed load
+//     the sink polls with a backoff instead of being woken per record, only errors and bursts wake it early
 #pragma once
 
-// just print logs to std::cout for now
-#include <iostream>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+#include "core/spsc_ring.hpp"
 #include "core/time/time.hpp"
 
 namespace core::log {
 
 constexpr const core::u32 LogMessageSize{ 512 };
 
+// records a producer thread may have waiting on the sink before new ones are dropped
+constexpr const std::size_t LogRingSize{ 256 };
+
+// bytes the sink collects before a write
+constexpr const std::size_t LogBatchSize{ 64 * 1024 };
+
+// sink poll interval, doubled on every idle pass up to the max
+constexpr const std::chrono::milliseconds LogPollMin{ 1 };
+constexpr const std::chrono::milliseconds LogPollMax{ 16 };
+
 enum class Level : core::u32 {
     debug = 0,
     info = 1,
@@ -29,22 +53,63 @@ enum class Level : core::u32 {
     }
 }
 
-// eventual pub-sub
 struct Log {
     u64 timestamp{ 0 };
     Level level{ Level::debug };
     std::array<char, LogMessageSize> message{};
 };
 
+// one producer thread -> the sink
+using LogRing = SpscRing<Log, LogRingSize>;
+
 class Logger {
-    // write buffer
-    // we use the core region memory type so that we can use it
-    // as our writing buffer, an allocator is not needed to
-    // manage this
-    std::array<char,LogMessageSize> buffer{};
+    std::atomic<Level> level;
+
+    // one ring per thread that has logged
+    ThreadRings<LogRing> rings{};
+
+    // records committed by producers and written by the sink
+    std::atomic<u64> published{ 0 };
+    std::atomic<u64> written{ 0 };
+    std::atomic<bool> running{ true };
+
+    // the sink sleeps on wake between polls, notified without the lock
+    std::mutex sleepMutex{};
+    std::condition_variable wake{};
+
+    // sink only: rings to drain this pass, and formatted records waiting on the next write
+    std::vector<LogRing*> draining{};
+    std::vector<char> batch{};
+
+    std::thread sink;
 
 public:
-    Logger() {}
+    explicit Logger(Level level = Level::debug)
+        : level(level), sink(&Logger::run, this)
+    {}
+
+    // writes out everything logged before it
+    ~Logger() {
+        running.store(false, std::memory_order_release);
+        wake.notify_one();
+        sink.join();
+    }
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // logs below level are dropped before any formatting
+    void setLevel(Level l) noexcept {
+        level.store(l, std::memory_order_relaxed);
+    }
+
+    Level getLevel() const noexcept {
+        return level.load(std::memory_order_relaxed);
+    }
+
+    bool enabled(Level l) const noexcept {
+        return static_cast<core::u32>(l) >= static_cast<core::u32>(level.load(std::memory_order_relaxed));
+    }
 
     template<typename... Args>
     void debug(const char * subsystem, const char * messageFormatString, Args&&... args) {
@@ -63,64 +128,128 @@ public:
 
     template<Level L, typename... Args>
     void log(const char * subsystem, const char * messageFormatString, Args&&... args) {
-        Log log;
-        log.timestamp = time::getTimestamp();
-
-        if constexpr(L == Level::debug) {
-            log.level = Level::debug;
+        if(!enabled(L)) {
+            return;
         }
-        if constexpr(L == Level::error) {
-            log.level = Level::error;
-        }
-        if constexpr(L == Level::info) {
-            log.level = Level::info;
+        LogRing& ring = producerRing();
+        Log* log = ring.reserve();
+        if(log == nullptr) {
+            return;
         }
+        log->timestamp = time::getTimestamp();
+        log->level = L;
 
+        // the message is formatted here: args may not outlive the call
         std::size_t prefixLength{ 0 };
         if(subsystem != nullptr) {
-            prefixLength = std::snprintf(
-                log.message.data(),
-                log.message.size(),
+            const int n = std::snprintf(
+                log->message.data(),
+                log->message.size(),
                 "[%s]: ",
                 subsystem
             );
+            prefixLength = n > 0 ? std::min<std::size_t>(static_cast<std::size_t>(n), log->message.size() - 1) : 0;
         }
 
         if constexpr(sizeof...(Args) == 0) {
             std::snprintf(
-                log.message.data() + prefixLength,
-                log.message.size() - prefixLength,
+                log->message.data() + prefixLength,
+                log->message.size() - prefixLength,
                 "%s",
                 messageFormatString
             );
         }
         else {
             std::snprintf(
-                log.message.data() + prefixLength,
-                log.message.size() - prefixLength,
+                log->message.data() + prefixLength,
+                log->message.size() - prefixLength,
                 messageFormatString,
                 std::forward<Args>(args)...
             );
         }
 
-        // todo: async pub
-        write(log);
+        const std::size_t waiting = ring.commit();
+        published.fetch_add(1, std::memory_order_relaxed);
+        // errors go out now, and a burst wakes the sink before the ring fills
+        if(L == Level::error || waiting == LogRingSize / 2) {
+            wake.notify_one();
+        }
+    }
+
+    // block until everything logged so far has been written
+    void flush() noexcept {
+        const u64 target = published.load(std::memory_order_acquire);
+        wake.notify_one();
+        while(written.load(std::memory_order_acquire) < target && running.load(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    // calling thread's ring, registered on its first log
+    LogRing& producerRing() {
+        return rings.local([](std::size_t) {
+            return std::make_unique<LogRing>();
+        });
+    }
 
-        return;
+    // sink thread: drain every ring, sleep until the next poll or error
+    void run() noexcept {
+        batch.reserve(LogBatchSize + LogMessageSize + 32);
+        std::chrono::milliseconds poll = LogPollMin;
+        while(true) {
+            const bool stopping = !running.load(std::memory_order_acquire);
+            rings.collect(draining);
+            u64 count = 0;
+            for(LogRing* ring : draining) {
+                count += ring->drain([&](const Log& log) {
+                    write(log);
+                });
+                if(const u64 dropped = ring->takeDropped(); dropped != 0) {
+                    Log note{ .timestamp = time::getTimestamp(), .level = Level::error };
+                    std::snprintf(note.message.data(), note.message.size(), "[core/log]: dropped (%llu) logs, ring full",
+                        static_cast<unsigned long long>(dropped));
+                    write(note);
+                }
+            }
+            writeBatch();
+            written.fetch_add(count, std::memory_order_release);
+            if(stopping) {
+                return;
+            }
+            poll = count != 0 ? LogPollMin : std::min(poll * 2, LogPollMax);
+            std::unique_lock lock(sleepMutex);
+            wake.wait_for(lock, poll);
+        }
     }
 
-    void write(const Log& log) {
-        // todo: async pull
+    void write(const Log& log) noexcept {
         const time::MSMTime msm = time::getMSM(log.timestamp);
-        int res = snprintf(
-                    buffer.data(),
-                    1024,
-                    "%c%02d:%02d:%03d %s",
-                    logLevelNametag(log.level),
-                    msm.minutes, msm.seconds, msm.millis,
-                    log.message.data()
+        std::array<char, LogMessageSize + 32> line{};
+        const int n = std::snprintf(
+            line.data(),
+            line.size(),
+            "%c%02d:%02d:%03d %s\n",
+            logLevelNametag(log.level),
+            msm.minutes, msm.seconds, msm.millis,
+            log.message.data()
         );
-        std::cout << buffer.data() << "\n";
+        if(n <= 0) {
+            return;
+        }
+        batch.insert(batch.end(), line.data(), line.data() + std::min<std::size_t>(static_cast<std::size_t>(n), line.size() - 1));
+        if(batch.size() >= LogBatchSize) {
+            writeBatch();
+        }
+    }
+
+    void writeBatch() noexcept {
+        if(batch.empty()) {
+            return;
+        }
+        std::fwrite(batch.data(), 1, batch.size(), stdout);
+        std::fflush(stdout);
+        batch.clear();
     }
 };
 
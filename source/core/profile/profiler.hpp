@@ -0,0 +1,247 @@
+// profiler.hpp: frame and subsystem profiling, scoped CPU zones and GPU timestamps on one timeline
+//     each thread records closed zones into its own single producer, single consumer ZoneRing, and
+//     endFrame() (on the frame's thread) moves them into a ring of the last ProfileFrameCount frames,
+//     which exportChromeTrace() writes out as Chrome trace event JSON (chrome://tracing, Perfetto,
+//     or Tracy through its import-chrome tool)
+//     only compiled in with DEUS_PROFILE defined, the DEUS_PROFILE_* macros expand to nothing otherwise
+#pragma once
+
+#if defined(DEUS_PROFILE)
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/spsc_ring.hpp"
+#include "core/time/time.hpp"
+
+// set by the build (DEUS_PROFILE_TRACE_PATH in CMakeLists.txt)
+#if !defined(DEUS_PROFILE_TRACE_PATH)
+#define DEUS_PROFILE_TRACE_PATH "./build/profile.json"
+#endif
+constexpr const char* PROFILE_TRACE_PATH{ DEUS_PROFILE_TRACE_PATH };
+
+namespace core::profile {
+
+// frames kept for export, older ones are overwritten
+constexpr const std::size_t ProfileFrameCount{ 128 };
+
+// zones a thread may have waiting on the next endFrame() before new ones are dropped
+constexpr const std::size_t ProfileRingSize{ 4096 };
+
+// a closed zone, timestamps in core::time nanoseconds
+struct Zone {
+    // must outlive the profiler, zones only keep the pointer (string literals)
+    const char* name{ nullptr };
+    u64 begin{ 0 };
+    u64 end{ 0 };
+    // timeline shown in the trace, the recording thread's own or a GPU queue's
+    u32 track{ 0 };
+};
+
+// one recording thread -> endFrame()
+struct ZoneRing : SpscRing<Zone, ProfileRingSize> {
+    // this thread's track
+    const u32 track;
+
+    explicit ZoneRing(u32 track)
+        : track(track)
+    {}
+};
+
+// every zone drained at one endFrame(), zones that span frames land in the frame they closed in
+struct FrameRecord {
+    u64 index{ 0 };
+    u64 begin{ 0 };
+    u64 end{ 0 };
+    // zones lost to full rings
+    u64 dropped{ 0 };
+    std::vector<Zone> zones{};
+};
+
+class Profiler {
+    // track 0 holds the frames themselves
+    static constexpr u32 FrameTrack{ 0 };
+
+    // one ring per recording thread
+    ThreadRings<ZoneRing> rings{};
+    // a name per track, guarded for registration and export
+    mutable std::mutex tracksMutex{};
+    std::vector<std::string> trackNames{ "frames" };
+
+    // frame thread only
+    std::array<FrameRecord, ProfileFrameCount> frames{};
+    u64 frameCount{ 0 };
+    u64 frameBegin{ time::getTimestamp() };
+    std::vector<ZoneRing*> draining{};
+
+    Profiler() = default;
+
+public:
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    static Profiler& get() noexcept {
+        static Profiler profiler{};
+        return profiler;
+    }
+
+    // a zone on the calling thread's track
+    void record(const char* name, u64 begin, u64 end) noexcept {
+        ZoneRing& ring = threadRing();
+        ring.push({ .name = name, .begin = begin, .end = end, .track = ring.track });
+    }
+
+    // a zone on another track, e.g. GPU timestamps resolved by the thread that submitted them
+    void record(u32 track, const char* name, u64 begin, u64 end) noexcept {
+        threadRing().push({ .name = name, .begin = begin, .end = end, .track = track });
+    }
+
+    // a timeline nothing records on directly, returns its track for record()
+    u32 addTrack(const char* name) {
+        std::lock_guard lock(tracksMutex);
+        trackNames.emplace_back(name);
+        return static_cast<u32>(trackNames.size() - 1);
+    }
+
+    // name the calling thread's track in the trace
+    void nameThread(const char* name) {
+        const u32 track = threadRing().track;
+        std::lock_guard lock(tracksMutex);
+        trackNames[track] = name;
+    }
+
+    // close the current frame: collect every thread's zones into the frame ring
+    // call from one thread only, the one driving frames
+    void endFrame() noexcept {
+        rings.collect(draining);
+        FrameRecord& frame = frames[frameCount % ProfileFrameCount];
+        frame.index = frameCount;
+        frame.begin = frameBegin;
+        frame.end = time::getTimestamp();
+        frame.dropped = 0;
+        frame.zones.clear();
+        for(ZoneRing* ring : draining) {
+            ring->drain([&](const Zone& zone) {
+                frame.zones.push_back(zone);
+            });
+            frame.dropped += ring->takeDropped();
+        }
+        frameBegin = frame.end;
+        ++frameCount;
+    }
+
+    // fn(const FrameRecord&) over the kept frames, oldest first, from the frame thread
+    template<typename Fn>
+    void forEachFrame(Fn&& fn) const {
+        const u64 kept = std::min<u64>(frameCount, ProfileFrameCount);
+        for(u64 i = frameCount - kept; i < frameCount; ++i) {
+            fn(static_cast<const FrameRecord&>(frames[i % ProfileFrameCount]));
+        }
+    }
+
+    // the kept frames as a Chrome trace event file, from the frame thread
+    bool exportChromeTrace(const char* path) const noexcept {
+        std::FILE* file = std::fopen(path, "wb");
+        if(file == nullptr) {
+            printf("profiler: could not open '%s' for the trace\n", path);
+            return false;
+        }
+        std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+        bool first = true;
+        auto separate = [&]() {
+            if(!first) {
+                std::fputs(",\n", file);
+            }
+            first = false;
+        };
+        {
+            std::lock_guard lock(tracksMutex);
+            for(std::size_t track = 0; track < trackNames.size(); ++track) {
+                separate();
+                std::fprintf(file, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+                    track, trackNames[track].c_str());
+            }
+        }
+        // trace timestamps are in microseconds
+        auto micros = [](u64 ns) {
+            return static_cast<double>(ns) / 1000.0;
+        };
+        forEachFrame([&](const FrameRecord& frame) {
+            separate();
+            std::fprintf(file, "{\"ph\":\"X\",\"name\":\"frame\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                "\"args\":{\"index\":%llu,\"dropped\":%llu}}",
+                FrameTrack, micros(frame.begin), micros(frame.end - frame.begin),
+                static_cast<unsigned long long>(frame.index), static_cast<unsigned long long>(frame.dropped));
+            for(const Zone& zone : frame.zones) {
+                separate();
+                std::fprintf(file, "{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    zone.name, zone.track, micros(zone.begin), micros(zone.end - zone.begin));
+            }
+        });
+        std::fputs("\n]}\n", file);
+        if(std::fclose(file) != 0) {
+            printf("profiler: could not write the trace to '%s'\n", path);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // calling thread's ring, registered on its first zone
+    // a later thread with an exited thread's id takes over its ring (and track)
+    ZoneRing& threadRing() {
+        return rings.local([&](std::size_t index) {
+            std::lock_guard lock(tracksMutex);
+            trackNames.push_back("thread " + std::to_string(index));
+            return std::make_unique<ZoneRing>(static_cast<u32>(trackNames.size() - 1));
+        });
+    }
+};
+
+// records a zone from construction to the end of the enclosing scope
+class Scope {
+    const char* name;
+    const u64 begin;
+
+public:
+    explicit Scope(const char* name) noexcept
+        : name(name), begin(time::getTimestamp())
+    {}
+
+    ~Scope() {
+        Profiler::get().record(name, begin, time::getTimestamp());
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+
+}
+
+#define DEUS_PROFILE_CONCAT_(a, b) a##b
+#define DEUS_PROFILE_CONCAT(a, b) DEUS_PROFILE_CONCAT_(a, b)
+
+// scoped CPU zone, name must be a string literal
+#define DEUS_PROFILE_ZONE(name) const ::core::profile::Scope DEUS_PROFILE_CONCAT(deusProfileZone, __LINE__){ name }
+// name the calling thread's track
+#define DEUS_PROFILE_THREAD(name) ::core::profile::Profiler::get().nameThread(name)
+// close the frame, once per frame from the frame thread
+#define DEUS_PROFILE_FRAME() ::core::profile::Profiler::get().endFrame()
+// write the kept frames out as a Chrome trace
+#define DEUS_PROFILE_EXPORT(path) ::core::profile::Profiler::get().exportChromeTrace(path)
+
+#else
+
+#define DEUS_PROFILE_ZONE(name) static_cast<void>(0)
+#define DEUS_PROFILE_THREAD(name) static_cast<void>(0)
+#define DEUS_PROFILE_FRAME() static_cast<void>(0)
+#define DEUS_PROFILE_EXPORT(path) static_cast<void>(0)
+
+#endif
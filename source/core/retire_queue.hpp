@@ -0,0 +1,70 @@
+// retire_queue.hpp: defines RetireQueue, deferred destruction for anything submitted GPU work may
+//     still be using: items are released (in use by work not yet submitted), retired with the value of
+//     the submit that last uses them, and reclaimed once that value has completed
+//     values are any monotonic submit counter, e.g. Commander::getSubmitValue / getCompletedValue
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <utility>
+
+#include "core/types.hpp"
+
+namespace core {
+
+template<typename T>
+class RetireQueue {
+    struct Entry {
+        T item;
+        // 0 until retired
+        u64 value{ 0 };
+    };
+    std::deque<Entry> entries{};
+    // trailing entries not retired yet
+    std::size_t unretired{ 0 };
+
+public:
+    // in use until the next retire()'s value completes
+    void release(T item) {
+        entries.push_back({ .item = std::move(item), .value = 0 });
+        ++unretired;
+    }
+
+    // everything released since the last retire may be in use until value completes
+    // values must not decrease
+    void retire(u64 value) noexcept {
+        for(std::size_t i = entries.size() - unretired; i < entries.size(); ++i) {
+            entries[i].value = value;
+        }
+        unretired = 0;
+    }
+
+    // destroy(T&) every retired item whose value has completed, oldest first
+    template<typename Fn>
+    void reclaim(u64 completedValue, Fn&& destroy) {
+        while(entries.size() > unretired && entries.front().value <= completedValue) {
+            destroy(entries.front().item);
+            entries.pop_front();
+        }
+    }
+
+    // destroy(T&) every item, retired or not, once nothing can be using them (the device is idle)
+    template<typename Fn>
+    void drain(Fn&& destroy) {
+        for(Entry& entry : entries) {
+            destroy(entry.item);
+        }
+        entries.clear();
+        unretired = 0;
+    }
+
+    std::size_t size() const noexcept {
+        return entries.size();
+    }
+
+    bool empty() const noexcept {
+        return entries.empty();
+    }
+};
+
+}
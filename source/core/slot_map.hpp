@@ -0,0 +1,131 @@
+// slot_map.hpp: defines SlotMap, a generational slot map: O(1) insert, erase and lookup through
+//     ids that pack a slot index with the slot's generation, so an id outlived by its value (erased,
+//     and the slot reused) is told apart from the slot's new occupant instead of aliasing it
+//     freed slots are kept on an intrusive free list and reused before the slots grow, and slots live in
+//     a deque so growing never moves a value: a pointer from get() stays valid until its id is erased
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <utility>
+
+#include "core/types.hpp"
+
+namespace core {
+
+// generation in the high 32 bits, slot index in the low 32, generations start at 1 so 0 is never an id
+constexpr const core::u64 SlotMapNull{ 0 };
+
+template<typename T>
+class SlotMap {
+    static constexpr core::u32 NoSlot{ ~0u };
+
+    struct Slot {
+        std::optional<T> value{};
+        core::u32 generation{ 1 };
+        // next free slot while empty
+        core::u32 nextFree{ NoSlot };
+    };
+    std::deque<Slot> slots{};
+    core::u32 freeHead{ NoSlot };
+    std::size_t count{ 0 };
+
+public:
+    static constexpr core::u32 index(core::u64 id) noexcept {
+        return static_cast<core::u32>(id);
+    }
+
+    static constexpr core::u32 generation(core::u64 id) noexcept {
+        return static_cast<core::u32>(id >> 32);
+    }
+
+    core::u64 insert(T value) {
+        core::u32 slot = freeHead;
+        if(slot == NoSlot) {
+            slot = static_cast<core::u32>(slots.size());
+            slots.emplace_back();
+        }
+        else {
+            freeHead = slots[slot].nextFree;
+        }
+        Slot& s = slots[slot];
+        s.value.emplace(std::move(value));
+        ++count;
+        return (static_cast<core::u64>(s.generation) << 32) | slot;
+    }
+
+    // nullptr for ids that were erased (or never handed out), valid until the id is erased
+    T* get(core::u64 id) noexcept {
+        const core::u32 slot = index(id);
+        if(slot >= slots.size() || slots[slot].generation != generation(id) || !slots[slot].value.has_value()) {
+            return nullptr;
+        }
+        return &*slots[slot].value;
+    }
+
+    const T* get(core::u64 id) const noexcept {
+        return const_cast<SlotMap*>(this)->get(id);
+    }
+
+    bool contains(core::u64 id) const noexcept {
+        return get(id) != nullptr;
+    }
+
+    // move the value out and free its slot, the id (and any copy of it) goes stale
+    std::optional<T> take(core::u64 id) noexcept {
+        T* value = get(id);
+        if(value == nullptr) {
+            return std::nullopt;
+        }
+        const core::u32 slot = index(id);
+        Slot& s = slots[slot];
+        std::optional<T> result{ std::move(*value) };
+        s.value.reset();
+        // skip 0 on wrap so a recycled id can never be SlotMapNull
+        s.generation = s.generation + 1 == 0 ? 1 : s.generation + 1;
+        s.nextFree = freeHead;
+        freeHead = slot;
+        --count;
+        return result;
+    }
+
+    bool erase(core::u64 id) noexcept {
+        return take(id).has_value();
+    }
+
+    std::size_t size() const noexcept {
+        return count;
+    }
+
+    bool empty() const noexcept {
+        return count == 0;
+    }
+
+    // fn(T&) over every live value, in slot order
+    template<typename Fn>
+    void forEach(Fn&& fn) {
+        for(Slot& s : slots) {
+            if(s.value.has_value()) {
+                fn(*s.value);
+            }
+        }
+    }
+
+    // drop every value, outstanding ids go stale
+    void clear() noexcept {
+        freeHead = NoSlot;
+        for(std::size_t slot = slots.size(); slot > 0; --slot) {
+            Slot& s = slots[slot - 1];
+            if(s.value.has_value()) {
+                s.value.reset();
+                s.generation = s.generation + 1 == 0 ? 1 : s.generation + 1;
+            }
+            s.nextFree = freeHead;
+            freeHead = static_cast<core::u32>(slot - 1);
+        }
+        count = 0;
+    }
+};
+
+}
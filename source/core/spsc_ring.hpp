@@ -0,0 +1,142 @@
+// spsc_ring.hpp: defines SpscRing, a bounded single producer, single consumer ring that drops (and
+//     counts) what it has no room for rather than block the producer, and ThreadRings, a registry
+//     handing each producer thread a ring of its own that one consumer walks
+//     used by the logger and the profiler: every thread records into its own ring, one thread drains them
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/types.hpp"
+
+namespace core {
+
+// one producer thread -> one consumer thread
+template<typename T, std::size_t Size>
+class SpscRing {
+    std::array<T, Size> items{};
+
+    // next slot the producer writes, and the consumer reads
+    alignas(64) std::atomic<std::size_t> head{ 0 };
+    alignas(64) std::atomic<std::size_t> tail{ 0 };
+    // items the producer found no room for since the consumer last looked
+    std::atomic<u64> dropped{ 0 };
+
+public:
+    // producer: slot to fill before commit(), nullptr (and counted) if the ring is full
+    T* reserve() noexcept {
+        const std::size_t h = head.load(std::memory_order_relaxed);
+        if(h - tail.load(std::memory_order_acquire) == Size) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &items[h % Size];
+    }
+
+    // producer: publish the reserved slot, returns the items now waiting on the consumer
+    std::size_t commit() noexcept {
+        const std::size_t h = head.load(std::memory_order_relaxed) + 1;
+        head.store(h, std::memory_order_release);
+        return h - tail.load(std::memory_order_relaxed);
+    }
+
+    // producer: reserve, copy and commit in one, false (and counted) if the ring is full
+    bool push(const T& item) noexcept {
+        T* slot = reserve();
+        if(slot == nullptr) {
+            return false;
+        }
+        *slot = item;
+        commit();
+        return true;
+    }
+
+    // consumer: fn(const T&) over every committed item, returns how many
+    template<typename Fn>
+    std::size_t drain(Fn&& fn) noexcept {
+        std::size_t t = tail.load(std::memory_order_relaxed);
+        const std::size_t h = head.load(std::memory_order_acquire);
+        const std::size_t count = h - t;
+        for(; t != h; ++t) {
+            fn(static_cast<const T&>(items[t % Size]));
+        }
+        tail.store(t, std::memory_order_release);
+        return count;
+    }
+
+    u64 takeDropped() noexcept {
+        return dropped.exchange(0, std::memory_order_relaxed);
+    }
+};
+
+// a ring per producer thread, registered on the thread's first use and never removed
+template<typename Ring>
+class ThreadRings {
+    inline static std::atomic<u64> nextId{ 1 };
+    // tells registries apart in each thread's ring cache
+    const u64 id{ nextId.fetch_add(1, std::memory_order_relaxed) };
+
+    struct Entry {
+        // producer thread, reused by a later thread with the same id once the first exits
+        std::thread::id owner{};
+        std::unique_ptr<Ring> ring{};
+    };
+    std::mutex mutex{};
+    std::vector<Entry> rings{};
+
+public:
+    // the calling thread's ring, make(index) -> std::unique_ptr<Ring> creates it on first use
+    // (under the registry's lock, index: rings registered before it)
+    template<typename Make>
+    Ring& local(Make&& make) {
+        Cached& cached = cache();
+        if(cached.registry == id) {
+            return *cached.ring;
+        }
+        // a thread producing into more than one registry finds its ring again here
+        const std::thread::id self = std::this_thread::get_id();
+        std::lock_guard lock(mutex);
+        Ring* ring = nullptr;
+        for(const Entry& entry : rings) {
+            if(entry.owner == self) {
+                ring = entry.ring.get();
+                break;
+            }
+        }
+        if(ring == nullptr) {
+            rings.push_back({ .owner = self, .ring = make(rings.size()) });
+            ring = rings.back().ring.get();
+        }
+        cached = { .registry = id, .ring = ring };
+        return *ring;
+    }
+
+    // every ring registered so far into out, rings are never removed so they can be drained outside the lock
+    void collect(std::vector<Ring*>& out) {
+        std::lock_guard lock(mutex);
+        out.clear();
+        for(const Entry& entry : rings) {
+            out.push_back(entry.ring.get());
+        }
+    }
+
+private:
+    struct Cached {
+        u64 registry{ 0 };
+        Ring* ring{ nullptr };
+    };
+
+    // the calling thread's last ring, one cache per ring type
+    static Cached& cache() noexcept {
+        thread_local Cached cached{};
+        return cached;
+    }
+};
+
+}
@@ -1,10 +1,14 @@
 // engine/main.cpp: runtime main for deus-vulkan
 
+#include <algorithm>
+#include <cstdlib>
+
 #include <sys/wait.h>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
 #include "core/log/logging.hpp"
+#include "core/profile/profiler.hpp"
 #include "gfx/vulkan/window.hpp"
 
 #include "engine/world/chunk.hpp"
@@ -12,6 +16,7 @@
 
 #include "engine/world/chonker.hpp"
 #include "engine/world/camera.hpp"
+#include "engine/world/height_query.hpp"
 
 #include "gfx/vulkan/constants.hpp"
 #include "gfx/vulkan/config.hpp"
@@ -19,22 +24,31 @@
 
 int main()
 {
-    // Logging
-    core::log::Logger log{};
+    // Logging, per frame debug logs are filtered out
+    core::log::Logger log{ core::log::Level::info };
 
     // GLFW Window
     gfx::vulkan::Window window(log, 800, 600);
 
+    // chunk geometry everything below is built for, the .chunk world must match it
+    using Terrain = engine::world::DefaultChunkTraits;
+
     // Mesh Generator
-    gfx::geometry::GridMesh gridMesh = gfx::geometry::MeshGenerator::createGridMesh(engine::world::CHUNK_RESOLUTION);
+    // lod chain: 33, 17, 9, 5 samples along an edge
+    gfx::geometry::GridMesh gridMesh = gfx::geometry::MeshGenerator::createLodGridMesh<Terrain::resolution>(gfx::vulkan::TERRAIN_LOD_COUNT);
 
     // Chunking System: Chonker
     using namespace engine::world;
     constexpr const std::size_t capacity = 64;
-    Chonker chonker(capacity);
+    // one I/O thread keeping a deep queue of reads in flight, noise terrain past the DEM's edges
+    BasicChonker<Terrain> chonker(capacity, ChunkReadMode::Async, 0, "assets/N40W106.chunk", TerrainNoiseParams{});
     float2 playerPosition{ 152.f, 300.f };
     Chunk playerChunk = worldPositionXZToChunk(playerPosition);
     chonker.request(playerChunk);
+
+    // create a camera, streaming is prioritized around it
+    engine::world::Camera camera{};
+    camera.position = { playerPosition.x, 0.f, playerPosition.y };
     // ChunkData* pChunkData = chonker.fetch(playerChunk);
 
     // Vulkan Configurator
@@ -62,8 +76,20 @@ int main()
     // generate surface
     gfx::vulkan::Surface surface(log, window, *config.getVulkanInstance());
 
-    // pick a physical device
-    std::optional<const gfx::vulkan::PhysicalDeviceHandle> bestPhysicalDevice = config.getBestPhysicalDevice();
+    // pick a physical device: discrete over integrated, then by optional extensions, queues and VRAM
+    // DEUS_GPU=<index, or part of a name if not all digits> overrides the pick
+    const char* preferredDevice = std::getenv("DEUS_GPU");
+    gfx::vulkan::DeviceRequest deviceRequest {
+        .requiredExtensionNames = { VK_KHR_SWAPCHAIN_EXTENSION_NAME },
+        .optionalExtensionNames = {
+            VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME,
+            VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
+            VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME
+        },
+        .surface = surface.get(),
+        .preferredDevice = preferredDevice != nullptr ? preferredDevice : ""
+    };
+    std::optional<const gfx::vulkan::PhysicalDeviceHandle> bestPhysicalDevice = config.getBestPhysicalDevice(deviceRequest);
     if(!bestPhysicalDevice.has_value()) {
         log.error("main", "could not select a physical device");
         return -1;
@@ -74,34 +100,111 @@ int main()
     gfx::vulkan::GpuContext context {
         physicalDevice,
         log,
-        config
+        config,
+        deviceRequest
     };
 
+    // one heightmap layer per pool slot
+    context.CreateHeightmapArray(chonker.getCapacity(), Terrain::resolution);
+
+    // every loaded chunk is an instance of the one grid mesh
+    context.CreateTerrainRenderer(gridMesh, Terrain::spacing, chonker.getCapacity());
+
+    // acquire swapchain: mailbox (or immediate) over vsync, one image more than the surface needs
+    const gfx::vulkan::SwapchainRequest swapchainRequest {
+        .presentPolicy = gfx::vulkan::PresentPolicy::LowLatency,
+        .imageCount = 0
+    };
+    context.AcquireSwapchain(surface.get(), swapchainRequest);
+
+    // instance destroyed on config dropping out of scope
+    // pipelines compile in the background while the first chunks load, the first frame waits on them
+    context.CreateGraphicsPipelineAsync();
+
     while(chonker.getStatus(playerChunk) != ChunkStatus::Loaded) {
+        chonker.update(camera);
         log.info("main","waiting before loading heightmap into GPU...");
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 
-    // create a camera
-    engine::world::Camera camera{};
+    // look out over the terrain from above the player
+    BasicHeightQuery<Terrain> heightQuery(chonker.getPool());
+    const float groundHeight = heightQuery.sample(playerPosition);
+    camera.position = { playerPosition.x, groundHeight + 200.f, playerPosition.y };
+    camera.look = { 1.f, -0.5f, 1.f };
 
-    // copy read heads into a device-local vertex buffer
-    context.CmdBuffers(chonker.fetch(playerChunk)->heights, CHUNK_RESOLUTION, gridMesh);
+    // chunk held by each heightmap layer, a layer is re-uploaded when its pool slot changes hands
+    std::vector<std::optional<Chunk>> layerChunks(chonker.getCapacity());
+    // culling input of each layer's chunk, bounds computed once per upload
+    std::vector<gfx::vulkan::TerrainInstance> layerInstances(chonker.getCapacity());
+    std::vector<gfx::vulkan::TerrainInstance> instances{};
+    instances.reserve(chonker.getCapacity());
 
-    // acquire swapchain
-    context.AcquireSwapchain(surface.get());
+    // largest on-screen error a chunk's lod may have, in pixels
+    constexpr const float pixelTolerance = 2.f;
 
-    // instance destroyed on config dropping out of scope
-    context.CreateGraphicsPipeline();
+    // chunks kept streamed in around the player
+    constexpr const core::i32 viewRadius = 3;
 
+    DEUS_PROFILE_THREAD("main");
     while(!glfwWindowShouldClose(window.get())) {
         glfwPollEvents();
 
-        // todo: on resize: reacquire swapchain
-        context.AcquireSubmitPresent();
+        for(core::i32 dz = -viewRadius; dz <= viewRadius; ++dz) {
+            for(core::i32 dx = -viewRadius; dx <= viewRadius; ++dx) {
+                chonker.request({ .x = playerChunk.x + dx, .z = playerChunk.z + dz });
+            }
+        }
+        chonker.update(camera);
+
+        instances.clear();
+        chonker.forEachLoaded([&](std::size_t poolIndex, const BasicChunkData<Terrain>& data) {
+            if(layerChunks[poolIndex] != data.chunk) {
+                // undrawn until the frames in flight sampling the slot's previous chunk complete
+                if(!context.UploadChunkHeightmap(static_cast<core::u32>(poolIndex), data.getHeights())) {
+                    return;
+                }
+                layerChunks[poolIndex] = data.chunk;
+
+                const float2 origin = chunkToWorldPositionXZ(data.chunk);
+                // precomputed whole-chunk bounds, the pyramid's last level
+                const ChunkBounds bounds = data.getBounds().back();
+                const std::vector<float> errors = gfx::geometry::MeshGenerator::lodErrors<Terrain::resolution>(data.getHeights(), gridMesh.lods);
+                gfx::vulkan::TerrainInstance& instance = layerInstances[poolIndex];
+                instance = {
+                    .originX = origin.x,
+                    .originZ = origin.y,
+                    .minHeight = static_cast<float>(bounds.min),
+                    .maxHeight = static_cast<float>(bounds.max),
+                    .layer = static_cast<core::u32>(poolIndex)
+                };
+                for(std::size_t lod = 1; lod < gfx::vulkan::TERRAIN_LOD_COUNT; ++lod) {
+                    // a mesh without the lod draws its coarsest one in its place
+                    instance.lodError[lod - 1] = errors[std::min(lod, errors.size() - 1)];
+                }
+            }
+            instances.push_back(layerInstances[poolIndex]);
+        });
+        // culled on the GPU, every loaded chunk goes in
+        context.SetTerrainInstances(instances);
+
+        // recreated by the next frame, the extent below may lag a frame behind
+        if(window.takeResized()) {
+            context.RequestSwapchainRecreate();
+        }
+        const VkExtent2D extent = context.GetExtent();
+        const float viewportHeight = static_cast<float>(extent.height);
+        const gfx::vulkan::TerrainView view {
+            .viewProj = camera.proj(viewportHeight, static_cast<float>(extent.width), 1.f, 4096.f) * camera.view(),
+            .eye = camera.position,
+            .errorScale = camera.screenSpaceScale(viewportHeight) / pixelTolerance
+        };
+        context.AcquireSubmitPresent(view);
+        DEUS_PROFILE_FRAME();
     }
 
     context.DestroyGraphicsPipeline();
+    DEUS_PROFILE_EXPORT(PROFILE_TRACE_PATH);
 
     return 0;
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cmath>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -20,6 +22,12 @@ struct Camera {
     glm::mat4 proj(float viewportHeight, float viewportWidth, float nearZ, float farZ) const noexcept {
         return glm::perspective(glm::radians(fovDeg), viewportWidth / viewportHeight, nearZ, farZ);
     }
+
+    // a world-space length l at distance d covers about l * screenSpaceScale(h) / d pixels of a
+    // viewport h pixels tall, used to bound lod error on screen
+    float screenSpaceScale(float viewportHeight) const noexcept {
+        return viewportHeight / (2.f * std::tan(glm::radians(fovDeg) * 0.5f));
+    }
 };
 
 }
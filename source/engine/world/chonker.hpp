@@ -1,46 +1,144 @@
 // chonker.hpp: defines the Chonker class which manages a ChunkPool and ChunkQueue to give
 //     rendering logic an easy way to request/fetch chunks to load that will trigger async file reads
 //     from worker threads all managed internally to this class
+//     requests are held by a ChunkScheduler and handed to workers nearest-first on update(camera)
+//     in ChunkReadMode::Async a single I/O thread keeps a deep queue of reads in flight through ChunkIO instead
+//     one Chonker streams one chunk resolution (ChunkTraits), worlds built for another fail to open
+//     with a ChunkGenerator, chunks the world has no data for are generated on the worker threads instead
+//     of dropped, so the terrain never has holes and synthetic regions never touch the disk
+//     (in ChunkReadMode::Async the I/O thread hands them to a pool of generator threads, so generation
+//     runs in parallel and never holds up read submission)
 #pragma once
 
 #include <cassert>
 
+#include <chrono>
 #include <iostream>
-#include <fstream>
+#include <optional>
 #include <thread>
+#include <vector>
 
+#include "core/profile/profiler.hpp"
+#include "engine/world/camera.hpp"
 #include "engine/world/chunk.hpp"
 #include "engine/world/chunk_data.hpp"
+#include "engine/world/chunk_generator.hpp"
+#include "engine/world/chunk_io.hpp"
+#include "engine/world/chunk_world.hpp"
 #include "engine/world/chunk_pool.hpp"
 #include "engine/world/chunk_queue.hpp"
+#include "engine/world/chunk_scheduler.hpp"
 
 namespace engine::world
 {
 
-class Chonker {
+// how loaded chunks get their heights out of the mapped .chunk file
+enum class ChunkReadMode : core::u32 {
+    // workers copy heights into the pool slot
+    Copy = 0,
+    // pool slots point straight at the mapped pages, no worker round trip
+    Mapped = 1,
+    // one thread batches reads through ChunkIO (io_uring where there is one) straight into pool slots
+    Async = 2
+};
+
+// most chunk reads in flight at once in ChunkReadMode::Async
+constexpr const std::size_t CHUNK_IO_DEPTH = 64;
+
+// request/update/cancel/getStatus are called from a single (render) thread
+template<ChunkGeometry Traits>
+class BasicChonker {
+public:
+    using Pool = BasicChunkPool<Traits>;
+    using Data = BasicChunkData<Traits>;
+
+private:
     // chunk pool arena allocator, with a loaded list
-    ChunkPool pool;
-    // async pub/sub queue for worker threads
+    Pool pool;
+    // lock-free pub/sub ring for worker threads
     ChunkQueue queue;
+    // requests waiting for a worker, ordered by camera distance
+    ChunkScheduler scheduler;
+    // chunks the workers gave up on, their slots are unloaded by the render thread on its next update
+    // note: every entry still holds its pool slot, so a ring as large as the pool never fills either
+    ChunkQueue failedChunks;
+    // chunks the I/O thread hands to the generator threads, ChunkReadMode::Async with a generator only
+    ChunkQueue generateQueue;
+
+    // chunks handed to workers and not yet loaded, capped at dispatchDepth
+    // so new requests near the camera don't wait behind a deep queue of stale ones
+    std::atomic<std::size_t> inFlight{ 0 };
+    // dispatch only runs once per update, so the cap is a per-frame budget: it starts at baseDepth,
+    // doubles while the workers drain all of it between frames and halves back while they fall behind
+    std::size_t dispatchDepth{ 0 };
+    std::size_t baseDepth{ 0 };
+    // the last dispatch stopped at the cap with requests still pending
+    bool saturated{ false };
+
+    // memory-mapped chunked heightmaps and their index, opened once for all workers
+    ChunkWorld file;
+    ChunkReadMode readMode;
 
-    // chunk reading offsets
-    std::unordered_map<Chunk, std::size_t, ChunkHash> fileOffsets;
+    // procedural fallback for chunks outside the world, without one they can't be requested
+    std::optional<ChunkGenerator<Traits>> generator{};
+
+    // pool slots reclaimed by LRU eviction
+    std::atomic<std::size_t> evictions{ 0 };
+    // chunks filled by the generator
+    std::atomic<std::size_t> generated{ 0 };
+    // chunks the world couldn't supply (read failed, short or malformed) and nothing generated
+    // note: counted rather than logged, a bad record fails again on every re-request
+    std::atomic<std::size_t> failures{ 0 };
+    // when each pool slot's chunk became Loaded, in steady_clock ticks, written by whichever thread loaded it
+    std::vector<std::atomic<std::chrono::steady_clock::rep>> loadedAt;
+
+    // async reads, ChunkReadMode::Async only
+    // note: declared before the workers so it outlives the I/O thread
+    std::optional<ChunkIO> io{};
 
     // worker threads for reading chunks
     std::vector<std::jthread> workers;
 
 public:
-    Chonker(const std::size_t chunkPoolCapacity)
-        : pool(chunkPoolCapacity)
+    // numWorkers = 0 spawns one worker per hardware thread
+    // (ChunkReadMode::Async spawns a single I/O thread, numWorkers sizes ChunkIO's pread fallback
+    // and, with terrain, the generator threads)
+    // worldFilename: a world index (.world) or a single .chunk file
+    // terrain: generate the chunks the world doesn't have from these noise params
+    BasicChonker(const std::size_t chunkPoolCapacity, ChunkReadMode readMode = ChunkReadMode::Copy, std::size_t numWorkers = 0,
+        const char* worldFilename = "assets/N40W106.chunk", std::optional<TerrainNoiseParams> terrain = std::nullopt)
+        // every queued chunk holds a Loading pool slot, so a ring as large as the pool never fills
+        : pool(chunkPoolCapacity), queue(pool.capacity()), failedChunks(pool.capacity()), generateQueue(pool.capacity()), file(worldFilename, static_cast<core::u32>(Traits::resolution)),
+          readMode(readMode), loadedAt(pool.capacity())
     {
-        // read the fileOffsets
-        readOffsets();
+        std::cout << "chonker: mapped " << file.size() << " chunks... \n";
+        if(terrain.has_value()) {
+            generator.emplace(*terrain);
+        }
 
         // spawn the chunking system worker threads
-        const int num_workers = 1;
-        workers.reserve(num_workers);
+        if(numWorkers == 0) {
+            numWorkers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if(readMode == ChunkReadMode::Async) {
+            dispatchDepth = baseDepth = std::min(CHUNK_IO_DEPTH, queue.capacity());
+            io.emplace(dispatchDepth, numWorkers);
+            workers.reserve(1 + (generator.has_value() ? numWorkers : 0));
+            workers.emplace_back([this](std::stop_token st) {
+                this->ioWorker(st);
+            });
+            for(std::size_t i = 0; generator.has_value() && i < numWorkers; ++i) {
+                workers.emplace_back([this](std::stop_token st) {
+                    this->generateWorker(st);
+                });
+            }
+            return;
+        }
+
+        workers.reserve(numWorkers);
+        dispatchDepth = baseDepth = std::min(2 * numWorkers, queue.capacity());
 
-        for (std::size_t i = 0; i < num_workers; ++i) {
+        for (std::size_t i = 0; i < numWorkers; ++i) {
             workers.emplace_back(
                 [this](std::stop_token st, std::size_t id){
                     this->worker(st, id);
@@ -50,106 +148,467 @@ public:
         }
     }
 
-    ~Chonker() {
+    ~BasicChonker() {
         // stop all
-        queue.notify_all();
-        // wake any sleeping threads
         for (auto& w : workers) {
             w.request_stop();
         }
+        // wake any parked threads so they observe the stop, chunks still queued are dropped with the pool
+        queue.notify_all();
+        generateQueue.notify_all();
     }
 
-    void request(Chunk c) noexcept {
-        // todo: check if we've already loaded it
+    std::size_t getNumWorkers() const noexcept {
+        return workers.size();
+    }
 
-        // no data in negative chunks for now
-        // we currently use the chunk coords to map to specific file
-        // offsets, but we could something else
-        if(c.x < 0 or c.z < 0) {
-            return;
+    // queue a chunk to be read (or generated) on a following update(), returns false for chunks we have
+    // no data for and can't generate
+    bool request(Chunk c) noexcept {
+        // O(1) through the world index, which also covers negative chunk coords
+        const bool stored = file.contains(c);
+        if(!stored and (!generator.has_value() or !ChunkTable::representable(c))) {
+            return false;
+        }
+        // already loaded or in flight: keep it warm
+        std::optional<std::size_t> poolIndex = pool.getPoolIndex(c);
+        if(poolIndex.has_value()) {
+            pool.touch(*poolIndex);
+            return true;
+        }
+
+        // zero-copy: no I/O to schedule, point a slot at the mapping and skip the workers entirely
+        // (encoded shards, or ones without precomputed normals and bounds, have nothing to view: their
+        // chunks still go through the workers)
+        if(readMode == ChunkReadMode::Mapped and stored) {
+            const ChunkView view = file.view(c);
+            if(!view.heights.empty() && !view.normals.empty() && !view.bounds.empty()) {
+                std::optional<ChunkPoolRequest> slot = acquireSlot(c);
+                if(slot.has_value()) {
+                    Data& data = pool.getChunkData(slot->poolIndex);
+                    data.mapped = view.heights;
+                    data.mappedNormals = view.normals;
+                    data.mappedBounds = view.bounds;
+                    stampLoaded(slot->poolIndex);
+                    pool.setChunkStatus(c, ChunkStatus::Loaded);
+                    // start paging the chunk in before the renderer touches it
+                    file.prefetch(c);
+                    return true;
+                }
+            }
         }
-        // allocate space in the pool arena allocator, init ChunkData
-        pool.request(c);
-        queue.push(c);
+
+        scheduler.push(c);
+        return true;
+    }
+
+    // drop a request that has not been handed to a worker yet
+    bool cancel(Chunk c) noexcept {
+        return scheduler.cancel(c);
+    }
+
+    // once per frame: re-score pending requests against the camera, cancel out of range ones
+    // and hand the most urgent to the workers
+    void update(const Camera& camera) noexcept {
+        DEUS_PROFILE_ZONE("chonker/update");
+        scheduler.update(camera);
+        reclaimFailed();
+        dispatch();
+    }
+
+    void setStreamingParams(const StreamingParams& params) noexcept {
+        scheduler.setParams(params);
     }
 
     ChunkStatus getStatus(Chunk c) noexcept {
-        return pool.getChunkStatus(c);
+        ChunkStatus status = pool.getChunkStatus(c);
+        // pending requests are loading as far as callers are concerned
+        if(status == ChunkStatus::Unloaded and scheduler.contains(c)) {
+            return ChunkStatus::Loading;
+        }
+        return status;
+    }
+
+    std::size_t getPendingCount() const noexcept {
+        return scheduler.size();
+    }
+
+    // number of pending requests cancelled, explicitly or by falling out of range
+    std::size_t getCancellationCount() const noexcept {
+        return scheduler.getCancellationCount();
     }
 
-    ChunkData* fetch(Chunk c) noexcept {
+    Data* fetch(Chunk c) noexcept {
         // check that this chunk has valid loaded ChunkData
         if(getStatus(c) == ChunkStatus::Unloaded) {
             return nullptr;
         }
         // get the pool index
-        std::size_t poolIndex = *pool.getPoolIndex(c);
-        // return ptr into the pool
-        // todo: safety of returning a ptr into an std::vector?
-        return &pool.getChunkData(poolIndex);
+        std::optional<std::size_t> poolIndex = pool.getPoolIndex(c);
+        if(!poolIndex.has_value()) {
+            return nullptr;
+        }
+        pool.touch(*poolIndex);
+        // return ptr into the pool, valid until a later request() evicts it
+        return &pool.getChunkData(*poolIndex);
+    }
+
+    // pool slot of a loaded or loading chunk, stable until the chunk is evicted
+    // GPU-side per-chunk storage (heightmap layers) is indexed the same way
+    std::optional<std::size_t> getPoolIndex(Chunk c) const noexcept {
+        return pool.getPoolIndex(c);
+    }
+
+    std::size_t getCapacity() const noexcept {
+        return pool.capacity();
+    }
+
+    // neighbour-aware height/normal lookups across loaded chunks, see ChunkPool::sampleHeight
+    // and HeightQuery for batches of world positions
+    const Pool& getPool() const noexcept {
+        return pool;
     }
 
-    void generate() noexcept {
-        const char * filename = "assets/N40W106.hgt";
-        std::ifstream fin(filename, std::ios_base::binary);
+    // the chunk index requests are checked against
+    const ChunkWorld& getWorld() const noexcept {
+        return file;
+    }
+
+    // visit every Loaded chunk as fn(poolIndex, const Data&), without touching their LRU order
+    // note: walks the loaded list, so must not interleave with request() or update() on another thread
+    template<typename Fn>
+    void forEachLoaded(Fn&& fn) noexcept {
+        for(std::size_t poolIndex : pool.getRequestedChunkIds()) {
+            if(pool.getSlotStatus(poolIndex) == ChunkStatus::Loaded) {
+                fn(poolIndex, static_cast<const Data&>(pool.getChunkData(poolIndex)));
+            }
+        }
+    }
+
+    // number of chunks evicted from the pool to make room for new requests
+    std::size_t getEvictionCount() const noexcept {
+        return evictions.load(std::memory_order_relaxed);
+    }
+
+    // number of chunks filled by the generator rather than read from the world
+    std::size_t getGeneratedCount() const noexcept {
+        return generated.load(std::memory_order_relaxed);
+    }
+
+    // number of chunk loads that failed and were handed back unloaded
+    std::size_t getFailureCount() const noexcept {
+        return failures.load(std::memory_order_relaxed);
+    }
+
+    // when chunk c finished loading, or nullopt if it isn't Loaded
+    // note: stamped by the thread that loaded it, so it isn't rounded up to the next update()
+    std::optional<std::chrono::steady_clock::time_point> getLoadedTime(Chunk c) const noexcept {
+        std::optional<std::size_t> poolIndex = pool.getPoolIndex(c);
+        // the status load orders the stamp before it
+        if(!poolIndex.has_value() or pool.getChunkStatus(c) != ChunkStatus::Loaded) {
+            return std::nullopt;
+        }
+        const std::chrono::steady_clock::rep ticks = loadedAt[*poolIndex].load(std::memory_order_relaxed);
+        return std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(ticks));
+    }
+
+    bool isGenerating() const noexcept {
+        return generator.has_value();
     }
 
 private:
-    // initialize chunk -> file offsets for worker reads
-    void readOffsets() noexcept {
-        const char * chunkFilename = "assets/N40W106.chunk";
-        std::ifstream fin(chunkFilename, std::ios::binary);
+    // pool slot for a new chunk, counting any eviction it caused
+    std::optional<ChunkPoolRequest> acquireSlot(Chunk c) noexcept {
+        std::optional<ChunkPoolRequest> slot = pool.request(c);
+        if(slot.has_value() and slot->evicted.has_value()) {
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+        return slot;
+    }
 
-        // read number of chunks
-        std::uint64_t numChunks{};
-        fin.read(reinterpret_cast<char*>(&numChunks), sizeof(numChunks));
+    // fill a chunk the world has no data for, no I/O involved
+    void generate(Chunk c, Data& data) noexcept {
+        DEUS_PROFILE_ZONE("chonker/generate");
+        generator->generate(c, file, data);
+        generated.fetch_add(1, std::memory_order_relaxed);
+    }
 
-        std::cout << "chonker: gonna read " << numChunks << " chunks... \n";
+    // record when a slot's chunk finished loading, before the status store that publishes it
+    void stampLoaded(std::size_t poolIndex) noexcept {
+        loadedAt[poolIndex].store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    }
+
+    // a worker is done with chunk c
+    void loaded(Chunk c) noexcept {
+        if(std::optional<std::size_t> poolIndex = pool.getPoolIndex(c); poolIndex.has_value()) {
+            stampLoaded(*poolIndex);
+        }
+        pool.setChunkStatus(c, ChunkStatus::Loaded);
+        inFlight.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    // the world couldn't supply chunk c (read failed, short or malformed): make it up if there's a
+    // generator, otherwise hand the slot back so a later request retries it instead of drawing stale data
+    // note: runs on worker/I/O threads, which must not touch the loaded list, so the slot is only marked
+    // Unloaded here (never drawn, never evicted) and released by reclaimFailed() on the render thread
+    void failed(Chunk c, Data& data) noexcept {
+        if(generator.has_value() and readMode == ChunkReadMode::Async) {
+            generateLater(c, data);
+            return;
+        }
+        if(generator.has_value()) {
+            generate(c, data);
+            loaded(c);
+            return;
+        }
+        failures.fetch_add(1, std::memory_order_relaxed);
+        pool.setChunkStatus(c, ChunkStatus::Unloaded);
+        failedChunks.push(c);
+        inFlight.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    // ChunkReadMode::Async: queue chunk c for the generator threads, the I/O thread goes back to its reads
+    void generateLater(Chunk c, Data& data) noexcept {
+        // every queued chunk holds a pool slot and the ring is as large as the pool, so this can't fail
+        if(!generateQueue.push(c)) {
+            generate(c, data);
+            loaded(c);
+        }
+    }
 
-        // read TOC for each entry, store in map
-        ChunkTOC chunkTOC{};
-        for(std::uint64_t c = 0; c < numChunks; ++c) {
-            fin.read(reinterpret_cast<char*>(&chunkTOC), sizeof(chunkTOC));
-            Chunk chunk {
-                .x = chunkTOC.chunkX,
-                .z = chunkTOC.chunkZ
-            };
-            fileOffsets[chunk] = chunkTOC.offset;
+    // release the slots of chunks the workers failed since the last update
+    void reclaimFailed() noexcept {
+        Chunk c{};
+        while(failedChunks.tryPop(c)) {
+            pool.unload(c);
+        }
+    }
+
+    // size this frame's budget from how the last one went
+    void resizeDispatch() noexcept {
+        const std::size_t left = inFlight.load(std::memory_order_acquire);
+        if(saturated and left == 0) {
+            // the workers went idle waiting for this frame
+            dispatchDepth = std::min(2 * dispatchDepth, queue.capacity());
+        }
+        else if(left > dispatchDepth / 2) {
+            dispatchDepth = std::max(dispatchDepth / 2, baseDepth);
+        }
+    }
+
+    void dispatch() noexcept {
+        resizeDispatch();
+        saturated = false;
+        Chunk c{};
+        while(scheduler.size() > 0) {
+            if(inFlight.load(std::memory_order_acquire) >= dispatchDepth) {
+                saturated = true;
+                return;
+            }
+            if(!scheduler.pop(c)) {
+                return;
+            }
+            // a full pool evicts its least recently used chunk
+            std::optional<ChunkPoolRequest> slot = acquireSlot(c);
+            if(!slot.has_value()) {
+                // every slot is still loading, try again next frame
+                scheduler.unpop(c);
+                return;
+            }
+            if(!slot->inserted) {
+                continue;
+            }
+
+            // start paging the chunk in while it waits for a worker (async reads are their own prefetch)
+            if(readMode != ChunkReadMode::Async) {
+                file.prefetch(c);
+            }
+
+            inFlight.fetch_add(1, std::memory_order_acq_rel);
+            if(!queue.push(c)) {
+                inFlight.fetch_sub(1, std::memory_order_acq_rel);
+                // no worker will ever fill the slot, so hand it straight back
+                pool.setChunkStatus(c, ChunkStatus::Unloaded);
+                pool.unload(c);
+                scheduler.unpop(c);
+                return;
+            }
         }
     }
 
     // worker thread function (called from lambda)
     void worker(std::stop_token st, std::size_t workerThreadID) noexcept {
+        DEUS_PROFILE_THREAD("chonker/worker");
         Chunk c{};
         // wait until we are notified to pop a chunk off the queue
         while (this->queue.pop(c, st)) {
+            DEUS_PROFILE_ZONE("chonker/load");
             // load chunk c
-            printf("chonker: chunk (%d,%d) requested\n",c.x,c.z);
-
             // get reference from thread pool
             std::optional<std::size_t> poolIndexOpt = pool.getPoolIndex(c);
             if(!poolIndexOpt.has_value()) {
-                // todo: very bad
-                assert(false && "very bad");
+                // a queued chunk holds its slot until a worker is done with it
+                assert(false && "queued chunk without a pool slot");
+                inFlight.fetch_sub(1, std::memory_order_acq_rel);
+                continue;
             }
             std::size_t poolIndex = *poolIndexOpt;
 
-            ChunkData& data = pool.getChunkData(poolIndex);
+            Data& data = pool.getChunkData(poolIndex);
 
-            const char * filename = "assets/N40W106.chunk";
-            std::ifstream fin(filename, std::ios_base::binary);
-
-            // set offset to chunk coordinate
-            std::size_t offset = fileOffsets.at(data.chunk);
-            fin.seekg(offset, std::ios::beg);
-            // read all data into the chunk
-            fin.read(reinterpret_cast<char*>(data.heights.data()), sizeof(int16_t) * data.heights.size());
+            // copy or decode heights (and normals, bounds) out of the mapping straight into the chunk,
+            // or make them up for chunks outside the world
+            if(!file.contains(c) && generator.has_value()) {
+                generate(c, data);
+            }
+            else if(!file.read(c, data)) {
+                failed(c, data);
+                continue;
+            }
 
             // mark chunk c fully loaded
-            pool.setChunkStatus(c, ChunkStatus::Loaded);
+            loaded(c);
         }
         printf("Worker %lu exiting\n", workerThreadID);
     }
+
+    // generator thread function, ChunkReadMode::Async only: fills the chunks the I/O thread hands over
+    void generateWorker(std::stop_token st) noexcept {
+        DEUS_PROFILE_THREAD("chonker/generator");
+        Chunk c{};
+        while(generateQueue.pop(c, st)) {
+            std::optional<std::size_t> poolIndex = pool.getPoolIndex(c);
+            if(!poolIndex.has_value()) {
+                assert(false && "queued chunk without a pool slot");
+                inFlight.fetch_sub(1, std::memory_order_acq_rel);
+                continue;
+            }
+            generate(c, pool.getChunkData(*poolIndex));
+            loaded(c);
+        }
+    }
+
+    // async I/O thread function: pops every queued chunk it has room for, submits their reads in one
+    // batch, then decodes whatever completed into the pool slots
+    void ioWorker(std::stop_token st) noexcept {
+        DEUS_PROFILE_THREAD("chonker/io");
+        struct PendingRead {
+            Chunk chunk{};
+            const ChunkFile* shard{ nullptr };
+            std::byte* buffer{ nullptr };
+            Data* data{ nullptr };
+        };
+        const std::size_t depth = io->getDepth();
+        // records that can't be read straight into their slot (encoded ones) land here, one per tag
+        constexpr std::size_t stagingBytes = chunkRecordMaxBytes(Traits::resolution);
+        constexpr std::size_t heightsBytes = chunkHeightsBytes(Traits::resolution);
+        std::vector<std::byte> staging(depth * stagingBytes);
+        std::vector<PendingRead> reads(depth);
+        std::vector<core::u64> freeTags{};
+        freeTags.reserve(depth);
+        for(std::size_t tag = depth; tag > 0; --tag) {
+            freeTags.push_back(tag - 1);
+        }
+        std::vector<ChunkIORead> batch{};
+        batch.reserve(depth);
+        std::size_t outstanding = 0;
+
+        auto prepare = [&](Chunk c) {
+            std::optional<std::size_t> poolIndex = pool.getPoolIndex(c);
+            if(!poolIndex.has_value()) {
+                assert(false && "queued chunk without a pool slot");
+                inFlight.fetch_sub(1, std::memory_order_acq_rel);
+                return;
+            }
+            Data& data = pool.getChunkData(*poolIndex);
+            // no read to batch, the generator threads fill it
+            if(!file.contains(c) && generator.has_value()) {
+                generateLater(c, data);
+                return;
+            }
+            std::optional<ChunkRecord> record = file.locate(c);
+            if(!record.has_value() || record->bytes == 0 || record->bytes > stagingBytes) {
+                failed(c, data);
+                return;
+            }
+            // callers keep outstanding + batch under depth, so a tag is always free
+            assert(!freeTags.empty() && "more reads prepared than the ring is deep");
+            const core::u64 tag = freeTags.back();
+            freeTags.pop_back();
+
+            // bare raw records go straight into the slot's heights, no copy
+            const bool direct = record->shard->getEncoding() == ChunkEncoding::Raw
+                && record->shard->getSections() == 0
+                && record->bytes == heightsBytes;
+            std::byte* buffer = direct ? reinterpret_cast<std::byte*>(data.heights.data()) : staging.data() + tag * stagingBytes;
+            reads[tag] = { .chunk = c, .shard = record->shard, .buffer = buffer, .data = &data };
+            batch.push_back({
+                .descriptor = record->shard->getDescriptor(),
+                .offset = record->offset,
+                .buffer = buffer,
+                .bytes = static_cast<core::u32>(record->bytes),
+                .tag = tag
+            });
+        };
+
+        auto complete = [&](const ChunkIOCompletion& completion) {
+            DEUS_PROFILE_ZONE("chonker/decode");
+            PendingRead& read = reads[completion.tag];
+            const bool direct = read.buffer == reinterpret_cast<std::byte*>(read.data->heights.data());
+            bool valid = completion.result > 0;
+            if(valid && direct) {
+                valid = static_cast<std::size_t>(completion.result) == heightsBytes;
+                if(valid) {
+                    deriveChunkSurface(*read.data);
+                }
+            }
+            else if(valid) {
+                valid = read.shard->decode(
+                    std::span<const std::byte>(read.buffer, static_cast<std::size_t>(completion.result)),
+                    *read.data
+                );
+            }
+            if(valid) {
+                loaded(read.chunk);
+            }
+            else {
+                failed(read.chunk, *read.data);
+            }
+            freeTags.push_back(completion.tag);
+            --outstanding;
+        };
+
+        for(;;) {
+            Chunk c{};
+            // park on the queue only when there's nothing to reap
+            if(outstanding == 0) {
+                if(!queue.pop(c, st)) {
+                    break;
+                }
+                prepare(c);
+            }
+            while(outstanding + batch.size() < depth && queue.tryPop(c)) {
+                prepare(c);
+            }
+
+            if(!batch.empty()) {
+                DEUS_PROFILE_ZONE("chonker/submit");
+                outstanding += batch.size();
+                io->submit(batch);
+                batch.clear();
+            }
+            if(outstanding > 0) {
+                io->reap(complete, 1);
+            }
+        }
+        // buffers must outlive every read still in flight
+        while(outstanding > 0) {
+            io->reap(complete, 1);
+        }
+        printf("chonker: I/O thread exiting\n");
+    }
 };
 
+using Chonker = BasicChonker<DefaultChunkTraits>;
+
 }
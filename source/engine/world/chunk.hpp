@@ -1,21 +1,52 @@
 #pragma once
 
 #include <algorithm>
+#include <bit>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
 
 #include "engine/world/types.hpp"
 
 namespace engine::world {
 
 // size of chunks in world space
+// note: the same for every ChunkTraits, so chunks of any resolution share one chunk grid
 constexpr const core::i32 CHUNK_SIZE = 32;
 
+// sample geometry of a chunk: Resolution samples along an edge, CHUNK_SIZE world units wide
+// every loop over a chunk's samples is bounded by these at compile time, so sampling, surface
+// derivation, the codec and mesh generation are specialized (and unrolled) per resolution
+template<core::i32 Resolution>
+struct ChunkTraits {
+    // pyramid cells of 8x8 quads and lod chains need a power of two quads, u16 mesh indices cap it
+    static_assert(Resolution >= 9 && Resolution <= 129 && std::has_single_bit(static_cast<core::u32>(Resolution - 1)),
+        "chunk resolution must be 2^k + 1 in [9, 129]");
+
+    // samples along an edge
+    static constexpr core::i32 resolution = Resolution;
+    // quads along an edge, edge samples are shared with the neighbouring chunk
+    static constexpr core::i32 cells = Resolution - 1;
+    static constexpr std::size_t samples = static_cast<std::size_t>(Resolution * Resolution);
+    // world distance between neighbouring samples
+    static constexpr float spacing = static_cast<float>(CHUNK_SIZE) / static_cast<float>(cells);
+};
+
+template<typename T>
+concept ChunkGeometry = std::same_as<T, ChunkTraits<T::resolution>>;
+
+// one sample per world unit, what every .chunk file before version 4 holds
+using DefaultChunkTraits = ChunkTraits<33>;
+// coarse far field: a sample every 2 world units
+using FarChunkTraits = ChunkTraits<17>;
+// dense near field: a sample every half world unit
+using NearChunkTraits = ChunkTraits<65>;
+
 // sample resolution of chunks
-constexpr const core::i32 CHUNK_RESOLUTION = 33;
+constexpr const core::i32 CHUNK_RESOLUTION = DefaultChunkTraits::resolution;
 
-// chunk coordinate
+// chunk coordinate, 8 bytes: packs into queue cells, table keys and ChunkData without padding
 struct Chunk {
-    alignas(std::hardware_destructive_interference_size)
-
     core::i32 x{ 0 };
     core::i32 z{ 0 };
 
@@ -24,6 +55,27 @@ struct Chunk {
         return (x == other.x) and (z == other.z);
     }
 };
+static_assert(sizeof(Chunk) == 8);
+
+// x in the high 32 bits, z in the low 32, both as their two's complement bit patterns
+inline core::u64 chunkKey(Chunk chunk) noexcept {
+    return (static_cast<core::u64>(static_cast<core::u32>(chunk.x)) << 32) | static_cast<core::u32>(chunk.z);
+}
+
+inline Chunk chunkFromKey(core::u64 key) noexcept {
+    return { .x = static_cast<core::i32>(static_cast<core::u32>(key >> 32)), .z = static_cast<core::i32>(static_cast<core::u32>(key)) };
+}
+
+// murmur3 finalizer: every key bit affects every hash bit, so neighbouring (and negative)
+// coordinates spread across a table instead of clustering in its low or high bits
+inline core::u64 mixChunkKey(core::u64 key) noexcept {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
 
 // local coordinates inside chunk
 struct ChunkLocal {
@@ -61,11 +113,11 @@ inline float2 chunkLocalPositionToWorldPositionXZ(ChunkLocal chunkLocal) noexcep
     return chunkToWorldPositionXZ(chunkLocal.chunk) + chunkLocal.local;
 }
 
-inline int2 chunkLocalPositionToSample(float2 chunkLocalPositionXZ) noexcept {
-    float spacing = static_cast<float>(CHUNK_SIZE) / static_cast<float>(CHUNK_RESOLUTION - 1);
+template<ChunkGeometry Traits = DefaultChunkTraits>
+int2 chunkLocalPositionToSample(float2 chunkLocalPositionXZ) noexcept {
     return {
-        .x = std::clamp(static_cast<core::i32>(chunkLocalPositionXZ.x / spacing), 0, CHUNK_RESOLUTION - 1),
-        .y = std::clamp(static_cast<core::i32>(chunkLocalPositionXZ.y / spacing), 0, CHUNK_RESOLUTION - 1)
+        .x = std::clamp(static_cast<core::i32>(chunkLocalPositionXZ.x / Traits::spacing), 0, Traits::resolution - 1),
+        .y = std::clamp(static_cast<core::i32>(chunkLocalPositionXZ.y / Traits::spacing), 0, Traits::resolution - 1)
     };
 }
 
@@ -0,0 +1,193 @@
+// chunk_codec.hpp: encoder/decoder for ChunkEncoding::Delta chunk records
+//     each sample is predicted from its up, left and up-left neighbours (h[z-1][x] + h[z][x-1] - h[z-1][x-1]),
+//     the residuals are zigzagged and bitpacked at one width per row. Decoding a row is a prefix sum of
+//     its residuals added onto the row above, both done 8 samples at a time where there is SIMD
+//
+// Record Layout
+// [BASE] - i16, the first sample; the row above row 0 is taken to be all base
+// [WIDTHS] - resolution u8, bits per residual of each row (<= 16)
+// [ROWS] - per row, resolution residuals packed LSB first, padded to a byte
+// [PAD] - 8 zero bytes, so the decoder can always read a whole u64 window
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "engine/world/chunk.hpp"
+
+namespace engine::world {
+
+// largest Delta record: every row at 16 bits
+constexpr inline std::size_t chunkEncodedMaxBytes(std::size_t resolution) noexcept {
+    return sizeof(core::i16) + resolution + resolution * resolution * sizeof(core::u16) + sizeof(core::u64);
+}
+
+// smallest Delta record: every row at 0 bits
+constexpr inline std::size_t chunkEncodedMinBytes(std::size_t resolution) noexcept {
+    return sizeof(core::i16) + resolution + sizeof(core::u64);
+}
+
+namespace codec {
+
+// arithmetic is mod 2^16 throughout, so any i16 input (voids included) round trips
+inline core::u16 zigzag(core::u16 r) noexcept {
+    return static_cast<core::u16>((r << 1) ^ static_cast<core::u16>(static_cast<core::i16>(r) >> 15));
+}
+
+inline core::u16 unzigzag(core::u16 v) noexcept {
+    return static_cast<core::u16>((v >> 1) ^ static_cast<core::u16>(0u - (v & 1u)));
+}
+
+// samples of one row, rounded up to whole vectors
+constexpr inline std::size_t rowLanes(std::size_t resolution) noexcept {
+    return (resolution + 7) / 8 * 8;
+}
+
+// prev[x] += prefix sum of unzigzag(v[0..x]), over Lanes samples
+template<std::size_t Lanes>
+void accumulateRow(const core::u16* v, core::u16* prev) noexcept {
+#if defined(__ARM_NEON)
+    const uint16x8_t zero = vdupq_n_u16(0);
+    const uint16x8_t one = vdupq_n_u16(1);
+    uint16x8_t carry = zero;
+    for(std::size_t i = 0; i < Lanes; i += 8) {
+        uint16x8_t x = vld1q_u16(v + i);
+        x = veorq_u16(vshrq_n_u16(x, 1), vsubq_u16(zero, vandq_u16(x, one)));
+        x = vaddq_u16(x, vextq_u16(zero, x, 7));
+        x = vaddq_u16(x, vextq_u16(zero, x, 6));
+        x = vaddq_u16(x, vextq_u16(zero, x, 4));
+        x = vaddq_u16(x, carry);
+        carry = vdupq_n_u16(vgetq_lane_u16(x, 7));
+        vst1q_u16(prev + i, vaddq_u16(vld1q_u16(prev + i), x));
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi16(1);
+    __m128i carry = zero;
+    for(std::size_t i = 0; i < Lanes; i += 8) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+        x = _mm_xor_si128(_mm_srli_epi16(x, 1), _mm_sub_epi16(zero, _mm_and_si128(x, one)));
+        x = _mm_add_epi16(x, _mm_slli_si128(x, 2));
+        x = _mm_add_epi16(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi16(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi16(x, carry);
+        // broadcast lane 7
+        carry = _mm_shufflehi_epi16(x, 0xFF);
+        carry = _mm_unpackhi_epi64(carry, carry);
+        __m128i* p = reinterpret_cast<__m128i*>(prev + i);
+        _mm_storeu_si128(p, _mm_add_epi16(_mm_loadu_si128(p), x));
+    }
+#else
+    core::u16 acc = 0;
+    for(std::size_t i = 0; i < Lanes; ++i) {
+        acc = static_cast<core::u16>(acc + unzigzag(v[i]));
+        prev[i] = static_cast<core::u16>(prev[i] + acc);
+    }
+#endif
+}
+
+}
+
+// append a Delta record of heights (Traits::samples) to out
+template<ChunkGeometry Traits = DefaultChunkTraits>
+void encodeChunkDelta(std::span<const core::i16> heights, std::vector<std::byte>& out) {
+    constexpr std::size_t N = Traits::resolution;
+    const core::u16 base = static_cast<core::u16>(heights[0]);
+    auto h = [&](std::size_t x, std::size_t z) {
+        return static_cast<core::u16>(heights[z * N + x]);
+    };
+
+    std::array<std::array<core::u16, N>, N> residuals{};
+    std::array<std::uint8_t, N> widths{};
+    for(std::size_t z = 0; z < N; ++z) {
+        core::u16 widest = 0;
+        for(std::size_t x = 0; x < N; ++x) {
+            const core::u16 up = z > 0 ? h(x, z - 1) : base;
+            core::u16 r = static_cast<core::u16>(h(x, z) - up);
+            if(x > 0) {
+                const core::u16 upLeft = z > 0 ? h(x - 1, z - 1) : base;
+                r = static_cast<core::u16>(r - h(x - 1, z) + upLeft);
+            }
+            residuals[z][x] = codec::zigzag(r);
+            widest |= residuals[z][x];
+        }
+        widths[z] = static_cast<std::uint8_t>(std::bit_width(widest));
+    }
+
+    const std::size_t begin = out.size();
+    out.resize(begin + sizeof(base) + N);
+    std::memcpy(out.data() + begin, &base, sizeof(base));
+    std::memcpy(out.data() + begin + sizeof(base), widths.data(), N);
+    for(std::size_t z = 0; z < N; ++z) {
+        const std::size_t rowBegin = out.size();
+        out.resize(rowBegin + (N * widths[z] + 7) / 8);
+        std::size_t bit = 0;
+        for(std::size_t x = 0; x < N; ++x, bit += widths[z]) {
+            for(std::size_t b = 0; b < widths[z]; ++b) {
+                if(residuals[z][x] & (1u << b)) {
+                    out[rowBegin + (bit + b) / 8] |= std::byte{ static_cast<std::uint8_t>(1u << ((bit + b) % 8)) };
+                }
+            }
+        }
+    }
+    out.resize(out.size() + sizeof(core::u64));
+}
+
+// decode a Delta record into heights (Traits::samples)
+// record may run past the end of the chunk's own bytes, returns false if it is truncated or malformed
+template<ChunkGeometry Traits = DefaultChunkTraits>
+bool decodeChunkDelta(std::span<const std::byte> record, std::span<core::i16> heights) noexcept {
+    constexpr std::size_t N = Traits::resolution;
+    constexpr std::size_t lanes = codec::rowLanes(N);
+    if(record.size() < chunkEncodedMinBytes(N) || heights.size() < N * N) {
+        return false;
+    }
+    core::u16 base{};
+    std::memcpy(&base, record.data(), sizeof(base));
+    const std::byte* widths = record.data() + sizeof(base);
+
+    std::size_t bytes = sizeof(base) + N + sizeof(core::u64);
+    for(std::size_t z = 0; z < N; ++z) {
+        const std::size_t width = static_cast<std::size_t>(widths[z]);
+        if(width > 16) {
+            return false;
+        }
+        bytes += (N * width + 7) / 8;
+    }
+    if(record.size() < bytes) {
+        return false;
+    }
+
+    alignas(16) std::array<core::u16, lanes> residuals{};
+    alignas(16) std::array<core::u16, lanes> row{};
+    row.fill(base);
+
+    const std::byte* packed = widths + N;
+    for(std::size_t z = 0; z < N; ++z) {
+        const std::size_t width = static_cast<std::size_t>(widths[z]);
+        const core::u64 mask = (core::u64{ 1 } << width) - 1;
+        // one unaligned u64 window per residual, the record's pad keeps it in bounds
+        for(std::size_t x = 0, bit = 0; x < N; ++x, bit += width) {
+            core::u64 window{};
+            std::memcpy(&window, packed + bit / 8, sizeof(window));
+            residuals[x] = static_cast<core::u16>((window >> (bit % 8)) & mask);
+        }
+        packed += (N * width + 7) / 8;
+
+        codec::accumulateRow<lanes>(residuals.data(), row.data());
+        std::memcpy(heights.data() + z * N, row.data(), N * sizeof(core::i16));
+    }
+    return true;
+}
+
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <array>
+#include <span>
 
 #include "engine/world/chunk.hpp"
+#include "engine/world/chunk_surface.hpp"
 
 namespace engine::world {
 
@@ -12,11 +14,86 @@ enum class ChunkStatus : core::u32 {
     Loaded = 2
 };
 
-struct ChunkData {
+template<ChunkGeometry Traits>
+struct BasicChunkData {
     // chunk coordinate
     Chunk chunk{};
     // height map
-    std::array<core::i16, CHUNK_RESOLUTION * CHUNK_RESOLUTION> heights{};
+    std::array<core::i16, Traits::samples> heights{};
+    // octahedral packed normal of every sample, see chunk_surface.hpp
+    std::array<core::u16, Traits::samples> normals{};
+    // min/max height pyramid, bounds.back() covers the whole chunk
+    std::array<ChunkBounds, CHUNK_BOUNDS_CELLS> bounds{};
+    // zero-copy height map + surface: point into a mapped ChunkFile when set, override the arrays above
+    std::span<const core::i16> mapped{};
+    std::span<const core::u16> mappedNormals{};
+    std::span<const ChunkBounds> mappedBounds{};
+
+    std::span<const core::i16> getHeights() const noexcept {
+        if(!mapped.empty()) {
+            return mapped;
+        }
+        return heights;
+    }
+
+    std::span<const core::u16> getNormals() const noexcept {
+        if(!mappedNormals.empty()) {
+            return mappedNormals;
+        }
+        return normals;
+    }
+
+    std::span<const ChunkBounds> getBounds() const noexcept {
+        if(!mappedBounds.empty()) {
+            return mappedBounds;
+        }
+        return bounds;
+    }
+};
+
+using ChunkData = BasicChunkData<DefaultChunkTraits>;
+
+// normals + bounds from the heights alone, for chunks read from files that don't carry them
+template<ChunkGeometry Traits>
+void deriveChunkSurface(BasicChunkData<Traits>& data) noexcept {
+    computeChunkNormals<Traits>(data.heights, data.normals);
+    computeChunkBounds<Traits>(data.heights, data.bounds);
+}
+
+// how a .chunk file stores each chunk's heights, see engine/world/chunk_codec.hpp
+enum class ChunkEncoding : core::u32 {
+    // resolution^2 native i16
+    Raw = 0,
+    // planar prediction residuals, zigzagged and bitpacked per row
+    Delta = 1
+};
+
+// "DVCHUNK\0": starts every versioned .chunk file, a version 0 file starts with its chunk count instead
+constexpr const core::u64 CHUNK_FILE_MAGIC = 0x004b4e5548435644;
+// version 2: chunks sit CHUNK_SIZE samples apart and share their edge samples with their neighbours
+// versions 0 and 1 tiled at a stride of CHUNK_RESOLUTION, their chunks neither share edges nor line up
+// with the world grid
+// version 3: records may carry precomputed bounds/normals ahead of their heights
+// version 4: the header records the chunks' resolution, earlier files are all CHUNK_FILE_LEGACY_RESOLUTION
+constexpr const core::u32 CHUNK_FILE_VERSION = 4;
+
+constexpr const core::u32 CHUNK_FILE_LEGACY_RESOLUTION = 33;
+// largest ChunkTraits resolution, a header claiming more is malformed
+constexpr const core::u32 CHUNK_FILE_MAX_RESOLUTION = 129;
+
+// optional surface sections stored ahead of each record's heights, in this order
+constexpr const core::u32 CHUNK_SECTION_BOUNDS = 1u << 0;
+constexpr const core::u32 CHUNK_SECTION_NORMALS = 1u << 1;
+
+struct ChunkFileHeader {
+    core::u64 magic{ CHUNK_FILE_MAGIC };
+    core::u32 version{ CHUNK_FILE_VERSION };
+    ChunkEncoding encoding{ ChunkEncoding::Raw };
+    core::u64 numChunks{};
+    // version 3 on: CHUNK_SECTION_* bits, versions 1 and 2 end before this and have no sections
+    core::u32 sections{};
+    // version 4 on: samples along a chunk edge (ChunkTraits::resolution), padding before
+    core::u32 resolution{ static_cast<core::u32>(CHUNK_RESOLUTION) };
 };
 
 struct ChunkTOC {
@@ -25,17 +102,28 @@ struct ChunkTOC {
     core::i32 chunkZ{};
     // file offset
     core::u64 offset{};
+    // record size in the file's encoding
+    core::u32 bytes{};
+    core::u32 pad{};
+};
+
+// TOC record of a version 0 file: no header but the chunk count, raw records
+struct ChunkTOCv0 {
+    core::i32 chunkX{};
+    core::i32 chunkZ{};
+    core::u64 offset{};
 };
 
-inline float sampleChunkDataHeights(ChunkData& chunkData, int2 sampleCoords) {
-    return chunkData.heights[
-        sampleCoords.y * CHUNK_RESOLUTION + sampleCoords.x
+template<ChunkGeometry Traits>
+float sampleChunkDataHeights(const BasicChunkData<Traits>& chunkData, int2 sampleCoords) {
+    return chunkData.getHeights()[
+        sampleCoords.y * Traits::resolution + sampleCoords.x
     ];
 }
 
 struct ChunkHash {
     std::size_t operator()(const Chunk& chunk) const noexcept {
-        return (static_cast<std::size_t>(chunk.x) << 32) | static_cast<std::size_t>(chunk.z);
+        return static_cast<std::size_t>(mixChunkKey(chunkKey(chunk)));
     }
 };
 
@@ -0,0 +1,391 @@
+// chunk_file.hpp: defines ChunkFile, a read-only memory mapping of a chunked heightmap file (.chunk)
+//     chunk heights are served straight out of the mapped pages by record offset, which a ChunkWorld
+//     looks up (see tools/dem_chunk_builder/main.cpp for the binary format)
+//     Raw records can be viewed in place, Delta records are decoded on read (see chunk_codec.hpp)
+//     precomputed bounds/normals ahead of a record are served the same way, or derived on read for
+//     files that don't carry them
+//     the descriptor stays open too, for reads that go around the mapping (see chunk_io.hpp)
+//     record sizes follow the resolution in the file's header, reads into ChunkData of any other
+//     resolution are rejected
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <span>
+
+#include "engine/world/chunk.hpp"
+#include "engine/world/chunk_codec.hpp"
+#include "engine/world/chunk_data.hpp"
+
+namespace engine::world {
+
+// bytes of a single chunk heightmap record in a .chunk file
+constexpr inline std::size_t chunkHeightsBytes(std::size_t resolution) noexcept {
+    return sizeof(core::i16) * resolution * resolution;
+}
+
+// bytes of the largest record, every section included
+constexpr inline std::size_t chunkRecordMaxBytes(std::size_t resolution) noexcept {
+    return CHUNK_BOUNDS_BYTES + chunkNormalsBytes(resolution)
+        + std::max(chunkHeightsBytes(resolution), chunkEncodedMaxBytes(resolution));
+}
+
+// zero-copy views of one record's data, each empty where the file can't serve it in place
+struct ChunkView {
+    std::span<const core::i16> heights{};
+    std::span<const core::u16> normals{};
+    std::span<const ChunkBounds> bounds{};
+};
+
+class ChunkFile {
+    // read-only mapping of the whole file
+    const std::byte* mapping{ nullptr };
+    std::size_t mappingSize{ 0 };
+    int descriptor{ -1 };
+
+    // parsed header
+    core::u32 version{ 0 };
+    ChunkEncoding encoding{ ChunkEncoding::Raw };
+    core::u32 sections{ 0 };
+    core::u32 resolution{ CHUNK_FILE_LEGACY_RESOLUTION };
+    core::u64 numChunks{ 0 };
+    std::size_t tocBegin{ 0 };
+
+public:
+    ChunkFile() = default;
+
+    explicit ChunkFile(const char* filename) noexcept {
+        open(filename);
+    }
+
+    ~ChunkFile() {
+        close();
+    }
+
+    ChunkFile(const ChunkFile&) = delete;
+    ChunkFile& operator=(const ChunkFile&) = delete;
+
+    ChunkFile(ChunkFile&& other) noexcept
+        : mapping(other.mapping), mappingSize(other.mappingSize), descriptor(other.descriptor),
+          version(other.version), encoding(other.encoding), sections(other.sections),
+          resolution(other.resolution), numChunks(other.numChunks), tocBegin(other.tocBegin)
+    {
+        other.mapping = nullptr;
+        other.mappingSize = 0;
+        other.descriptor = -1;
+    }
+
+    ChunkFile& operator=(ChunkFile&& other) noexcept {
+        if(this != &other) {
+            close();
+            mapping = other.mapping;
+            mappingSize = other.mappingSize;
+            descriptor = other.descriptor;
+            version = other.version;
+            encoding = other.encoding;
+            sections = other.sections;
+            resolution = other.resolution;
+            numChunks = other.numChunks;
+            tocBegin = other.tocBegin;
+            other.mapping = nullptr;
+            other.mappingSize = 0;
+            other.descriptor = -1;
+        }
+        return *this;
+    }
+
+    bool isOpen() const noexcept {
+        return mapping != nullptr;
+    }
+
+    core::u32 getVersion() const noexcept {
+        return version;
+    }
+
+    ChunkEncoding getEncoding() const noexcept {
+        return encoding;
+    }
+
+    // CHUNK_SECTION_* bits carried by every record
+    core::u32 getSections() const noexcept {
+        return sections;
+    }
+
+    // samples along the edge of every chunk in the file (see ChunkTraits)
+    core::u32 getResolution() const noexcept {
+        return resolution;
+    }
+
+    // whether neighbouring chunks share their edge samples (see CHUNK_FILE_VERSION)
+    bool hasSharedEdges() const noexcept {
+        return version >= 2;
+    }
+
+    // read-only descriptor of the mapped file, for pread/io_uring reads
+    int getDescriptor() const noexcept {
+        return descriptor;
+    }
+
+    // visit every TOC record as fn(Chunk, offset), returns false on a malformed TOC
+    // note: only needed to index a file, ChunkWorld indices already hold every offset
+    template<typename Fn>
+    bool forEachChunk(Fn&& fn) const noexcept {
+        if(!isOpen()) {
+            return false;
+        }
+        const std::size_t stride = version == 0 ? sizeof(ChunkTOCv0) : sizeof(ChunkTOC);
+        if(numChunks > (mappingSize - tocBegin) / stride) {
+            return false;
+        }
+        for(core::u64 i = 0; i < numChunks; ++i) {
+            ChunkTOC chunkTOC{};
+            if(version == 0) {
+                ChunkTOCv0 v0{};
+                std::memcpy(&v0, mapping + tocBegin + i * stride, sizeof(v0));
+                chunkTOC = { .chunkX = v0.chunkX, .chunkZ = v0.chunkZ, .offset = v0.offset, .bytes = static_cast<core::u32>(heightsBytes()) };
+            }
+            else {
+                std::memcpy(&chunkTOC, mapping + tocBegin + i * stride, sizeof(chunkTOC));
+            }
+            if(!contains(chunkTOC.offset)) {
+                return false;
+            }
+            fn(Chunk{ .x = chunkTOC.chunkX, .z = chunkTOC.chunkZ }, chunkTOC.offset);
+        }
+        return true;
+    }
+
+    // whether a record starts at offset with room for at least the smallest record of this file
+    // note: Delta records are variable sized and packed back to back, only Raw ones must be aligned
+    bool contains(core::u64 offset) const noexcept {
+        const std::size_t minBytes = sectionBytes() + (encoding == ChunkEncoding::Raw ? heightsBytes() : chunkEncodedMinBytes(resolution));
+        const bool aligned = encoding != ChunkEncoding::Raw || offset % alignof(core::i16) == 0;
+        return mappingSize >= minBytes && aligned && offset <= mappingSize - minBytes;
+    }
+
+    // zero-copy views of the record at offset: heights only when Raw, normals/bounds only when the
+    // file carries them
+    // note: the views are valid for as long as this ChunkFile is open
+    ChunkView view(core::u64 offset) const noexcept {
+        // sections of a misaligned (Delta) record can only be copied out
+        if(!contains(offset) || offset % alignof(core::i16) != 0) {
+            return {};
+        }
+        ChunkView v{};
+        const std::byte* p = mapping + offset;
+        const std::size_t samples = static_cast<std::size_t>(resolution) * resolution;
+        if(sections & CHUNK_SECTION_BOUNDS) {
+            v.bounds = { reinterpret_cast<const ChunkBounds*>(p), CHUNK_BOUNDS_CELLS };
+            p += CHUNK_BOUNDS_BYTES;
+        }
+        if(sections & CHUNK_SECTION_NORMALS) {
+            v.normals = { reinterpret_cast<const core::u16*>(p), samples };
+            p += chunkNormalsBytes(resolution);
+        }
+        if(encoding == ChunkEncoding::Raw) {
+            v.heights = { reinterpret_cast<const core::i16*>(p), samples };
+        }
+        return v;
+    }
+
+    // copy/decode the record at offset into out's heights, normals and bounds, returns false if there is none
+    template<ChunkGeometry Traits>
+    bool read(core::u64 offset, BasicChunkData<Traits>& out) const noexcept {
+        if(!contains(offset)) {
+            return false;
+        }
+        return decode(record(offset), out);
+    }
+
+    // bytes to read from offset to be sure of the whole record, 0 if there is none
+    // note: encoded records are variable sized, so this may run into the next record (its pages are
+    // usually wanted next anyway)
+    std::size_t getRecordBytes(core::u64 offset) const noexcept {
+        if(!contains(offset)) {
+            return 0;
+        }
+        return record(offset).size();
+    }
+
+    // copy (Raw) or decode (Delta) record bytes read out of this file into out
+    // sections the file doesn't carry are derived from the heights
+    template<ChunkGeometry Traits>
+    bool decode(std::span<const std::byte> bytes, BasicChunkData<Traits>& out) const noexcept {
+        if(resolution != static_cast<core::u32>(Traits::resolution) || bytes.size() < sectionBytes()) {
+            return false;
+        }
+        constexpr std::size_t heightsBytes = chunkHeightsBytes(Traits::resolution);
+        std::span<const std::byte> heights = bytes.subspan(sectionBytes());
+        if(encoding == ChunkEncoding::Raw) {
+            if(heights.size() < heightsBytes) {
+                return false;
+            }
+            std::memcpy(out.heights.data(), heights.data(), heightsBytes);
+        }
+        else if(!decodeChunkDelta<Traits>(heights, out.heights)) {
+            return false;
+        }
+
+        std::size_t at = 0;
+        if(sections & CHUNK_SECTION_BOUNDS) {
+            std::memcpy(out.bounds.data(), bytes.data(), CHUNK_BOUNDS_BYTES);
+            at += CHUNK_BOUNDS_BYTES;
+        }
+        else {
+            computeChunkBounds<Traits>(out.heights, out.bounds);
+        }
+        if(sections & CHUNK_SECTION_NORMALS) {
+            std::memcpy(out.normals.data(), bytes.data() + at, chunkNormalsBytes(Traits::resolution));
+        }
+        else {
+            computeChunkNormals<Traits>(out.heights, out.normals);
+        }
+        return true;
+    }
+
+    // hint to the kernel that we're about to touch this record, so it can start reading
+    // ahead before a worker (or the renderer, for zero-copy views) faults the pages in
+    void prefetch(core::u64 offset) const noexcept {
+        if(!contains(offset)) {
+            return;
+        }
+        advise(offset, record(offset).size(), MADV_WILLNEED);
+    }
+
+private:
+    std::size_t heightsBytes() const noexcept {
+        return chunkHeightsBytes(resolution);
+    }
+
+    // bytes of the sections ahead of every record's heights
+    std::size_t sectionBytes() const noexcept {
+        return (sections & CHUNK_SECTION_BOUNDS ? CHUNK_BOUNDS_BYTES : 0)
+            + (sections & CHUNK_SECTION_NORMALS ? chunkNormalsBytes(resolution) : 0);
+    }
+
+    // bytes from offset up to the largest a record could be, clipped to the mapping
+    std::span<const std::byte> record(core::u64 offset) const noexcept {
+        const std::size_t maxBytes = sectionBytes() + (encoding == ChunkEncoding::Raw ? heightsBytes() : chunkEncodedMaxBytes(resolution));
+        return { mapping + offset, std::min(maxBytes, mappingSize - static_cast<std::size_t>(offset)) };
+    }
+
+    void open(const char* filename) noexcept {
+        int fd = ::open(filename, O_RDONLY);
+        if(fd < 0) {
+            printf("chunk file: could not open '%s'\n", filename);
+            return;
+        }
+
+        struct stat st{};
+        if(fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(core::u64))) {
+            printf("chunk file: '%s' is too small to hold a header\n", filename);
+            ::close(fd);
+            return;
+        }
+        mappingSize = static_cast<std::size_t>(st.st_size);
+
+        void* ptr = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(ptr == MAP_FAILED) {
+            printf("chunk file: could not map '%s'\n", filename);
+            ::close(fd);
+            mappingSize = 0;
+            return;
+        }
+        mapping = static_cast<const std::byte*>(ptr);
+        descriptor = fd;
+
+        if(!readHeader()) {
+            printf("chunk file: '%s' has an unsupported header\n", filename);
+            close();
+            return;
+        }
+
+        // chunks are requested wherever the camera goes, so don't let the kernel
+        // read ahead sequentially on every fault
+        advise(0, mappingSize, MADV_RANDOM);
+
+        printf("chunk file: mapped %zu bytes (v%u, %ux%u) from '%s'\n", mappingSize, version, resolution, resolution, filename);
+    }
+
+    // version 0 files start straight with the chunk count
+    bool readHeader() noexcept {
+        core::u64 magic{};
+        std::memcpy(&magic, mapping, sizeof(magic));
+        if(magic != CHUNK_FILE_MAGIC) {
+            version = 0;
+            encoding = ChunkEncoding::Raw;
+            resolution = CHUNK_FILE_LEGACY_RESOLUTION;
+            numChunks = magic;
+            tocBegin = sizeof(core::u64);
+            return true;
+        }
+        // versions 1 and 2 end their header before the sections field
+        constexpr std::size_t headerV2Bytes = offsetof(ChunkFileHeader, sections);
+        ChunkFileHeader header{};
+        if(mappingSize < headerV2Bytes) {
+            return false;
+        }
+        std::memcpy(static_cast<void*>(&header), mapping, headerV2Bytes);
+        if(header.version == 0 || header.version > CHUNK_FILE_VERSION
+            || (header.encoding != ChunkEncoding::Raw && header.encoding != ChunkEncoding::Delta)) {
+            return false;
+        }
+        tocBegin = headerV2Bytes;
+        if(header.version >= 3) {
+            if(mappingSize < sizeof(header)) {
+                return false;
+            }
+            std::memcpy(&header, mapping, sizeof(header));
+            tocBegin = sizeof(header);
+        }
+        version = header.version;
+        encoding = header.encoding;
+        // a section we don't know would shift every record
+        if((header.sections & ~(CHUNK_SECTION_BOUNDS | CHUNK_SECTION_NORMALS)) != 0) {
+            return false;
+        }
+        sections = header.sections;
+        // versions 3 and earlier hold padding here
+        resolution = header.version >= 4 ? header.resolution : CHUNK_FILE_LEGACY_RESOLUTION;
+        if(resolution < 2 || resolution > CHUNK_FILE_MAX_RESOLUTION) {
+            return false;
+        }
+        numChunks = header.numChunks;
+        return true;
+    }
+
+    void close() noexcept {
+        if(mapping != nullptr) {
+            munmap(const_cast<std::byte*>(mapping), mappingSize);
+        }
+        if(descriptor >= 0) {
+            ::close(descriptor);
+        }
+        mapping = nullptr;
+        mappingSize = 0;
+        descriptor = -1;
+        version = 0;
+        encoding = ChunkEncoding::Raw;
+        sections = 0;
+        resolution = CHUNK_FILE_LEGACY_RESOLUTION;
+        numChunks = 0;
+        tocBegin = 0;
+    }
+
+    // madvise a byte range of the mapping, widened out to page boundaries
+    void advise(std::size_t offset, std::size_t bytes, int advice) const noexcept {
+        static const std::size_t pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const std::size_t begin = offset & ~(pageSize - 1);
+        const std::size_t end = std::min(offset + bytes, mappingSize);
+        madvise(const_cast<std::byte*>(mapping) + begin, end - begin, advice);
+    }
+};
+
+}
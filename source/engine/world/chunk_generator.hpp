@@ -0,0 +1,243 @@
+// chunk_generator.hpp: defines ChunkGenerator, the procedural backend for chunks the world has no data for
+//     heights are fractal value noise of world position (see chunk_noise.hpp), so generated chunks tile
+//     with each other without seams. Next to chunks the world does have, the noise is bent onto their shared
+//     edge samples: each edge's difference fades out over half a chunk, corners are corrected so two faded
+//     edges don't count their shared sample twice (a transfinite, Coons-style blend), and every term depends
+//     on world position alone, so generated neighbours agree on the blended edges too
+//     normals come from central differences over one sample past each edge, bounds from the heights
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <span>
+
+#include "engine/world/chunk.hpp"
+#include "engine/world/chunk_data.hpp"
+#include "engine/world/chunk_noise.hpp"
+#include "engine/world/chunk_surface.hpp"
+#include "engine/world/chunk_world.hpp"
+
+namespace engine::world {
+
+struct TerrainNoiseParams {
+    core::u32 seed{ 1 };
+    // world units per lattice cell of the first octave
+    float wavelength{ 2048.f };
+    core::u32 octaves{ 8 };
+    float lacunarity{ 2.f };
+    float gain{ 0.5f };
+    // height of zero noise and the furthest the noise strays from it, in height map units
+    float baseHeight{ 2500.f };
+    float amplitude{ 1200.f };
+    // bend generated chunks onto the edges of the world's chunks around them
+    bool blendBorders{ true };
+};
+
+// stateless after construction: generate() may run on any number of threads at once
+template<ChunkGeometry Traits>
+class ChunkGenerator {
+    // samples along an edge, and past each edge for the normals
+    static constexpr core::i32 N = Traits::resolution;
+    static constexpr core::i32 APRON = N + 2;
+    // apron rows padded to whole lanes
+    static constexpr core::i32 STRIDE = (APRON + 3) / 4 * 4;
+
+    // west, east, north (-z), south (+z)
+    enum Edge : std::size_t { West = 0, East = 1, North = 2, South = 3 };
+
+    using Heights = std::array<float, static_cast<std::size_t>(STRIDE * APRON)>;
+
+    TerrainNoiseParams params;
+
+public:
+    explicit ChunkGenerator(const TerrainNoiseParams& params) noexcept
+        : params(params)
+    {}
+
+    const TerrainNoiseParams& getParams() const noexcept {
+        return params;
+    }
+
+    // heights, normals and bounds of chunk c into out, blended into the world's chunks around it
+    void generate(Chunk c, const ChunkWorld& world, BasicChunkData<Traits>& out) const noexcept {
+        Heights h;
+        fill(c, h);
+        if(params.blendBorders) {
+            blend(c, world, h);
+        }
+
+        constexpr float lo = static_cast<float>(std::numeric_limits<core::i16>::min());
+        constexpr float hi = static_cast<float>(std::numeric_limits<core::i16>::max());
+        for(core::i32 z = 0; z < N; ++z) {
+            for(core::i32 x = 0; x < N; ++x) {
+                out.heights[static_cast<std::size_t>(z * N + x)] = static_cast<core::i16>(std::lround(std::clamp(at(h, x, z), lo, hi)));
+            }
+        }
+        computeChunkNormals<Traits>([&](core::i32 x, core::i32 z) {
+            return at(h, x, z);
+        }, out.normals);
+        computeChunkBounds<Traits>(out.heights, out.bounds);
+    }
+
+private:
+    // chunk local sample (x, z in [-1, N]) of the apron grid
+    static float& at(Heights& h, core::i32 x, core::i32 z) noexcept {
+        return h[static_cast<std::size_t>((z + 1) * STRIDE + (x + 1))];
+    }
+
+    static float at(const Heights& h, core::i32 x, core::i32 z) noexcept {
+        return h[static_cast<std::size_t>((z + 1) * STRIDE + (x + 1))];
+    }
+
+    // noise heights over the chunk and one sample past each edge, 4 lanes along x at a time
+    // world positions are doubles: a float one stops resolving samples about 2^23 units out
+    void fill(Chunk c, Heights& h) const noexcept {
+        const double originX = static_cast<double>(c.x) * CHUNK_SIZE;
+        const double originZ = static_cast<double>(c.z) * CHUNK_SIZE;
+        const double spacing = static_cast<double>(Traits::spacing);
+        const double invWavelength = 1.0 / static_cast<double>(params.wavelength);
+        for(core::i32 z = 0; z < APRON; ++z) {
+            const double wz = (originZ + static_cast<double>(z - 1) * spacing) * invWavelength;
+            for(core::i32 x = 0; x < STRIDE; x += 4) {
+                double xs[4];
+                double zs[4];
+                for(core::i32 k = 0; k < 4; ++k) {
+                    xs[k] = (originX + static_cast<double>(x + k - 1) * spacing) * invWavelength;
+                    zs[k] = wz;
+                }
+                float* row = h.data() + z * STRIDE + x;
+                noise::fractalNoise4(xs, zs, params.seed, params.octaves, params.lacunarity, params.gain, row);
+                for(core::i32 k = 0; k < 4; ++k) {
+                    row[k] = params.baseHeight + params.amplitude * row[k];
+                }
+            }
+        }
+    }
+
+    // weight of an edge's difference s samples in from it: 1 on the edge, 0 from half a chunk in
+    // never reaching the opposite edge keeps each edge's neighbour the only one it has to agree with
+    static float falloff(core::i32 s) noexcept {
+        constexpr float half = static_cast<float>(Traits::cells / 2);
+        const float t = std::clamp(1.f - static_cast<float>(s) / half, 0.f, 1.f);
+        return t * t * (3.f - 2.f * t);
+    }
+
+    // heights of one of the world's chunks, false if it is not in the world or malformed
+    static bool worldHeights(const ChunkWorld& world, Chunk c, BasicChunkData<Traits>& scratch,
+        std::span<const core::i16>& heights) noexcept
+    {
+        if(!world.contains(c)) {
+            return false;
+        }
+        // raw shards are read in place, anything else decodes into scratch
+        const ChunkView view = world.view(c);
+        if(view.heights.size() == static_cast<std::size_t>(Traits::samples)) {
+            heights = view.heights;
+            return true;
+        }
+        if(!world.read(c, scratch)) {
+            return false;
+        }
+        heights = scratch.heights;
+        return true;
+    }
+
+    void blend(Chunk c, const ChunkWorld& world, Heights& h) const noexcept {
+        constexpr core::i32 last = N - 1;
+        BasicChunkData<Traits> scratch{};
+        std::span<const core::i16> heights{};
+
+        // world height minus noise along each edge the world has a chunk across
+        std::array<std::array<float, N>, 4> delta{};
+        std::array<bool, 4> has{};
+        const std::array<Chunk, 4> across {
+            Chunk{ .x = c.x - 1, .z = c.z }, Chunk{ .x = c.x + 1, .z = c.z },
+            Chunk{ .x = c.x, .z = c.z - 1 }, Chunk{ .x = c.x, .z = c.z + 1 }
+        };
+        for(std::size_t e = 0; e < 4; ++e) {
+            has[e] = worldHeights(world, across[e], scratch, heights);
+            if(!has[e]) {
+                continue;
+            }
+            for(core::i32 t = 0; t < N; ++t) {
+                // our edge sample, and the neighbour's copy of it
+                core::i32 x = t, z = t, nx = t, nz = t;
+                switch(e) {
+                    case West: x = 0; nx = last; break;
+                    case East: x = last; nx = 0; break;
+                    case North: z = 0; nz = last; break;
+                    default: z = last; nz = 0; break;
+                }
+                delta[e][static_cast<std::size_t>(t)] = static_cast<float>(heights[static_cast<std::size_t>(nz * N + nx)]) - at(h, x, z);
+            }
+        }
+
+        // per corner: both edges blended counts the corner twice, take it back out once;
+        // neither edge blended but the diagonal chunk in the world leaves the corner to add on its own
+        struct Corner {
+            Edge a;
+            Edge b;
+            core::i32 x;
+            core::i32 z;
+        };
+        constexpr std::array<Corner, 4> corners {
+            Corner{ West, North, 0, 0 }, Corner{ East, North, last, 0 },
+            Corner{ West, South, 0, last }, Corner{ East, South, last, last }
+        };
+        std::array<float, 4> cornerWeight{};
+        std::array<float, 4> cornerDelta{};
+        for(std::size_t k = 0; k < 4; ++k) {
+            const Corner& corner = corners[k];
+            if(has[corner.a] && has[corner.b]) {
+                cornerWeight[k] = -1.f;
+                cornerDelta[k] = delta[corner.a][static_cast<std::size_t>(corner.z)];
+                continue;
+            }
+            if(has[corner.a] || has[corner.b]) {
+                continue;
+            }
+            const Chunk diagonal{
+                .x = c.x + (corner.x == 0 ? -1 : 1),
+                .z = c.z + (corner.z == 0 ? -1 : 1)
+            };
+            if(worldHeights(world, diagonal, scratch, heights)) {
+                const core::i32 nx = last - corner.x;
+                const core::i32 nz = last - corner.z;
+                cornerWeight[k] = 1.f;
+                cornerDelta[k] = static_cast<float>(heights[static_cast<std::size_t>(nz * N + nx)]) - at(h, corner.x, corner.z);
+            }
+        }
+
+        if(!has[West] && !has[East] && !has[North] && !has[South]
+            && std::all_of(cornerWeight.begin(), cornerWeight.end(), [](float w) { return w == 0.f; }))
+        {
+            return;
+        }
+
+        for(core::i32 z = -1; z <= N; ++z) {
+            const std::size_t tz = static_cast<std::size_t>(std::clamp(z, 0, last));
+            const float fn = falloff(z);
+            const float fs = falloff(last - z);
+            for(core::i32 x = -1; x <= N; ++x) {
+                const std::size_t tx = static_cast<std::size_t>(std::clamp(x, 0, last));
+                const float fw = falloff(x);
+                const float fe = falloff(last - x);
+                float correction = 0.f;
+                correction += has[West] ? fw * delta[West][tz] : 0.f;
+                correction += has[East] ? fe * delta[East][tz] : 0.f;
+                correction += has[North] ? fn * delta[North][tx] : 0.f;
+                correction += has[South] ? fs * delta[South][tx] : 0.f;
+                correction += cornerWeight[0] * fw * fn * cornerDelta[0];
+                correction += cornerWeight[1] * fe * fn * cornerDelta[1];
+                correction += cornerWeight[2] * fw * fs * cornerDelta[2];
+                correction += cornerWeight[3] * fe * fs * cornerDelta[3];
+                at(h, x, z) += correction;
+            }
+        }
+    }
+};
+
+}
@@ -0,0 +1,440 @@
+// chunk_io.hpp: defines ChunkIO, asynchronous positional reads of chunk records
+//     batches of reads are submitted to an io_uring on Linux so a single thread can keep a deep queue
+//     on the device, and completions are reaped whenever that thread gets to them. Where there is no
+//     io_uring (other platforms, old kernels, sandboxes that refuse io_uring_setup) a small pool of
+//     threads issues the same reads with pread instead, and a ring that breaks part way falls back to
+//     the same pool: it is parked, not closed, until the reads it still holds have completed
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define DEUS_CHUNK_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "engine/world/chunk.hpp"
+
+namespace engine::world {
+
+enum class ChunkIOBackend : core::u32 {
+    IoUring = 0,
+    ThreadPool = 1
+};
+
+struct ChunkIORead {
+    int descriptor{ -1 };
+    core::u64 offset{};
+    std::byte* buffer{ nullptr };
+    core::u32 bytes{};
+    // handed back with the completion
+    core::u64 tag{};
+};
+
+struct ChunkIOCompletion {
+    core::u64 tag{};
+    // bytes read, or -errno
+    std::int64_t result{};
+};
+
+// how often reap polls a parked ring, which has no way to wake the thread pool's waiters
+constexpr const std::chrono::milliseconds CHUNK_IO_PARKED_POLL{ 1 };
+
+// submit/reap are called from a single thread, which keeps at most getDepth() reads outstanding
+class ChunkIO {
+    ChunkIOBackend backend{ ChunkIOBackend::ThreadPool };
+    std::size_t depth{ 0 };
+    // pread threads to spawn, up front or once the io_uring breaks
+    std::size_t numThreads{ 0 };
+
+#if defined(DEUS_CHUNK_IO_URING)
+    int ring{ -1 };
+    void* sqMapping{ nullptr };
+    std::size_t sqMappingSize{ 0 };
+    void* cqMapping{ nullptr };
+    std::size_t cqMappingSize{ 0 };
+    io_uring_sqe* sqes{ nullptr };
+    std::size_t sqesSize{ 0 };
+    core::u32* sqTail{ nullptr };
+    core::u32 sqMask{ 0 };
+    core::u32* sqArray{ nullptr };
+    core::u32* cqHead{ nullptr };
+    core::u32* cqTail{ nullptr };
+    core::u32 cqMask{ 0 };
+    io_uring_cqe* cqes{ nullptr };
+    // reads submitted to the ring and not reaped yet: their buffers belong to the kernel until then,
+    // so a broken ring stays mapped (parked) until this drops to zero
+    std::size_t ringOutstanding{ 0 };
+#endif
+
+    // thread pool fallback: pending reads in, completions out
+    std::mutex mutex{};
+    std::condition_variable submitted{};
+    std::condition_variable completed{};
+    std::deque<ChunkIORead> pending{};
+    std::vector<ChunkIOCompletion> done{};
+    std::vector<ChunkIOCompletion> reaping{};
+    std::vector<std::jthread> threads{};
+
+public:
+    // depth: most reads outstanding at once
+    // numThreads: pread threads, only spawned if io_uring is unavailable or not wanted
+    explicit ChunkIO(std::size_t depth, std::size_t numThreads = 4, bool allowIoUring = true) noexcept
+        : depth(std::max<std::size_t>(depth, 1)),
+          numThreads(std::clamp<std::size_t>(numThreads, 1, this->depth))
+    {
+#if defined(DEUS_CHUNK_IO_URING)
+        if(allowIoUring && setupRing()) {
+            backend = ChunkIOBackend::IoUring;
+            printf("chunk io: io_uring, depth %zu\n", this->depth);
+            return;
+        }
+#endif
+        (void)allowIoUring;
+        startThreads();
+    }
+
+    ~ChunkIO() {
+        if(!threads.empty()) {
+            {
+                std::lock_guard lock(mutex);
+                for(std::jthread& t : threads) {
+                    t.request_stop();
+                }
+            }
+            submitted.notify_all();
+            threads.clear();
+        }
+#if defined(DEUS_CHUNK_IO_URING)
+        closeRing();
+#endif
+    }
+
+    ChunkIO(const ChunkIO&) = delete;
+    ChunkIO& operator=(const ChunkIO&) = delete;
+    ChunkIO(ChunkIO&&) = delete;
+    ChunkIO& operator=(ChunkIO&&) = delete;
+
+    ChunkIOBackend getBackend() const noexcept {
+        return backend;
+    }
+
+    std::size_t getDepth() const noexcept {
+        return depth;
+    }
+
+    // queue every read in one go, each of them completes through reap
+    // (if the io_uring refuses them they go to the pread threads instead)
+    void submit(std::span<const ChunkIORead> reads) noexcept {
+        if(reads.empty()) {
+            return;
+        }
+#if defined(DEUS_CHUNK_IO_URING)
+        if(backend == ChunkIOBackend::IoUring) {
+            reads = reads.subspan(submitRing(reads));
+            if(reads.empty()) {
+                return;
+            }
+        }
+#endif
+        {
+            std::lock_guard lock(mutex);
+            pending.insert(pending.end(), reads.begin(), reads.end());
+        }
+        submitted.notify_all();
+    }
+
+    // hand every finished read to fn(const ChunkIOCompletion&), waiting until at least minComplete have
+    // returns the number reaped
+    template<typename Fn>
+    std::size_t reap(Fn&& fn, std::size_t minComplete = 0) noexcept {
+        std::size_t count = 0;
+#if defined(DEUS_CHUNK_IO_URING)
+        if(backend == ChunkIOBackend::IoUring) {
+            count = reapRing(fn, minComplete);
+            if(backend == ChunkIOBackend::IoUring || count >= minComplete) {
+                return count;
+            }
+        }
+        // reads the ring took before it broke still complete through it
+        count += reapParked(fn);
+#endif
+        {
+            std::unique_lock lock(mutex);
+            auto ready = [&]() { return count + done.size() >= minComplete; };
+#if defined(DEUS_CHUNK_IO_URING)
+            while(ringOutstanding > 0 && !ready()) {
+                completed.wait_for(lock, CHUNK_IO_PARKED_POLL, ready);
+                lock.unlock();
+                count += reapParked(fn);
+                lock.lock();
+            }
+#endif
+            completed.wait(lock, ready);
+            reaping.swap(done);
+        }
+        for(const ChunkIOCompletion& completion : reaping) {
+            fn(completion);
+        }
+        count += reaping.size();
+        reaping.clear();
+        return count;
+    }
+
+private:
+    void startThreads() noexcept {
+        backend = ChunkIOBackend::ThreadPool;
+        done.reserve(depth);
+        reaping.reserve(depth);
+        threads.reserve(numThreads);
+        for(std::size_t i = 0; i < numThreads; ++i) {
+            threads.emplace_back([this](std::stop_token st) {
+                this->readThread(st);
+            });
+        }
+        printf("chunk io: %zu pread threads, depth %zu\n", numThreads, depth);
+    }
+
+    void readThread(std::stop_token st) noexcept {
+        std::unique_lock lock(mutex);
+        for(;;) {
+            submitted.wait(lock, [&]() { return st.stop_requested() || !pending.empty(); });
+            if(st.stop_requested()) {
+                return;
+            }
+            const ChunkIORead read = pending.front();
+            pending.pop_front();
+
+            lock.unlock();
+            const ChunkIOCompletion completion{ .tag = read.tag, .result = readAll(read) };
+            lock.lock();
+
+            done.push_back(completion);
+            completed.notify_one();
+        }
+    }
+
+    static std::int64_t readAll(const ChunkIORead& read) noexcept {
+        std::size_t total = 0;
+        while(total < read.bytes) {
+            const ssize_t n = pread(
+                read.descriptor,
+                read.buffer + total,
+                read.bytes - total,
+                static_cast<off_t>(read.offset + total)
+            );
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            if(n < 0) {
+                return -errno;
+            }
+            if(n == 0) {
+                break;
+            }
+            total += static_cast<std::size_t>(n);
+        }
+        return static_cast<std::int64_t>(total);
+    }
+
+#if defined(DEUS_CHUNK_IO_URING)
+    static int enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) noexcept {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    bool setupRing() noexcept {
+        io_uring_params params{};
+        // completions can never outrun the submission ring they came from
+        const core::u32 entries = std::bit_ceil(static_cast<core::u32>(depth));
+        ring = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if(ring < 0) {
+            ring = -1;
+            return false;
+        }
+        // IORING_OP_READ arrived in 5.6, FEAT_FAST_POLL (5.7) is the nearest feature bit that implies it
+        if((params.features & IORING_FEAT_FAST_POLL) == 0) {
+            closeRing();
+            return false;
+        }
+
+        sqMappingSize = params.sq_off.array + params.sq_entries * sizeof(core::u32);
+        cqMappingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if(single) {
+            sqMappingSize = std::max(sqMappingSize, cqMappingSize);
+        }
+        sqMapping = mmap(nullptr, sqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+        if(sqMapping == MAP_FAILED) {
+            sqMapping = nullptr;
+            closeRing();
+            return false;
+        }
+        if(single) {
+            cqMapping = sqMapping;
+            cqMappingSize = 0;
+        }
+        else {
+            cqMapping = mmap(nullptr, cqMappingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+            if(cqMapping == MAP_FAILED) {
+                cqMapping = nullptr;
+                closeRing();
+                return false;
+            }
+        }
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqesMapping = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+        if(sqesMapping == MAP_FAILED) {
+            closeRing();
+            return false;
+        }
+        sqes = static_cast<io_uring_sqe*>(sqesMapping);
+
+        std::byte* sq = static_cast<std::byte*>(sqMapping);
+        std::byte* cq = static_cast<std::byte*>(cqMapping);
+        sqTail = reinterpret_cast<core::u32*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<core::u32*>(sq + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<core::u32*>(sq + params.sq_off.array);
+        cqHead = reinterpret_cast<core::u32*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<core::u32*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<core::u32*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    void closeRing() noexcept {
+        if(sqes != nullptr) {
+            munmap(sqes, sqesSize);
+        }
+        if(cqMapping != nullptr && cqMapping != sqMapping) {
+            munmap(cqMapping, cqMappingSize);
+        }
+        if(sqMapping != nullptr) {
+            munmap(sqMapping, sqMappingSize);
+        }
+        if(ring >= 0) {
+            ::close(ring);
+        }
+        ring = -1;
+        sqMapping = cqMapping = nullptr;
+        sqes = nullptr;
+    }
+
+    // returns how many of the lead reads the ring took, the rest are the caller's to issue elsewhere
+    std::size_t submitRing(std::span<const ChunkIORead> reads) noexcept {
+        // only this thread writes the tail, the kernel only reads it
+        core::u32 tail = *sqTail;
+        for(const ChunkIORead& read : reads) {
+            const core::u32 index = tail & sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READ;
+            sqe.fd = read.descriptor;
+            sqe.off = read.offset;
+            sqe.addr = reinterpret_cast<core::u64>(read.buffer);
+            sqe.len = read.bytes;
+            sqe.user_data = read.tag;
+            sqArray[index] = index;
+            ++tail;
+        }
+        std::atomic_ref<core::u32>(*sqTail).store(tail, std::memory_order_release);
+
+        unsigned remaining = static_cast<unsigned>(reads.size());
+        while(remaining > 0) {
+            const int submittedCount = enter(ring, remaining, 0, 0);
+            if(submittedCount < 0 && errno == EINTR) {
+                continue;
+            }
+            if(submittedCount <= 0) {
+                printf("chunk io: io_uring_enter failed, falling back to pread: %s\n", std::strerror(errno));
+                // without SQPOLL the kernel only consumes entries inside enter, and in order:
+                // the trailing ones it never took can be taken back
+                std::atomic_ref<core::u32>(*sqTail).store(tail - remaining, std::memory_order_release);
+                ringOutstanding += reads.size() - remaining;
+                parkRing();
+                return reads.size() - remaining;
+            }
+            remaining -= static_cast<unsigned>(submittedCount);
+        }
+        ringOutstanding += reads.size();
+        return reads.size();
+    }
+
+    // stop submitting to a ring that failed, the reads it holds may still be writing into their buffers
+    // so it stays mapped and is reaped (polled) until they have all completed, later reads use pread
+    void parkRing() noexcept {
+        startThreads();
+        if(ringOutstanding == 0) {
+            closeRing();
+        }
+    }
+
+    // completions the kernel already posted, without entering it
+    template<typename Fn>
+    std::size_t drainRing(Fn& fn) noexcept {
+        std::size_t count = 0;
+        core::u32 head = *cqHead;
+        const core::u32 tail = std::atomic_ref<core::u32>(*cqTail).load(std::memory_order_acquire);
+        for(; head != tail; ++head, ++count) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            fn(ChunkIOCompletion{ .tag = cqe.user_data, .result = cqe.res });
+        }
+        // hand the entries back to the kernel
+        std::atomic_ref<core::u32>(*cqHead).store(head, std::memory_order_release);
+        ringOutstanding -= count;
+        return count;
+    }
+
+    // reap a parked ring, tearing it down once nothing is left in it
+    template<typename Fn>
+    std::size_t reapParked(Fn& fn) noexcept {
+        if(ring < 0) {
+            return 0;
+        }
+        const std::size_t count = drainRing(fn);
+        if(ringOutstanding == 0) {
+            closeRing();
+        }
+        return count;
+    }
+
+    // parks the ring if waiting on it fails, see reap for the rest of the wait
+    template<typename Fn>
+    std::size_t reapRing(Fn& fn, std::size_t minComplete) noexcept {
+        std::size_t count = 0;
+        for(;;) {
+            count += drainRing(fn);
+            if(count >= minComplete) {
+                return count;
+            }
+            const unsigned wanted = static_cast<unsigned>(minComplete - count);
+            if(enter(ring, 0, wanted, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                // waiting again would fail the same way, and closing the ring doesn't wait for the reads
+                // it holds: keep polling it for those, and issue new reads with pread
+                printf("chunk io: io_uring_enter failed, falling back to pread: %s\n", std::strerror(errno));
+                parkRing();
+                return count;
+            }
+        }
+    }
+#endif
+};
+
+}
@@ -0,0 +1,177 @@
+// chunk_noise.hpp: value noise and fractal (fBm) sums of it for generated terrain, 4 samples at a time
+//     where there is SIMD. Lattice values come from an integer hash of the cell corner and the seed, so
+//     noise is a pure function of position: chunks generated on different threads, or in different runs,
+//     agree on every sample they share
+//     the SIMD paths run the scalar one's operations in the same order, so they give the same results
+//     positions are split into an integer lattice cell and a float fraction in double precision, so the
+//     fraction keeps its precision however far out the sample is; cells wrap modulo 2^32
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "core/types.hpp"
+
+namespace engine::world {
+
+namespace noise {
+
+constexpr const core::u32 HASH_X = 0x27d4eb2du;
+constexpr const core::u32 HASH_Z = 0x165667b1u;
+constexpr const core::u32 HASH_MIX = 0x2c1b3c6du;
+// per-octave seed step, keeps octaves from sharing lattice values
+constexpr const core::u32 OCTAVE_SEED = 0x9e3779b9u;
+// top 24 bits of a hash -> [-1, 1)
+constexpr const float HASH_SCALE = 2.f / 16777216.f;
+
+inline core::u32 hash(core::i32 x, core::i32 z, core::u32 seed) noexcept {
+    core::u32 h = (static_cast<core::u32>(x) * HASH_X) ^ (static_cast<core::u32>(z) * HASH_Z) ^ seed;
+    h ^= h >> 15;
+    h *= HASH_MIX;
+    h ^= h >> 12;
+    return h;
+}
+
+inline float lattice(core::i32 x, core::i32 z, core::u32 seed) noexcept {
+    return static_cast<float>(hash(x, z, seed) >> 8) * HASH_SCALE - 1.f;
+}
+
+// quintic fade, zero first and second derivatives at the lattice so octaves don't crease
+inline float fade(float t) noexcept {
+    return t * t * t * (t * (t * 6.f - 15.f) + 10.f);
+}
+
+// cx, cz: 4 lattice cells, fx, fz: the positions within them in [0, 1) -> out: 4 value noise samples in [-1, 1)
+inline void valueNoise4(const core::i32* cx, const core::i32* cz, const float* fx, const float* fz, core::u32 seed, float* out) noexcept {
+#if defined(__ARM_NEON)
+    const uint32x4_t ix = vreinterpretq_u32_s32(vld1q_s32(cx));
+    const uint32x4_t iz = vreinterpretq_u32_s32(vld1q_s32(cz));
+    const uint32x4_t one = vdupq_n_u32(1);
+    const uint32x4_t s = vdupq_n_u32(seed);
+    auto value = [&](uint32x4_t hx, uint32x4_t hz) {
+        uint32x4_t h = veorq_u32(veorq_u32(vmulq_n_u32(hx, HASH_X), vmulq_n_u32(hz, HASH_Z)), s);
+        h = veorq_u32(h, vshrq_n_u32(h, 15));
+        h = vmulq_n_u32(h, HASH_MIX);
+        h = veorq_u32(h, vshrq_n_u32(h, 12));
+        return vsubq_f32(vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(h, 8)), HASH_SCALE), vdupq_n_f32(1.f));
+    };
+    const float32x4_t v00 = value(ix, iz);
+    const float32x4_t v10 = value(vaddq_u32(ix, one), iz);
+    const float32x4_t v01 = value(ix, vaddq_u32(iz, one));
+    const float32x4_t v11 = value(vaddq_u32(ix, one), vaddq_u32(iz, one));
+    auto smooth = [](float32x4_t t) {
+        const float32x4_t inner = vaddq_f32(vmulq_f32(t, vsubq_f32(vmulq_n_f32(t, 6.f), vdupq_n_f32(15.f))), vdupq_n_f32(10.f));
+        return vmulq_f32(vmulq_f32(vmulq_f32(t, t), t), inner);
+    };
+    const float32x4_t u = smooth(vld1q_f32(fx));
+    const float32x4_t v = smooth(vld1q_f32(fz));
+    const float32x4_t top = vaddq_f32(v00, vmulq_f32(vsubq_f32(v10, v00), u));
+    const float32x4_t bottom = vaddq_f32(v01, vmulq_f32(vsubq_f32(v11, v01), u));
+    vst1q_f32(out, vaddq_f32(top, vmulq_f32(vsubq_f32(bottom, top), v)));
+#elif defined(__SSE2__)
+    const __m128 onef = _mm_set1_ps(1.f);
+    // SSE2 has no 32-bit low multiply: two 32x32->64 multiplies over the even and odd lanes, low halves interleaved
+    auto mullo = [](__m128i a, __m128i b) {
+        const __m128i even = _mm_mul_epu32(a, b);
+        const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    };
+    const __m128i ix = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cx));
+    const __m128i iz = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cz));
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i kx = _mm_set1_epi32(static_cast<int>(HASH_X));
+    const __m128i kz = _mm_set1_epi32(static_cast<int>(HASH_Z));
+    const __m128i km = _mm_set1_epi32(static_cast<int>(HASH_MIX));
+    const __m128i s = _mm_set1_epi32(static_cast<int>(seed));
+    const __m128 scale = _mm_set1_ps(HASH_SCALE);
+    auto value = [&](__m128i hx, __m128i hz) {
+        __m128i h = _mm_xor_si128(_mm_xor_si128(mullo(hx, kx), mullo(hz, kz)), s);
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+        h = mullo(h, km);
+        h = _mm_xor_si128(h, _mm_srli_epi32(h, 12));
+        // 24 bits fit a signed conversion
+        return _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), scale), onef);
+    };
+    const __m128 v00 = value(ix, iz);
+    const __m128 v10 = value(_mm_add_epi32(ix, one), iz);
+    const __m128 v01 = value(ix, _mm_add_epi32(iz, one));
+    const __m128 v11 = value(_mm_add_epi32(ix, one), _mm_add_epi32(iz, one));
+    auto smooth = [](__m128 t) {
+        const __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.f)), _mm_set1_ps(15.f))), _mm_set1_ps(10.f));
+        return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+    };
+    const __m128 u = smooth(_mm_loadu_ps(fx));
+    const __m128 v = smooth(_mm_loadu_ps(fz));
+    const __m128 top = _mm_add_ps(v00, _mm_mul_ps(_mm_sub_ps(v10, v00), u));
+    const __m128 bottom = _mm_add_ps(v01, _mm_mul_ps(_mm_sub_ps(v11, v01), u));
+    _mm_storeu_ps(out, _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), v)));
+#else
+    for(std::size_t k = 0; k < 4; ++k) {
+        // the cell after the last wraps, like the SIMD lanes
+        const core::i32 ix = cx[k];
+        const core::i32 iz = cz[k];
+        const core::i32 jx = static_cast<core::i32>(static_cast<core::u32>(ix) + 1);
+        const core::i32 jz = static_cast<core::i32>(static_cast<core::u32>(iz) + 1);
+        const float u = fade(fx[k]);
+        const float v = fade(fz[k]);
+        const float v00 = lattice(ix, iz, seed);
+        const float v10 = lattice(jx, iz, seed);
+        const float v01 = lattice(ix, jz, seed);
+        const float v11 = lattice(jx, jz, seed);
+        const float top = v00 + (v10 - v00) * u;
+        const float bottom = v01 + (v11 - v01) * u;
+        out[k] = top + (bottom - top) * v;
+    }
+#endif
+}
+
+// position in lattice units -> its cell, wrapped to 32 bits, and the float fraction within it
+inline void splitLattice(double p, core::i32& cell, float& fraction) noexcept {
+    const double floor = std::floor(p);
+    cell = static_cast<core::i32>(static_cast<core::u32>(static_cast<std::int64_t>(floor)));
+    fraction = static_cast<float>(p - floor);
+}
+
+// x, z: 4 positions in lattice units of the first octave -> out: octaves of valueNoise4, each lacunarity
+// times the frequency and gain times the amplitude of the last, normalized back to [-1, 1)
+inline void fractalNoise4(const double* x, const double* z, core::u32 seed, core::u32 octaves,
+    float lacunarity, float gain, float* out) noexcept
+{
+    float sum[4]{};
+    double frequency = 1.0;
+    float amplitude = 1.f;
+    float total = 0.f;
+    for(core::u32 octave = 0; octave < octaves; ++octave) {
+        core::i32 cx[4];
+        core::i32 cz[4];
+        float fx[4];
+        float fz[4];
+        float n[4];
+        for(std::size_t k = 0; k < 4; ++k) {
+            splitLattice(x[k] * frequency, cx[k], fx[k]);
+            splitLattice(z[k] * frequency, cz[k], fz[k]);
+        }
+        valueNoise4(cx, cz, fx, fz, seed + octave * OCTAVE_SEED, n);
+        for(std::size_t k = 0; k < 4; ++k) {
+            sum[k] += n[k] * amplitude;
+        }
+        total += amplitude;
+        frequency *= static_cast<double>(lacunarity);
+        amplitude *= gain;
+    }
+    const float normalize = total > 0.f ? 1.f / total : 0.f;
+    for(std::size_t k = 0; k < 4; ++k) {
+        out[k] = sum[k] * normalize;
+    }
+}
+
+}
+
+}
@@ -1,27 +1,61 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
 #include <optional>
 #include <span>
 #include <vector>
-#include <unordered_map>
 
 #include "engine/world/chunk_data.hpp"
+#include "engine/world/chunk_table.hpp"
 
 namespace engine::world {
 
-class ChunkPool {
+// result of requesting a pool slot for a chunk
+struct ChunkPoolRequest {
+    std::size_t poolIndex{ 0 };
+    // false if the chunk already had a slot
+    bool inserted{ false };
+    // chunk whose slot was reclaimed to make room, if any
+    std::optional<Chunk> evicted{};
+};
+
+// lookups (getPoolIndex, getChunkStatus, setChunkStatus) are lock-free and safe from any thread,
+// request/unload are serialized against each other
+// note: slots are only ever reused inside request/unload, so a ChunkData& stays valid
+// until the thread that owns those calls evicts it
+template<ChunkGeometry Traits>
+class BasicChunkPool {
+public:
+    using Data = BasicChunkData<Traits>;
+
+    // the chunk table packs pool indices into 16 bits, slots past its range could never be looked up
+    static constexpr const std::size_t MAX_CAPACITY = ChunkTable::MAX_INDEX + 1;
+
+private:
     // chunk pool
-    std::vector<ChunkData> pool{};
+    std::vector<Data> pool{};
+
+    // per slot bookkeeping as structure of arrays, so scans (eviction, lookups that check a slot
+    // still holds their chunk) walk dense words instead of striding through kilobyte ChunkData
+    // chunk coords of each slot, packed with chunkKey
+    std::vector<std::atomic<core::u64>> coords{};
 
     // loaded
     std::vector<std::atomic<ChunkStatus>> status{};
 
+    // last time each slot was requested or fetched, drives LRU eviction
+    std::vector<std::atomic<core::u64>> lastUsed{};
+    std::atomic<core::u64> clock{ 0 };
+
     // free stack, filled with indices into the chunk pool at init
     std::vector<std::size_t> loadable{};
 
     // chunk coords -> chunk pool index
-    std::unordered_map<Chunk, std::size_t, ChunkHash> chunkToLoaded{};
+    ChunkTable chunkToLoaded;
 
     // pool indices that are loaded
     std::vector<std::size_t> loaded{};
@@ -29,73 +63,107 @@ class ChunkPool {
     // pool index -> location in loaded
     std::vector<std::size_t> loadedIndex{};
 
+    // serializes writers of the free stack, loaded lists and chunk table
+    std::mutex writer{};
+
 public:
-    ChunkPool(const std::size_t capacity)
-        : pool(capacity),
-          status(capacity),
-          loadedIndex(capacity)
+    // capacity is clamped to MAX_CAPACITY, everything else is sized from the pool
+    BasicChunkPool(const std::size_t capacity)
+        : pool(clampCapacity(capacity)),
+          coords(pool.size()),
+          status(pool.size()),
+          lastUsed(pool.size()),
+          chunkToLoaded(pool.size()),
+          loadedIndex(pool.size())
     {
         // set all chunks unloaded
         for(std::size_t i = 0; i < status.size(); ++i) {
+            coords[i] = 0;
             status[i] = ChunkStatus::Unloaded;
+            lastUsed[i] = 0;
         }
         // we can at most load all of our chunks
-        loaded.reserve(capacity);
+        loaded.reserve(pool.size());
 
         // populate loadable with indices into the pool
-        loadable.reserve(capacity);
+        loadable.reserve(pool.size());
         for(std::size_t i = 0; i < pool.size(); ++i) {
             loadable.push_back(i);
         }
     }
 
+    std::size_t capacity() const noexcept {
+        return pool.size();
+    }
+
     // load: request index to ChunkData pool for later reads
-    void request(Chunk chunk) {
-        // out of space?
-        // todo: eviction notice
+    // when the pool is full the least recently used Loaded chunk is evicted, returns nullopt
+    // only if every slot is still Loading (or the coords are out of range), so the caller can retry
+    std::optional<ChunkPoolRequest> request(Chunk chunk) {
+        if(!ChunkTable::representable(chunk)) {
+            return std::nullopt;
+        }
+        std::lock_guard lock(writer);
+
+        // already have a slot: just refresh it
+        std::optional<std::size_t> existing = chunkToLoaded.find(chunk);
+        if(existing.has_value()) {
+            touch(*existing);
+            return ChunkPoolRequest{ .poolIndex = *existing, .inserted = false };
+        }
+
+        ChunkPoolRequest result{ .inserted = true };
         if(loadable.empty()) {
-            return;
+            std::optional<std::size_t> victim = leastRecentlyUsed();
+            if(!victim.has_value()) {
+                return std::nullopt;
+            }
+            result.evicted = getSlotChunk(*victim);
+            release(*victim);
         }
         std::size_t poolIndex = loadable.back();
         loadable.pop_back();
+        result.poolIndex = poolIndex;
 
-        // insert pool index into hash by chunk coordinates
-        chunkToLoaded[chunk] = poolIndex;
+        // reset the slot for its new chunk
+        coords[poolIndex].store(chunkKey(chunk), std::memory_order_relaxed);
+        pool[poolIndex].chunk = chunk;
+        pool[poolIndex].mapped = {};
+        pool[poolIndex].mappedNormals = {};
+        pool[poolIndex].mappedBounds = {};
+        touch(poolIndex);
 
         // update loaded list of chunks and
         loadedIndex[poolIndex] = loaded.size();
         loaded.push_back(poolIndex);
 
-        // update status to loading
+        // update status to loading before publishing the slot to readers
         status[poolIndex].store(ChunkStatus::Loading, std::memory_order_release);
-        return;
-    }
 
-    void unload(Chunk chunk) {
-        if(!chunkToLoaded.contains(chunk)) {
-            // todo: log
-            return;
+        // insert pool index into hash by chunk coordinates
+        if(!chunkToLoaded.insert(chunk, poolIndex)) {
+            // unreachable with the capacity clamped and the table at 1/4 load, but a slot nobody can
+            // find would never be filled or freed: hand it straight back
+            loaded.pop_back();
+            loadable.push_back(poolIndex);
+            status[poolIndex].store(ChunkStatus::Unloaded, std::memory_order_release);
+            return std::nullopt;
         }
-        std::size_t poolIndex = chunkToLoaded[chunk];
-        std::size_t ldIndex = loadedIndex[poolIndex];
-
-        // delist from the chunk coord -> pool index mapping
-        chunkToLoaded.erase(chunk);
-
-        // swap this chunk to be unloaded with the last loaded chunk
-        // in the loaded list, so that we can pop it off
-        std::size_t prevIndex = loaded.back();
-        std::swap(loaded[ldIndex], loaded[prevIndex]);
-        loaded.pop_back();
-
-        // fix the pool index -> loaded list index for the swapped chunk
-        loadedIndex[prevIndex] = ldIndex;
-
-        // add the unloaded chunk pool index into the loadable pool indices
-        loadable.push_back(poolIndex);
+        return result;
+    }
 
-        // update status to unloaded
-        status[poolIndex].store(ChunkStatus::Unloaded, std::memory_order_release);
+    // returns false if the chunk has no slot, or a worker is still filling it
+    bool unload(Chunk chunk) {
+        std::lock_guard lock(writer);
+        std::optional<std::size_t> poolIndex = chunkToLoaded.find(chunk);
+        if(!poolIndex.has_value()) {
+            return false;
+        }
+        if(status[*poolIndex].load(std::memory_order_acquire) == ChunkStatus::Loading) {
+            return false;
+        }
+        release(*poolIndex);
+        return true;
     }
 
     std::span<const std::size_t> getRequestedChunkIds() const noexcept {
@@ -104,31 +172,146 @@ public:
 
     ChunkStatus getChunkStatus(Chunk chunk) const noexcept {
         // if we haven't loaded the chunk yet, just return unloaded
-        if(!chunkToLoaded.contains(chunk)) {
+        std::optional<std::size_t> poolIndex = chunkToLoaded.find(chunk);
+        if(!poolIndex.has_value()) {
             return ChunkStatus::Unloaded;
         }
-        std::size_t poolIndex = chunkToLoaded.at(chunk);
-        return status[poolIndex].load(std::memory_order_acquire);
+        return status[*poolIndex].load(std::memory_order_acquire);
     }
 
     void setChunkStatus(Chunk chunk, ChunkStatus s) noexcept {
-        if(!chunkToLoaded.contains(chunk)) {
+        std::optional<std::size_t> poolIndex = chunkToLoaded.find(chunk);
+        if(!poolIndex.has_value()) {
             return;
         }
-        std::size_t poolIndex = chunkToLoaded.at(chunk);
-        status[poolIndex].store(s, std::memory_order_release);
+        status[*poolIndex].store(s, std::memory_order_release);
     }
 
     std::optional<std::size_t> getPoolIndex(Chunk chunk) const noexcept {
-        if(chunkToLoaded.contains(chunk)) {
-            return chunkToLoaded.at(chunk);
-        }
-        return std::nullopt;
+        return chunkToLoaded.find(chunk);
     }
 
-    ChunkData& getChunkData(std::size_t poolIndex) noexcept {
+    ChunkStatus getSlotStatus(std::size_t poolIndex) const noexcept {
+        return status[poolIndex].load(std::memory_order_acquire);
+    }
+
+    // chunk a slot was last handed to, without touching its ChunkData
+    Chunk getSlotChunk(std::size_t poolIndex) const noexcept {
+        return chunkFromKey(coords[poolIndex].load(std::memory_order_relaxed));
+    }
+
+    Data& getChunkData(std::size_t poolIndex) noexcept {
+        return pool[poolIndex];
+    }
+
+    const Data& getChunkData(std::size_t poolIndex) const noexcept {
         return pool[poolIndex];
     }
+
+    // height at sample (x, z) of chunk c, where x and z may run past [0, Traits::cells] into neighbouring
+    // chunks: edges are shared, so sample Traits::cells of a chunk is sample 0 of the next one
+    // returns nullopt if the chunk holding the sample isn't Loaded
+    // note: like getChunkData, only stable until the request/unload thread evicts that chunk
+    std::optional<core::i16> sampleHeight(Chunk c, core::i32 x, core::i32 z) const noexcept {
+        // along each axis, samples on c's own edges are served by c
+        constexpr core::i32 cells = Traits::cells;
+        auto neighbour = [](core::i32 s) {
+            if(s < 0) {
+                return (s - cells + 1) / cells;
+            }
+            return s > cells ? (s - 1) / cells : 0;
+        };
+        const core::i32 dx = neighbour(x);
+        const core::i32 dz = neighbour(z);
+        c = { .x = c.x + dx, .z = c.z + dz };
+        x -= dx * cells;
+        z -= dz * cells;
+        std::optional<std::size_t> poolIndex = chunkToLoaded.find(c);
+        if(!poolIndex.has_value() || status[*poolIndex].load(std::memory_order_acquire) != ChunkStatus::Loaded) {
+            return std::nullopt;
+        }
+        return pool[*poolIndex].getHeights()[static_cast<std::size_t>(z * Traits::resolution + x)];
+    }
+
+    // unit surface normal at sample (x, z) of chunk c, from central differences that read across into
+    // neighbouring chunks at c's edges, one-sided where a neighbour isn't Loaded
+    // sampleSpacing: world distance between samples
+    std::optional<float3> sampleNormal(Chunk c, core::i32 x, core::i32 z, float sampleSpacing = Traits::spacing) const noexcept {
+        std::optional<core::i16> center = sampleHeight(c, x, z);
+        if(!center.has_value()) {
+            return std::nullopt;
+        }
+        // d/dx or d/dz over [-1, +1] samples, whichever of them are loaded
+        auto slope = [&](core::i32 ix, core::i32 iz) {
+            const std::optional<core::i16> lo = sampleHeight(c, x - ix, z - iz);
+            const std::optional<core::i16> hi = sampleHeight(c, x + ix, z + iz);
+            const float h0 = static_cast<float>(lo.value_or(*center));
+            const float h1 = static_cast<float>(hi.value_or(*center));
+            const float span = static_cast<float>(lo.has_value() + hi.has_value()) * sampleSpacing;
+            return span > 0.f ? (h1 - h0) / span : 0.f;
+        };
+        const float dx = slope(1, 0);
+        const float dz = slope(0, 1);
+        const float length = std::sqrt(dx * dx + 1.f + dz * dz);
+        return float3{ .x = -dx / length, .y = 1.f / length, .z = -dz / length };
+    }
+
+    // mark a slot as recently used so it is evicted last
+    void touch(std::size_t poolIndex) noexcept {
+        lastUsed[poolIndex].store(clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+private:
+    static std::size_t clampCapacity(std::size_t capacity) noexcept {
+        if(capacity > MAX_CAPACITY) {
+            printf("chunk pool: capacity %zu clamped to %zu slots\n", capacity, MAX_CAPACITY);
+            return MAX_CAPACITY;
+        }
+        return capacity;
+    }
+
+    // oldest Loaded slot, Loading slots are being written by a worker and can't be evicted
+    // only called with every slot taken, so a linear pass over the status and stamp arrays
+    // (sequential, prefetched) visits the same slots as the loaded list would, without its indirection
+    std::optional<std::size_t> leastRecentlyUsed() const noexcept {
+        std::optional<std::size_t> victim{};
+        core::u64 oldest = UINT64_MAX;
+        for(std::size_t poolIndex = 0; poolIndex < status.size(); ++poolIndex) {
+            if(status[poolIndex].load(std::memory_order_acquire) != ChunkStatus::Loaded) {
+                continue;
+            }
+            const core::u64 used = lastUsed[poolIndex].load(std::memory_order_relaxed);
+            if(used < oldest) {
+                oldest = used;
+                victim = poolIndex;
+            }
+        }
+        return victim;
+    }
+
+    // return a slot to the free stack, caller holds the writer lock
+    void release(std::size_t poolIndex) noexcept {
+        // delist from the chunk coord -> pool index mapping
+        chunkToLoaded.erase(getSlotChunk(poolIndex));
+
+        // swap this chunk to be unloaded with the last loaded chunk
+        // in the loaded list, so that we can pop it off
+        std::size_t ldIndex = loadedIndex[poolIndex];
+        std::size_t lastIndex = loaded.back();
+        loaded[ldIndex] = lastIndex;
+        loaded.pop_back();
+
+        // fix the pool index -> loaded list index for the swapped chunk
+        loadedIndex[lastIndex] = ldIndex;
+
+        // add the unloaded chunk pool index into the loadable pool indices
+        loadable.push_back(poolIndex);
+
+        // update status to unloaded
+        status[poolIndex].store(ChunkStatus::Unloaded, std::memory_order_release);
+    }
 };
 
+using ChunkPool = BasicChunkPool<DefaultChunkTraits>;
+
 }
@@ -1,53 +1,170 @@
+// chunk_queue.hpp: bounded lock-free multi-producer/multi-consumer ring buffer of chunk jobs
+//     each cell carries a sequence number that tells producers/consumers whose turn it is,
+//     idle consumers park on an atomic counter instead of a mutex + condition variable
 #pragma once
 
-#include <functional>
-#include <queue>
-#include <condition_variable>
+#include <atomic>
+#include <bit>
+#include <cstddef>
 #include <stop_token>
-#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "engine/world/chunk.hpp"
 
 namespace engine::world {
 
+// fixed rather than std::hardware_destructive_interference_size, which GCC warns about in every
+// translation unit that includes it (its value may differ between compiler flags)
+constexpr const std::size_t CACHE_LINE = 64;
+
 class ChunkQueue {
 private:
-    // todo: ring buffer + atomic
-    std::queue<Chunk> jobs{};
-    std::mutex mutex{};
-    std::condition_variable_any cv{};
+    struct Cell {
+        // == position: free for the producer claiming position
+        // == position + 1: filled, ready for the consumer claiming position
+        std::atomic<std::size_t> sequence{ 0 };
+        Chunk job{};
+    };
+
+    // number of failed pops before a consumer parks
+    static constexpr const std::size_t spinCount = 64;
+
+    std::vector<Cell> cells;
+    const std::size_t mask;
+
+    // producer and consumer cursors live on separate cache lines
+    alignas(CACHE_LINE) std::atomic<std::size_t> head{ 0 };
+    alignas(CACHE_LINE) std::atomic<std::size_t> tail{ 0 };
+
+    // bumped on every push/wake, consumers park on it with atomic wait
+    alignas(CACHE_LINE) std::atomic<core::u32> signal{ 0 };
+    // number of parked consumers, so push only issues a wake when someone sleeps
+    std::atomic<core::u32> sleepers{ 0 };
 
 public:
-    void push(Chunk job) {
-        {
-            std::lock_guard lock(mutex);
-            jobs.push(std::move(job));
+    // capacity is rounded up to a power of two
+    explicit ChunkQueue(std::size_t capacity)
+        : cells(std::bit_ceil(std::max<std::size_t>(capacity, 2))),
+          mask(cells.size() - 1)
+    {
+        for(std::size_t i = 0; i < cells.size(); ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
         }
-        cv.notify_one();
     }
 
-    // return false if stop is requested and there are no chunks to load
-    bool pop(Chunk& out, std::stop_token st) {
-        std::unique_lock lock(mutex);
+    ChunkQueue(const ChunkQueue&) = delete;
+    ChunkQueue& operator=(const ChunkQueue&) = delete;
 
-        cv.wait(lock, st, [&] {
-            return st.stop_requested() || !jobs.empty();
-        });
+    std::size_t capacity() const noexcept {
+        return cells.size();
+    }
 
-        // stop request + no job
-        if(st.stop_requested() && jobs.empty()) {
-            return false;
+    // returns false if the ring is full
+    bool push(Chunk job) noexcept {
+        std::size_t pos = head.load(std::memory_order_relaxed);
+        Cell* cell{ nullptr };
+        for(;;) {
+            cell = &cells[pos & mask];
+            const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if(diff == 0) {
+                if(head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if(diff < 0) {
+                return false;
+            }
+            else {
+                pos = head.load(std::memory_order_relaxed);
+            }
         }
+        cell->job = job;
+        cell->sequence.store(pos + 1, std::memory_order_release);
 
-        out = std::move(jobs.front());
-        jobs.pop();
+        wake(false);
         return true;
     }
 
-    void notify_all() {
-        cv.notify_all();
+    // returns false if the ring is empty
+    bool tryPop(Chunk& out) noexcept {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        Cell* cell{ nullptr };
+        for(;;) {
+            cell = &cells[pos & mask];
+            const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if(diff == 0) {
+                if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if(diff < 0) {
+                return false;
+            }
+            else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        out = cell->job;
+        // hand the cell back to producers one lap ahead
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
     }
 
+    // blocks until a chunk is popped
+    // returns false as soon as stop is requested: chunks still queued are dropped, not drained,
+    // so shutdown never waits behind a deep queue of loads nobody will look at
+    bool pop(Chunk& out, std::stop_token st) noexcept {
+        for(;;) {
+            // spin a little before paying for a park
+            for(std::size_t i = 0; i < spinCount; ++i) {
+                if(st.stop_requested()) {
+                    return false;
+                }
+                if(tryPop(out)) {
+                    return true;
+                }
+                std::this_thread::yield();
+            }
+
+            // park: announce ourselves, then re-check before sleeping on the counter
+            const core::u32 observed = signal.load(std::memory_order_seq_cst);
+            sleepers.fetch_add(1, std::memory_order_seq_cst);
+            if(st.stop_requested()) {
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+                return false;
+            }
+            if(tryPop(out)) {
+                sleepers.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            if(signal.load(std::memory_order_seq_cst) == observed) {
+                signal.wait(observed, std::memory_order_seq_cst);
+            }
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // wake every parked consumer, e.g. after requesting stop on the workers
+    void notify_all() noexcept {
+        wake(true);
+    }
+
+private:
+    void wake(bool all) noexcept {
+        signal.fetch_add(1, std::memory_order_seq_cst);
+        if(sleepers.load(std::memory_order_seq_cst) == 0) {
+            return;
+        }
+        if(all) {
+            signal.notify_all();
+        }
+        else {
+            signal.notify_one();
+        }
+    }
 };
 
 }
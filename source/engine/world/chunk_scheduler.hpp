@@ -0,0 +1,187 @@
+// chunk_scheduler.hpp: defines the ChunkScheduler, which holds chunk requests that have not been
+//     handed to a worker yet and re-scores them against the camera every frame, so the chunks
+//     nearest to (and in front of) the camera are read first and far away ones can be cancelled
+//     a chunk -> pending slot index keeps push/contains/cancel O(1), so per-frame status checks
+//     over every candidate chunk stay linear
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "engine/world/camera.hpp"
+#include "engine/world/chunk.hpp"
+#include "engine/world/chunk_data.hpp"
+
+namespace engine::world {
+
+struct StreamingParams {
+    // pending chunks whose centers are further than this from the camera are cancelled
+    float cancelRadius{ 1024.f };
+    // distance multiplier for chunks outside the view cone
+    float outOfViewPenalty{ 4.f };
+    // [0, 1]: how much chunks along the direction of motion are favoured
+    float motionWeight{ 0.5f };
+    // horizontal half-angle of the view cone, relative to the camera's vertical fov
+    // accounts for widescreen aspect ratios without knowing the viewport
+    float viewConeScale{ 0.9f };
+};
+
+// not thread-safe: owned by whichever thread requests chunks and updates the camera
+class ChunkScheduler {
+    struct Pending {
+        Chunk chunk{};
+        // lower is more urgent
+        float score{ 0.f };
+        // cancelled in place, skipped by pop and dropped on the next update
+        bool cancelled{ false };
+    };
+
+    // sorted most urgent last after every update, so dispatch pops from the back
+    std::vector<Pending> pending{};
+    // live (not cancelled) entries of pending by chunk
+    std::unordered_map<Chunk, std::size_t, ChunkHash> index{};
+
+    StreamingParams params{};
+
+    // camera state from the last update, for direction of motion
+    glm::vec3 lastPosition{ 0.f };
+    bool hasLastPosition{ false };
+
+    std::size_t cancellations{ 0 };
+
+public:
+    void setParams(const StreamingParams& p) noexcept {
+        params = p;
+    }
+
+    const StreamingParams& getParams() const noexcept {
+        return params;
+    }
+
+    // queue a chunk, returns false if it was already pending
+    // unscored until the next update sorts it into place, so it goes on the back
+    bool push(Chunk c) {
+        if(!index.try_emplace(c, pending.size()).second) {
+            return false;
+        }
+        pending.push_back(Pending{ .chunk = c, .score = INFINITY });
+        return true;
+    }
+
+    bool contains(Chunk c) const noexcept {
+        return index.contains(c);
+    }
+
+    // drop a pending chunk before any worker sees it
+    bool cancel(Chunk c) noexcept {
+        auto it = index.find(c);
+        if(it == index.end()) {
+            return false;
+        }
+        pending[it->second].cancelled = true;
+        index.erase(it);
+        ++cancellations;
+        return true;
+    }
+
+    // most urgent pending chunk, if any
+    bool pop(Chunk& out) noexcept {
+        while(!pending.empty()) {
+            const Pending p = pending.back();
+            pending.pop_back();
+            if(!p.cancelled) {
+                index.erase(p.chunk);
+                out = p.chunk;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // put a chunk that could not be dispatched back as the most urgent
+    void unpop(Chunk c) {
+        if(index.try_emplace(c, pending.size()).second) {
+            pending.push_back(Pending{ .chunk = c, .score = 0.f });
+        }
+    }
+
+    std::size_t size() const noexcept {
+        return index.size();
+    }
+
+    std::size_t getCancellationCount() const noexcept {
+        return cancellations;
+    }
+
+    // re-score every pending chunk from the camera, cancel any that fell out of range
+    void update(const Camera& camera) {
+        const glm::vec2 eye{ camera.position.x, camera.position.z };
+
+        glm::vec2 look{ camera.look.x, camera.look.z };
+        const bool hasLook = glm::dot(look, look) > 1e-8f;
+        if(hasLook) {
+            look = glm::normalize(look);
+        }
+
+        glm::vec2 motion{ 0.f };
+        if(hasLastPosition) {
+            motion = eye - glm::vec2{ lastPosition.x, lastPosition.z };
+            if(glm::dot(motion, motion) > 1e-8f) {
+                motion = glm::normalize(motion);
+            }
+        }
+        lastPosition = camera.position;
+        hasLastPosition = true;
+
+        const float halfAngle = glm::radians(camera.fovDeg) * params.viewConeScale;
+        // bounding circle of a chunk's footprint
+        const float chunkRadius = static_cast<float>(CHUNK_SIZE) * 0.70710678f;
+
+        std::erase_if(pending, [&](Pending& p) {
+            if(p.cancelled) {
+                return true;
+            }
+            const float2 origin = chunkToWorldPositionXZ(p.chunk);
+            const glm::vec2 center{
+                origin.x + 0.5f * CHUNK_SIZE,
+                origin.y + 0.5f * CHUNK_SIZE
+            };
+            const glm::vec2 toChunk = center - eye;
+            const float distance = glm::length(toChunk);
+
+            if(distance > params.cancelRadius) {
+                index.erase(p.chunk);
+                ++cancellations;
+                return true;
+            }
+
+            float score = distance;
+            if(distance > chunkRadius) {
+                const glm::vec2 dir = toChunk / distance;
+                // in the view cone if any part of the chunk's bounding circle is
+                const float angle = std::acos(std::clamp(glm::dot(dir, look), -1.f, 1.f));
+                const float slack = std::asin(chunkRadius / distance);
+                if(hasLook and angle - slack > halfAngle) {
+                    score *= params.outOfViewPenalty;
+                }
+                // favour chunks ahead of where we're moving
+                score *= 1.f - params.motionWeight * std::max(0.f, glm::dot(dir, motion));
+            }
+            p.score = score;
+            return false;
+        });
+
+        // most urgent last
+        std::ranges::sort(pending, [](const Pending& a, const Pending& b){ return a.score > b.score; });
+        // every remaining chunk is already indexed, only its slot moved
+        for(std::size_t i = 0; i < pending.size(); ++i) {
+            index[pending[i].chunk] = i;
+        }
+    }
+};
+
+}
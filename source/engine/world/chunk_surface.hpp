@@ -0,0 +1,143 @@
+// chunk_surface.hpp: per-chunk surface data derived from heights, precomputed by the ChunkBuilder
+//     normals: octahedral packed, two unorm8 components per sample
+//     bounds: min/max height pyramid over the chunk's cells, finest level first, last entry the whole chunk
+//     files without them (older versions) get them derived here at load time instead
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <span>
+
+#include "engine/world/chunk.hpp"
+
+namespace engine::world {
+
+struct ChunkBounds {
+    core::i16 min{ std::numeric_limits<core::i16>::max() };
+    core::i16 max{ std::numeric_limits<core::i16>::min() };
+};
+
+// pyramid levels: 8x8 cells (of 4x4 quads at CHUNK_RESOLUTION), then 4x4, 2x2 and the whole chunk
+// the same for every resolution, so bounds sections are one size
+constexpr const std::size_t CHUNK_BOUNDS_LEVELS = 4;
+constexpr const std::size_t CHUNK_BOUNDS_WIDTH = 8;
+
+// cells at level, along an edge
+constexpr inline std::size_t chunkBoundsWidth(std::size_t level) noexcept {
+    return CHUNK_BOUNDS_WIDTH >> level;
+}
+
+// index of level's first cell
+constexpr inline std::size_t chunkBoundsOffset(std::size_t level) noexcept {
+    std::size_t offset = 0;
+    for(std::size_t l = 0; l < level; ++l) {
+        offset += chunkBoundsWidth(l) * chunkBoundsWidth(l);
+    }
+    return offset;
+}
+
+constexpr const std::size_t CHUNK_BOUNDS_CELLS = chunkBoundsOffset(CHUNK_BOUNDS_LEVELS);
+
+constexpr inline std::size_t chunkNormalsBytes(std::size_t resolution) noexcept {
+    return sizeof(core::u16) * resolution * resolution;
+}
+
+constexpr const std::size_t CHUNK_BOUNDS_BYTES = sizeof(ChunkBounds) * CHUNK_BOUNDS_CELLS;
+
+// n: unit vector, y up
+inline core::u16 packOctahedral(float x, float y, float z) noexcept {
+    const float l1 = std::abs(x) + std::abs(y) + std::abs(z);
+    float u = x / l1;
+    float v = z / l1;
+    // fold the lower hemisphere over the diagonals
+    if(y < 0.f) {
+        const float fu = (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+        const float fv = (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+        u = fu;
+        v = fv;
+    }
+    auto unorm8 = [](float s) {
+        return static_cast<core::u16>(std::lround(std::clamp(s * 0.5f + 0.5f, 0.f, 1.f) * 255.f));
+    };
+    return static_cast<core::u16>(unorm8(u) | (unorm8(v) << 8));
+}
+
+inline float3 unpackOctahedral(core::u16 packed) noexcept {
+    const float u = static_cast<float>(packed & 0xFF) / 255.f * 2.f - 1.f;
+    const float v = static_cast<float>(packed >> 8) / 255.f * 2.f - 1.f;
+    float3 n{ .x = u, .y = 1.f - std::abs(u) - std::abs(v), .z = v };
+    if(n.y < 0.f) {
+        n.x = (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+        n.z = (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+    }
+    const float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+    return { .x = n.x / length, .y = n.y / length, .z = n.z / length };
+}
+
+// octahedral normal from central differences of height(x, z), which must cover one sample past
+// each edge of the chunk (x, z in [-1, Traits::resolution])
+template<ChunkGeometry Traits = DefaultChunkTraits, std::invocable<core::i32, core::i32> Height>
+void computeChunkNormals(Height&& height, std::span<core::u16> normals) noexcept {
+    constexpr core::i32 N = Traits::resolution;
+    constexpr float scale = 0.5f / Traits::spacing;
+    for(core::i32 z = 0; z < N; ++z) {
+        for(core::i32 x = 0; x < N; ++x) {
+            const float dx = (static_cast<float>(height(x + 1, z)) - static_cast<float>(height(x - 1, z))) * scale;
+            const float dz = (static_cast<float>(height(x, z + 1)) - static_cast<float>(height(x, z - 1))) * scale;
+            const float length = std::sqrt(dx * dx + 1.f + dz * dz);
+            normals[static_cast<std::size_t>(z * N + x)] = packOctahedral(-dx / length, 1.f / length, -dz / length);
+        }
+    }
+}
+
+// normals from the chunk's own heights alone, one-sided along its edges
+template<ChunkGeometry Traits = DefaultChunkTraits>
+void computeChunkNormals(std::span<const core::i16> heights, std::span<core::u16> normals) noexcept {
+    constexpr core::i32 N = Traits::resolution;
+    computeChunkNormals<Traits>([&](core::i32 x, core::i32 z) {
+        return heights[static_cast<std::size_t>(std::clamp(z, 0, N - 1) * N + std::clamp(x, 0, N - 1))];
+    }, normals);
+}
+
+template<ChunkGeometry Traits = DefaultChunkTraits>
+void computeChunkBounds(std::span<const core::i16> heights, std::span<ChunkBounds> bounds) noexcept {
+    constexpr std::size_t N = Traits::resolution;
+    constexpr std::size_t quads = Traits::cells / CHUNK_BOUNDS_WIDTH;
+    // finest level: every sample of a cell's quads, edges included so neighbouring cells overlap
+    for(std::size_t cz = 0; cz < CHUNK_BOUNDS_WIDTH; ++cz) {
+        for(std::size_t cx = 0; cx < CHUNK_BOUNDS_WIDTH; ++cx) {
+            ChunkBounds cell{};
+            for(std::size_t z = cz * quads; z <= (cz + 1) * quads; ++z) {
+                for(std::size_t x = cx * quads; x <= (cx + 1) * quads; ++x) {
+                    cell.min = std::min(cell.min, heights[z * N + x]);
+                    cell.max = std::max(cell.max, heights[z * N + x]);
+                }
+            }
+            bounds[cz * CHUNK_BOUNDS_WIDTH + cx] = cell;
+        }
+    }
+    // coarser levels: 2x2 children each
+    for(std::size_t level = 1; level < CHUNK_BOUNDS_LEVELS; ++level) {
+        const std::size_t width = chunkBoundsWidth(level);
+        const std::size_t childWidth = chunkBoundsWidth(level - 1);
+        const ChunkBounds* children = bounds.data() + chunkBoundsOffset(level - 1);
+        ChunkBounds* cells = bounds.data() + chunkBoundsOffset(level);
+        for(std::size_t cz = 0; cz < width; ++cz) {
+            for(std::size_t cx = 0; cx < width; ++cx) {
+                ChunkBounds cell{};
+                for(std::size_t i = 0; i < 4; ++i) {
+                    const ChunkBounds& child = children[(2 * cz + i / 2) * childWidth + 2 * cx + i % 2];
+                    cell.min = std::min(cell.min, child.min);
+                    cell.max = std::max(cell.max, child.max);
+                }
+                cells[cz * width + cx] = cell;
+            }
+        }
+    }
+}
+
+}
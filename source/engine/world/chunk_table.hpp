@@ -0,0 +1,156 @@
+// chunk_table.hpp: defines ChunkTable, an open-addressing chunk coords -> pool index map
+//     every cell is a single packed atomic word, so readers on any thread can look up
+//     chunks without locks while one writer at a time inserts and erases
+//     erase shifts the rest of the probe run back instead of leaving tombstones, so churn never
+//     lengthens probes; a version counter, odd while a shift is moving cells, tells a reader whose
+//     lookup missed that a cell may have moved past it, and it probes again
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "engine/world/chunk.hpp"
+
+namespace engine::world {
+
+class ChunkTable {
+    // cell layout: [x : 24][z : 24][pool index + 1 : 16]
+    // a cell of 0 is empty and ends a probe
+    static constexpr const core::u64 EMPTY = 0;
+    static constexpr const core::u64 INDEX_MASK = 0xFFFF;
+    static constexpr const core::u64 COORD_MASK = 0xFFFFFF;
+
+    std::vector<std::atomic<core::u64>> cells;
+    const std::size_t mask;
+    // bumped to odd before erase moves any cell and back to even after
+    std::atomic<core::u32> version{ 0 };
+
+public:
+    // representable chunk coordinates and pool indices
+    static constexpr const core::i32 COORD_MIN = -(1 << 23);
+    static constexpr const core::i32 COORD_MAX = (1 << 23) - 1;
+    static constexpr const std::size_t MAX_INDEX = INDEX_MASK - 1;
+
+    // keep the load factor at or below 1/4 so probes stay short under churn
+    explicit ChunkTable(std::size_t capacity)
+        : cells(std::bit_ceil(std::max<std::size_t>(capacity * 4, 16))),
+          mask(cells.size() - 1)
+    {
+        for(std::atomic<core::u64>& cell : cells) {
+            cell.store(EMPTY, std::memory_order_relaxed);
+        }
+    }
+
+    ChunkTable(const ChunkTable&) = delete;
+    ChunkTable& operator=(const ChunkTable&) = delete;
+
+    static bool representable(Chunk chunk) noexcept {
+        return chunk.x >= COORD_MIN and chunk.x <= COORD_MAX
+           and chunk.z >= COORD_MIN and chunk.z <= COORD_MAX;
+    }
+
+    // lock-free, safe to call from any thread
+    // a hit is always current (cells carry their own key), only a miss during an erase is retried
+    std::optional<std::size_t> find(Chunk chunk) const noexcept {
+        if(!representable(chunk)) {
+            return std::nullopt;
+        }
+        const core::u64 key = pack(chunk);
+        for(;;) {
+            const core::u32 before = version.load(std::memory_order_acquire);
+            std::size_t i = hash(key) & mask;
+            for(std::size_t probe = 0; probe < cells.size(); ++probe, i = (i + 1) & mask) {
+                const core::u64 cell = cells[i].load(std::memory_order_acquire);
+                if(cell == EMPTY) {
+                    break;
+                }
+                if((cell >> 16) == key) {
+                    return static_cast<std::size_t>(cell & INDEX_MASK) - 1;
+                }
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if((before & 1) == 0 and version.load(std::memory_order_relaxed) == before) {
+                return std::nullopt;
+            }
+            // an erase is shifting cells, it only ever moves a short probe run
+            std::this_thread::yield();
+        }
+    }
+
+    // single writer: insert or overwrite a mapping, false if the table is full
+    bool insert(Chunk chunk, std::size_t poolIndex) noexcept {
+        if(!representable(chunk) or poolIndex > MAX_INDEX) {
+            return false;
+        }
+        const core::u64 key = pack(chunk);
+        const core::u64 value = (key << 16) | static_cast<core::u64>(poolIndex + 1);
+
+        std::size_t i = hash(key) & mask;
+        for(std::size_t probe = 0; probe < cells.size(); ++probe, i = (i + 1) & mask) {
+            const core::u64 cell = cells[i].load(std::memory_order_relaxed);
+            if(cell == EMPTY or (cell >> 16) == key) {
+                cells[i].store(value, std::memory_order_release);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // single writer: remove a mapping, false if it was not present
+    bool erase(Chunk chunk) noexcept {
+        if(!representable(chunk)) {
+            return false;
+        }
+        const core::u64 key = pack(chunk);
+        std::size_t i = hash(key) & mask;
+        for(std::size_t probe = 0; probe < cells.size(); ++probe, i = (i + 1) & mask) {
+            const core::u64 cell = cells[i].load(std::memory_order_relaxed);
+            if(cell == EMPTY) {
+                return false;
+            }
+            if((cell >> 16) == key) {
+                shiftBack(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    // backward-shift deletion: pull every later cell of the probe run whose home isn't between the
+    // hole and itself into the hole, until the run ends, then empty the last hole
+    void shiftBack(std::size_t hole) noexcept {
+        const core::u32 v = version.load(std::memory_order_relaxed);
+        version.store(v + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(std::size_t j = (hole + 1) & mask; ; j = (j + 1) & mask) {
+            const core::u64 cell = cells[j].load(std::memory_order_relaxed);
+            if(cell == EMPTY) {
+                break;
+            }
+            // distance from home to the cell vs from home to the hole, cyclically
+            const std::size_t home = hash(cell >> 16) & mask;
+            if(((j - home) & mask) >= ((hole - home) & mask)) {
+                cells[hole].store(cell, std::memory_order_release);
+                hole = j;
+            }
+        }
+        cells[hole].store(EMPTY, std::memory_order_release);
+        version.store(v + 2, std::memory_order_release);
+    }
+
+    static core::u64 pack(Chunk chunk) noexcept {
+        return ((static_cast<core::u64>(static_cast<core::u32>(chunk.x)) & COORD_MASK) << 24)
+              | (static_cast<core::u64>(static_cast<core::u32>(chunk.z)) & COORD_MASK);
+    }
+
+    // spreads neighbouring chunk coords across the table
+    static std::size_t hash(core::u64 key) noexcept {
+        return static_cast<std::size_t>(mixChunkKey(key));
+    }
+};
+
+}
@@ -0,0 +1,324 @@
+// chunk_world.hpp: defines ChunkWorld, the global chunk index: chunk coordinate -> (shard, offset) across
+//     every .chunk file of a sharded world, held as a grid indexed directly by chunk coordinate so a
+//     lookup is O(1) and nothing but the index itself is read at startup
+//     every shard must hold chunks of the resolution the world is opened for, a world mixing them
+//     (or built for another ChunkTraits) fails to open, as does one with shards from before shared edges
+//
+// World Index Binary File Format (.world)
+// [HEADER] - ChunkWorldHeader
+// [SHARDS] - numShards file names: u32 length + bytes, relative to the index's directory
+// [GRID] - width * height u64 cells, z-major: packChunkWorldCell(shard, offset), 0 where there is no data
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "engine/world/chunk.hpp"
+#include "engine/world/chunk_file.hpp"
+#include "engine/world/chunk_table.hpp"
+
+namespace engine::world {
+
+// "DVWORLD\0", read as a .chunk header it would claim more chunks than any file could hold
+constexpr const core::u64 CHUNK_WORLD_MAGIC = 0x00444c524f575644;
+
+struct ChunkWorldHeader {
+    core::u64 magic{ CHUNK_WORLD_MAGIC };
+    // chunk coordinate of grid cell (0,0)
+    core::i32 originX{};
+    core::i32 originZ{};
+    // grid size in chunks
+    core::u32 width{};
+    core::u32 height{};
+    core::u32 numShards{};
+    core::u32 pad{};
+};
+
+// grid cell: shard + 1 in the top 16 bits, byte offset into the shard in the low 48
+constexpr const core::u64 CHUNK_WORLD_OFFSET_MASK = (core::u64{ 1 } << 48) - 1;
+
+inline core::u64 packChunkWorldCell(core::u32 shard, core::u64 offset) noexcept {
+    return (static_cast<core::u64>(shard + 1) << 48) | (offset & CHUNK_WORLD_OFFSET_MASK);
+}
+
+// where a chunk's record lives, for reads that go around the mapping
+struct ChunkRecord {
+    const ChunkFile* shard{ nullptr };
+    core::u64 offset{};
+    // bytes to read, see ChunkFile::getRecordBytes
+    std::size_t bytes{};
+};
+
+// read-only after open, safe to query from any thread
+class ChunkWorld {
+    // most grid cells a lone .chunk file may need per chunk it holds
+    static constexpr const core::u64 maxCellsPerRecord = 64;
+
+    // mapped .chunk files
+    std::vector<ChunkFile> shards{};
+
+    // directly indexed grid over the bounding box of every chunk
+    std::vector<core::u64> cells{};
+    Chunk origin{};
+    core::u32 width{ 0 };
+    core::u32 height{ 0 };
+    std::size_t count{ 0 };
+    // samples along a chunk edge shards must have
+    core::u32 resolution{ static_cast<core::u32>(CHUNK_RESOLUTION) };
+
+public:
+    ChunkWorld() = default;
+
+    // a world index (.world), or a single .chunk file as a world of one shard
+    explicit ChunkWorld(const char* filename, core::u32 resolution = static_cast<core::u32>(CHUNK_RESOLUTION)) noexcept
+        : resolution(resolution)
+    {
+        open(filename);
+    }
+
+    ChunkWorld(const ChunkWorld&) = delete;
+    ChunkWorld& operator=(const ChunkWorld&) = delete;
+    ChunkWorld(ChunkWorld&&) = default;
+    ChunkWorld& operator=(ChunkWorld&&) = default;
+
+    bool isOpen() const noexcept {
+        return !shards.empty();
+    }
+
+    // number of chunks with data
+    std::size_t size() const noexcept {
+        return count;
+    }
+
+    std::size_t getShardCount() const noexcept {
+        return shards.size();
+    }
+
+    // bounding box of every chunk with data: width x height chunks from origin
+    Chunk getOrigin() const noexcept {
+        return origin;
+    }
+
+    core::u32 getWidth() const noexcept {
+        return width;
+    }
+
+    core::u32 getHeight() const noexcept {
+        return height;
+    }
+
+    core::u32 getResolution() const noexcept {
+        return resolution;
+    }
+
+    bool contains(Chunk c) const noexcept {
+        return cell(c) != 0;
+    }
+
+    // zero-copy views of a chunk's data, empty if the chunk is not in this world (see ChunkFile::view)
+    // note: the views are valid for as long as this ChunkWorld is open
+    ChunkView view(Chunk c) const noexcept {
+        const core::u64 packed = cell(c);
+        if(packed == 0) {
+            return {};
+        }
+        return shards[(packed >> 48) - 1].view(packed & CHUNK_WORLD_OFFSET_MASK);
+    }
+
+    // copy or decode a chunk's heights, normals and bounds out of its shard, returns false if the chunk
+    // is not in this world
+    template<ChunkGeometry Traits>
+    bool read(Chunk c, BasicChunkData<Traits>& out) const noexcept {
+        const core::u64 packed = cell(c);
+        if(packed == 0) {
+            return false;
+        }
+        return shards[(packed >> 48) - 1].read(packed & CHUNK_WORLD_OFFSET_MASK, out);
+    }
+
+    std::optional<ChunkRecord> locate(Chunk c) const noexcept {
+        const core::u64 packed = cell(c);
+        if(packed == 0) {
+            return std::nullopt;
+        }
+        const ChunkFile& shard = shards[(packed >> 48) - 1];
+        const core::u64 offset = packed & CHUNK_WORLD_OFFSET_MASK;
+        return ChunkRecord{ .shard = &shard, .offset = offset, .bytes = shard.getRecordBytes(offset) };
+    }
+
+    void prefetch(Chunk c) const noexcept {
+        const core::u64 packed = cell(c);
+        if(packed == 0) {
+            return;
+        }
+        shards[(packed >> 48) - 1].prefetch(packed & CHUNK_WORLD_OFFSET_MASK);
+    }
+
+private:
+    core::u64 cell(Chunk c) const noexcept {
+        // unsigned wrap turns chunks left of / above the origin into out of range ones too
+        const core::u64 gx = static_cast<core::u64>(static_cast<std::int64_t>(c.x) - origin.x);
+        const core::u64 gz = static_cast<core::u64>(static_cast<std::int64_t>(c.z) - origin.z);
+        if(gx >= width || gz >= height) {
+            return 0;
+        }
+        return cells[gz * width + gx];
+    }
+
+    void open(const char* filename) noexcept {
+        std::FILE* f = std::fopen(filename, "rb");
+        if(f == nullptr) {
+            printf("chunk world: could not open '%s'\n", filename);
+            return;
+        }
+        ChunkWorldHeader header{};
+        const bool isIndex = std::fread(&header, sizeof(header), 1, f) == 1 && header.magic == CHUNK_WORLD_MAGIC;
+        bool opened = isIndex ? openIndex(f, header, filename) : openChunkFile(filename);
+        std::fclose(f);
+        if(!opened) {
+            printf("chunk world: '%s' is malformed\n", filename);
+            close();
+            return;
+        }
+        printf("chunk world: indexed %zu chunks in %zu shards from '%s'\n", count, shards.size(), filename);
+    }
+
+    bool openIndex(std::FILE* f, const ChunkWorldHeader& header, const char* filename) noexcept {
+        // shard names are relative to the index
+        const std::string path(filename);
+        const std::size_t slash = path.find_last_of('/');
+        const std::string dir = slash == std::string::npos ? std::string{} : path.substr(0, slash + 1);
+
+        // every shard name takes at least its length word, so a corrupt count fails here, not in the reserve
+        struct stat st{};
+        long position = std::ftell(f);
+        if(fstat(fileno(f), &st) != 0 || position < 0 || st.st_size < position) {
+            return false;
+        }
+        if(header.numShards > static_cast<core::u64>(st.st_size - position) / sizeof(core::u32)) {
+            return false;
+        }
+        shards.reserve(header.numShards);
+        for(core::u32 i = 0; i < header.numShards; ++i) {
+            core::u32 length{};
+            if(std::fread(&length, sizeof(length), 1, f) != 1 || length > 4096) {
+                return false;
+            }
+            std::string name(length, '\0');
+            if(std::fread(name.data(), 1, length, f) != length) {
+                return false;
+            }
+            shards.emplace_back((dir + name).c_str());
+            if(!shards.back().isOpen() || !matchesLayout(shards.back(), (dir + name).c_str())) {
+                return false;
+            }
+        }
+
+        origin = { .x = header.originX, .z = header.originZ };
+        width = header.width;
+        height = header.height;
+        // the grid is the rest of the file: a corrupt width or height fails here, not in the resize
+        position = std::ftell(f);
+        if(position < 0 || st.st_size < position) {
+            return false;
+        }
+        const core::u64 gridBytes = static_cast<core::u64>(st.st_size - position);
+        if(static_cast<core::u64>(width) * height > gridBytes / sizeof(core::u64)) {
+            return false;
+        }
+        cells.resize(static_cast<std::size_t>(width) * height);
+        if(std::fread(cells.data(), sizeof(core::u64), cells.size(), f) != cells.size()) {
+            return false;
+        }
+        for(core::u64 packed : cells) {
+            if(packed == 0) {
+                continue;
+            }
+            const core::u64 shard = (packed >> 48) - 1;
+            if(shard >= shards.size() || !shards[shard].contains(packed & CHUNK_WORLD_OFFSET_MASK)) {
+                return false;
+            }
+            ++count;
+        }
+        return true;
+    }
+
+    // index a lone .chunk file from its TOC
+    bool openChunkFile(const char* filename) noexcept {
+        ChunkFile& file = shards.emplace_back(filename);
+        if(file.isOpen() && !matchesLayout(file, filename)) {
+            return false;
+        }
+        core::i32 minX = std::numeric_limits<core::i32>::max(), minZ = minX;
+        core::i32 maxX = std::numeric_limits<core::i32>::min(), maxZ = maxX;
+        core::u64 records = 0;
+        bool representable = true;
+        const bool valid = file.forEachChunk([&](Chunk c, core::u64) {
+            // nothing past the chunk table's range could be loaded anyway
+            representable = representable && ChunkTable::representable(c);
+            minX = std::min(minX, c.x);
+            minZ = std::min(minZ, c.z);
+            maxX = std::max(maxX, c.x);
+            maxZ = std::max(maxZ, c.z);
+            ++records;
+        });
+        if(!valid || !representable) {
+            return false;
+        }
+        if(minX > maxX) {
+            // no chunks
+            return true;
+        }
+        // the grid is the TOC's bounding box: a few stray coordinates would make it mostly empty cells
+        const std::int64_t spanX = static_cast<std::int64_t>(maxX) - minX + 1;
+        const std::int64_t spanZ = static_cast<std::int64_t>(maxZ) - minZ + 1;
+        if(static_cast<core::u64>(spanX * spanZ) > records * maxCellsPerRecord) {
+            return false;
+        }
+        origin = { .x = minX, .z = minZ };
+        width = static_cast<core::u32>(spanX);
+        height = static_cast<core::u32>(spanZ);
+        cells.assign(static_cast<std::size_t>(width) * height, 0);
+        file.forEachChunk([&](Chunk c, core::u64 offset) {
+            core::u64& packed = cells[static_cast<std::size_t>(c.z - minZ) * width + (c.x - minX)];
+            count += packed == 0;
+            packed = packChunkWorldCell(0, offset);
+        });
+        return true;
+    }
+
+    // shards must share edge samples (everything downstream samples chunks that way) and hold
+    // chunks of the world's resolution
+    bool matchesLayout(const ChunkFile& shard, const char* filename) const noexcept {
+        if(!shard.hasSharedEdges()) {
+            printf("chunk world: '%s' is a version %u file without shared chunk edges, rebuild it with ChunkBuilder\n",
+                filename, shard.getVersion());
+            return false;
+        }
+        if(shard.getResolution() != resolution) {
+            printf("chunk world: '%s' holds (%ux%u) chunks, expected (%ux%u)\n",
+                filename, shard.getResolution(), shard.getResolution(), resolution, resolution);
+            return false;
+        }
+        return true;
+    }
+
+    void close() noexcept {
+        shards.clear();
+        cells.clear();
+        origin = {};
+        width = 0;
+        height = 0;
+        count = 0;
+    }
+};
+
+}
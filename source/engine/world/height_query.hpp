@@ -0,0 +1,290 @@
+// height_query.hpp: defines HeightQuery, batched bilinear terrain height lookups over a ChunkPool's Loaded chunks
+//     positions are split into chunk coordinates and sample cells 4 at a time, each distinct chunk of a batch
+//     is resolved to its pool slot once, then the 4 corner samples are gathered and blended 4 lanes at a time
+//     where there is SIMD. The last chunk resolved is kept across calls, so repeated queries from one agent
+//     or camera skip the chunk table entirely
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <span>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "engine/world/chunk_pool.hpp"
+
+namespace engine::world {
+
+namespace query {
+
+// one block of 4 positions
+struct alignas(16) HeightLanes {
+    core::i32 chunkX[4];
+    core::i32 chunkZ[4];
+    // sample index of each cell's (x0, z0) corner
+    core::i32 index[4];
+    float fx[4];
+    float fz[4];
+    // corners (x0, z0), (x0 + 1, z0), (x0, z0 + 1), (x0 + 1, z0 + 1), converted to float in blendLanes
+    core::i32 h00[4];
+    core::i32 h10[4];
+    core::i32 h01[4];
+    core::i32 h11[4];
+};
+
+constexpr const float INV_CHUNK_SIZE = 1.f / static_cast<float>(CHUNK_SIZE);
+
+// xz: 4 interleaved (x, z) world positions -> chunk, cell and fraction of each
+template<ChunkGeometry Traits>
+void splitLanes(const float* xz, HeightLanes& lanes) noexcept {
+    constexpr float invSpacing = 1.f / Traits::spacing;
+    constexpr float resolution = static_cast<float>(Traits::resolution);
+    constexpr float lastSample = static_cast<float>(Traits::resolution - 1);
+    // last cell corner: edges are shared, so every cell of a chunk lies inside it
+    constexpr float lastCell = static_cast<float>(Traits::resolution - 2);
+#if defined(__ARM_NEON)
+    const float32x4x2_t p = vld2q_f32(xz);
+    const float32x4_t cx = vrndmq_f32(vmulq_n_f32(p.val[0], INV_CHUNK_SIZE));
+    const float32x4_t cz = vrndmq_f32(vmulq_n_f32(p.val[1], INV_CHUNK_SIZE));
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    const float32x4_t last = vdupq_n_f32(lastCell);
+    const float32x4_t edge = vdupq_n_f32(lastSample);
+    const float32x4_t scale = vdupq_n_f32(invSpacing);
+    // chunk local sample coordinates, min/max clear rounding past the edges
+    const float32x4_t sx = vminq_f32(vmaxq_f32(vmulq_f32(vmlsq_n_f32(p.val[0], cx, static_cast<float>(CHUNK_SIZE)), scale), zero), edge);
+    const float32x4_t sz = vminq_f32(vmaxq_f32(vmulq_f32(vmlsq_n_f32(p.val[1], cz, static_cast<float>(CHUNK_SIZE)), scale), zero), edge);
+    const float32x4_t x0 = vminq_f32(vrndmq_f32(sx), last);
+    const float32x4_t z0 = vminq_f32(vrndmq_f32(sz), last);
+    vst1q_s32(lanes.chunkX, vcvtq_s32_f32(cx));
+    vst1q_s32(lanes.chunkZ, vcvtq_s32_f32(cz));
+    vst1q_s32(lanes.index, vcvtq_s32_f32(vmlaq_n_f32(x0, z0, resolution)));
+    vst1q_f32(lanes.fx, vsubq_f32(sx, x0));
+    vst1q_f32(lanes.fz, vsubq_f32(sz, z0));
+#elif defined(__SSE2__)
+    const __m128 a = _mm_loadu_ps(xz);
+    const __m128 b = _mm_loadu_ps(xz + 4);
+    const __m128 x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+    const __m128 z = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+    const __m128 one = _mm_set1_ps(1.f);
+    // SSE2 has no floor: truncate, then step down where that rounded up
+    auto floor = [&](__m128 v) {
+        const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, v), one));
+    };
+    const __m128 cx = floor(_mm_mul_ps(x, _mm_set1_ps(INV_CHUNK_SIZE)));
+    const __m128 cz = floor(_mm_mul_ps(z, _mm_set1_ps(INV_CHUNK_SIZE)));
+    const __m128 size = _mm_set1_ps(static_cast<float>(CHUNK_SIZE));
+    const __m128 scale = _mm_set1_ps(invSpacing);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 edge = _mm_set1_ps(lastSample);
+    const __m128 last = _mm_set1_ps(lastCell);
+    // chunk local sample coordinates, min/max clear rounding past the edges
+    const __m128 sx = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(x, _mm_mul_ps(cx, size)), scale), zero), edge);
+    const __m128 sz = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(z, _mm_mul_ps(cz, size)), scale), zero), edge);
+    const __m128 x0 = _mm_min_ps(floor(sx), last);
+    const __m128 z0 = _mm_min_ps(floor(sz), last);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes.chunkX), _mm_cvttps_epi32(cx));
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes.chunkZ), _mm_cvttps_epi32(cz));
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes.index),
+        _mm_cvttps_epi32(_mm_add_ps(x0, _mm_mul_ps(z0, _mm_set1_ps(resolution)))));
+    _mm_store_ps(lanes.fx, _mm_sub_ps(sx, x0));
+    _mm_store_ps(lanes.fz, _mm_sub_ps(sz, z0));
+#else
+    for(std::size_t i = 0; i < 4; ++i) {
+        const float cx = std::floor(xz[2 * i] * INV_CHUNK_SIZE);
+        const float cz = std::floor(xz[2 * i + 1] * INV_CHUNK_SIZE);
+        const float sx = std::min(std::max((xz[2 * i] - cx * CHUNK_SIZE) * invSpacing, 0.f), lastSample);
+        const float sz = std::min(std::max((xz[2 * i + 1] - cz * CHUNK_SIZE) * invSpacing, 0.f), lastSample);
+        const float x0 = std::min(std::floor(sx), lastCell);
+        const float z0 = std::min(std::floor(sz), lastCell);
+        lanes.chunkX[i] = static_cast<core::i32>(cx);
+        lanes.chunkZ[i] = static_cast<core::i32>(cz);
+        lanes.index[i] = static_cast<core::i32>(z0) * Traits::resolution + static_cast<core::i32>(x0);
+        lanes.fx[i] = sx - x0;
+        lanes.fz[i] = sz - z0;
+    }
+#endif
+}
+
+// bilinear blend of the gathered corners
+inline void blendLanes(const HeightLanes& lanes, float* out) noexcept {
+#if defined(__ARM_NEON)
+    auto load = [](const core::i32* h) {
+        return vcvtq_f32_s32(vld1q_s32(h));
+    };
+    const float32x4_t fx = vld1q_f32(lanes.fx);
+    const float32x4_t h00 = load(lanes.h00);
+    const float32x4_t h01 = load(lanes.h01);
+    const float32x4_t h0 = vmlaq_f32(h00, vsubq_f32(load(lanes.h10), h00), fx);
+    const float32x4_t h1 = vmlaq_f32(h01, vsubq_f32(load(lanes.h11), h01), fx);
+    vst1q_f32(out, vmlaq_f32(h0, vsubq_f32(h1, h0), vld1q_f32(lanes.fz)));
+#elif defined(__SSE2__)
+    auto load = [](const core::i32* h) {
+        return _mm_cvtepi32_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(h)));
+    };
+    const __m128 fx = _mm_load_ps(lanes.fx);
+    const __m128 h00 = load(lanes.h00);
+    const __m128 h01 = load(lanes.h01);
+    const __m128 h0 = _mm_add_ps(h00, _mm_mul_ps(_mm_sub_ps(load(lanes.h10), h00), fx));
+    const __m128 h1 = _mm_add_ps(h01, _mm_mul_ps(_mm_sub_ps(load(lanes.h11), h01), fx));
+    _mm_storeu_ps(out, _mm_add_ps(h0, _mm_mul_ps(_mm_sub_ps(h1, h0), _mm_load_ps(lanes.fz))));
+#else
+    for(std::size_t i = 0; i < 4; ++i) {
+        const float h00 = static_cast<float>(lanes.h00[i]);
+        const float h01 = static_cast<float>(lanes.h01[i]);
+        const float h0 = h00 + (static_cast<float>(lanes.h10[i]) - h00) * lanes.fx[i];
+        const float h1 = h01 + (static_cast<float>(lanes.h11[i]) - h01) * lanes.fx[i];
+        out[i] = h0 + (h1 - h0) * lanes.fz[i];
+    }
+#endif
+}
+
+}
+
+// note: like ChunkPool::sampleHeight, results are only stable while the request/unload thread isn't
+// evicting the chunks being sampled; a HeightQuery itself is not thread safe, use one per thread
+template<ChunkGeometry Traits>
+class BasicHeightQuery {
+    // per batch direct mapped cache of resolved chunks, indexed by the low 3 bits of x and z so
+    // any 8x8 block of chunks resolves without collisions
+    static constexpr const std::size_t CACHE_SIZE = 64;
+
+    struct Resolved {
+        core::u64 key{ UINT64_MAX };
+        // batch that resolved it, entries of earlier batches are stale
+        core::u64 batch{ 0 };
+        // nullptr if the chunk isn't Loaded
+        const core::i16* heights{ nullptr };
+    };
+
+    const BasicChunkPool<Traits>& pool;
+
+    std::array<Resolved, CACHE_SIZE> cache{};
+    core::u64 batch{ 0 };
+
+    // last chunk resolved, checked against its slot again on every call
+    core::u64 lastKey{ UINT64_MAX };
+    std::size_t lastIndex{ 0 };
+
+    // resolutions that went to the chunk table
+    std::size_t lookups{ 0 };
+
+public:
+    explicit BasicHeightQuery(const BasicChunkPool<Traits>& pool) noexcept
+        : pool(pool)
+    {}
+
+    // bilinear terrain height at each world position (x, z), NaN where its chunk isn't Loaded
+    // heights must hold at least positions.size() floats, returns the number of positions resolved
+    // positions near each other in the span share resolutions, so sorting by chunk is never slower
+    std::size_t sample(std::span<const float2> positions, std::span<float> heights) noexcept {
+        ++batch;
+        std::size_t found = 0;
+        // chunk of the previous lane, most lanes in a row share it
+        core::u64 currentKey = UINT64_MAX;
+        const core::i16* current = nullptr;
+        query::HeightLanes lanes;
+        std::array<float2, 4> tail{};
+        std::array<float, 4> tailHeights{};
+        for(std::size_t i = 0; i < positions.size(); i += 4) {
+            const std::size_t count = std::min<std::size_t>(4, positions.size() - i);
+            // the last partial block repeats its final position
+            const float2* block = positions.data() + i;
+            float* out = heights.data() + i;
+            if(count < 4) {
+                for(std::size_t k = 0; k < 4; ++k) {
+                    tail[k] = positions[i + std::min(k, count - 1)];
+                }
+                block = tail.data();
+                out = tailHeights.data();
+            }
+            query::splitLanes<Traits>(reinterpret_cast<const float*>(block), lanes);
+            std::array<bool, 4> missing{};
+            for(std::size_t k = 0; k < 4; ++k) {
+                const core::u64 key = chunkKey({ .x = lanes.chunkX[k], .z = lanes.chunkZ[k] });
+                if(key != currentKey) {
+                    currentKey = key;
+                    current = resolve(lanes.chunkX[k], lanes.chunkZ[k], key);
+                }
+                const core::i16* h = current;
+                if(h == nullptr) {
+                    missing[k] = true;
+                    lanes.h00[k] = lanes.h10[k] = lanes.h01[k] = lanes.h11[k] = 0;
+                    continue;
+                }
+                h += lanes.index[k];
+                lanes.h00[k] = h[0];
+                lanes.h10[k] = h[1];
+                lanes.h01[k] = h[Traits::resolution];
+                lanes.h11[k] = h[Traits::resolution + 1];
+            }
+            query::blendLanes(lanes, out);
+            for(std::size_t k = 0; k < count; ++k) {
+                if(missing[k]) {
+                    out[k] = std::numeric_limits<float>::quiet_NaN();
+                }
+                else {
+                    ++found;
+                }
+            }
+            if(count < 4) {
+                std::copy_n(tailHeights.begin(), count, heights.begin() + static_cast<std::ptrdiff_t>(i));
+            }
+        }
+        return found;
+    }
+
+    // single position, same rules as above
+    float sample(float2 position) noexcept {
+        float height = 0.f;
+        sample(std::span<const float2>(&position, 1), std::span<float>(&height, 1));
+        return height;
+    }
+
+    // chunk table lookups made so far, the rest were served from the caches
+    std::size_t getLookupCount() const noexcept {
+        return lookups;
+    }
+
+private:
+    static std::size_t slot(core::i32 x, core::i32 z) noexcept {
+        return (static_cast<std::size_t>(x) & 7) | ((static_cast<std::size_t>(z) & 7) << 3);
+    }
+
+    const core::i16* resolve(core::i32 x, core::i32 z, core::u64 key) noexcept {
+        Resolved& resolved = cache[slot(x, z)];
+        if(resolved.key == key && resolved.batch == batch) {
+            return resolved.heights;
+        }
+        resolved.key = key;
+        resolved.batch = batch;
+        resolved.heights = nullptr;
+        const Chunk c{ .x = x, .z = z };
+        // still in the slot we found it in last time: the slot's chunk is rewritten on reuse
+        if(key == lastKey && pool.getSlotStatus(lastIndex) == ChunkStatus::Loaded
+            && pool.getSlotChunk(lastIndex) == c) {
+            resolved.heights = pool.getChunkData(lastIndex).getHeights().data();
+            return resolved.heights;
+        }
+        ++lookups;
+        std::optional<std::size_t> poolIndex = pool.getPoolIndex(c);
+        if(!poolIndex.has_value() || pool.getSlotStatus(*poolIndex) != ChunkStatus::Loaded) {
+            return nullptr;
+        }
+        lastKey = key;
+        lastIndex = *poolIndex;
+        resolved.heights = pool.getChunkData(*poolIndex).getHeights().data();
+        return resolved.heights;
+    }
+};
+
+using HeightQuery = BasicHeightQuery<DefaultChunkTraits>;
+
+}
@@ -14,6 +14,12 @@ struct float2 {
     float y{ 0 };
 };
 
+struct float3 {
+    float x{ 0 };
+    float y{ 0 };
+    float z{ 0 };
+};
+
 constexpr inline float2 operator+(float2 a, float2 b) {
     return {
         .x = a.x + b.x,
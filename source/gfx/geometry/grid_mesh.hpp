@@ -1,11 +1,26 @@
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <span>
 #include <vector>
 
 #include "core/types.hpp"
 
 namespace gfx::geometry {
 
+// set on vertexBufferX of skirt vertices: an edge sample dropped below the chunk to hide lod cracks
+constexpr const core::u16 GRID_SKIRT_BIT = 0x8000;
+
+// range of GridMesh::indexBuffer drawing one level of detail
+struct GridLod {
+    core::u32 firstIndex{};
+    core::u32 indexCount{};
+    // distance between the samples this lod triangulates
+    core::u32 step{ 1 };
+};
+
 struct GridMesh {
     std::vector<core::u16> vertexBufferX{};
     std::vector<core::u16> vertexBufferZ{};
@@ -13,6 +28,8 @@ struct GridMesh {
     core::u32 vertexCount{};
     core::u32 indexCount{};
     core::u32 vertexStride{};
+    // finest first, all lods index the same vertices
+    std::vector<GridLod> lods{};
 };
 
 class MeshGenerator {
@@ -66,9 +83,125 @@ public:
                 grid.indexBuffer.push_back(i3);
             }
         }
+        grid.lods.push_back({ .firstIndex = 0, .indexCount = grid.indexCount, .step = 1 });
 
         return grid;
     }
+
+    // lod chain over one set of vertices: lod l triangulates every 2^l-th sample (33, 17, 9, 5, ...)
+    // every lod is closed by a skirt, so neighbouring chunks at different lods show no cracks
+    // one specialization per chunk resolution (samples along an edge), every loop bound is a constant
+    // note: lods stop at the first step that doesn't divide (Resolution - 1)
+    template<std::size_t Resolution>
+    static GridMesh createLodGridMesh(std::size_t lodCount) {
+        constexpr std::size_t N = Resolution;
+        static_assert(N * N + 4 * N <= std::numeric_limits<core::u16>::max() + std::size_t{ 1 },
+            "resolution too great for core::u16 indices");
+        GridMesh grid{};
+
+        // grid vertices, then one skirt copy per edge: z = 0, z = N - 1, x = 0, x = N - 1
+        grid.vertexCount = N * N + 4 * N;
+        grid.vertexBufferX.reserve(grid.vertexCount);
+        grid.vertexBufferZ.reserve(grid.vertexCount);
+        for(core::u16 z = 0; z < N; ++z) {
+            for(core::u16 x = 0; x < N; ++x) {
+                grid.vertexBufferX.push_back(x);
+                grid.vertexBufferZ.push_back(z);
+            }
+        }
+        const core::u16 last = static_cast<core::u16>(N - 1);
+        for(core::u16 edge = 0; edge < 4; ++edge) {
+            for(core::u16 t = 0; t < N; ++t) {
+                const core::u16 x = edge < 2 ? t : (edge == 2 ? 0 : last);
+                const core::u16 z = edge < 2 ? (edge == 0 ? 0 : last) : t;
+                grid.vertexBufferX.push_back(x | GRID_SKIRT_BIT);
+                grid.vertexBufferZ.push_back(z);
+            }
+        }
+
+        auto gridIndex = [](std::size_t x, std::size_t z) {
+            return static_cast<core::u16>(z * N + x);
+        };
+        auto skirtIndex = [](std::size_t edge, std::size_t t) {
+            return static_cast<core::u16>(N * N + edge * N + t);
+        };
+
+        for(std::size_t lod = 0; lod < lodCount; ++lod) {
+            const std::size_t step = std::size_t{ 1 } << lod;
+            if((N - 1) % step != 0) {
+                break;
+            }
+            GridLod range{ .firstIndex = static_cast<core::u32>(grid.indexBuffer.size()), .step = static_cast<core::u32>(step) };
+
+            // same quad layout as createGridMesh, quads step samples wide
+            for(std::size_t z = 0; z + step < N; z += step) {
+                for(std::size_t x = 0; x + step < N; x += step) {
+                    const core::u16 i0 = gridIndex(x, z);
+                    const core::u16 i1 = gridIndex(x + step, z);
+                    const core::u16 i2 = gridIndex(x, z + step);
+                    const core::u16 i3 = gridIndex(x + step, z + step);
+                    grid.indexBuffer.insert(grid.indexBuffer.end(), { i0, i2, i1, i1, i2, i3 });
+                }
+            }
+
+            // skirt: a vertical quad under each edge segment
+            for(std::size_t t = 0; t + step < N; t += step) {
+                const core::u16 edges[4][2] = {
+                    { gridIndex(t, 0), gridIndex(t + step, 0) },
+                    { gridIndex(t, N - 1), gridIndex(t + step, N - 1) },
+                    { gridIndex(0, t), gridIndex(0, t + step) },
+                    { gridIndex(N - 1, t), gridIndex(N - 1, t + step) }
+                };
+                for(std::size_t edge = 0; edge < 4; ++edge) {
+                    const core::u16 a = edges[edge][0];
+                    const core::u16 b = edges[edge][1];
+                    const core::u16 sa = skirtIndex(edge, t);
+                    const core::u16 sb = skirtIndex(edge, t + step);
+                    grid.indexBuffer.insert(grid.indexBuffer.end(), { a, sa, b, b, sa, sb });
+                }
+            }
+
+            range.indexCount = static_cast<core::u32>(grid.indexBuffer.size()) - range.firstIndex;
+            grid.lods.push_back(range);
+        }
+        grid.indexCount = static_cast<core::u32>(grid.indexBuffer.size());
+
+        return grid;
+    }
+
+    // geometric error of each lod of createLodGridMesh against a chunk's full resolution heights:
+    // the largest vertical distance between a sample and the lod's coarser surface
+    // errors never decrease with lod, lod 0 is exact
+    template<std::size_t Resolution>
+    static std::vector<float> lodErrors(std::span<const core::i16> heights, std::span<const GridLod> lods) {
+        constexpr std::size_t N = Resolution;
+        std::vector<float> errors(lods.size(), 0.f);
+        if(heights.size() != N * N) {
+            return errors;
+        }
+        auto height = [&](std::size_t x, std::size_t z) {
+            return static_cast<float>(heights[z * N + x]);
+        };
+        for(std::size_t lod = 1; lod < lods.size(); ++lod) {
+            const std::size_t step = lods[lod].step;
+            float error = errors[lod - 1];
+            for(std::size_t z = 0; z < N; ++z) {
+                for(std::size_t x = 0; x < N; ++x) {
+                    // coarse cell holding the sample, bilinear estimate of the triangulated surface
+                    const std::size_t x0 = std::min(x / step * step, N - 1 - step);
+                    const std::size_t z0 = std::min(z / step * step, N - 1 - step);
+                    const float u = static_cast<float>(x - x0) / static_cast<float>(step);
+                    const float v = static_cast<float>(z - z0) / static_cast<float>(step);
+                    const float coarse =
+                        (1.f - u) * (1.f - v) * height(x0, z0) + u * (1.f - v) * height(x0 + step, z0) +
+                        (1.f - u) * v * height(x0, z0 + step) + u * v * height(x0 + step, z0 + step);
+                    error = std::max(error, std::abs(coarse - height(x, z)));
+                }
+            }
+            errors[lod] = error;
+        }
+        return errors;
+    }
 };
 
 }
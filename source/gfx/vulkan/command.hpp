@@ -1,154 +1,312 @@
 #pragma once
 
 #include "core/log/logging.hpp"
+#include "core/profile/profiler.hpp"
 #include "gfx/vulkan/config.hpp"
 #include "gfx/vulkan/resources.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_core.h>
 
 namespace gfx::vulkan {
 
+// a region of a frame's transient buffer, writable through pMapped until the frame comes back around
+struct TransientAllocation {
+    BufferHandle buffer{};
+    VkDeviceSize offset{ 0 };
+    VkDeviceSize size{ 0 };
+    std::byte* pMapped{ nullptr };
+};
+
 class Commander {
+    // timestamp queries per frame in flight, two per GPU zone
+    static constexpr core::u32 TimestampQueryCount{ 64 };
+    static constexpr core::u32 NoTimestamp{ ~0u };
+
     core::log::Logger& log;
     const Configurator& config;
     const VkDevice vulkanDevice;
     ResourceManager& manager;
 
     // queue
+    const core::u32 queueFamilyIndex;
     VkQueue queue{ VK_NULL_HANDLE };
-    // command pool (should be per-thread)
-    VkCommandPool pool{ VK_NULL_HANDLE };
-    // command buffers
+
+    // everything a frame in flight records into and synchronizes on
+    // recording a frame only waits on the fence of the frame framesInFlight submits ago
+    struct Frame {
+        // command pool, reset wholesale when the frame comes back around
+        VkCommandPool pool{ VK_NULL_HANDLE };
+        VkCommandBuffer buffer{ VK_NULL_HANDLE };
+        VkFence fence{ VK_NULL_HANDLE };
+        // signaled by swapchain image acquisition, waited on by this frame's submit
+        VkSemaphore acquire{ VK_NULL_HANDLE };
+        // value of the frame's last submit, complete once its fence has been waited on
+        core::u64 submitValue{ 0 };
+        // bump-allocated transient data and descriptor sets, reset wholesale like the command pool
+        std::optional<BufferHandle> transient{};
+        std::byte* transientMapped{ nullptr };
+        VkDeviceSize transientHead{ 0 };
+        VkDescriptorPool descriptors{ VK_NULL_HANDLE };
+#if defined(DEUS_PROFILE)
+        // begin/end timestamp pairs written this frame, resolved when the frame comes back around
+        VkQueryPool timestamps{ VK_NULL_HANDLE };
+        std::array<const char*, TimestampQueryCount / 2> timestampNames{};
+        core::u32 timestampCount{ 0 };
+        // CPU time of the submit, the GPU zones are placed relative to it
+        core::u64 submitted{ 0 };
+#endif
+    };
+    std::vector<Frame> frames{};
+    std::size_t current{ 0 };
+
+    // the current frame's command buffer and fence
     VkCommandBuffer buffer{ VK_NULL_HANDLE };
-    // fence (per frame)
     VkFence frame{ VK_NULL_HANDLE };
 
+    // every submit gets the next value, fences signal in submission order on the one queue
+    // so waiting on a frame's fence completes every value up to its submit's
+    core::u64 submitted{ 0 };
+    core::u64 completed{ 0 };
+
+    // per frame transient buffer size, and the alignment every allocation from it starts at
+    VkDeviceSize transientCapacity{ 0 };
+    VkDeviceSize transientAlignment{ 1 };
+
+    // VK_KHR_draw_indirect_count's command, see enableDrawIndirectCount
+    PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount{ nullptr };
+
+#if defined(DEUS_PROFILE)
+    // nanoseconds per timestamp tick, and the bits the queue actually writes
+    double timestampPeriod{ 0.0 };
+    core::u64 timestampMask{ 0 };
+    core::u32 timestampTrack{ 0 };
+    core::u32 renderPassTimestamp{ NoTimestamp };
+#endif
+
 public:
-    Commander(core::log::Logger& log, const Configurator& config, const VkDevice device, gfx::vulkan::ResourceManager& manager)
-        : log(log), config(config), vulkanDevice(device), manager(manager)
+    // records and submits to a queue created by the Device from queueFamilyIndex
+    // framesInFlight > 1 lets the CPU record the next frame while the GPU executes earlier ones
+    Commander(core::log::Logger& log, const Configurator& config, const VkDevice device, core::u32 queueFamilyIndex, VkQueue queue, gfx::vulkan::ResourceManager& manager,
+        core::u32 framesInFlight = 1)
+        : log(log), config(config), vulkanDevice(device), manager(manager), queueFamilyIndex(queueFamilyIndex), queue(queue)
     {
-        // request a single queue
-        vkGetDeviceQueue(
-            vulkanDevice,
-            0,
-            0,
-            &queue
-        );
-
         if(queue == VK_NULL_HANDLE) {
             logError("failed to fetch a device queue");
         }
 
-        // create a single command pool
-        const VkCommandPoolCreateInfo cmdPoolCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        frames.resize(std::max(1u, framesInFlight));
+        for(Frame& f : frames) {
+            createFrame(f);
+        }
+        buffer = frames[current].buffer;
+        frame = frames[current].fence;
+        logInfo("created (%lu) frames in flight", frames.size());
+    }
+
+    ~Commander() {
+        for(Frame& f : frames) {
+            destroyFrame(f);
+        }
+    }
+
+    // delete assignment/copy/move constructors
+    Commander(const Commander&) = delete;
+    Commander& operator=(const Commander&) = delete;
+    Commander(Commander&&) = delete;
+    Commander& operator=(Commander&&) = delete;
+
+    core::u32 getQueueFamilyIndex() const noexcept {
+        return queueFamilyIndex;
+    }
+
+    std::size_t getFramesInFlight() const noexcept {
+        return frames.size();
+    }
+
+    // index of the frame being recorded, in [0, getFramesInFlight())
+    std::size_t getFrameIndex() const noexcept {
+        return current;
+    }
+
+    // the current frame's semaphore to acquire a swapchain image with
+    VkSemaphore getAcquireSemaphore() const noexcept {
+        return frames[current].acquire;
+    }
+
+#if defined(DEUS_PROFILE)
+    // time the render pass and copies on the GPU, as zones on a track of their own
+    // timestampPeriod: VkPhysicalDeviceLimits::timestampPeriod, validBits: the queue family's timestampValidBits
+    void enableTimestamps(float period, core::u32 validBits, const char* trackName) {
+        if(validBits == 0 || period <= 0.f) {
+            logInfo("queue family (%u) has no timestamps, GPU zones disabled", queueFamilyIndex);
+            return;
+        }
+        const VkQueryPoolCreateInfo createInfo {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
             .pNext = nullptr,
-            // transient: command buffers allocated from the pool will be short-lived,
-            // meaning that they will be reset or freed in a relatively short timeframe
-            // reset command buffer: any command buffer allocated from a pool to be
-            // individually reset to the initial state
-            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-            .queueFamilyIndex = 0
+            .flags = 0,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = TimestampQueryCount,
+            .pipelineStatistics = 0
         };
+        for(Frame& f : frames) {
+            if(vkCreateQueryPool(vulkanDevice, &createInfo, nullptr, &f.timestamps) != VK_SUCCESS) {
+                f.timestamps = VK_NULL_HANDLE;
+                logError("could not create a timestamp query pool");
+            }
+        }
+        timestampPeriod = static_cast<double>(period);
+        timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+        timestampTrack = core::profile::Profiler::get().addTrack(trackName);
+        logInfo("enabled GPU timestamps, (%u) valid bits, %.3f ns per tick", validBits, period);
+    }
+#endif
 
-        VkResult result = vkCreateCommandPool(
-            vulkanDevice,
-            &cmdPoolCreateInfo,
-            nullptr,
-            &pool
-        );
-        if(result != VK_SUCCESS) {
-            pool = VK_NULL_HANDLE;
-            logError("could not create a command pool");
+    // let drawIndexedIndirectCount take its draw count from a device buffer
+    // fn: Device::getDrawIndexedIndirectCount, whose device also enabled multiDrawIndirect and drawIndirectFirstInstance
+    void enableDrawIndirectCount(PFN_vkCmdDrawIndexedIndirectCountKHR fn) noexcept {
+        cmdDrawIndexedIndirectCount = fn;
+        if(fn != nullptr) {
+            logInfo("enabled device side draw counts");
         }
-        logInfo("created a command pool");
+    }
 
-        // allocate a single resettable command buffer
-        const VkCommandBufferAllocateInfo cmdBufferAllocInfo {
-            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+    bool hasDrawIndirectCount() const noexcept {
+        return cmdDrawIndexedIndirectCount != nullptr;
+    }
+
+    // give every frame in flight a transientBytes buffer and a descriptor pool of maxSets sets drawn from
+    // poolSizes, both reset when the frame comes back around; alignment: at least the device's
+    // minUniformBufferOffsetAlignment (and minStorageBufferOffsetAlignment, if bound as storage)
+    bool enableTransients(VkDeviceSize transientBytes, VkDeviceSize alignment, core::u32 maxSets,
+        std::span<const VkDescriptorPoolSize> poolSizes) noexcept
+    {
+        transientCapacity = transientBytes;
+        transientAlignment = std::max<VkDeviceSize>(1, alignment);
+        const VkDescriptorPoolCreateInfo poolInfo {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
             .pNext = nullptr,
-            .commandPool = pool,
-            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            .commandBufferCount = 1
+            .flags = 0,
+            .maxSets = maxSets,
+            .poolSizeCount = static_cast<core::u32>(poolSizes.size()),
+            .pPoolSizes = poolSizes.data()
         };
-        result = vkAllocateCommandBuffers(
-            vulkanDevice,
-            &cmdBufferAllocInfo,
-            &buffer
-        );
-        logInfo("allocated a command buffer");
+        for(Frame& f : frames) {
+            if(transientBytes > 0 && !f.transient.has_value()) {
+                f.transient = manager.createTransientBuffer(transientBytes);
+                if(!f.transient.has_value()) {
+                    logError("could not create a (%lu) byte transient buffer", transientBytes);
+                    return false;
+                }
+                f.transientMapped = static_cast<std::byte*>(manager.getBuffer(*f.transient)->allocationInfo.pMappedData);
+            }
+            if(maxSets > 0 && !poolSizes.empty() && f.descriptors == VK_NULL_HANDLE) {
+                if(vkCreateDescriptorPool(vulkanDevice, &poolInfo, nullptr, &f.descriptors) != VK_SUCCESS) {
+                    f.descriptors = VK_NULL_HANDLE;
+                    logError("could not create a frame descriptor pool");
+                    return false;
+                }
+            }
+        }
+        logInfo("enabled (%lu) transient bytes and (%u) descriptor sets per frame", transientBytes, maxSets);
+        return true;
+    }
 
-        if(result != VK_SUCCESS) {
-            buffer = VK_NULL_HANDLE;
-            logError("could not allocate a command buffer");
+    // carve an aligned region out of the current frame's transient buffer, nullopt once it is full
+    // the region is valid until the frame is next begun, host writes to it need a flush
+    // (see flushTransient) unless the memory is coherent
+    std::optional<TransientAllocation> allocateTransient(VkDeviceSize size) noexcept {
+        Frame& f = frames[current];
+        if(!f.transient.has_value()) {
+            return std::nullopt;
+        }
+        const VkDeviceSize begin = (f.transientHead + transientAlignment - 1) / transientAlignment * transientAlignment;
+        if(begin + size > transientCapacity) {
+            logError("frame transient buffer full, (%lu) of (%lu) bytes requested", size, transientCapacity - f.transientHead);
+            return std::nullopt;
         }
+        f.transientHead = begin + size;
+        return TransientAllocation {
+            .buffer = *f.transient,
+            .offset = begin,
+            .size = size,
+            .pMapped = f.transientMapped + begin
+        };
+    }
 
-        // create fence, initialize to (SIGNALED)
-        VkFenceCreateInfo fenceCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+    // every transient byte of the current frame written so far, call once before submitting
+    bool flushTransient() noexcept {
+        const Frame& f = frames[current];
+        if(!f.transient.has_value() || f.transientHead == 0) {
+            return true;
+        }
+        return manager.flushBuffer(*f.transient, 0, f.transientHead);
+    }
+
+    // a descriptor set out of the current frame's pool, valid until the frame is next begun
+    std::optional<VkDescriptorSet> allocateDescriptorSet(VkDescriptorSetLayout layout) noexcept {
+        const Frame& f = frames[current];
+        if(f.descriptors == VK_NULL_HANDLE) {
+            return std::nullopt;
+        }
+        const VkDescriptorSetAllocateInfo allocInfo {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
             .pNext = nullptr,
-            .flags = VK_FENCE_CREATE_SIGNALED_BIT
+            .descriptorPool = f.descriptors,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &layout
         };
-        result = vkCreateFence(
-            vulkanDevice,
-            &fenceCreateInfo,
-            nullptr,
-            &frame
-        );
-
-        if(result != VK_SUCCESS) {
-            frame = VK_NULL_HANDLE;
-            logError("could not create a fence");
+        VkDescriptorSet set{ VK_NULL_HANDLE };
+        if(vkAllocateDescriptorSets(vulkanDevice, &allocInfo, &set) != VK_SUCCESS) {
+            logError("frame descriptor pool exhausted");
+            return std::nullopt;
         }
-        logInfo("created a frame fence");
+        return set;
     }
 
-    ~Commander() {
-        // await for resettable command pool
-        VkResult result = vkWaitForFences(
+    // value of the latest submit, resources it may use retire with it (see ResourceManager::retireReleased)
+    core::u64 getSubmitValue() const noexcept {
+        return submitted;
+    }
+
+    // every submit up to this value has finished executing
+    core::u64 getCompletedValue() const noexcept {
+        return completed;
+    }
+
+    // move on to the next frame in the ring, call once the current frame has been submitted
+    void nextFrame() noexcept {
+        current = (current + 1) % frames.size();
+        buffer = frames[current].buffer;
+        frame = frames[current].fence;
+    }
+
+    void awaitAndResetFrameFence() noexcept {
+        DEUS_PROFILE_ZONE("gfx/await frame fence");
+        vkWaitForFences(
             vulkanDevice,
             1,
             &frame,
             VK_TRUE,
             UINT64_MAX
         );
-        if(result != VK_SUCCESS) {
-            logError("could not wait for fences");
-        }
-
-        // destroy the fence
-        vkDestroyFence(
-            vulkanDevice,
-            frame,
-            nullptr
-        );
-        logInfo("destroyed frame fence");
-
-        // free command buffer
-        vkFreeCommandBuffers(
+        completed = std::max(completed, frames[current].submitValue);
+        vkResetFences(
             vulkanDevice,
-            pool,
             1,
-            &buffer
-        );
-        logInfo("freed command buffer");
-
-        // destroy single command pool
-        vkDestroyCommandPool(
-            vulkanDevice,
-            pool,
-            nullptr
+            &frame
         );
-        logInfo("destroyed command pool");
     }
 
-    // delete assignment/copy/move constructors
-    Commander(const Commander&) = delete;
-    Commander& operator=(const Commander&) = delete;
-    Commander(Commander&&) = delete;
-    Commander& operator=(Commander&&) = delete;
-
-    void awaitAndResetFrameFence() noexcept {
+    // wait for the last submit without resetting, so the next awaitAndResetFrameFence doesn't block
+    void awaitFrameFence() noexcept {
+        DEUS_PROFILE_ZONE("gfx/await frame fence");
         vkWaitForFences(
             vulkanDevice,
             1,
@@ -156,6 +314,12 @@ public:
             VK_TRUE,
             UINT64_MAX
         );
+        completed = std::max(completed, frames[current].submitValue);
+    }
+
+    // after awaitFrameFence, once the frame is sure to be submitted (a frame that bails out before
+    // submitting must leave the fence signaled, or the next wait on it never returns)
+    void resetFrameFence() noexcept {
         vkResetFences(
             vulkanDevice,
             1,
@@ -165,12 +329,20 @@ public:
 
     // this uses our frame-level fence, and it assumes we've called the awaitAndResetFrameFence
     bool begin() noexcept {
-        // reset buffer
-        VkResult result = vkResetCommandBuffer(buffer, 0);
+        // the GPU is done with the frame, so are its timestamps
+        resolveTimestamps();
+
+        // reset the frame's pool (and so its buffer), the GPU is done with both
+        VkResult result = vkResetCommandPool(vulkanDevice, frames[current].pool, 0);
         if(result != VK_SUCCESS) {
-            logError("could not reset command buffer");
+            logError("could not reset command pool");
             return false;
         }
+        // and its transient allocations with it
+        frames[current].transientHead = 0;
+        if(frames[current].descriptors != VK_NULL_HANDLE) {
+            vkResetDescriptorPool(vulkanDevice, frames[current].descriptors, 0);
+        }
 
         // begin fresh command submission
         VkCommandBufferBeginInfo cmdBufferBeginInfo {
@@ -189,8 +361,13 @@ public:
             logError("could not begin a command buffer");
             return false;
         }
+#if defined(DEUS_PROFILE)
+        if(frames[current].timestamps != VK_NULL_HANDLE) {
+            vkCmdResetQueryPool(buffer, frames[current].timestamps, 0, TimestampQueryCount);
+        }
+#endif
 
-        logInfo("reset command buffer, recording");
+        logDebug("reset command buffer, recording");
         return true;
     }
 
@@ -215,6 +392,7 @@ public:
             .pSignalSemaphores = nullptr
         };
 
+        markSubmitted();
         result = vkQueueSubmit(
             queue,
             1,
@@ -229,29 +407,94 @@ public:
             return false;
         }
 
-        logInfo("submitted command buffer");
+        logDebug("submitted command buffer");
         return true;
     }
 
-    void submitSwapchain(VkSemaphore imageAvailable, VkSemaphore renderFinished) {
+    // ends the command buffer, submits it and signals a timeline semaphore value on completion
+    bool submit(VkSemaphore timeline, core::u64 signalValue) noexcept {
         VkResult result = vkEndCommandBuffer(buffer);
         if(result != VK_SUCCESS) {
             logError("could not end command buffer");
+            return false;
         }
 
-        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        VkSubmitInfo info {
+        const VkTimelineSemaphoreSubmitInfoKHR timelineInfo {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
+            .pNext = nullptr,
+            .waitSemaphoreValueCount = 0,
+            .pWaitSemaphoreValues = nullptr,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &signalValue
+        };
+        const VkSubmitInfo submitInfo {
             .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = &timelineInfo,
+            .waitSemaphoreCount = 0,
+            .pWaitSemaphores = nullptr,
+            .pWaitDstStageMask = nullptr,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &buffer,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores = &timeline
+        };
+
+        markSubmitted();
+        result = vkQueueSubmit(
+            queue,
+            1,
+            &submitInfo,
+            frame
+        );
+        if(result != VK_SUCCESS) {
+            logError("could not submit queue");
+            return false;
+        }
+
+        logDebug("submitted command buffer, signaling timeline value (%lu)", signalValue);
+        return true;
+    }
+
+    // optionally also waits for a timeline semaphore to reach uploadValue before uploadStages,
+    // so a frame only stalls on the uploads it actually reads
+    void submitSwapchain(VkSemaphore imageAvailable, VkSemaphore renderFinished,
+        VkSemaphore uploadTimeline = VK_NULL_HANDLE, core::u64 uploadValue = 0,
+        VkPipelineStageFlags uploadStages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT)
+    {
+        DEUS_PROFILE_ZONE("gfx/submit");
+        VkResult result = vkEndCommandBuffer(buffer);
+        if(result != VK_SUCCESS) {
+            logError("could not end command buffer");
+        }
+
+        const VkSemaphore waits[2] = { imageAvailable, uploadTimeline };
+        const VkPipelineStageFlags waitStages[2] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, uploadStages };
+        // the binary semaphore's value is ignored
+        const core::u64 waitValues[2] = { 0, uploadValue };
+        const core::u64 signalValue{ 0 };
+        const bool waitUpload = uploadTimeline != VK_NULL_HANDLE;
+
+        const VkTimelineSemaphoreSubmitInfoKHR timelineInfo {
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR,
             .pNext = nullptr,
-            .waitSemaphoreCount = 1,
-            .pWaitSemaphores = &imageAvailable,
-            .pWaitDstStageMask = &waitStage,
+            .waitSemaphoreValueCount = 2,
+            .pWaitSemaphoreValues = waitValues,
+            .signalSemaphoreValueCount = 1,
+            .pSignalSemaphoreValues = &signalValue
+        };
+        VkSubmitInfo info {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = waitUpload ? &timelineInfo : nullptr,
+            .waitSemaphoreCount = waitUpload ? 2u : 1u,
+            .pWaitSemaphores = waits,
+            .pWaitDstStageMask = waitStages,
             .commandBufferCount = 1,
             .pCommandBuffers = &buffer,
             .signalSemaphoreCount = 1,
             .pSignalSemaphores = &renderFinished
         };
 
+        markSubmitted();
         result = vkQueueSubmit(
             queue,
             1,
@@ -261,10 +504,12 @@ public:
         if(result != VK_SUCCESS) {
             logError("could not submit queue");
         }
-        logInfo("enqued queue submit");
+        logDebug("enqued queue submit");
     }
 
-    void presentSwapchain(VkSemaphore renderFinished, VkSwapchainKHR swapchain, uint32_t imageIndex) {
+    // VK_ERROR_OUT_OF_DATE_KHR and VK_SUBOPTIMAL_KHR mean the swapchain wants recreating
+    VkResult presentSwapchain(VkSemaphore renderFinished, VkSwapchainKHR swapchain, uint32_t imageIndex) {
+        DEUS_PROFILE_ZONE("gfx/present");
         VkResult result{};
         VkPresentInfoKHR info {
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -277,14 +522,15 @@ public:
             .pResults = &result
         };
 
-        vkQueuePresentKHR(queue, &info);
-        logInfo("enqued queue present");
+        const VkResult presented = vkQueuePresentKHR(queue, &info);
+        logDebug("enqued queue present");
+        return presented;
     }
 
     // no fences are used inside of the command wrappers
     void copy(BufferHandle bufferHandleSrc, BufferHandle bufferHandleDst) noexcept {
-        Buffer bufferSrc = *manager.getBuffer(bufferHandleSrc);
-        Buffer bufferDst = *manager.getBuffer(bufferHandleDst);
+        const Buffer& bufferSrc = *manager.getBuffer(bufferHandleSrc);
+        const Buffer& bufferDst = *manager.getBuffer(bufferHandleDst);
 
         const VkBufferCopy bufferCpy {
             .srcOffset = 0,// vertexBufferSrc.allocationInfo.offset,
@@ -293,6 +539,7 @@ public:
         };
 
         // copy from buffer 1 to 2
+        const core::u32 timestamp = beginTimestamp("copy buffer");
         vkCmdCopyBuffer(
             buffer,
             bufferSrc.buffer,
@@ -300,12 +547,62 @@ public:
             1,
             &bufferCpy
         );
+        endTimestamp(timestamp);
 
-        logInfo("command: copy buffer (%lu) -> buffer (%lu)", bufferHandleSrc.id, bufferHandleDst.id);
+        logDebug("command: copy buffer (%lu) -> buffer (%lu)", bufferHandleSrc.id, bufferHandleDst.id);
+    }
+
+    // copy a sub-range of one buffer into another
+    void copy(BufferHandle bufferHandleSrc, VkDeviceSize srcOffset, BufferHandle bufferHandleDst, VkDeviceSize dstOffset, VkDeviceSize size) noexcept {
+        const VkBufferCopy bufferCpy {
+            .srcOffset = srcOffset,
+            .dstOffset = dstOffset,
+            .size = size
+        };
+
+        const core::u32 timestamp = beginTimestamp("copy buffer range");
+        vkCmdCopyBuffer(
+            buffer,
+            manager.getBuffer(bufferHandleSrc)->buffer,
+            manager.getBuffer(bufferHandleDst)->buffer,
+            1,
+            &bufferCpy
+        );
+        endTimestamp(timestamp);
+
+        logDebug("command: copy buffer (%lu) +%lu -> buffer (%lu) +%lu, (%lu) bytes",
+            bufferHandleSrc.id, srcOffset, bufferHandleDst.id, dstOffset, size);
+    }
+
+    // record a single pipeline barrier over any number of global and image memory barriers
+    // buffer barriers are only needed for queue family ownership transfers, use memory barriers otherwise
+    void barrier(VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+        std::span<const VkMemoryBarrier> memoryBarriers,
+        std::span<const VkImageMemoryBarrier> imageBarriers,
+        std::span<const VkBufferMemoryBarrier> bufferBarriers = {}) noexcept
+    {
+        if(memoryBarriers.empty() && imageBarriers.empty() && bufferBarriers.empty()) {
+            return;
+        }
+        vkCmdPipelineBarrier(
+            buffer,
+            srcStage,
+            dstStage,
+            0,
+            static_cast<core::u32>(memoryBarriers.size()),
+            memoryBarriers.data(),
+            static_cast<core::u32>(bufferBarriers.size()),
+            bufferBarriers.data(),
+            static_cast<core::u32>(imageBarriers.size()),
+            imageBarriers.data()
+        );
+
+        logDebug("command: barrier (%lu) memory, (%lu) buffer, (%lu) image",
+            memoryBarriers.size(), bufferBarriers.size(), imageBarriers.size());
     }
 
     void makeWriteable(ImageHandle handle) noexcept {
-        Image img = *manager.getImage(handle);
+        const Image& img = *manager.getImage(handle);
         VkImageSubresourceRange subresourceRange {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
             .baseMipLevel = 0,
@@ -342,11 +639,11 @@ public:
         // update layout
         manager.updateImageLayout(handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
-        logInfo("command: barrier image (%lu) access -> writeable", handle.id);
+        logDebug("command: barrier image (%lu) access -> writeable", handle.id);
     }
 
     void makeReadable(ImageHandle handle) noexcept {
-       Image img = *manager.getImage(handle);
+       const Image& img = *manager.getImage(handle);
        VkImageSubresourceRange subresourceRange {
            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
            .baseMipLevel = 0,
@@ -383,19 +680,26 @@ public:
        // update layout
        manager.updateImageLayout(handle, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-       logInfo("command: barrier image (%lu) access -> readable from shader", handle.id);
+       logDebug("command: barrier image (%lu) access -> readable from shader", handle.id);
     }
 
     void copy(BufferHandle bufferHandle, ImageHandle imageHandle, core::u32 imageWidth, core::u32 imageHeight) noexcept {
+        copy(bufferHandle, 0, imageHandle, imageWidth, imageHeight);
+    }
+
+    // copy tightly packed texels starting at bufferOffset into the whole of one image layer
+    void copy(BufferHandle bufferHandle, VkDeviceSize bufferOffset, ImageHandle imageHandle, core::u32 imageWidth, core::u32 imageHeight,
+        core::u32 layer = 0) noexcept
+    {
         VkImageSubresourceLayers subresourceLayers {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
             .mipLevel = 0,
-            .baseArrayLayer = 0,
+            .baseArrayLayer = layer,
             .layerCount = 1
         };
 
         VkBufferImageCopy region{
-            .bufferOffset = 0,
+            .bufferOffset = bufferOffset,
             .bufferRowLength = 0,
             .bufferImageHeight = 0,
             .imageSubresource = subresourceLayers,
@@ -403,6 +707,7 @@ public:
             .imageExtent = VkExtent3D { imageWidth, imageHeight, 1}
         };
 
+        const core::u32 timestamp = beginTimestamp("copy buffer to image");
         vkCmdCopyBufferToImage(
             buffer,
             manager.getBuffer(bufferHandle)->buffer,
@@ -411,21 +716,29 @@ public:
             1,
             &region
         );
+        endTimestamp(timestamp);
 
-        logInfo("command: copy buffer (%lu) -> image (%lu)", bufferHandle.id, imageHandle.id);
+        logDebug("command: copy buffer (%lu) +%lu -> image (%lu) layer (%u)", bufferHandle.id, bufferOffset, imageHandle.id, layer);
     }
 
-    void beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent, VkClearValue clearValue) noexcept {
+    // clearValues: one per attachment of the render pass, in attachment order
+    void beginRenderPass(VkRenderPass renderPass, VkFramebuffer framebuffer, VkExtent2D extent,
+        std::span<const VkClearValue> clearValues) noexcept
+    {
         VkRenderPassBeginInfo beginInfo {
             .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
             .pNext = nullptr,
             .renderPass = renderPass,
             .framebuffer = framebuffer,
             .renderArea = VkRect2D{.offset = VkOffset2D{ 0, 0}, .extent = extent},
-            .clearValueCount = 1,
-            .pClearValues = &clearValue
+            .clearValueCount = static_cast<uint32_t>(clearValues.size()),
+            .pClearValues = clearValues.data()
         };
 
+        // the zone is opened outside the pass, so it covers the clear and load ops too
+#if defined(DEUS_PROFILE)
+        renderPassTimestamp = beginTimestamp("render pass");
+#endif
         VkSubpassContents contents{ VK_SUBPASS_CONTENTS_INLINE };
         vkCmdBeginRenderPass(
             buffer,
@@ -433,12 +746,16 @@ public:
             contents
         );
 
-        logInfo("command: begin render pass");
+        logDebug("command: begin render pass");
     }
 
     void endRenderPass() noexcept {
         vkCmdEndRenderPass(buffer);
-        logInfo("command: end render pass");
+#if defined(DEUS_PROFILE)
+        endTimestamp(renderPassTimestamp);
+        renderPassTimestamp = NoTimestamp;
+#endif
+        logDebug("command: end render pass");
     }
 
     void bindPipeline(VkPipelineBindPoint bindPoint, VkPipeline pipeline) noexcept {
@@ -447,7 +764,7 @@ public:
             bindPoint,
             pipeline
         );
-        logInfo("command: bind pipeline");
+        logDebug("command: bind pipeline");
     }
 
     void setViewportAndScissor(VkViewport viewport, VkRect2D scissor) noexcept {
@@ -463,16 +780,333 @@ public:
             1,
             &scissor
         );
-        logInfo("command: set viewport + scissor");
+        logDebug("command: set viewport + scissor");
     }
 
     void draw() noexcept {
         vkCmdDraw(buffer, 3, 1, 0, 0);
 
-        logInfo("command: draw");
+        logDebug("command: draw");
+    }
+
+    // bind buffers to consecutive vertex input bindings starting at 0
+    void bindVertexBuffers(std::span<const BufferHandle> handles, std::span<const VkDeviceSize> offsets) noexcept {
+        std::vector<VkBuffer> vkBuffers{};
+        vkBuffers.reserve(handles.size());
+        for(BufferHandle handle : handles) {
+            vkBuffers.push_back(manager.getBuffer(handle)->buffer);
+        }
+        vkCmdBindVertexBuffers(
+            buffer,
+            0,
+            static_cast<core::u32>(vkBuffers.size()),
+            vkBuffers.data(),
+            offsets.data()
+        );
+        logDebug("command: bind (%lu) vertex buffers", vkBuffers.size());
+    }
+
+    void bindIndexBuffer(BufferHandle handle, VkIndexType indexType) noexcept {
+        vkCmdBindIndexBuffer(
+            buffer,
+            manager.getBuffer(handle)->buffer,
+            0,
+            indexType
+        );
+        logDebug("command: bind index buffer (%lu)", handle.id);
+    }
+
+    void bindDescriptorSet(VkPipelineBindPoint bindPoint, VkPipelineLayout layout, VkDescriptorSet set) noexcept {
+        vkCmdBindDescriptorSets(
+            buffer,
+            bindPoint,
+            layout,
+            0,
+            1,
+            &set,
+            0,
+            nullptr
+        );
+        logDebug("command: bind descriptor set");
+    }
+
+    void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stages, const void* data, core::u32 size) noexcept {
+        vkCmdPushConstants(
+            buffer,
+            layout,
+            stages,
+            0,
+            size,
+            data
+        );
+        logDebug("command: push (%u) bytes of constants", size);
+    }
+
+    void drawIndexed(core::u32 indexCount, core::u32 instanceCount) noexcept {
+        vkCmdDrawIndexed(buffer, indexCount, instanceCount, 0, 0, 0);
+
+        logDebug("command: draw indexed, (%u) indices, (%u) instances", indexCount, instanceCount);
+    }
+
+    // single draw whose parameters (VkDrawIndexedIndirectCommand) are read from a device buffer
+    void drawIndexedIndirect(BufferHandle handle, VkDeviceSize offset) noexcept {
+        vkCmdDrawIndexedIndirect(
+            buffer,
+            manager.getBuffer(handle)->buffer,
+            offset,
+            1,
+            sizeof(VkDrawIndexedIndirectCommand)
+        );
+        logDebug("command: draw indexed indirect from buffer (%lu)", handle.id);
+    }
+
+    // up to maxDrawCount draws (VkDrawIndexedIndirectCommand) read from a device buffer, as many as
+    // the u32 at countOffset of countHandle says; needs enableDrawIndirectCount
+    // note: maxDrawCount must stay under maxDrawIndirectCount, at least 2^16 - 1 with multiDrawIndirect
+    void drawIndexedIndirectCount(BufferHandle handle, VkDeviceSize offset, BufferHandle countHandle, VkDeviceSize countOffset,
+        core::u32 maxDrawCount) noexcept
+    {
+        if(cmdDrawIndexedIndirectCount == nullptr) {
+            logError("command: draw indexed indirect count without VK_KHR_draw_indirect_count");
+            return;
+        }
+        cmdDrawIndexedIndirectCount(
+            buffer,
+            manager.getBuffer(handle)->buffer,
+            offset,
+            manager.getBuffer(countHandle)->buffer,
+            countOffset,
+            maxDrawCount,
+            sizeof(VkDrawIndexedIndirectCommand)
+        );
+        logDebug("command: draw indexed indirect count from buffer (%lu), up to (%u) draws", handle.id, maxDrawCount);
+    }
+
+    void dispatch(core::u32 groupsX, core::u32 groupsY, core::u32 groupsZ) noexcept {
+        vkCmdDispatch(buffer, groupsX, groupsY, groupsZ);
+
+        logDebug("command: dispatch (%u,%u,%u) groups", groupsX, groupsY, groupsZ);
+    }
+
+    // inline buffer write, recorded outside a render pass: small (<= 64KiB) and 4-byte aligned
+    void updateBuffer(BufferHandle handle, VkDeviceSize offset, VkDeviceSize size, const void* data) noexcept {
+        vkCmdUpdateBuffer(
+            buffer,
+            manager.getBuffer(handle)->buffer,
+            offset,
+            size,
+            data
+        );
+        logDebug("command: update (%lu) bytes of buffer (%lu)", size, handle.id);
     }
 
 private:
+    void createFrame(Frame& f) noexcept {
+        const VkCommandPoolCreateInfo cmdPoolCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            // transient: command buffers allocated from the pool will be short-lived,
+            // meaning that they will be reset or freed in a relatively short timeframe
+            // the pool is reset as a whole in begin(), so buffers need no individual reset
+            .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+            .queueFamilyIndex = queueFamilyIndex
+        };
+
+        VkResult result = vkCreateCommandPool(
+            vulkanDevice,
+            &cmdPoolCreateInfo,
+            nullptr,
+            &f.pool
+        );
+        if(result != VK_SUCCESS) {
+            f.pool = VK_NULL_HANDLE;
+            logError("could not create a command pool");
+        }
+        logInfo("created a command pool");
+
+        // allocate a single command buffer per frame
+        const VkCommandBufferAllocateInfo cmdBufferAllocInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .commandPool = f.pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        result = vkAllocateCommandBuffers(
+            vulkanDevice,
+            &cmdBufferAllocInfo,
+            &f.buffer
+        );
+        logInfo("allocated a command buffer");
+
+        if(result != VK_SUCCESS) {
+            f.buffer = VK_NULL_HANDLE;
+            logError("could not allocate a command buffer");
+        }
+
+        // create fence, initialize to (SIGNALED)
+        VkFenceCreateInfo fenceCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_FENCE_CREATE_SIGNALED_BIT
+        };
+        result = vkCreateFence(
+            vulkanDevice,
+            &fenceCreateInfo,
+            nullptr,
+            &f.fence
+        );
+
+        if(result != VK_SUCCESS) {
+            f.fence = VK_NULL_HANDLE;
+            logError("could not create a fence");
+        }
+        logInfo("created a frame fence");
+
+        VkSemaphoreCreateInfo semaphoreCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0
+        };
+        result = vkCreateSemaphore(
+            vulkanDevice,
+            &semaphoreCreateInfo,
+            nullptr,
+            &f.acquire
+        );
+        if(result != VK_SUCCESS) {
+            f.acquire = VK_NULL_HANDLE;
+            logError("could not create a frame image acquire semaphore");
+        }
+    }
+
+    void destroyFrame(Frame& f) noexcept {
+        // await for resettable command pool
+        VkResult result = vkWaitForFences(
+            vulkanDevice,
+            1,
+            &f.fence,
+            VK_TRUE,
+            UINT64_MAX
+        );
+        if(result != VK_SUCCESS) {
+            logError("could not wait for fences");
+        }
+
+        vkDestroySemaphore(
+            vulkanDevice,
+            f.acquire,
+            nullptr
+        );
+#if defined(DEUS_PROFILE)
+        if(f.timestamps != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(vulkanDevice, f.timestamps, nullptr);
+        }
+#endif
+        if(f.descriptors != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(vulkanDevice, f.descriptors, nullptr);
+        }
+        if(f.transient.has_value()) {
+            manager.destroyBuffer(*f.transient);
+        }
+
+        // destroy the fence
+        vkDestroyFence(
+            vulkanDevice,
+            f.fence,
+            nullptr
+        );
+        logInfo("destroyed frame fence");
+
+        // free command buffer
+        vkFreeCommandBuffers(
+            vulkanDevice,
+            f.pool,
+            1,
+            &f.buffer
+        );
+        logInfo("freed command buffer");
+
+        vkDestroyCommandPool(
+            vulkanDevice,
+            f.pool,
+            nullptr
+        );
+        logInfo("destroyed command pool");
+    }
+
+    // GPU zones, nothing is written (and these compile to nothing) without DEUS_PROFILE
+    // returns the zone's first query for endTimestamp, NoTimestamp when out of queries
+    core::u32 beginTimestamp([[maybe_unused]] const char* name) noexcept {
+#if defined(DEUS_PROFILE)
+        Frame& f = frames[current];
+        if(f.timestamps == VK_NULL_HANDLE || f.timestampCount + 2 > TimestampQueryCount) {
+            return NoTimestamp;
+        }
+        const core::u32 query = f.timestampCount;
+        f.timestampCount += 2;
+        f.timestampNames[query / 2] = name;
+        vkCmdWriteTimestamp(buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, f.timestamps, query);
+        return query;
+#else
+        return NoTimestamp;
+#endif
+    }
+
+    void endTimestamp([[maybe_unused]] core::u32 query) noexcept {
+#if defined(DEUS_PROFILE)
+        if(query == NoTimestamp) {
+            return;
+        }
+        vkCmdWriteTimestamp(buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frames[current].timestamps, query + 1);
+#endif
+    }
+
+    void markSubmitted() noexcept {
+        frames[current].submitValue = ++submitted;
+#if defined(DEUS_PROFILE)
+        frames[current].submitted = core::time::getTimestamp();
+#endif
+    }
+
+    // hand the current frame's last timestamps to the profiler, its fence must have been waited on
+    // the GPU clock is anchored at the CPU submit time: zones keep their exact lengths and spacing
+    // within a frame, but sit a little early on the CPU timeline (by the submit to execution latency)
+    void resolveTimestamps() noexcept {
+#if defined(DEUS_PROFILE)
+        Frame& f = frames[current];
+        const core::u32 count = f.timestampCount;
+        f.timestampCount = 0;
+        if(f.timestamps == VK_NULL_HANDLE || count == 0 || f.submitted == 0) {
+            return;
+        }
+        std::array<core::u64, TimestampQueryCount> ticks{};
+        const VkResult result = vkGetQueryPoolResults(
+            vulkanDevice,
+            f.timestamps,
+            0,
+            count,
+            count * sizeof(core::u64),
+            ticks.data(),
+            sizeof(core::u64),
+            VK_QUERY_RESULT_64_BIT
+        );
+        if(result != VK_SUCCESS) {
+            // recorded but never submitted, or abandoned mid-frame
+            return;
+        }
+        core::profile::Profiler& profiler = core::profile::Profiler::get();
+        const core::u64 origin = ticks[0];
+        auto toCpu = [&](core::u64 tick) {
+            return f.submitted + static_cast<core::u64>(static_cast<double>((tick - origin) & timestampMask) * timestampPeriod);
+        };
+        for(core::u32 query = 0; query + 1 < count; query += 2) {
+            profiler.record(timestampTrack, f.timestampNames[query / 2], toCpu(ticks[query]), toCpu(ticks[query + 1]));
+        }
+        f.submitted = 0;
+#endif
+    }
+
     // log convenience
     template<typename... Args>
     void logError(const char* msg, Args... args) {
@@ -2,6 +2,10 @@
 // the lifetime of a single Vulkan instance and queries device properties upfront at init
 #pragma once
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <span>
@@ -26,6 +30,18 @@ struct InstanceRequest {
     std::vector<std::string> optionalExtensionNames;
 };
 
+// device-level extensions, what getBestPhysicalDevice picks a device by and Device enables on it
+struct DeviceRequest {
+    // devices missing one are never picked
+    std::vector<std::string> requiredExtensionNames;
+    // enabled where available, each one available raises a device's score
+    std::vector<std::string> optionalExtensionNames;
+    // devices whose graphics family can't present to it are never picked, VK_NULL_HANDLE skips the check
+    VkSurfaceKHR surface{ VK_NULL_HANDLE };
+    // picked over the best scoring device if usable: a device index if all digits, else part of a device name
+    std::string preferredDevice{};
+};
+
 // note: if the entirety of configurator is optionally returned in the first place,
 // we might as well throw away the optional on its members
 
@@ -57,8 +73,13 @@ class Configurator {
     std::vector<std::string> instanceRequestedLayers{};
     std::vector<std::string> instanceRequestedExtensions{};
 
-    // device-level extensions
-    std::vector<VkExtensionProperties> physicalDeviceExtensionProps{};
+    // device-level extensions, per physical device
+    std::vector<std::vector<VkExtensionProperties>> physicalDeviceExtensionProps{};
+
+    // core features, and descriptor indexing support (left zeroed without VK_EXT_descriptor_indexing)
+    std::vector<VkPhysicalDeviceFeatures> physicalDeviceFeatures{};
+    std::vector<VkPhysicalDeviceDescriptorIndexingFeaturesEXT> physicalDeviceDescriptorIndexingFeatures{};
+    std::vector<VkPhysicalDeviceDescriptorIndexingPropertiesEXT> physicalDeviceDescriptorIndexingProps{};
 
     // logging
     core::log::Logger& log;
@@ -108,6 +129,8 @@ public:
         config.enumeratePhysicalDeviceProperties();
         config.enumeratePhysicalDeviceMemoryProperties();
         config.enumerateQueueFamilyProperties();
+        config.enumerateDeviceExtensionProperties();
+        config.enumeratePhysicalDeviceFeatures();
 
         // return a config with a properly set instance, invalidate the local temporary config's instance
         return std::move(config);
@@ -139,6 +162,11 @@ public:
         // device-level extensions
         physicalDeviceExtensionProps = other.physicalDeviceExtensionProps;
 
+        // device-level features
+        physicalDeviceFeatures = other.physicalDeviceFeatures;
+        physicalDeviceDescriptorIndexingFeatures = other.physicalDeviceDescriptorIndexingFeatures;
+        physicalDeviceDescriptorIndexingProps = other.physicalDeviceDescriptorIndexingProps;
+
         // enabled extensions layers and extensions
         instanceRequestedLayers = other.instanceRequestedLayers;
         instanceRequestedExtensions = other.instanceRequestedExtensions;
@@ -176,23 +204,158 @@ public:
     }
 
     // methods for enumerateing devices and or device/queue properties
-    // todo: pick a device based on optional and required features
-    std::optional<const PhysicalDeviceHandle> getBestPhysicalDevice() const noexcept {
-        if(physicalDevices.empty()) {
+    // the request's preferred device if it is usable, else the best scoring one (see scorePhysicalDevice)
+    std::optional<const PhysicalDeviceHandle> getBestPhysicalDevice(const DeviceRequest& request) const noexcept {
+        std::optional<PhysicalDeviceHandle> best{};
+        core::u64 bestScore{ 0 };
+        // all digits is an index only, anything else is matched against names only
+        const std::string& preferred = request.preferredDevice;
+        const bool preferIndex = !preferred.empty()
+            && std::all_of(preferred.begin(), preferred.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+        const std::size_t preferredIndex = preferIndex ? std::strtoull(preferred.c_str(), nullptr, 10) : 0;
+        for(const PhysicalDeviceHandle& handle : physicalDeviceHandles) {
+            const char* name = physicalDeviceProps.at(handle.id).deviceName;
+            const std::optional<core::u64> score = scorePhysicalDevice(handle, request);
+            if(!score.has_value()) {
+                logInfo("physical device (%lu) '%s' is unusable", handle.id, name);
+                continue;
+            }
+            logInfo("physical device (%lu) '%s' scored (%llx)", handle.id, name, static_cast<unsigned long long>(*score));
+            const bool preferredMatch = preferIndex ? handle.id == preferredIndex
+                : !preferred.empty() && std::strstr(name, preferred.c_str()) != nullptr;
+            if(preferredMatch) {
+                logInfo("using preferred physical device (%lu) '%s'", handle.id, name);
+                return handle;
+            }
+            if(!best.has_value() || *score > bestScore) {
+                best = handle;
+                bestScore = *score;
+            }
+        }
+        if(!request.preferredDevice.empty()) {
+            logError("preferred physical device '%s' is missing or unusable", request.preferredDevice.c_str());
+        }
+        if(best.has_value()) {
+            logInfo("using physical device (%lu) '%s'", best->id, physicalDeviceProps.at(best->id).deviceName);
+        }
+        return best;
+    }
+
+    // nullopt for devices that can't serve the request, otherwise larger is better, compared by in order:
+    // device type (discrete > integrated > virtual > cpu), optional extensions available,
+    // dedicated transfer and compute families, then the largest device local heap
+    std::optional<core::u64> scorePhysicalDevice(const PhysicalDeviceHandle& handle, const DeviceRequest& request) const noexcept {
+        if(handle.id >= physicalDevices.size() || handle.id >= physicalDeviceProps.size()) {
+            return std::nullopt;
+        }
+        for(const std::string& name : request.requiredExtensionNames) {
+            if(!isDeviceExtensionUsable(handle, name)) {
+                return std::nullopt;
+            }
+        }
+
+        // Device uses (and presents on) the first graphics family
+        std::span<const VkQueueFamilyProperties> families = getQueueFamilyProperties(handle);
+        std::optional<core::u32> graphics{};
+        bool transferOnly{ false };
+        bool asyncCompute{ false };
+        for(core::u32 i = 0; i < families.size(); ++i) {
+            const VkQueueFlags flags = families[i].queueFlags;
+            if(families[i].queueCount == 0) {
+                continue;
+            }
+            if((flags & VK_QUEUE_GRAPHICS_BIT) && !graphics.has_value()) {
+                graphics = i;
+            }
+            transferOnly |= (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+            asyncCompute |= (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT);
+        }
+        if(!graphics.has_value()) {
             return std::nullopt;
         }
-        // just return the first one for now
-        return physicalDeviceHandles.front();
+        if(request.surface != VK_NULL_HANDLE) {
+            VkBool32 present{ VK_FALSE };
+            VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevices[handle.id], *graphics, request.surface, &present);
+            if(result != VK_SUCCESS || !present) {
+                return std::nullopt;
+            }
+        }
+
+        core::u64 type{ 0 };
+        switch(physicalDeviceProps[handle.id].deviceType) {
+            case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+                type = 4;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+                type = 3;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+                type = 2;
+                break;
+            case VK_PHYSICAL_DEVICE_TYPE_CPU:
+                type = 1;
+                break;
+            default:
+                type = 0;
+                break;
+        }
+        core::u64 extensions{ 0 };
+        for(const std::string& name : request.optionalExtensionNames) {
+            extensions += isDeviceExtensionUsable(handle, name) ? 1 : 0;
+        }
+        const core::u64 queues = (transferOnly ? 2 : 0) + (asyncCompute ? 1 : 0);
+        VkDeviceSize deviceLocal{ 0 };
+        if(handle.id < physicalDeviceMemoryProps.size()) {
+            const VkPhysicalDeviceMemoryProperties& memory = physicalDeviceMemoryProps[handle.id];
+            for(core::u32 i = 0; i < memory.memoryHeapCount; ++i) {
+                if(memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                    deviceLocal = std::max(deviceLocal, memory.memoryHeaps[i].size);
+                }
+            }
+        }
+        // type: 3 bits, extensions: 8 bits, queues: 2 bits, device local MiB: 36 bits
+        const core::u64 mebibytes = std::min<core::u64>(deviceLocal >> 20, (core::u64{ 1 } << 36) - 1);
+        return (type << 48) | (std::min<core::u64>(extensions, 0xff) << 40) | (queues << 36) | mebibytes;
+    }
+
+    // available, and for extensions that only matter with their features, the features are too
+    bool isDeviceExtensionUsable(const PhysicalDeviceHandle& physicalDevice, const std::string& extensionName) const noexcept {
+        if(extensionName == VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) {
+            return isDescriptorIndexingUsable(physicalDevice);
+        }
+        return isDeviceExtensionAvailable(physicalDevice, extensionName.c_str());
+    }
+
+    // what the DescriptorHeap needs of VK_EXT_descriptor_indexing, and maintenance3 it depends on
+    bool isDescriptorIndexingUsable(const PhysicalDeviceHandle& physicalDevice) const noexcept {
+        const std::optional<const VkPhysicalDeviceDescriptorIndexingFeaturesEXT> features = getDescriptorIndexingFeatures(physicalDevice);
+        const std::optional<const VkPhysicalDeviceProperties> props = getPhysicalDeviceProperties(physicalDevice);
+        const bool hasMaintenance3 = (props.has_value() && props->apiVersion >= VK_API_VERSION_1_1)
+            || isDeviceExtensionAvailable(physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+        return features.has_value() && hasMaintenance3
+            && features->descriptorBindingPartiallyBound
+            && features->descriptorBindingUpdateUnusedWhilePending
+            && features->descriptorBindingSampledImageUpdateAfterBind
+            && features->descriptorBindingStorageBufferUpdateAfterBind;
     }
 
     // get device-level available extensions
-    std::optional<const VkExtensionProperties> getAvailableDeviceExtensionProperties(const PhysicalDeviceHandle& physicalDevice) const noexcept {
-        if(physicalDeviceExtensionProps.empty()) {
-            return std::nullopt;
+    std::span<const VkExtensionProperties> getAvailableDeviceExtensionProperties(const PhysicalDeviceHandle& physicalDevice) const noexcept {
+        if(physicalDevice.id >= physicalDeviceExtensionProps.size()) {
+            return {};
         }
         return physicalDeviceExtensionProps.at(physicalDevice.id);
     }
 
+    bool isDeviceExtensionAvailable(const PhysicalDeviceHandle& physicalDevice, const char* extensionName) const noexcept {
+        for(const VkExtensionProperties& prop : getAvailableDeviceExtensionProperties(physicalDevice)) {
+            if(std::strcmp(prop.extensionName, extensionName) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     std::optional<const VkPhysicalDeviceProperties> getPhysicalDeviceProperties(const PhysicalDeviceHandle& physicalDevice) const noexcept {
         if(physicalDeviceProps.empty()) {
             return std::nullopt;
@@ -210,6 +373,36 @@ public:
         return physicalDeviceMemoryProps.at(physicalDevice.id);
     }
 
+    std::optional<const VkPhysicalDeviceFeatures> getPhysicalDeviceFeatures(const PhysicalDeviceHandle& physicalDevice) const noexcept {
+        if(physicalDevice.id >= physicalDeviceFeatures.size()) {
+            return std::nullopt;
+        }
+
+        return physicalDeviceFeatures.at(physicalDevice.id);
+    }
+
+    // nullopt without VK_EXT_descriptor_indexing, pNext of the result is not meaningful
+    std::optional<const VkPhysicalDeviceDescriptorIndexingFeaturesEXT> getDescriptorIndexingFeatures(const PhysicalDeviceHandle& physicalDevice) const noexcept {
+        if(physicalDevice.id >= physicalDeviceDescriptorIndexingFeatures.size()
+            || !isDeviceExtensionAvailable(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+        {
+            return std::nullopt;
+        }
+
+        return physicalDeviceDescriptorIndexingFeatures.at(physicalDevice.id);
+    }
+
+    // update after bind limits, nullopt without VK_EXT_descriptor_indexing
+    std::optional<const VkPhysicalDeviceDescriptorIndexingPropertiesEXT> getDescriptorIndexingProperties(const PhysicalDeviceHandle& physicalDevice) const noexcept {
+        if(physicalDevice.id >= physicalDeviceDescriptorIndexingProps.size()
+            || !isDeviceExtensionAvailable(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME))
+        {
+            return std::nullopt;
+        }
+
+        return physicalDeviceDescriptorIndexingProps.at(physicalDevice.id);
+    }
+
     std::span<const VkQueueFamilyProperties> getQueueFamilyProperties(const PhysicalDeviceHandle& physicalDevice) const noexcept {
         if(queueFamilyProperties.empty()) {
             return {};
@@ -253,17 +446,17 @@ private:
 
     // log convenience
     template<typename... Args>
-    void logError(const char* msg, Args... args) {
+    void logError(const char* msg, Args... args) const {
         log.error("gfx/vulkan/configurator", msg, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
-    void logDebug(const char* msg, Args... args) {
+    void logDebug(const char* msg, Args... args) const {
         log.debug("gfx/vulkan/configurator", msg, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
-    void logInfo(const char* msg, Args... args) {
+    void logInfo(const char* msg, Args... args) const {
         log.info("gfx/vulkan/configurator", msg, std::forward<Args>(args)...);
     }
 
@@ -372,6 +565,89 @@ private:
         }
     }
 
+    void enumerateDeviceExtensionProperties() noexcept {
+        physicalDeviceExtensionProps.resize(physicalDevices.size());
+        for(const PhysicalDeviceHandle& physicalDeviceHandle : physicalDeviceHandles) {
+            const VkPhysicalDevice physicalDevice = physicalDevices.at(physicalDeviceHandle.id);
+
+            core::u32 numExtensions{ 0 };
+            VkResult result = vkEnumerateDeviceExtensionProperties(
+                physicalDevice,
+                nullptr,
+                &numExtensions,
+                nullptr
+            );
+            if(result != VK_SUCCESS) {
+                logError("could not enumerate device extensions for physical device (%lu)", physicalDeviceHandle.id);
+                continue;
+            }
+
+            physicalDeviceExtensionProps.at(physicalDeviceHandle.id).resize(numExtensions);
+            result = vkEnumerateDeviceExtensionProperties(
+                physicalDevice,
+                nullptr,
+                &numExtensions,
+                physicalDeviceExtensionProps[physicalDeviceHandle.id].data()
+            );
+            if(result != VK_SUCCESS) {
+                logError("could not enumerate device extensions for physical device (%lu)", physicalDeviceHandle.id);
+                physicalDeviceExtensionProps[physicalDeviceHandle.id].clear();
+            }
+        }
+    }
+
+    // core features for every device, extension features through vkGetPhysicalDeviceFeatures2KHR
+    // note: VK_KHR_get_physical_device_properties2 is a required instance extension (see main)
+    void enumeratePhysicalDeviceFeatures() noexcept {
+        physicalDeviceFeatures.resize(physicalDevices.size());
+        physicalDeviceDescriptorIndexingFeatures.resize(physicalDevices.size());
+        physicalDeviceDescriptorIndexingProps.resize(physicalDevices.size());
+
+        auto getFeatures2 = reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+            vkGetInstanceProcAddr(*instance, "vkGetPhysicalDeviceFeatures2KHR"));
+        auto getProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+            vkGetInstanceProcAddr(*instance, "vkGetPhysicalDeviceProperties2KHR"));
+
+        for(const PhysicalDeviceHandle& physicalDeviceHandle : physicalDeviceHandles) {
+            const VkPhysicalDevice physicalDevice = physicalDevices.at(physicalDeviceHandle.id);
+            vkGetPhysicalDeviceFeatures(
+                physicalDevice,
+                &physicalDeviceFeatures[physicalDeviceHandle.id]
+            );
+
+            // chaining an extension's structures is only valid when the device exposes it
+            if(!isDeviceExtensionAvailable(physicalDeviceHandle, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)) {
+                continue;
+            }
+            if(getFeatures2 == nullptr || getProperties2 == nullptr) {
+                logError("no vkGetPhysicalDeviceFeatures2KHR, cannot query descriptor indexing for physical device (%lu)", physicalDeviceHandle.id);
+                continue;
+            }
+
+            VkPhysicalDeviceDescriptorIndexingFeaturesEXT& indexing = physicalDeviceDescriptorIndexingFeatures[physicalDeviceHandle.id];
+            indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+            indexing.pNext = nullptr;
+            VkPhysicalDeviceFeatures2KHR features {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+                .pNext = &indexing,
+                .features = {}
+            };
+            getFeatures2(physicalDevice, &features);
+            indexing.pNext = nullptr;
+
+            VkPhysicalDeviceDescriptorIndexingPropertiesEXT& limits = physicalDeviceDescriptorIndexingProps[physicalDeviceHandle.id];
+            limits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+            limits.pNext = nullptr;
+            VkPhysicalDeviceProperties2KHR props {
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR,
+                .pNext = &limits,
+                .properties = {}
+            };
+            getProperties2(physicalDevice, &props);
+            limits.pNext = nullptr;
+        }
+    }
+
     // there is no way in vulkan 1.0 to even ask if 1.0 is supported
     // we just have to infer based on the lack of vkEnumerateInstanceVersion
     // which was introduced in 1.1
@@ -2,13 +2,29 @@
 #pragma once
 
 #include "core/log/logging.hpp"
+#include "core/profile/profiler.hpp"
 #include "gfx/geometry/grid_mesh.hpp"
 #include "gfx/vulkan/config.hpp"
+#include "gfx/vulkan/descriptor_heap.hpp"
 #include "gfx/vulkan/device.hpp"
+#include "gfx/vulkan/heightmaps.hpp"
+#include "gfx/vulkan/pipeline_cache.hpp"
 #include "gfx/vulkan/resources.hpp"
 #include "gfx/vulkan/command.hpp"
 #include "gfx/vulkan/shader.hpp"
 #include "gfx/vulkan/swapchain.hpp"
+#include "gfx/vulkan/terrain.hpp"
+#include "gfx/vulkan/timeline.hpp"
+#include "gfx/vulkan/upload.hpp"
+
+#include <algorithm>
+#include <array>
+#include <future>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
 
 #include <vulkan/vulkan_core.h>
 
@@ -60,19 +76,48 @@ class GpuContext {
     const Configurator& config;
     PhysicalDeviceHandle physicalDeviceHandle;
     Device device;
+    // outlive every pipeline built against them, saved to disk on destruction
+    PipelineCache pipelineCache;
+    ShaderCache shaders;
+    // every descriptor shaders read, bound once per pipeline layout and indexed with push constants
+    DescriptorHeap heap;
     Allocator allocator;
     ResourceManager manager;
+    // graphics queue: frames and synchronous uploads
     Commander cmd;
+    // transfer queue: async uploads (the graphics queue if the device has no other family)
+    // as many batches in flight as frames, so a batch per frame only waits on the one framesInFlight ago
+    Commander transferCmd;
+    // signaled by async upload batches, unset without VK_KHR_timeline_semaphore
+    std::optional<TimelineSemaphore> uploadTimeline{};
+    UploadBatcher uploader;
+    // chunk heightmaps, one array layer per chunk pool slot
+    std::optional<HeightmapArray> heightmaps{};
+    // uploads the next frame reads: acquire barriers to record and the timeline value to wait on
+    std::vector<VkImageMemoryBarrier> frameImageAcquires{};
+    std::vector<VkBufferMemoryBarrier> frameBufferAcquires{};
+    core::u64 frameUploadValue{ 0 };
     SwapchainManager swapchain;
+    // presented to, kept for recreating the swapchain
+    VkSurfaceKHR surface{ VK_NULL_HANDLE };
     std::vector<VkSemaphore> submit;
-    // graphics pipeline (move into an owner class)
-    VkPipelineLayout graphicsPipelineLayout { VK_NULL_HANDLE };
-    VkPipeline graphicsPipeline { VK_NULL_HANDLE };
+    // draws the loaded chunks, destroyed before the heightmaps it samples
+    std::optional<TerrainRenderer> terrain{};
+    std::vector<TerrainInstance> terrainInstances{};
+    // background terrain pipeline builds, joined before anything records with the pipelines
+    std::future<bool> cullPipelineBuild{};
+    std::future<bool> graphicsPipelineBuild{};
 
 public:
-    GpuContext(PhysicalDeviceHandle physicalDeviceHandle, core::log::Logger& log, const Configurator& config)
+    // deviceRequest: what physicalDeviceHandle was picked for, enabled on the device
+    // framesInFlight: frames the CPU may record ahead of the GPU
+    GpuContext(PhysicalDeviceHandle physicalDeviceHandle, core::log::Logger& log, const Configurator& config,
+        const DeviceRequest& deviceRequest, core::u32 framesInFlight = 2)
         : log(log), config(config), physicalDeviceHandle(physicalDeviceHandle),
-        device(log,config,physicalDeviceHandle),
+        device(log,config,physicalDeviceHandle,deviceRequest),
+        pipelineCache(log, device.get(), *config.getPhysicalDeviceProperties(physicalDeviceHandle)),
+        shaders(log, device.get()),
+        heap(log, device.get(), config, physicalDeviceHandle, device.hasDescriptorIndexing()),
         allocator({
             .physicalDevice = *config.getVulkanPhysicalDevice(physicalDeviceHandle),
             .device = device.get(),
@@ -83,223 +128,125 @@ public:
             .vulkanApiVersion = VK_API_VERSION_1_0
         }, log),
         manager(config,allocator.get(),device.get(),log),
-        cmd(log, config, device.get(), manager),
-        swapchain(log,config,physicalDeviceHandle,device.get())
-    {}
-
-    ~GpuContext() {}
-
-    void CreateGraphicsPipeline() noexcept {
-        Shader vert(log, device.get(), "triangle.vert.spv");
-        Shader frag(log, device.get(), "triangle.frag.spv");
-
-        // vertex -> frag
-        VkPipelineShaderStageCreateInfo stages[2] = {
-            {
-                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                .pNext = nullptr,
-                .flags = 0,
-                .stage = VK_SHADER_STAGE_VERTEX_BIT,
-                .module = vert.get(),
-                .pName = "main",
-                .pSpecializationInfo = nullptr
-            },
-            {
-                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                .pNext = nullptr,
-                .flags = 0,
-                .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-                .module = frag.get(),
-                .pName = "main",
-                .pSpecializationInfo = nullptr
+        cmd(log, config, device.get(), device.getQueueFamilies().graphics, device.getGraphicsQueue(), manager, framesInFlight),
+        transferCmd(log, config, device.get(), device.getQueueFamilies().transfer, device.getTransferQueue(), manager, framesInFlight),
+        uploader(log, manager, cmd),
+        swapchain(log,config,physicalDeviceHandle,device.get(),manager)
+    {
+        // without timeline semaphores every upload flushes synchronously on the graphics queue
+        if(device.hasTimelineSemaphores()) {
+            uploadTimeline.emplace(log, device.get());
+            if(uploadTimeline->valid()) {
+                uploader.enableAsync(transferCmd, *uploadTimeline, device.getQueueFamilies().graphics);
             }
-        };
-
-        VkPipelineVertexInputStateCreateInfo vertexInput {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .vertexBindingDescriptionCount = 0,
-            .pVertexBindingDescriptions = nullptr,
-            .vertexAttributeDescriptionCount = 0,
-            .pVertexAttributeDescriptions = nullptr
-        };
-
-        VkPipelineInputAssemblyStateCreateInfo inputAssembly {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-            .primitiveRestartEnable = 0
-        };
-
-        // scissor and viewport are dynamic - do not specify pointers
-        VkPipelineViewportStateCreateInfo viewportState {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .viewportCount = 1,
-            .pViewports = nullptr,
-            .scissorCount = 1,
-            .pScissors = nullptr
-        };
-
-        VkPipelineRasterizationStateCreateInfo rasterizer {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .depthClampEnable = 0,
-            .rasterizerDiscardEnable = 0,
-            .polygonMode = VK_POLYGON_MODE_FILL,
-            .cullMode = VK_CULL_MODE_NONE,
-            .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
-            .depthBiasEnable = 0,
-            .depthBiasConstantFactor = 0.f,
-            .depthBiasClamp = 0.f,
-            .depthBiasSlopeFactor = 0.f,
-            .lineWidth = 1.f
-        };
-
-        VkPipelineMultisampleStateCreateInfo multisample {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
-            .sampleShadingEnable = 0,
-            .minSampleShading = 0.f,
-            .pSampleMask = nullptr,
-            .alphaToCoverageEnable = 0,
-            .alphaToOneEnable = 0
-        };
-
-        VkPipelineColorBlendAttachmentState colorBlendAttachment {
-            .blendEnable = 0,
-            .srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .colorBlendOp = VK_BLEND_OP_ADD,
-            .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-            .alphaBlendOp = VK_BLEND_OP_ADD,
-            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-                VK_COLOR_COMPONENT_G_BIT |
-                VK_COLOR_COMPONENT_B_BIT |
-                VK_COLOR_COMPONENT_A_BIT
-        };
-
-        VkPipelineColorBlendStateCreateInfo colorBlend {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .logicOpEnable = 0,
-            .logicOp = VK_LOGIC_OP_CLEAR,
-            .attachmentCount = 1,
-            .pAttachments = &colorBlendAttachment,
-            .blendConstants = {0.f, 0.f, 0.f, 0.f}
-        };
-
-        VkDynamicState dynamics[] = {
-            VK_DYNAMIC_STATE_VIEWPORT,
-            VK_DYNAMIC_STATE_SCISSOR
-        };
-
-        VkPipelineDynamicStateCreateInfo dynamicState {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .dynamicStateCount = 2,
-            .pDynamicStates = dynamics
-        };
+        }
+        // per frame uniforms and descriptor sets, recycled with the frame instead of created and freed
+        const VkPhysicalDeviceLimits limits = config.getPhysicalDeviceProperties(physicalDeviceHandle)->limits;
+        cmd.enableTransients(transientBytes,
+            std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment),
+            transientSets, transientPoolSizes);
+        // the terrain draws every visible chunk in one call where the draw count can stay on the GPU
+        cmd.enableDrawIndirectCount(device.getDrawIndexedIndirectCount());
+#if defined(DEUS_PROFILE)
+        // GPU zones need a queue that writes timestamps, and the tick length to turn them into nanoseconds
+        const float timestampPeriod = config.getPhysicalDeviceProperties(physicalDeviceHandle)->limits.timestampPeriod;
+        std::span<const VkQueueFamilyProperties> families = config.getQueueFamilyProperties(physicalDeviceHandle);
+        cmd.enableTimestamps(timestampPeriod, families[device.getQueueFamilies().graphics].timestampValidBits, "gpu/graphics");
+        transferCmd.enableTimestamps(timestampPeriod, families[device.getQueueFamilies().transfer].timestampValidBits, "gpu/transfer");
+#endif
+    }
 
-        VkPipelineLayoutCreateInfo layoutInfo {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .setLayoutCount = 0,
-            .pSetLayouts = nullptr,
-            .pushConstantRangeCount = 0,
-            .pPushConstantRanges = nullptr
-        };
+    ~GpuContext() {
+        AwaitGraphicsPipeline();
+    }
 
-        VkResult result = vkCreatePipelineLayout(
-            device.get(),
-            &layoutInfo,
-            nullptr,
-            &graphicsPipelineLayout
-        );
-        if(result != VK_SUCCESS) {
-            logError("could not create graphics pipeline layout");
-            graphicsPipelineLayout = VK_NULL_HANDLE;
+    // terrain pipelines against the swapchain's render pass, recreate with the swapchain
+    void CreateGraphicsPipeline() noexcept {
+        AwaitGraphicsPipeline();
+        if(!terrain.has_value()) {
+            logError("no terrain renderer to create a graphics pipeline for");
             return;
         }
+        terrain->createCullPipeline();
+        terrain->createPipeline(swapchain.getRenderPass());
+    }
 
-        VkGraphicsPipelineCreateInfo pipelineInfo {
-            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .stageCount = 2,
-            .pStages = stages,
-            .pVertexInputState = &vertexInput,
-            .pInputAssemblyState = &inputAssembly,
-            .pTessellationState = nullptr,
-            .pViewportState = &viewportState,
-            .pRasterizationState = &rasterizer,
-            .pMultisampleState = &multisample,
-            .pDepthStencilState = nullptr,
-            .pColorBlendState = &colorBlend,
-            .pDynamicState = &dynamicState,
-            .layout = graphicsPipelineLayout,
-            .renderPass = swapchain.getRenderPass(),
-            .subpass = 0,
-            .basePipelineHandle = VK_NULL_HANDLE,
-            .basePipelineIndex = 0
-        };
+    // CreateGraphicsPipeline on background threads, one per pipeline, so startup work (waiting on chunks,
+    // uploads) overlaps shader compilation; the first frame, or AwaitGraphicsPipeline, waits for them
+    void CreateGraphicsPipelineAsync() noexcept {
+        AwaitGraphicsPipeline();
+        if(!terrain.has_value()) {
+            logError("no terrain renderer to create a graphics pipeline for");
+            return;
+        }
+        const VkRenderPass renderPass = swapchain.getRenderPass();
+        cullPipelineBuild = std::async(std::launch::async, [this] {
+            return terrain->createCullPipeline();
+        });
+        graphicsPipelineBuild = std::async(std::launch::async, [this, renderPass] {
+            return terrain->createPipeline(renderPass);
+        });
+    }
 
-        // create pipeline
-        result = vkCreateGraphicsPipelines(
-            device.get(),
-            VK_NULL_HANDLE,
-            1,
-            &pipelineInfo,
-            nullptr,
-            &graphicsPipeline
-        );
-        if(result != VK_SUCCESS) {
-            logError("could not create graphics pipeline");
-            graphicsPipeline = VK_NULL_HANDLE;
+    // join any background pipeline builds, false if one of them failed
+    // a cold cache is written out right away, so a crash later still keeps the compiled pipelines
+    bool AwaitGraphicsPipeline() noexcept {
+        if(!cullPipelineBuild.valid() && !graphicsPipelineBuild.valid()) {
+            return true;
+        }
+        bool built = true;
+        for(std::future<bool>* build : { &cullPipelineBuild, &graphicsPipelineBuild }) {
+            if(build->valid()) {
+                built = build->get() && built;
+            }
         }
+        pipelineCache.save();
+        return built;
     }
 
     void DestroyGraphicsPipeline() noexcept {
+        AwaitGraphicsPipeline();
         vkDeviceWaitIdle(device.get());
-        // destroy pipeline + layout
-        if(graphicsPipeline != VK_NULL_HANDLE) {
-            vkDestroyPipeline(
-                device.get(),
-                graphicsPipeline,
-                nullptr
-            );
-        }
-        if(graphicsPipelineLayout != VK_NULL_HANDLE) {
-            vkDestroyPipelineLayout(
-                device.get(),
-                graphicsPipelineLayout,
-                nullptr
-            );
+        if(terrain.has_value()) {
+            terrain->destroyPipeline();
         }
     }
 
-    void AcquireSubmitPresent() noexcept {
-        cmd.awaitAndResetFrameFence();
+    // view: camera the terrain is culled and drawn for
+    void AcquireSubmitPresent(const TerrainView& view) noexcept {
+        DEUS_PROFILE_ZONE("gfx/frame");
+        // pipelines still building in the background are needed from here on
+        AwaitGraphicsPipeline();
+
+        // anything staged since the last frame goes out in one batch this frame waits on
+        SubmitUploads();
+
+        // resized, or acquire/present said so: replace the swapchain, skip frames while minimized
+        if((swapchain.isStale() || !swapchain.valid()) && !RecreateSwapchain()) {
+            return;
+        }
+
+        // only waits on the frame framesInFlight submits ago, earlier frames may still be executing
+        cmd.awaitFrameFence();
+        // and frees whatever was destroyed while the frames now complete were in flight
+        manager.reclaimReleased(cmd.getCompletedValue());
+        heap.reclaimReleased(cmd.getCompletedValue());
+        swapchain.reclaimRetired(cmd.getCompletedValue());
 
-        // this needs to be cached only once (even between recreating the swapchain), as it is not
-        // the "signal" of the semaphore
-        // as such, it is perfectly safe to copy from our swapchain manager
-        VkSemaphore acquire = swapchain.getAcquireSemaphore();
+        // per frame in flight: its last waiter was the submit the fence just covered
+        VkSemaphore acquire = cmd.getAcquireSemaphore();
 
         // call vkAcquireNextImage, set submit semaphore to the corresponding index
-        uint32_t imageIndex = swapchain.acquireImage();
+        // out of date: nothing was acquired, leave the fence signaled and recreate next frame
+        const std::optional<uint32_t> acquired = swapchain.acquireImage(acquire);
+        if(!acquired.has_value()) {
+            swapchain.markStale();
+            return;
+        }
+        cmd.resetFrameFence();
+        const uint32_t imageIndex = *acquired;
         VkSemaphore submit = swapchain.getSubmitSemaphore(imageIndex);
-        logInfo("acquired swapchain index %d",imageIndex);
+        logDebug("acquired swapchain index %d",imageIndex);
 
         // set viewport + scissor
         VkExtent2D extent = swapchain.getExtent();
@@ -320,101 +267,149 @@ public:
         VkClearColorValue clearColorValue {
             .float32 = { 1.f, 0.f, 0.0f, 1.0f }
         };
-        VkClearValue clearValue {
-            .color = clearColorValue,
+        // color, then depth: cleared to the far plane
+        const VkClearValue clearValues[2] = {
+            { .color = clearColorValue },
+            { .depthStencil = { .depth = 1.f, .stencil = 0 } }
         };
         cmd.begin();
+        // take ownership of anything uploaded for this frame, before the render pass reads it
+        cmd.barrier(uploadStages, uploadStages, {}, frameImageAcquires, frameBufferAcquires);
+        // pick the visible chunks on the GPU, before the render pass draws them
+        if(terrain.has_value()) {
+            terrain->cull(cmd, terrainInstances, view);
+        }
         cmd.beginRenderPass(
             swapchain.getRenderPass(),
             swapchain.getFramebuffers()[imageIndex],
             swapchain.getExtent(),
-            clearValue
+            clearValues
         );
 
-        cmd.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
         cmd.setViewportAndScissor(viewport, scissor);
-        cmd.draw();
+        // every visible chunk in one instanced draw
+        if(terrain.has_value()) {
+            terrain->draw(cmd, view);
+        }
 
         cmd.endRenderPass();
 
-        cmd.submitSwapchain(acquire, submit);
-        cmd.presentSwapchain(submit, swapchain.get(), imageIndex);
+        // only wait on the transfer queue if this frame reads uploads it hasn't finished
+        const bool waitUploads = uploadTimeline.has_value() && frameUploadValue != 0
+            && !uploadTimeline->isComplete(frameUploadValue);
+        cmd.submitSwapchain(acquire, submit,
+            waitUploads ? uploadTimeline->get() : VK_NULL_HANDLE, frameUploadValue, uploadStages);
+        // anything destroyed up to now may still be read by this frame, or the ones before it
+        // and so may the heightmap layers of every chunk it drew
+        if(heightmaps.has_value()) {
+            for(const TerrainInstance& instance : terrainInstances) {
+                heightmaps->markUsed(instance.layer, cmd.getSubmitValue());
+            }
+        }
+        manager.retireReleased(cmd.getSubmitValue());
+        heap.retireReleased(cmd.getSubmitValue());
+        if(!swapchain.checkResult(cmd.presentSwapchain(submit, swapchain.get(), imageIndex))) {
+            logError("could not present swapchain image (%u)", imageIndex);
+        }
+        cmd.nextFrame();
+
+        frameImageAcquires.clear();
+        frameBufferAcquires.clear();
+        frameUploadValue = 0;
     }
 
-    bool AcquireSwapchain(VkSurfaceKHR surface) {
-        return swapchain.createSwapchain(0,surface);
+    // make the next frame wait on (and acquire ownership of) an async upload batch
+    void RequireUpload(UploadTicket&& ticket) {
+        frameImageAcquires.insert(frameImageAcquires.end(), ticket.imageAcquires.begin(), ticket.imageAcquires.end());
+        frameBufferAcquires.insert(frameBufferAcquires.end(), ticket.bufferAcquires.begin(), ticket.bufferAcquires.end());
+        frameUploadValue = std::max(frameUploadValue, ticket.value);
     }
 
-    bool RecreateSwapchain(VkSurfaceKHR surface) {
-        return swapchain.recreateSwapchain(0,surface);
+    // submit everything staged since the last frame as one batch, read by the next frame
+    void SubmitUploads() {
+        std::optional<UploadTicket> ticket = uploader.flushAsync();
+        if(!ticket.has_value()) {
+            logError("could not submit uploads");
+            return;
+        }
+        RequireUpload(std::move(*ticket));
     }
 
-    // fill an image with heightmap data
-    template<size_t N>
-    void CmdBuffers(const std::array<int16_t, N>& heightData, core::i32 heightResolution, const gfx::geometry::GridMesh& gridMesh) {
-        // create image to store heightmap
-        std::optional<const ImageHandle> imageHandle = manager.createImage(heightResolution,heightResolution,1);
-        // image staging buffer
-        std::optional<const BufferHandle> bufferToImgHandle = manager.createStagingBuffer(heightResolution * heightResolution * sizeof(int16_t));
+    // one heightmap layer per chunk pool slot, layers = chunk pool capacity
+    bool CreateHeightmapArray(core::u32 layers, core::u32 resolution) {
+        heightmaps.emplace(log, manager, uploader, layers, resolution);
+        return heightmaps->valid();
+    }
 
-        // fill image staging buffer
-        bool heightFillResult = fillMemoryMappedBuffer(*bufferToImgHandle, heightData.data(), heightResolution * heightResolution);
+    // stage a chunk's heights into the layer of its pool slot, submitted with the next frame
+    // false while frames in flight still sample the slot's previous chunk, retry on a later frame
+    bool UploadChunkHeightmap(core::u32 layer, std::span<const core::i16> heightData) {
+        if(!heightmaps.has_value()) {
+            logError("no heightmap array to upload chunk heightmaps into");
+            return false;
+        }
+        return heightmaps->upload(layer, heightData, cmd.getCompletedValue());
+    }
 
-        // note: how can we minimize total submits?
-        // make heightmap image writeable
-        cmd.awaitAndResetFrameFence();
-        cmd.begin();
-        cmd.makeWriteable(*imageHandle);
-        cmd.submit();
-        // fill image from staging buffer
-        cmd.awaitAndResetFrameFence();
-        cmd.begin();
-        cmd.copy(*bufferToImgHandle, *imageHandle, heightResolution, heightResolution);
-        cmd.submit();
-        // make heightmap image readable from a shader
-        cmd.awaitAndResetFrameFence();
-        cmd.begin();
-        cmd.makeReadable(*imageHandle);
-        cmd.submit();
-
-        // create buffers to hold grid mesh vertex data
-        std::optional<const BufferHandle> bufferHandleGridX = manager.createDeviceLocalVertexBuffer(gridMesh.vertexCount * sizeof(core::u16));
-        std::optional<const BufferHandle> bufferHandleGridZ = manager.createDeviceLocalVertexBuffer(gridMesh.vertexCount * sizeof(core::u16));
-        // staging buffer for uploads
-        std::optional<const BufferHandle> bufferHandleSrc = manager.createStagingBuffer(gridMesh.vertexCount * sizeof(core::u16));
-
-        // fill staging buffer, copy to X and Z vertex buffers storing our gridmesh
-        bool fillResult = fillMemoryMappedBuffer(*bufferHandleSrc, gridMesh.vertexBufferX.data(), gridMesh.vertexCount);
-        cmd.awaitAndResetFrameFence();
-        cmd.begin();
-        cmd.copy(*bufferHandleSrc, *bufferHandleGridX);
-        cmd.submit();
+    bool AcquireSwapchain(VkSurfaceKHR presentSurface, const SwapchainRequest& request = {}) {
+        surface = presentSurface;
+        return swapchain.createSwapchain(device.getQueueFamilies().graphics,surface,request);
+    }
 
-        fillResult = fillMemoryMappedBuffer(*bufferHandleSrc, gridMesh.vertexBufferZ.data(), gridMesh.vertexCount);
-        cmd.awaitAndResetFrameFence();
-        cmd.begin();
-        cmd.copy(*bufferHandleSrc, *bufferHandleGridZ);
-        cmd.submit();
+    // without waiting for the device: the old swapchain is retired until the frames submitted so far
+    // complete, pipelines are only rebuilt if the render pass had to change
+    bool RecreateSwapchain() {
+        const VkRenderPass renderPass = swapchain.getRenderPass();
+        if(!swapchain.recreateSwapchain(device.getQueueFamilies().graphics, surface, cmd.getSubmitValue())) {
+            return false;
+        }
+        if(swapchain.getRenderPass() != renderPass && terrain.has_value()) {
+            AwaitGraphicsPipeline();
+            terrain->createPipeline(swapchain.getRenderPass());
+        }
+        return true;
     }
 
-    void Shaders() {
-        Shader frag(log, device.get(), "triangle.frag.spv");
-        Shader vert(log, device.get(), "triangle.vert.spv");
+    // e.g. the window's framebuffer was resized, picked up by the next AcquireSubmitPresent
+    void RequestSwapchainRecreate() noexcept {
+        swapchain.markStale();
     }
 
-private:
-    // fill host-visible buffer
-    template<typename T>
-    bool fillMemoryMappedBuffer(BufferHandle bufferHandle, T* data, std::size_t count) noexcept {
-        std::optional<Buffer> buffer = manager.getBuffer(bufferHandle);
-        void* pAlloc = buffer->allocationInfo.pMappedData;
+    // one grid mesh shared by every chunk, staged with the next frame's uploads
+    // maxChunks: instance capacity, at most the heightmap array's layers
+    bool CreateTerrainRenderer(const gfx::geometry::GridMesh& gridMesh, float sampleSpacing, core::u32 maxChunks) {
+        if(!heightmaps.has_value() || !heightmaps->valid()) {
+            logError("terrain renderer needs a heightmap array");
+            return false;
+        }
+        terrain.emplace(log, device.get(), manager, uploader, pipelineCache, shaders, *heightmaps, heap, gridMesh, sampleSpacing,
+            std::min(maxChunks, heightmaps->getLayerCount()), static_cast<core::u32>(cmd.getFramesInFlight()));
+        return true;
+    }
 
-        std::memcpy(pAlloc, data, count);
+    // loaded chunks to cull and draw from the next frame on
+    void SetTerrainInstances(std::span<const TerrainInstance> instances) {
+        terrainInstances.assign(instances.begin(), instances.end());
+    }
 
-        logInfo("filled buffer (%lu) with (%lu) bytes", bufferHandle.id, count);
-        return true;
+    VkExtent2D GetExtent() const noexcept {
+        return swapchain.getExtent();
     }
 
+private:
+    // per frame transient budget: bytes of the frame's linear buffer, descriptor sets of its pool
+    static constexpr const VkDeviceSize transientBytes = 1 << 20;
+    static constexpr const core::u32 transientSets = 64;
+    static constexpr const std::array<VkDescriptorPoolSize, 3> transientPoolSizes {
+        VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, .descriptorCount = 64 },
+        VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 64 },
+        VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = 16 }
+    };
+
+    // stages that read uploads: vertex buffers, heightmap sampling
+    static constexpr const VkPipelineStageFlags uploadStages =
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
     // log convenience
     template<typename... Args>
     void logError(const char* msg, Args... args) const noexcept {
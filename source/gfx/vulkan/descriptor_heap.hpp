@@ -0,0 +1,413 @@
+// descriptor_heap.hpp: defines the DescriptorHeap, one long-lived descriptor set of large arrays
+//     (combined image samplers at binding 0, storage buffers at binding 1) that resources register
+//     into once and shaders index with push constants, so draws bind nothing but the heap
+//     with VK_EXT_descriptor_indexing the arrays are partially bound and update after bind: entries
+//     are written while frames in flight use others, freed indices are reused once those frames
+//     complete (same release -> retire -> reclaim scheme as the ResourceManager)
+//     without it the arrays are clamped to the core limits, every free element aliases a live one,
+//     and entries may only change while no submitted frame uses the heap
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "core/log/logging.hpp"
+#include "core/retire_queue.hpp"
+#include "gfx/vulkan/config.hpp"
+
+namespace gfx::vulkan {
+
+// shaders declare the heap as set 0 with these bindings, arrays sized through a specialization
+// constant (see DescriptorHeap::getImageCapacity)
+constexpr const core::u32 DescriptorHeapImageBinding{ 0 };
+constexpr const core::u32 DescriptorHeapBufferBinding{ 1 };
+
+// requested array sizes, clamped to the device's limits
+constexpr const core::u32 DescriptorHeapImageCapacity{ 4096 };
+constexpr const core::u32 DescriptorHeapBufferCapacity{ 4096 };
+
+class DescriptorHeap {
+    // every stage that may index the heap
+    static constexpr VkShaderStageFlags HeapStages{
+        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT
+    };
+
+    core::log::Logger& log;
+    const VkDevice device;
+    // partially bound, update after bind arrays
+    const bool bindless;
+
+    VkDescriptorSetLayout layout{ VK_NULL_HANDLE };
+    VkDescriptorPool pool{ VK_NULL_HANDLE };
+    VkDescriptorSet set{ VK_NULL_HANDLE };
+
+    // one array binding: free indices (lowest on top) and what each live one holds
+    struct Array {
+        core::u32 binding{ 0 };
+        VkDescriptorType type{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER };
+        core::u32 capacity{ 0 };
+        std::vector<core::u32> free{};
+        std::vector<bool> live{};
+        std::vector<VkDescriptorImageInfo> images{};
+        std::vector<VkDescriptorBufferInfo> buffers{};
+        // without bindless: the live entry free elements alias
+        std::optional<core::u32> filler{};
+    };
+    Array images{};
+    Array buffers{};
+
+    // released indices frames in flight may still read, free again once their retire value completes
+    struct Released {
+        Array* array{ nullptr };
+        core::u32 index{ 0 };
+    };
+    core::RetireQueue<Released> released{};
+
+public:
+    // bindless: the device was created with descriptor indexing (see Device::hasDescriptorIndexing)
+    DescriptorHeap(core::log::Logger& log, VkDevice device, const Configurator& config,
+        const PhysicalDeviceHandle& physicalDeviceHandle, bool bindless,
+        core::u32 imageCapacity = DescriptorHeapImageCapacity, core::u32 bufferCapacity = DescriptorHeapBufferCapacity)
+        : log(log), device(device), bindless(bindless)
+    {
+        clampCapacities(config, physicalDeviceHandle, imageCapacity, bufferCapacity);
+        initArray(images, DescriptorHeapImageBinding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCapacity);
+        initArray(buffers, DescriptorHeapBufferBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bufferCapacity);
+        createSet();
+    }
+
+    // the device must be idle
+    ~DescriptorHeap() {
+        if(pool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(device, pool, nullptr);
+        }
+        if(layout != VK_NULL_HANDLE) {
+            vkDestroyDescriptorSetLayout(device, layout, nullptr);
+        }
+        logInfo("destroyed descriptor heap");
+    }
+
+    DescriptorHeap(const DescriptorHeap&) = delete;
+    DescriptorHeap& operator=(const DescriptorHeap&) = delete;
+    DescriptorHeap(DescriptorHeap&&) = delete;
+    DescriptorHeap& operator=(DescriptorHeap&&) = delete;
+
+    bool valid() const noexcept {
+        return set != VK_NULL_HANDLE;
+    }
+
+    bool isBindless() const noexcept {
+        return bindless;
+    }
+
+    VkDescriptorSetLayout getLayout() const noexcept {
+        return layout;
+    }
+
+    VkDescriptorSet get() const noexcept {
+        return set;
+    }
+
+    // array sizes after clamping, what shaders size their heap arrays with
+    core::u32 getImageCapacity() const noexcept {
+        return images.capacity;
+    }
+
+    core::u32 getBufferCapacity() const noexcept {
+        return buffers.capacity;
+    }
+
+    // index into the image array, nullopt once it is full
+    std::optional<core::u32> addImage(VkImageView view, VkSampler sampler, VkImageLayout imageLayout) noexcept {
+        std::optional<core::u32> index = allocate(images);
+        if(!index.has_value()) {
+            logError("descriptor heap is out of images, (%u) in use", images.capacity);
+            return std::nullopt;
+        }
+        images.images[*index] = { .sampler = sampler, .imageView = view, .imageLayout = imageLayout };
+        publish(images, *index);
+        logDebug("registered image at heap index (%u)", *index);
+        return index;
+    }
+
+    // index into the storage buffer array, nullopt once it is full
+    std::optional<core::u32> addBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) noexcept {
+        std::optional<core::u32> index = allocate(buffers);
+        if(!index.has_value()) {
+            logError("descriptor heap is out of storage buffers, (%u) in use", buffers.capacity);
+            return std::nullopt;
+        }
+        buffers.buffers[*index] = { .buffer = buffer, .offset = offset, .range = range };
+        publish(buffers, *index);
+        logDebug("registered storage buffer at heap index (%u)", *index);
+        return index;
+    }
+
+    // the index is free again once the frames that may still read it complete (see retireReleased)
+    // the resource behind it must live until then too
+    void releaseImage(core::u32 index) noexcept {
+        release(images, index);
+    }
+
+    void releaseBuffer(core::u32 index) noexcept {
+        release(buffers, index);
+    }
+
+    // everything released since the last retire may be in use until value completes
+    // values must not decrease, e.g. the next Commander submit value
+    void retireReleased(core::u64 value) noexcept {
+        released.retire(value);
+    }
+
+    // free every retired index whose value has completed
+    void reclaimReleased(core::u64 completedValue) noexcept {
+        released.reclaim(completedValue, [&](Released& r) {
+            reclaim(*r.array, r.index);
+        });
+    }
+
+private:
+    // the core limits count every descriptor of a binding in each stage it is visible to, the update
+    // after bind ones replace them for update after bind layouts
+    void clampCapacities(const Configurator& config, const PhysicalDeviceHandle& physicalDeviceHandle,
+        core::u32& imageCapacity, core::u32& bufferCapacity) const noexcept
+    {
+        const std::optional<const VkPhysicalDeviceProperties> props = config.getPhysicalDeviceProperties(physicalDeviceHandle);
+        const std::optional<const VkPhysicalDeviceDescriptorIndexingPropertiesEXT> indexing =
+            config.getDescriptorIndexingProperties(physicalDeviceHandle);
+        core::u32 imageLimit{ 0 };
+        core::u32 bufferLimit{ 0 };
+        core::u32 resourceLimit{ 0 };
+        if(bindless && indexing.has_value()) {
+            imageLimit = std::min({
+                indexing->maxPerStageDescriptorUpdateAfterBindSamplers,
+                indexing->maxPerStageDescriptorUpdateAfterBindSampledImages,
+                indexing->maxDescriptorSetUpdateAfterBindSamplers,
+                indexing->maxDescriptorSetUpdateAfterBindSampledImages
+            });
+            bufferLimit = std::min(
+                indexing->maxPerStageDescriptorUpdateAfterBindStorageBuffers,
+                indexing->maxDescriptorSetUpdateAfterBindStorageBuffers
+            );
+            resourceLimit = indexing->maxPerStageUpdateAfterBindResources;
+        }
+        else if(props.has_value()) {
+            const VkPhysicalDeviceLimits& limits = props->limits;
+            imageLimit = std::min({
+                limits.maxPerStageDescriptorSamplers,
+                limits.maxPerStageDescriptorSampledImages,
+                limits.maxDescriptorSetSamplers,
+                limits.maxDescriptorSetSampledImages
+            });
+            bufferLimit = std::min(limits.maxPerStageDescriptorStorageBuffers, limits.maxDescriptorSetStorageBuffers);
+            resourceLimit = limits.maxPerStageResources;
+        }
+        imageCapacity = std::min(imageCapacity, imageLimit);
+        bufferCapacity = std::min(bufferCapacity, bufferLimit);
+        // images and buffers share the per stage resource budget: buffers keep up to half of it so a
+        // sampled image limit as large as the budget can't squeeze them to nothing, images get the rest
+        const core::u32 bufferReserve = std::min(bufferCapacity, resourceLimit / 2);
+        imageCapacity = std::min(imageCapacity, resourceLimit - bufferReserve);
+        bufferCapacity = std::min(bufferCapacity, resourceLimit - imageCapacity);
+    }
+
+    void initArray(Array& array, core::u32 binding, VkDescriptorType type, core::u32 capacity) {
+        array.binding = binding;
+        array.type = type;
+        array.capacity = capacity;
+        array.live.assign(capacity, false);
+        if(type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
+            array.buffers.assign(capacity, VkDescriptorBufferInfo{});
+        }
+        else {
+            array.images.assign(capacity, VkDescriptorImageInfo{});
+        }
+        // popped from the back, lowest indices first
+        array.free.reserve(capacity);
+        for(core::u32 index = capacity; index > 0; --index) {
+            array.free.push_back(index - 1);
+        }
+    }
+
+    void createSet() noexcept {
+        if(images.capacity == 0 || buffers.capacity == 0) {
+            logError("device limits leave no room for a descriptor heap");
+            return;
+        }
+
+        VkDescriptorSetLayoutBinding bindings[2] = {
+            {
+                .binding = images.binding,
+                .descriptorType = images.type,
+                .descriptorCount = images.capacity,
+                .stageFlags = HeapStages,
+                .pImmutableSamplers = nullptr
+            },
+            {
+                .binding = buffers.binding,
+                .descriptorType = buffers.type,
+                .descriptorCount = buffers.capacity,
+                .stageFlags = HeapStages,
+                .pImmutableSamplers = nullptr
+            }
+        };
+        // unwritten elements stay unwritten, written ones change under recorded and pending frames
+        // that don't read them
+        const VkDescriptorBindingFlagsEXT bindlessFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT
+            | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+            | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+        const VkDescriptorBindingFlagsEXT bindingFlags[2] = { bindlessFlags, bindlessFlags };
+        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+            .pNext = nullptr,
+            .bindingCount = 2,
+            .pBindingFlags = bindingFlags
+        };
+        VkDescriptorSetLayoutCreateInfo layoutInfo {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = bindless ? &bindingFlagsInfo : nullptr,
+            .flags = bindless ? static_cast<VkDescriptorSetLayoutCreateFlags>(VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT) : 0u,
+            .bindingCount = 2,
+            .pBindings = bindings
+        };
+        VkResult result = vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout);
+        if(result != VK_SUCCESS) {
+            logError("could not create descriptor heap set layout");
+            layout = VK_NULL_HANDLE;
+            return;
+        }
+
+        VkDescriptorPoolSize poolSizes[2] = {
+            { .type = images.type, .descriptorCount = images.capacity },
+            { .type = buffers.type, .descriptorCount = buffers.capacity }
+        };
+        VkDescriptorPoolCreateInfo poolInfo {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = bindless ? static_cast<VkDescriptorPoolCreateFlags>(VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT) : 0u,
+            .maxSets = 1,
+            .poolSizeCount = 2,
+            .pPoolSizes = poolSizes
+        };
+        result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool);
+        if(result != VK_SUCCESS) {
+            logError("could not create descriptor heap pool");
+            pool = VK_NULL_HANDLE;
+            return;
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .pNext = nullptr,
+            .descriptorPool = pool,
+            .descriptorSetCount = 1,
+            .pSetLayouts = &layout
+        };
+        result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+        if(result != VK_SUCCESS) {
+            logError("could not allocate descriptor heap set");
+            set = VK_NULL_HANDLE;
+            return;
+        }
+        logInfo("created %s descriptor heap of (%u) images, (%u) storage buffers",
+            bindless ? "bindless" : "static", images.capacity, buffers.capacity);
+    }
+
+    std::optional<core::u32> allocate(Array& array) noexcept {
+        if(set == VK_NULL_HANDLE || array.free.empty()) {
+            return std::nullopt;
+        }
+        const core::u32 index = array.free.back();
+        array.free.pop_back();
+        array.live[index] = true;
+        return index;
+    }
+
+    // write a live element, without bindless the first live one also fills every free element
+    void publish(Array& array, core::u32 index) noexcept {
+        write(array, index, index);
+        if(!bindless && !array.filler.has_value()) {
+            array.filler = index;
+            for(core::u32 free : array.free) {
+                write(array, free, index);
+            }
+        }
+    }
+
+    void release(Array& array, core::u32 index) noexcept {
+        if(index >= array.capacity || !array.live[index]) {
+            logError("attempt to release unused heap index (%u)", index);
+            return;
+        }
+        array.live[index] = false;
+        released.release({ .array = &array, .index = index });
+    }
+
+    // nothing reads index any more: reuse it, without bindless point it (or everything free) at a live entry
+    void reclaim(Array& array, core::u32 index) noexcept {
+        array.free.push_back(index);
+        if(bindless) {
+            return;
+        }
+        if(array.filler != index) {
+            if(array.filler.has_value()) {
+                write(array, index, *array.filler);
+            }
+            return;
+        }
+        array.filler.reset();
+        for(core::u32 candidate = 0; candidate < array.capacity; ++candidate) {
+            if(array.live[candidate]) {
+                array.filler = candidate;
+                break;
+            }
+        }
+        if(!array.filler.has_value()) {
+            return;
+        }
+        for(core::u32 free : array.free) {
+            write(array, free, *array.filler);
+        }
+    }
+
+    // element index takes source's descriptor
+    void write(const Array& array, core::u32 index, core::u32 source) noexcept {
+        const bool buffer = array.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        VkWriteDescriptorSet update {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext = nullptr,
+            .dstSet = set,
+            .dstBinding = array.binding,
+            .dstArrayElement = index,
+            .descriptorCount = 1,
+            .descriptorType = array.type,
+            .pImageInfo = buffer ? nullptr : &array.images[source],
+            .pBufferInfo = buffer ? &array.buffers[source] : nullptr,
+            .pTexelBufferView = nullptr
+        };
+        vkUpdateDescriptorSets(device, 1, &update, 0, nullptr);
+    }
+
+    // log convenience
+    template<typename... Args>
+    void logError(const char* msg, Args... args) const noexcept {
+        log.error("gfx/vulkan/descriptor_heap", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logDebug(const char* msg, Args... args) const noexcept {
+        log.debug("gfx/vulkan/descriptor_heap", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logInfo(const char* msg, Args... args) const noexcept {
+        log.info("gfx/vulkan/descriptor_heap", msg, std::forward<Args>(args)...);
+    }
+};
+
+}
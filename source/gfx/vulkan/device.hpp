@@ -7,29 +7,69 @@
 
 namespace gfx::vulkan {
 
+// queue families picked for a logical device
+struct QueueFamilies {
+    core::u32 graphics{ 0 };
+    // equal to graphics when the device has no separate transfer-capable family
+    core::u32 transfer{ 0 };
+};
+
 // Owner for VkDevice
 class Device {
     std::vector<std::string> extensionNames{};
     VkDevice device{};
 
+    QueueFamilies families{};
+    VkQueue graphicsQueue{ VK_NULL_HANDLE };
+    VkQueue transferQueue{ VK_NULL_HANDLE };
+
+    // VK_KHR_timeline_semaphore was enabled
+    bool timelineSemaphores{ false };
+    // VK_EXT_descriptor_indexing was enabled with partially bound, update after bind bindings
+    bool descriptorIndexing{ false };
+    // VK_KHR_draw_indirect_count was enabled with multiDrawIndirect and drawIndirectFirstInstance,
+    // and its command loaded
+    bool drawIndirectCount{ false };
+    PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount{ nullptr };
+    // core features the device was created with
+    VkPhysicalDeviceFeatures enabledFeatures{};
+
     core::log::Logger& log;
 
 public:
     Device() = delete;
-    Device(core::log::Logger& log, const Configurator& config, const PhysicalDeviceHandle& physicalDeviceHandle)
+    // request: the one physicalDeviceHandle was picked with (see Configurator::getBestPhysicalDevice)
+    Device(core::log::Logger& log, const Configurator& config, const PhysicalDeviceHandle& physicalDeviceHandle,
+        const DeviceRequest& request)
         : log(log)
     {
         float priority = 1.0f;
 
-        // todo: query directly from the configurator
-        VkDeviceQueueCreateInfo deviceQueueCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .queueFamilyIndex = 0,
-            .queueCount = 1,
-            .pQueuePriorities = &priority
+        // pick a graphics family and, if there is one, a transfer family that isn't it
+        families = pickQueueFamilies(config.getQueueFamilyProperties(physicalDeviceHandle));
+        log.info("gfx/vulkan/device","using queue family (%u) for graphics, (%u) for transfers",
+            families.graphics, families.transfer);
+
+        std::vector<VkDeviceQueueCreateInfo> deviceQueueCreateInfos {
+            {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .queueFamilyIndex = families.graphics,
+                .queueCount = 1,
+                .pQueuePriorities = &priority
+            }
         };
+        if(hasDedicatedTransferQueue()) {
+            deviceQueueCreateInfos.push_back({
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .queueFamilyIndex = families.transfer,
+                .queueCount = 1,
+                .pQueuePriorities = &priority
+            });
+        }
 
         // query configurator to see if portability was set
         std::span<const std::string> propNames = config.getEnabledExtensionNames();
@@ -40,9 +80,62 @@ public:
                 extensionNames.push_back("VK_KHR_portability_subset");
             }
         }
-        // enable creating swapchains
-        extensionNames.push_back("VK_KHR_swapchain");
-        log.info("gfx/vulkan/Device","enabling VK_KHR_swapchain");
+        // everything the request requires (getBestPhysicalDevice only picks devices that have it all),
+        // and what it would like where the device has it
+        for(const std::string& name : request.requiredExtensionNames) {
+            enableExtension(name);
+        }
+        for(const std::string& name : request.optionalExtensionNames) {
+            if(config.isDeviceExtensionUsable(physicalDeviceHandle, name)) {
+                enableExtension(name);
+            }
+            else {
+                log.info("gfx/vulkan/Device","optional device extension '%s' is unavailable", name.c_str());
+            }
+        }
+
+        // timeline semaphores let uploads on the transfer queue run ahead of the frame
+        // note: devices exposing the extension must support the feature
+        VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR,
+            .pNext = nullptr,
+            .timelineSemaphore = VK_TRUE
+        };
+        timelineSemaphores = isExtensionEnabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+        // bindless descriptor arrays (see DescriptorHeap): sparsely filled bindings, written while
+        // frames using other elements of them are in flight
+        // note: VK_KHR_maintenance3 is core from 1.1, required by the extension on 1.0 devices
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+            .pNext = timelineSemaphores ? &timelineFeatures : nullptr
+        };
+        descriptorIndexing = isExtensionEnabled(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+        if(descriptorIndexing) {
+            indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+            indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            const std::optional<const VkPhysicalDeviceProperties> props = config.getPhysicalDeviceProperties(physicalDeviceHandle);
+            if(!props.has_value() || props->apiVersion < VK_API_VERSION_1_1) {
+                enableExtension(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+            }
+        }
+
+        // only what is used, and only what is supported: shaders index descriptor arrays with push constants
+        // note: without these the heap's arrays may only be indexed with constants
+        const VkPhysicalDeviceFeatures supported = config.getPhysicalDeviceFeatures(physicalDeviceHandle).value_or(VkPhysicalDeviceFeatures{});
+        enabledFeatures.shaderSampledImageArrayDynamicIndexing = supported.shaderSampledImageArrayDynamicIndexing;
+        enabledFeatures.shaderStorageBufferArrayDynamicIndexing = supported.shaderStorageBufferArrayDynamicIndexing;
+        if(!enabledFeatures.shaderSampledImageArrayDynamicIndexing || !enabledFeatures.shaderStorageBufferArrayDynamicIndexing) {
+            log.error("gfx/vulkan/Device","device does not support dynamically indexed descriptor arrays");
+        }
+        // device side draw counts for the culled chunks: one draw per chunk, each finding its instance
+        // through firstInstance, without them the terrain keeps its fixed draw per lod
+        drawIndirectCount = isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)
+            && supported.multiDrawIndirect && supported.drawIndirectFirstInstance;
+        enabledFeatures.multiDrawIndirect = drawIndirectCount ? VK_TRUE : VK_FALSE;
+        enabledFeatures.drawIndirectFirstInstance = drawIndirectCount ? VK_TRUE : VK_FALSE;
 
         // create buffer for extension name pointers
         std::vector<const char*> extensionNamePtrs{};
@@ -50,19 +143,20 @@ public:
             extensionNamePtrs.push_back(name.c_str());
         }
 
-        // todo: require features
-        //VkPhysicalDeviceFeatures pEnabledFeatures;
+        const void* features = descriptorIndexing
+            ? static_cast<const void*>(&indexingFeatures)
+            : (timelineSemaphores ? static_cast<const void*>(&timelineFeatures) : nullptr);
         VkDeviceCreateInfo logicalDeviceCreateInfo {
             .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-            .pNext = nullptr,
+            .pNext = features,
             .flags = 0,
-            .queueCreateInfoCount = 1,
-            .pQueueCreateInfos = &deviceQueueCreateInfo,
+            .queueCreateInfoCount = static_cast<core::u32>(deviceQueueCreateInfos.size()),
+            .pQueueCreateInfos = deviceQueueCreateInfos.data(),
             .enabledLayerCount = 0,
             .ppEnabledLayerNames = nullptr,
             .enabledExtensionCount = static_cast<core::u32>(extensionNamePtrs.size()),
             .ppEnabledExtensionNames = extensionNamePtrs.data(),
-            .pEnabledFeatures = nullptr
+            .pEnabledFeatures = &enabledFeatures
         };
 
         std::optional<const VkPhysicalDevice> physicalDeviceOpt = config.getVulkanPhysicalDevice(physicalDeviceHandle);
@@ -85,6 +179,17 @@ public:
             return;
         }
 
+        // fetch the single queue we created from each family
+        vkGetDeviceQueue(device, families.graphics, 0, &graphicsQueue);
+        vkGetDeviceQueue(device, families.transfer, 0, &transferQueue);
+
+        // extension commands aren't exported by the loader
+        if(drawIndirectCount) {
+            cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+            drawIndirectCount = cmdDrawIndexedIndirectCount != nullptr;
+        }
+
         log.info("gfx/vulkan/device","created a logical device");
     }
 
@@ -108,6 +213,94 @@ public:
     const VkDevice& get() const noexcept {
         return device;
     }
+
+    const QueueFamilies& getQueueFamilies() const noexcept {
+        return families;
+    }
+
+    VkQueue getGraphicsQueue() const noexcept {
+        return graphicsQueue;
+    }
+
+    // same queue as graphics when there is no dedicated transfer family
+    VkQueue getTransferQueue() const noexcept {
+        return transferQueue;
+    }
+
+    bool hasDedicatedTransferQueue() const noexcept {
+        return families.transfer != families.graphics;
+    }
+
+    bool hasTimelineSemaphores() const noexcept {
+        return timelineSemaphores;
+    }
+
+    bool hasDescriptorIndexing() const noexcept {
+        return descriptorIndexing;
+    }
+
+    bool hasDrawIndirectCount() const noexcept {
+        return drawIndirectCount;
+    }
+
+    // vkCmdDrawIndexedIndirectCountKHR, null unless hasDrawIndirectCount()
+    PFN_vkCmdDrawIndexedIndirectCountKHR getDrawIndexedIndirectCount() const noexcept {
+        return cmdDrawIndexedIndirectCount;
+    }
+
+    const VkPhysicalDeviceFeatures& getEnabledFeatures() const noexcept {
+        return enabledFeatures;
+    }
+
+private:
+    void enableExtension(const std::string& name) {
+        if(isExtensionEnabled(name.c_str())) {
+            return;
+        }
+        extensionNames.push_back(name);
+        log.info("gfx/vulkan/Device","enabling %s", name.c_str());
+    }
+
+    bool isExtensionEnabled(const char* name) const noexcept {
+        for(const std::string& enabled : extensionNames) {
+            if(enabled == name) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // graphics: first family with graphics
+    // transfer: prefer a transfer-only family (copy engine), then a transfer-capable non-graphics
+    //           family (async compute), falling back to the graphics family
+    static QueueFamilies pickQueueFamilies(std::span<const VkQueueFamilyProperties> props) noexcept {
+        QueueFamilies picked{};
+        std::optional<core::u32> graphics{};
+        std::optional<core::u32> transferOnly{};
+        std::optional<core::u32> transferCompute{};
+        for(core::u32 i = 0; i < props.size(); ++i) {
+            const VkQueueFlags flags = props[i].queueFlags;
+            if(props[i].queueCount == 0) {
+                continue;
+            }
+            const bool hasGraphics = flags & VK_QUEUE_GRAPHICS_BIT;
+            const bool hasCompute = flags & VK_QUEUE_COMPUTE_BIT;
+            const bool hasTransfer = flags & VK_QUEUE_TRANSFER_BIT;
+            if(hasGraphics && !graphics.has_value()) {
+                graphics = i;
+            }
+            if(hasTransfer && !hasGraphics && !hasCompute && !transferOnly.has_value()) {
+                transferOnly = i;
+            }
+            // compute queues implicitly support transfers
+            if((hasTransfer || hasCompute) && !hasGraphics && !transferCompute.has_value()) {
+                transferCompute = i;
+            }
+        }
+        picked.graphics = graphics.value_or(0);
+        picked.transfer = transferOnly.value_or(transferCompute.value_or(picked.graphics));
+        return picked;
+    }
 };
 
 }
@@ -0,0 +1,130 @@
+// heightmaps.hpp: defines the HeightmapArray, the GPU-side store for chunk heightmaps: a single
+//     2D array image with one layer per ChunkPool slot, so a chunk's pool index is also its layer
+//     and streaming a chunk in is a copy into an existing allocation. A layer is only refilled once the
+//     graphics submits that last sampled it have completed, the copy runs on the transfer queue
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "core/log/logging.hpp"
+#include "gfx/vulkan/resources.hpp"
+#include "gfx/vulkan/upload.hpp"
+
+namespace gfx::vulkan {
+
+class HeightmapArray {
+    core::log::Logger& log;
+    ResourceManager& manager;
+    UploadBatcher& uploader;
+
+    std::optional<ImageHandle> image{};
+    const core::u32 resolution;
+    const core::u32 layers;
+    // graphics submit value of the last frame that may sample each layer, 0 if none has
+    std::vector<core::u64> lastUse{};
+
+public:
+    // layers: ChunkPool capacity, resolution: samples along a chunk edge
+    HeightmapArray(core::log::Logger& log, ResourceManager& manager, UploadBatcher& uploader, core::u32 layers, core::u32 resolution)
+        : log(log), manager(manager), uploader(uploader), resolution(resolution), layers(layers), lastUse(layers, 0)
+    {
+        image = manager.createImageArray(resolution, resolution, layers);
+        if(!image.has_value()) {
+            logError("could not create a (%u) layer heightmap array", layers);
+            return;
+        }
+        logInfo("created a (%u) layer, (%ux%u) heightmap array", layers, resolution, resolution);
+    }
+
+    // freed once the frames in flight are done sampling it, uploads into it must have been submitted
+    ~HeightmapArray() {
+        if(image.has_value()) {
+            manager.destroyImage(*image);
+        }
+    }
+
+    HeightmapArray(const HeightmapArray&) = delete;
+    HeightmapArray& operator=(const HeightmapArray&) = delete;
+    HeightmapArray(HeightmapArray&&) = delete;
+    HeightmapArray& operator=(HeightmapArray&&) = delete;
+
+    bool valid() const noexcept {
+        return image.has_value();
+    }
+
+    // bound once as a sampled 2D array for all of the visible terrain
+    ImageHandle getImage() const noexcept {
+        return *image;
+    }
+
+    VkImageView getView() const noexcept {
+        return manager.getImage(*image)->view;
+    }
+
+    core::u32 getLayerCount() const noexcept {
+        return layers;
+    }
+
+    core::u32 getResolution() const noexcept {
+        return resolution;
+    }
+
+    // the frame submitted with value samples layer (see Commander::getSubmitValue)
+    void markUsed(core::u32 layer, core::u64 value) noexcept {
+        if(layer < layers) {
+            lastUse[layer] = std::max(lastUse[layer], value);
+        }
+    }
+
+    // a frame up to completedValue freed the layer's previous chunk, it can be overwritten
+    bool isFree(core::u32 layer, core::u64 completedValue) const noexcept {
+        return layer < layers && lastUse[layer] <= completedValue;
+    }
+
+    // stage a chunk's heights into the layer of its pool slot, copied on the uploader's next flush
+    // false, and nothing staged, while frames in flight may still sample the layer's previous chunk
+    // (completedValue: the graphics Commander's getCompletedValue), retry once they completed
+    bool upload(core::u32 layer, std::span<const core::i16> heights, core::u64 completedValue) noexcept {
+        if(!valid()) {
+            return false;
+        }
+        if(layer >= layers) {
+            logError("heightmap layer (%u) out of range, (%u) layers", layer, layers);
+            return false;
+        }
+        if(heights.size() != static_cast<std::size_t>(resolution) * resolution) {
+            logError("heightmap upload of (%lu) samples, expected (%u)", heights.size(), resolution * resolution);
+            return false;
+        }
+        if(!isFree(layer, completedValue)) {
+            logDebug("heightmap layer (%u) still sampled until (%lu), (%lu) completed", layer, lastUse[layer], completedValue);
+            return false;
+        }
+        return uploader.upload(*image, heights.data(), heights.size_bytes(), resolution, resolution, layer);
+    }
+
+private:
+    // log convenience
+    template<typename... Args>
+    void logError(const char* msg, Args... args) const noexcept {
+        log.error("gfx/vulkan/heightmaps", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logDebug(const char* msg, Args... args) const noexcept {
+        log.debug("gfx/vulkan/heightmaps", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logInfo(const char* msg, Args... args) const noexcept {
+        log.info("gfx/vulkan/heightmaps", msg, std::forward<Args>(args)...);
+    }
+};
+
+}
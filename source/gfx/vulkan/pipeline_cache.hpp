@@ -0,0 +1,177 @@
+// pipeline_cache.hpp: RAII owner for a VkPipelineCache persisted to disk between runs
+//     the saved data is only handed back to the driver if its header matches this device's vendor,
+//     device and pipelineCacheUUID, anything else (other GPU, driver update, truncated file) starts empty
+//     vulkan pipeline caches are internally synchronized, so pipelines may be built against one from many threads
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "core/log/logging.hpp"
+
+// set by the build (DEUS_PIPELINE_CACHE_PATH in CMakeLists.txt)
+#if !defined(DEUS_PIPELINE_CACHE_PATH)
+#define DEUS_PIPELINE_CACHE_PATH "./build/pipeline.cache"
+#endif
+constexpr const char* PIPELINE_CACHE_PATH{ DEUS_PIPELINE_CACHE_PATH };
+
+namespace gfx::vulkan {
+
+class PipelineCache {
+    core::log::Logger& log;
+    const VkDevice device;
+    const VkPhysicalDeviceProperties properties;
+    const std::string filepath;
+
+    VkPipelineCache cache{ VK_NULL_HANDLE };
+
+public:
+    PipelineCache(core::log::Logger& log, VkDevice device, const VkPhysicalDeviceProperties& properties,
+        std::string filepath = PIPELINE_CACHE_PATH)
+        : log(log), device(device), properties(properties), filepath(std::move(filepath))
+    {
+        std::vector<char> data = readCacheData();
+        if(!data.empty() && !matchesDevice(data)) {
+            logInfo("discarding pipeline cache '%s' built for another device or driver", this->filepath.c_str());
+            data.clear();
+        }
+
+        VkPipelineCacheCreateInfo createInfo {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .initialDataSize = data.size(),
+            .pInitialData = data.empty() ? nullptr : data.data()
+        };
+        VkResult result = vkCreatePipelineCache(
+            device,
+            &createInfo,
+            nullptr,
+            &cache
+        );
+        if(result != VK_SUCCESS && !data.empty()) {
+            // the driver rejected data that passed the header check, start over empty
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData = nullptr;
+            data.clear();
+            result = vkCreatePipelineCache(device, &createInfo, nullptr, &cache);
+        }
+        if(result != VK_SUCCESS) {
+            cache = VK_NULL_HANDLE;
+            logError("could not create a pipeline cache");
+            return;
+        }
+        logInfo("created a pipeline cache, (%zu) bytes loaded from '%s'", data.size(), this->filepath.c_str());
+    }
+
+    ~PipelineCache() {
+        if(cache == VK_NULL_HANDLE) {
+            return;
+        }
+        save();
+        vkDestroyPipelineCache(
+            device,
+            cache,
+            nullptr
+        );
+        logInfo("destroyed a pipeline cache");
+    }
+
+    PipelineCache(const PipelineCache&) = delete;
+    PipelineCache& operator=(const PipelineCache&) = delete;
+    PipelineCache(PipelineCache&&) = delete;
+    PipelineCache& operator=(PipelineCache&&) = delete;
+
+    // VK_NULL_HANDLE if creation failed, which pipeline creation accepts as no cache
+    VkPipelineCache get() const noexcept {
+        return cache;
+    }
+
+    // write the cache out, through a temporary file so a crash mid-write never leaves a torn cache
+    bool save() const noexcept {
+        if(cache == VK_NULL_HANDLE) {
+            return false;
+        }
+        std::size_t bytes = 0;
+        if(vkGetPipelineCacheData(device, cache, &bytes, nullptr) != VK_SUCCESS || bytes == 0) {
+            logError("could not size pipeline cache data");
+            return false;
+        }
+        std::vector<char> data(bytes);
+        if(vkGetPipelineCacheData(device, cache, &bytes, data.data()) != VK_SUCCESS) {
+            logError("could not read pipeline cache data");
+            return false;
+        }
+
+        const std::string temporary = filepath + ".tmp";
+        std::FILE* file = std::fopen(temporary.c_str(), "wb");
+        if(file == nullptr) {
+            logError("could not open '%s' to save the pipeline cache", temporary.c_str());
+            return false;
+        }
+        const bool written = std::fwrite(data.data(), 1, bytes, file) == bytes;
+        if(std::fclose(file) != 0 || !written || std::rename(temporary.c_str(), filepath.c_str()) != 0) {
+            logError("could not save the pipeline cache to '%s'", filepath.c_str());
+            std::remove(temporary.c_str());
+            return false;
+        }
+        logInfo("saved (%zu) bytes of pipeline cache to '%s'", bytes, filepath.c_str());
+        return true;
+    }
+
+private:
+    std::vector<char> readCacheData() const noexcept {
+        std::vector<char> data{};
+        std::FILE* file = std::fopen(filepath.c_str(), "rb");
+        if(file == nullptr) {
+            // first run, nothing saved yet
+            return data;
+        }
+        if(std::fseek(file, 0, SEEK_END) == 0) {
+            const long bytes = std::ftell(file);
+            if(bytes > 0 && std::fseek(file, 0, SEEK_SET) == 0) {
+                data.resize(static_cast<std::size_t>(bytes));
+                if(std::fread(data.data(), 1, data.size(), file) != data.size()) {
+                    logError("could not read the pipeline cache from '%s'", filepath.c_str());
+                    data.clear();
+                }
+            }
+        }
+        std::fclose(file);
+        return data;
+    }
+
+    // the header every VkPipelineCache's data starts with, see VkPipelineCacheHeaderVersionOne
+    bool matchesDevice(const std::vector<char>& data) const noexcept {
+        VkPipelineCacheHeaderVersionOne header{};
+        if(data.size() < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        return header.headerSize >= sizeof(header)
+            && header.headerSize <= data.size()
+            && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+            && header.vendorID == properties.vendorID
+            && header.deviceID == properties.deviceID
+            && std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    }
+
+    // log convenience
+    template<typename... Args>
+    void logError(const char* msg, Args... args) const noexcept {
+        log.error("gfx/vulkan/pipeline_cache", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logInfo(const char* msg, Args... args) const noexcept {
+        log.info("gfx/vulkan/pipeline_cache", msg, std::forward<Args>(args)...);
+    }
+};
+
+}
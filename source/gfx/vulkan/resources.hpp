@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <deque>
 #include <optional>
 #include <vector>
 
@@ -10,10 +11,14 @@
 #include "vk_mem_alloc.h"
 
 #include "core/log/logging.hpp"
+#include "core/retire_queue.hpp"
+#include "core/slot_map.hpp"
 #include "gfx/vulkan/config.hpp"
 
 namespace gfx::vulkan {
 
+// handle ids are SlotMap ids: a destroyed resource's handles go stale rather than alias whatever
+// reuses its slot, 0 is never a valid id
 struct BufferHandle {
     std::size_t id{ 0 };
 };
@@ -42,6 +47,14 @@ struct Image {
     VkImageLayout  currentLayout{VK_IMAGE_LAYOUT_UNDEFINED}; // Track transitions
 };
 
+// a region of the staging ring, writable through pMapped until it is retired
+struct StagingAllocation {
+    BufferHandle buffer{};
+    VkDeviceSize offset{ 0 };
+    VkDeviceSize size{ 0 };
+    std::byte* pMapped{ nullptr };
+};
+
 // lacking a fitting name
 class ResourceManager {
     const Configurator& config;
@@ -49,37 +62,107 @@ class ResourceManager {
     const VkDevice device;
     core::log::Logger& log;
 
-    std::vector<Buffer> buffers{};
-    std::vector<Image> images{};
+    core::SlotMap<Buffer> buffers{};
+    core::SlotMap<Image> images{};
+
+    // destroyed resources frames in flight may still be using, freed once their retire value completes
+    // same scheme as the staging ring: released -> retireReleased(value) -> reclaimReleased(completed)
+    struct Released {
+        std::optional<Buffer> buffer{};
+        std::optional<Image> image{};
+    };
+    core::RetireQueue<Released> released{};
+
+    // persistently mapped ring that every CPU -> GPU upload is staged through
+    // positions grow monotonically and wrap modulo the capacity, the GPU may still be reading
+    // [stagingTail, stagingHead)
+    std::optional<BufferHandle> stagingRing{};
+    std::byte* stagingMapped{ nullptr };
+    VkDeviceSize stagingCapacity{ 0 };
+    VkDeviceSize stagingHead{ 0 };
+    VkDeviceSize stagingTail{ 0 };
+    // regions handed out before a retireStaging(value) call, freed once value has completed
+    struct StagingRetirement {
+        VkDeviceSize end{ 0 };
+        core::u64 value{ 0 };
+    };
+    std::deque<StagingRetirement> stagingInUse{};
 
 public:
     ResourceManager(const Configurator& config, const VmaAllocator& allocator, const VkDevice& device, core::log::Logger& log)
         : config(config), allocator(allocator), device(device), log(log)
     {}
 
+    // the device must be idle: released resources go too, retired or not
     ~ResourceManager() {
+        released.drain([&](Released& r) {
+            destroyReleased(r);
+        });
         destroyBuffers();
         destroyImages();
     }
 
-    std::optional<Buffer> getBuffer(BufferHandle handle) const noexcept {
-        std::optional<Buffer> result{};
-        if(handle.id >= buffers.size()) {
-            logError("attempt to fetch buffer with array index (%lu) when only (%lu) buffers exist", handle.id, buffers.size());
-            return result;
+    // nullptr for a destroyed (or never created) buffer, valid until the buffer is destroyed
+    const Buffer* getBuffer(BufferHandle handle) const noexcept {
+        const Buffer* buffer = buffers.get(handle.id);
+        if(buffer == nullptr) {
+            logError("attempt to fetch stale or unknown buffer (%lu), (%lu) buffers exist", handle.id, buffers.size());
         }
-        result.emplace(buffers[handle.id]);
-        return result;
+        return buffer;
     }
 
-    std::optional<Image> getImage(ImageHandle handle) const noexcept {
-        std::optional<Image> result{};
-        if(handle.id >= images.size()) {
-            logError("attempt to fetch image with array index (%lu) when only (%lu) buffers exist", handle.id, buffers.size());
-            return result;
+    // nullptr for a destroyed (or never created) image, valid until the image is destroyed
+    const Image* getImage(ImageHandle handle) const noexcept {
+        const Image* image = images.get(handle.id);
+        if(image == nullptr) {
+            logError("attempt to fetch stale or unknown image (%lu), (%lu) images exist", handle.id, images.size());
         }
-        result.emplace(images[handle.id]);
-        return result;
+        return image;
+    }
+
+    std::size_t getBufferCount() const noexcept {
+        return buffers.size();
+    }
+
+    std::size_t getImageCount() const noexcept {
+        return images.size();
+    }
+
+    // handles go stale now, the memory is freed once the frames that may still use it complete
+    // (see retireReleased), transfers feeding a frame complete before it does
+    bool destroyBuffer(BufferHandle handle) noexcept {
+        std::optional<Buffer> buffer = buffers.take(handle.id);
+        if(!buffer.has_value()) {
+            logError("attempt to destroy stale or unknown buffer (%lu)", handle.id);
+            return false;
+        }
+        released.release({ .buffer = std::move(buffer), .image = std::nullopt });
+        logDebug("released buffer (%lu)", handle.id);
+        return true;
+    }
+
+    bool destroyImage(ImageHandle handle) noexcept {
+        std::optional<Image> image = images.take(handle.id);
+        if(!image.has_value()) {
+            logError("attempt to destroy stale or unknown image (%lu)", handle.id);
+            return false;
+        }
+        released.release({ .buffer = std::nullopt, .image = std::move(image) });
+        logDebug("released image (%lu)", handle.id);
+        return true;
+    }
+
+    // everything destroyed since the last retire may be in use until value completes
+    // values must not decrease, e.g. the next Commander submit value
+    void retireReleased(core::u64 value) noexcept {
+        released.retire(value);
+    }
+
+    // free every retired resource whose value has completed
+    void reclaimReleased(core::u64 completedValue) noexcept {
+        released.reclaim(completedValue, [&](Released& r) {
+            destroyReleased(r);
+        });
     }
 
     // creates a device local buffer (not host visible, needs staging upload)
@@ -100,6 +183,24 @@ public:
         return createBuffer(sizeBytes, bufferCreateInfo, allocCreateInfo);
     }
 
+    // creates a device local index buffer (not host visible, needs staging upload)
+    std::optional<BufferHandle> createDeviceLocalIndexBuffer(std::size_t sizeBytes) noexcept {
+        const VkBufferCreateInfo bufferCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .size = sizeBytes,
+            .usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr
+        };
+        VmaAllocationCreateInfo allocCreateInfo {
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+        };
+        return createBuffer(sizeBytes, bufferCreateInfo, allocCreateInfo);
+    }
+
     std::optional<BufferHandle> createMappedVertexBuffer(std::size_t sizeBytes) noexcept {
         const VkBufferCreateInfo bufferCreateInfo {
             .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -118,6 +219,44 @@ public:
         return createBuffer(sizeBytes, bufferCreateInfo, allocCreateInfo);
     }
 
+    // creates a device local storage buffer written by compute, extraUsage: how it is read back
+    // (vertex input, indirect draws)
+    std::optional<BufferHandle> createDeviceLocalStorageBuffer(std::size_t sizeBytes, VkBufferUsageFlags extraUsage) noexcept {
+        const VkBufferCreateInfo bufferCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .size = sizeBytes,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | extraUsage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr
+        };
+        VmaAllocationCreateInfo allocCreateInfo {
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+        };
+        return createBuffer(sizeBytes, bufferCreateInfo, allocCreateInfo);
+    }
+
+    // creates a host-visible mapped storage buffer: written by the CPU every frame, read by compute
+    std::optional<BufferHandle> createMappedStorageBuffer(std::size_t sizeBytes) noexcept {
+        const VkBufferCreateInfo bufferCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .size = sizeBytes,
+            .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr
+        };
+        VmaAllocationCreateInfo allocCreateInfo {
+            .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+        };
+        return createBuffer(sizeBytes, bufferCreateInfo, allocCreateInfo);
+    }
+
     // creates a host-visible mapped buffer: used for staging an upload
     std::optional<BufferHandle> createStagingBuffer(core::u32 sizeBytes) noexcept {
         const VkBufferCreateInfo bufferCreateInfo {
@@ -137,7 +276,165 @@ public:
         return createBuffer(sizeBytes, bufferCreateInfo, allocCreateInfo);
     }
 
+    // creates a host-visible mapped buffer a frame bump-allocates its transient data from:
+    // uniforms, storage, vertex/index data and staging copies that live for one frame only
+    std::optional<BufferHandle> createTransientBuffer(std::size_t sizeBytes) noexcept {
+        const VkBufferCreateInfo bufferCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .size = sizeBytes,
+            .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+                | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr
+        };
+        VmaAllocationCreateInfo allocCreateInfo {
+            .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+        };
+        return createBuffer(sizeBytes, bufferCreateInfo, allocCreateInfo);
+    }
+
     std::optional<ImageHandle> createImage(core::u32 width, core::u32 height, core::u32 depth) noexcept {
+        return createImage2D(width, height, 1, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R16_SINT,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    // one allocation and one 2D array view over layers equally sized images
+    std::optional<ImageHandle> createImageArray(core::u32 width, core::u32 height, core::u32 layers) noexcept {
+        return createImage2D(width, height, layers, VK_IMAGE_VIEW_TYPE_2D_ARRAY, VK_FORMAT_R16_SINT,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+    }
+
+    // depth attachment of a render pass, format: a depth (or depth/stencil) format the device can attach
+    std::optional<ImageHandle> createDepthImage(core::u32 width, core::u32 height, VkFormat format) noexcept {
+        // an attachment view of a combined format covers both of its aspects
+        const bool stencil = format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT
+            || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+        return createImage2D(width, height, 1, VK_IMAGE_VIEW_TYPE_2D, format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+            VK_IMAGE_ASPECT_DEPTH_BIT | (stencil ? VK_IMAGE_ASPECT_STENCIL_BIT : 0));
+    }
+
+    // create the staging ring, once: upload memory stays bounded by its capacity
+    bool createStagingRing(VkDeviceSize capacity) noexcept {
+        if(stagingRing.has_value()) {
+            return true;
+        }
+        const VkBufferCreateInfo bufferCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .size = capacity,
+            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices = nullptr
+        };
+        VmaAllocationCreateInfo allocCreateInfo {
+            .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST
+        };
+        stagingRing = createBuffer(capacity, bufferCreateInfo, allocCreateInfo);
+        if(!stagingRing.has_value()) {
+            logError("could not create a (%lu) byte staging ring", capacity);
+            return false;
+        }
+        stagingMapped = static_cast<std::byte*>(buffers.get(stagingRing->id)->allocationInfo.pMappedData);
+        stagingCapacity = capacity;
+        logInfo("created a (%lu) byte staging ring", capacity);
+        return true;
+    }
+
+    // carve an aligned region out of the staging ring, nullopt if the GPU still owns the space
+    // regions never straddle the end of the ring
+    std::optional<StagingAllocation> allocateStaging(VkDeviceSize size, VkDeviceSize alignment) noexcept {
+        if(!stagingRing.has_value() || size > stagingCapacity) {
+            return std::nullopt;
+        }
+        VkDeviceSize begin = (stagingHead + alignment - 1) & ~(alignment - 1);
+        // would wrap: skip to the start of the next lap
+        if(begin % stagingCapacity + size > stagingCapacity) {
+            begin = (begin / stagingCapacity + 1) * stagingCapacity;
+        }
+        if(begin + size - stagingTail > stagingCapacity) {
+            return std::nullopt;
+        }
+        stagingHead = begin + size;
+
+        const VkDeviceSize offset = begin % stagingCapacity;
+        return StagingAllocation {
+            .buffer = *stagingRing,
+            .offset = offset,
+            .size = size,
+            .pMapped = stagingMapped + offset
+        };
+    }
+
+    // everything allocated since the last retire is in use until value completes
+    // values must not decrease, 0 is already complete
+    void retireStaging(core::u64 value) noexcept {
+        if(!stagingInUse.empty() && stagingInUse.back().end == stagingHead) {
+            return;
+        }
+        stagingInUse.push_back({ .end = stagingHead, .value = value });
+    }
+
+    // free every retired region whose value has completed
+    void reclaimStaging(core::u64 completedValue) noexcept {
+        while(!stagingInUse.empty() && stagingInUse.front().value <= completedValue) {
+            stagingTail = stagingInUse.front().end;
+            stagingInUse.pop_front();
+        }
+    }
+
+    // value to wait on before the oldest retired region can be reclaimed
+    std::optional<core::u64> getOldestStagingRetirement() const noexcept {
+        if(stagingInUse.empty()) {
+            return std::nullopt;
+        }
+        return stagingInUse.front().value;
+    }
+
+    VkDeviceSize getStagingCapacity() const noexcept {
+        return stagingCapacity;
+    }
+
+    // bytes the GPU may still be reading, plus any not yet retired
+    VkDeviceSize getStagingInUse() const noexcept {
+        return stagingHead - stagingTail;
+    }
+
+    // make host writes to a mapped buffer range visible to the device (no-op on coherent memory)
+    bool flushBuffer(BufferHandle handle, VkDeviceSize offset, VkDeviceSize size) noexcept {
+        const Buffer* buffer = buffers.get(handle.id);
+        if(buffer == nullptr) {
+            logError("attempt to flush stale or unknown buffer (%lu)", handle.id);
+            return false;
+        }
+        VkResult result = vmaFlushAllocation(allocator, buffer->allocation, offset, size);
+        if(result != VK_SUCCESS) {
+            logError("could not flush buffer (%lu)", handle.id);
+            return false;
+        }
+        return true;
+    }
+
+    bool updateImageLayout(ImageHandle handle, VkImageLayout layout) noexcept {
+        Image* image = images.get(handle.id);
+        if(image == nullptr) {
+            logError("attempt to fetch stale or unknown image (%lu)", handle.id);
+            return false;
+        }
+        image->currentLayout = layout;
+        return true;
+    }
+
+private:
+    std::optional<ImageHandle> createImage2D(core::u32 width, core::u32 height, core::u32 layers, VkImageViewType viewType,
+        VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspect) noexcept
+    {
         std::optional<ImageHandle> resultImage{};
 
         VkExtent3D extent{ width, height, 1 };
@@ -146,13 +443,13 @@ public:
             .pNext = nullptr,
             .flags = 0,
             .imageType = VK_IMAGE_TYPE_2D,
-            .format = VK_FORMAT_R16_SINT,
+            .format = format,
             .extent = VkExtent3D{ width, height, 1},
             .mipLevels = 1,
-            .arrayLayers = 1,
+            .arrayLayers = layers,
             .samples = VK_SAMPLE_COUNT_1_BIT,
             .tiling = VK_IMAGE_TILING_OPTIMAL,
-            .usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            .usage = usage,
             .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
             .queueFamilyIndexCount = 0,
             .pQueueFamilyIndices = nullptr,
@@ -172,19 +469,19 @@ public:
 
         // though an image view is a derived object, we return it from the resource manager
         VkImageSubresourceRange subRange {
-            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .aspectMask = aspect,
             .baseMipLevel = 0,
             .levelCount = 1,
             .baseArrayLayer = 0,
-            .layerCount = 1
+            .layerCount = layers
         };
         VkImageViewCreateInfo viewCreateInfo {
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             .pNext = nullptr,
             .flags = 0,
             .image = vulkanImage,
-            .viewType = VK_IMAGE_VIEW_TYPE_2D,
-            .format = VK_FORMAT_R16_SINT,
+            .viewType = viewType,
+            .format = format,
             .subresourceRange = subRange
         };
         VkImageView imageView{};
@@ -196,34 +493,27 @@ public:
         );
         if(result != VK_SUCCESS) {
             logError("could not create image view");
+            vmaDestroyImage(allocator, vulkanImage, allocation);
             return resultImage;
         }
 
         Image image {
             .image = vulkanImage,
             .allocation = allocation,
-            .view = imageView
+            .view = imageView,
+            .format = format,
+            .extent = extent,
+            .arrayLayers = layers
         };
         ImageHandle handle {
-            .id = images.size()
+            .id = images.insert(image)
         };
-        images.push_back(image);
 
         resultImage.emplace(handle);
-        logInfo("created a new image (%lu) and view", handle.id);
+        logInfo("created a new image (%lu) with (%u) layers and view", handle.id, layers);
         return resultImage;
     }
 
-    bool updateImageLayout(ImageHandle handle, VkImageLayout layout) noexcept {
-        if(handle.id >= images.size()) {
-            logError("attempt to fetch image with array index (%lu) when only (%lu) buffers exist", handle.id, buffers.size());
-            return false;
-        }
-        images[handle.id].currentLayout = layout;
-        return true;
-    }
-
-private:
     std::optional<BufferHandle> createBuffer(std::size_t sizeBytes, const VkBufferCreateInfo& bufferCreateInfo,
         const VmaAllocationCreateInfo& allocCreateInfo) noexcept
     {
@@ -240,36 +530,42 @@ private:
             return std::nullopt;
         }
 
-        handle.emplace(buffers.size());
-        buffers.push_back({
+        handle.emplace(buffers.insert({
             .buffer = buffer,
             .allocation = allocation,
             .allocationInfo = allocationInfo,
             .size = sizeBytes
-        });
+        }));
 
-        logInfo("created a new buffer (%lu)", *handle);
+        logInfo("created a new buffer (%lu)", handle->id);
         return handle;
     }
-    void destroyBuffers() noexcept {
-        for(std::size_t i = 0; i < buffers.size(); ++i) {
-            vmaDestroyBuffer(allocator, buffers[i].buffer, buffers[i].allocation);
+    void destroyReleased(Released& r) noexcept {
+        if(r.buffer.has_value()) {
+            vmaDestroyBuffer(allocator, r.buffer->buffer, r.buffer->allocation);
+        }
+        if(r.image.has_value()) {
+            vkDestroyImageView(device, r.image->view, nullptr);
+            vmaDestroyImage(allocator, r.image->image, r.image->allocation);
         }
+    }
+
+    void destroyBuffers() noexcept {
+        buffers.forEach([&](Buffer& buffer) {
+            vmaDestroyBuffer(allocator, buffer.buffer, buffer.allocation);
+        });
 
-        buffers.resize(0);
+        buffers.clear();
         logInfo("destroyed all buffers");
     }
     void destroyImages() noexcept {
         // destroy image views first
-        for(std::size_t i = 0; i < images.size(); ++i) {
-            vkDestroyImageView(device, images[i].view, nullptr);
-        }
-
-        for(std::size_t i = 0; i < images.size(); ++i) {
-            vmaDestroyImage(allocator, images[i].image, images[i].allocation);
-        }
+        images.forEach([&](Image& image) {
+            vkDestroyImageView(device, image.view, nullptr);
+            vmaDestroyImage(allocator, image.image, image.allocation);
+        });
 
-        images.resize(0);
+        images.clear();
         logInfo("destroyed all images");
     }
     // log convenience
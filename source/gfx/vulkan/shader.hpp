@@ -1,8 +1,13 @@
 // shader.hpp: define shader objects, initialized with precompiled SPIR-V shader source filenames
+//     and a ShaderCache that keeps one module per file for pipelines built (and rebuilt) from them
 #pragma once
 
-#include <string>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <vulkan/vulkan_core.h>
 
@@ -98,4 +103,32 @@ private:
     }
 };
 
+// modules are read and created on first use, then live as long as the cache, so pipelines recreated
+// with the swapchain don't go back to disk; safe to call from pipeline build threads
+class ShaderCache {
+    core::log::Logger& log;
+    const VkDevice device;
+
+    std::mutex mutex{};
+    std::unordered_map<std::string, std::unique_ptr<Shader>> shaders{};
+
+public:
+    ShaderCache(core::log::Logger& log, VkDevice device)
+        : log(log), device(device)
+    {}
+
+    ShaderCache(const ShaderCache&) = delete;
+    ShaderCache& operator=(const ShaderCache&) = delete;
+
+    // VK_NULL_HANDLE if the file couldn't be read or its module created, which is not retried
+    VkShaderModule get(const std::string& filename) {
+        std::lock_guard lock(mutex);
+        auto it = shaders.find(filename);
+        if(it == shaders.end()) {
+            it = shaders.emplace(filename, std::make_unique<Shader>(log, device, filename)).first;
+        }
+        return it->second->get();
+    }
+};
+
 };
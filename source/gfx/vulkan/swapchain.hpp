@@ -1,14 +1,56 @@
+// swapchain.hpp: defines the SwapchainManager, the swapchain and what renders into its images
+//     (views, a depth buffer, the render pass, framebuffers, per image submit semaphores), created to a
+//     SwapchainRequest: a present mode policy picked from what the surface supports, and an image count
+//     recreation hands the old swapchain to the new one and retires what belonged to it until the
+//     frames that used it complete, instead of idling the device
 #pragma once
 
 #include <vulkan/vulkan_core.h>
 
 #include "core/log/logging.hpp"
+#include "core/retire_queue.hpp"
 #include "gfx/vulkan/config.hpp"
+#include "gfx/vulkan/resources.hpp"
 
+#include <algorithm>
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace gfx::vulkan {
 
+// present modes in order of preference, FIFO (always supported) is the last resort of every policy
+enum class PresentPolicy : core::u32 {
+    // FIFO: vsync, every frame shown, latency of the queued images
+    Vsync = 0,
+    // FIFO_RELAXED: vsync, a late frame tears in instead of waiting another refresh
+    Relaxed = 1,
+    // MAILBOX then IMMEDIATE: newest frame replaces a queued one, no tearing, rendering never blocks on vsync
+    LowLatency = 2,
+    // IMMEDIATE then MAILBOX: frames shown as soon as they are done, tears
+    Immediate = 3
+};
+
+inline const char* presentModeName(VkPresentModeKHR mode) noexcept {
+    switch(mode) {
+        case VK_PRESENT_MODE_IMMEDIATE_KHR:
+            return "immediate";
+        case VK_PRESENT_MODE_MAILBOX_KHR:
+            return "mailbox";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+            return "fifo relaxed";
+        default:
+            return "fifo";
+    }
+}
+
+struct SwapchainRequest {
+    PresentPolicy presentPolicy{ PresentPolicy::LowLatency };
+    // clamped to the surface's limits, 0: one more than the surface's minimum, so acquiring never
+    // waits on the presentation engine holding onto all but one image
+    core::u32 imageCount{ 0 };
+};
+
 struct SwapchainSupport {
     VkSurfaceCapabilitiesKHR caps{};
     std::vector<VkSurfaceFormatKHR> formats{};
@@ -22,38 +64,236 @@ class SwapchainManager {
     const PhysicalDeviceHandle physicalDeviceHandle;
     const VkPhysicalDevice physicalDevice;
     const VkDevice vulkanDevice;
+    // owns the depth buffer, and frees it once the frames that rendered into it complete
+    ResourceManager& manager;
+    SwapchainRequest request{};
     // currently acquiring/presenting from
-    VkSwapchainKHR active{};
+    VkSwapchainKHR active{ VK_NULL_HANDLE };
+    VkPresentModeKHR presentMode{ VK_PRESENT_MODE_FIFO_KHR };
     VkExtent2D extent{};
     VkFormat format{};
     std::vector<VkImage> images{};
     std::vector<VkImageView> views{};
+    // one depth buffer at the swapchain's extent, shared by every image: frames that render into it
+    // are ordered by the render pass' dependency
+    VkFormat depthFormat{ VK_FORMAT_UNDEFINED };
+    std::optional<ImageHandle> depth{};
     VkRenderPass renderPass{};
     std::vector<VkFramebuffer> framebuffers{};
-    // semaphores for swapchain image availability and submission
-    // note: does not need to be recreated when recreating a swapchain
-    // note: need as many acquire semaphores as we do in-flight frames
-    VkSemaphore acquire{};
+    // semaphores for swapchain image submission, one per image
+    // note: image acquire semaphores live with the frames in flight (see Commander)
     std::vector<VkSemaphore> submit{};
+    // set when acquire or present report the swapchain no longer matches the surface
+    bool stale{ false };
+
+    // a replaced swapchain, and everything created for its images, destroyed once its retire value completes
+    struct Retired {
+        VkSwapchainKHR swapchain{ VK_NULL_HANDLE };
+        std::vector<VkImageView> views{};
+        std::vector<VkFramebuffer> framebuffers{};
+        std::vector<VkSemaphore> submit{};
+    };
+    core::RetireQueue<Retired> retired{};
 
 public:
-    SwapchainManager(core::log::Logger& log, const Configurator& config, PhysicalDeviceHandle handle, VkDevice vulkanDevice)
+    SwapchainManager(core::log::Logger& log, const Configurator& config, PhysicalDeviceHandle handle, VkDevice vulkanDevice,
+        ResourceManager& manager)
         : log(log), config(config), physicalDeviceHandle(handle), physicalDevice(*config.getVulkanPhysicalDevice(handle)),
-          vulkanDevice(vulkanDevice)
+          vulkanDevice(vulkanDevice), manager(manager)
     {}
 
     ~SwapchainManager() {
         vkDeviceWaitIdle(vulkanDevice);
+        retired.drain([&](Retired& r) {
+            destroyRetired(r);
+        });
         destroySemaphores();
         destroyFramebuffers();
         destroyRenderPass();
+        destroyDepth();
         destroySwapchainImageViews();
         destroySwapchain();
     }
 
-    // happens on application startup / window creation as well as resizing
+    // happens on application startup / window creation, the request is kept for recreations
     // returns true if the new swapchain is valid
-    bool createSwapchain(uint32_t queueGraphicsFamily, VkSurfaceKHR surface) noexcept {
+    bool createSwapchain(uint32_t queueGraphicsFamily, VkSurfaceKHR surface, const SwapchainRequest& swapchainRequest = {}) noexcept {
+        request = swapchainRequest;
+        return build(queueGraphicsFamily, surface, VK_NULL_HANDLE);
+    }
+
+    // on resizing, or once acquire or present reported the swapchain stale
+    // the old swapchain (and its views, framebuffers and semaphores) are destroyed by reclaimRetired
+    // once retireValue completes, e.g. the last Commander submit value, and its depth buffer goes to the
+    // ResourceManager's release queue; the render pass, and so pipelines built against it, survive
+    // unless the surface format changes
+    // note: returns false without a swapchain while the surface has no area (minimized), try again later
+    bool recreateSwapchain(uint32_t queueFamilyIndex, VkSurfaceKHR surface, core::u64 retireValue) noexcept {
+        std::optional<SwapchainSupport> optSupport = getSwapchainSupport(queueFamilyIndex, surface);
+        if(!optSupport.has_value()) {
+            logError("could not recreate swapchain: no support for presenting");
+            return false;
+        }
+        if(optSupport->caps.currentExtent.width == 0 || optSupport->caps.currentExtent.height == 0) {
+            logDebug("surface has no area, not recreating the swapchain yet");
+            return false;
+        }
+
+        // the old swapchain is retired by the create call, whether it succeeds or not
+        const VkSwapchainKHR old = active;
+        retired.release({
+            .swapchain = old,
+            .views = std::move(views),
+            .framebuffers = std::move(framebuffers),
+            .submit = std::move(submit)
+        });
+        retired.retire(retireValue);
+        // retired with the next ResourceManager::retireReleased, after every frame that rendered into it
+        destroyDepth();
+        active = VK_NULL_HANDLE;
+        views.clear();
+        framebuffers.clear();
+        submit.clear();
+        images.clear();
+        return build(queueFamilyIndex, surface, old);
+    }
+
+    // destroy every retired swapchain whose frames have completed
+    void reclaimRetired(core::u64 completedValue) noexcept {
+        retired.reclaim(completedValue, [&](Retired& r) {
+            destroyRetired(r);
+        });
+    }
+
+    bool valid() const noexcept {
+        return active != VK_NULL_HANDLE && !framebuffers.empty();
+    }
+
+    // acquire or present found the swapchain out of date, or suboptimal, for the surface
+    bool isStale() const noexcept {
+        return stale;
+    }
+
+    void markStale() noexcept {
+        stale = true;
+    }
+
+    VkPresentModeKHR getPresentMode() const noexcept {
+        return presentMode;
+    }
+
+    // present or acquire result: tracks whether the swapchain needs recreating
+    // returns false if the result is an error other than the swapchain going stale
+    bool checkResult(VkResult result) noexcept {
+        if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            stale = true;
+            return true;
+        }
+        return result == VK_SUCCESS;
+    }
+
+    VkRenderPass getRenderPass() const noexcept {
+        return renderPass;
+    }
+
+    std::vector<VkFramebuffer> getFramebuffers() const noexcept {
+        return framebuffers;
+    }
+
+    VkExtent2D getExtent() const noexcept {
+        return extent;
+    }
+
+    // query a physical device for swapchain capabilities, formats, and present modes for a specified surface and queueFamilyIndex
+    std::optional<SwapchainSupport> getSwapchainSupport(uint32_t queueFamilyIndex, VkSurfaceKHR surface) const noexcept {
+        std::optional<SwapchainSupport> support{};
+
+        VkBool32 presentOK{false};
+        VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(
+            physicalDevice,
+            queueFamilyIndex,
+            surface,
+            &presentOK
+        );
+
+        if(result != VK_SUCCESS) {
+            logError("could not query physical device for (%lu) presentation support", physicalDeviceHandle.id);
+            return support;
+        }
+        if(presentOK == false) {
+            logInfo("queueFamilyIndex (%lu) does not support presenting to specified surface on physical device (%lu)",
+                queueFamilyIndex, physicalDeviceHandle.id);
+            return support;
+        }
+
+        VkSurfaceCapabilitiesKHR caps{};
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &caps);
+
+        uint32_t formatCount{0};
+        std::vector<VkSurfaceFormatKHR> formats{};
+        result = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, nullptr);
+        if(result != VK_SUCCESS) {
+            logError("could not query physical device (%lu) for specified surface's count of supported color formats", physicalDeviceHandle.id);
+            return support;
+        }
+        formats.resize(formatCount);
+        result = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, formats.data());
+        if(result != VK_SUCCESS) {
+            logError("could not query physical device (%lu) for specified surface's supported color formats", physicalDeviceHandle.id);
+            return support;
+        }
+
+        uint32_t presentCount{0};
+        std::vector<VkPresentModeKHR> modes{};
+        result = vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentCount, nullptr);
+        if(result != VK_SUCCESS) {
+            logError("could not query physical device (%lu) for specified surface's count of supported present modes", physicalDeviceHandle.id);
+            return support;
+        }
+        modes.resize(presentCount);
+        result = vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentCount, modes.data());
+        if(result != VK_SUCCESS) {
+            logError("could not query physical device (%lu) for specified surface's supported present modes", physicalDeviceHandle.id);
+            return support;
+        }
+        support.emplace(caps,formats,modes);
+        return support;
+    }
+
+    // signals imageAvailable, not const
+    // nullopt if no image was acquired (and imageAvailable won't be signaled), e.g. when out of date
+    std::optional<uint32_t> acquireImage(VkSemaphore imageAvailable) noexcept {
+        uint32_t imageIndex{ 0 };
+        VkResult result = vkAcquireNextImageKHR(
+            vulkanDevice,
+            active,
+            UINT64_MAX,
+            imageAvailable,
+            VK_NULL_HANDLE,
+            &imageIndex
+        );
+        // suboptimal still acquired an image, presenting it is fine
+        if(!checkResult(result)) {
+            logError("could not acquire next swapchain image");
+            return std::nullopt;
+        }
+        if(result == VK_ERROR_OUT_OF_DATE_KHR) {
+            logDebug("swapchain out of date on acquire");
+            return std::nullopt;
+        }
+        return imageIndex;
+    }
+
+    VkSwapchainKHR get() const noexcept {
+        return active;
+    }
+
+    VkSemaphore getSubmitSemaphore(uint32_t index) const noexcept {
+        return submit[index];
+    }
+
+private:
+    bool build(uint32_t queueGraphicsFamily, VkSurfaceKHR surface, VkSwapchainKHR oldSwapchain) noexcept {
         std::optional<SwapchainSupport> optSupport = getSwapchainSupport(queueGraphicsFamily, surface);
         if(!optSupport.has_value()) {
             logError("could not acquire swapchain: no support for presenting");
@@ -65,9 +305,17 @@ public:
         extent = support.caps.currentExtent;
         // set format
         // todo: check if the formats we are requesting exist in the support struct
-        VkFormat format = VK_FORMAT_B8G8R8A8_SRGB;
+        const VkFormat previousFormat = format;
+        format = VK_FORMAT_B8G8R8A8_SRGB;
         VkColorSpaceKHR colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
-        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        presentMode = pickPresentMode(support.modes);
+
+        // one more than the minimum unless asked otherwise, maxImageCount 0 is unbounded
+        core::u32 imageCount = request.imageCount != 0 ? request.imageCount : support.caps.minImageCount + 1;
+        imageCount = std::max(imageCount, support.caps.minImageCount);
+        if(support.caps.maxImageCount != 0) {
+            imageCount = std::min(imageCount, support.caps.maxImageCount);
+        }
 
         // create swapchain (move to separate function)
         VkSwapchainCreateInfoKHR createInfo{
@@ -75,7 +323,7 @@ public:
             .pNext = nullptr,
             .flags = 0,
             .surface = surface,
-            .minImageCount = support.caps.minImageCount,
+            .minImageCount = imageCount,
             .imageFormat = format,
             .imageColorSpace = colorSpace,
             .imageExtent = support.caps.currentExtent,
@@ -88,7 +336,7 @@ public:
             .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
             .presentMode = presentMode,
             .clipped = VK_TRUE,
-            .oldSwapchain = VK_NULL_HANDLE
+            .oldSwapchain = oldSwapchain
         };
 
         VkResult result = vkCreateSwapchainKHR(
@@ -100,15 +348,17 @@ public:
 
         if(result != VK_SUCCESS) {
             logError("renderer could not create a swapchain");
+            active = VK_NULL_HANDLE;
             return false;
         }
+        stale = false;
 
         // get image references
         uint32_t imgCount{ 0 };
         vkGetSwapchainImagesKHR(vulkanDevice, active, &imgCount, nullptr);
         images.resize(imgCount);
         vkGetSwapchainImagesKHR(vulkanDevice, active, &imgCount, images.data());
-        logInfo("created a swapchain with (%lu) images", images.size());
+        logInfo("created a (%s) swapchain with (%lu) images", presentModeName(presentMode), images.size());
 
         // create image views
         for(VkImage img: images) {
@@ -145,75 +395,31 @@ public:
         }
         logInfo("created %lu swapchain image views", views.size());
 
-        // create renderpass
-        VkAttachmentDescription color{
-            .flags = 0,
-            .format = format,
-            .samples = VK_SAMPLE_COUNT_1_BIT,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
-        };
-        VkAttachmentReference colorReference {
-            .attachment = 0,
-            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
-        };
-        VkSubpassDescription subpass {
-            .flags = 0,
-            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-            .inputAttachmentCount = 0,
-            .pInputAttachments = nullptr,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &colorReference,
-            .pResolveAttachments = nullptr,
-            .pDepthStencilAttachment = nullptr,
-            .preserveAttachmentCount = 0,
-            .pPreserveAttachments = nullptr
-        };
-        VkSubpassDependency subpassDep {
-            .srcSubpass = VK_SUBPASS_EXTERNAL,
-            .dstSubpass = 0,
-            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .srcAccessMask = VK_ACCESS_NONE,
-            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-            .dependencyFlags = 0
-        };
-        VkRenderPassCreateInfo renderPassCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0,
-            .attachmentCount = 1,
-            .pAttachments = &color,
-            .subpassCount = 1,
-            .pSubpasses = &subpass,
-            .dependencyCount = 1,
-            .pDependencies = &subpassDep
-        };
-        result = vkCreateRenderPass(
-            vulkanDevice,
-            &renderPassCreateInfo,
-            nullptr,
-            &renderPass
-        );
-        if(result != VK_SUCCESS) {
-            logError("failed to create render pass");
-            renderPass = VK_NULL_HANDLE;
+        if(!createDepth()) {
+            return false;
+        }
+
+        // the render pass only depends on the formats
+        if(renderPass != VK_NULL_HANDLE && previousFormat != format) {
+            // rare enough to wait on: frames in flight render with it
+            vkDeviceWaitIdle(vulkanDevice);
+            destroyRenderPass();
+        }
+        if(renderPass == VK_NULL_HANDLE && !createRenderPass()) {
             return false;
         }
 
-        // create framebuffers
+        // create framebuffers: the image's view, then the shared depth buffer
+        const VkImageView depthView = manager.getImage(*depth)->view;
         for(VkImageView view : views) {
+            const VkImageView attachments[2] = { view, depthView };
             VkFramebufferCreateInfo framebufferCreateInfo {
                 .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
                 .pNext = nullptr,
                 .flags = 0,
                 .renderPass = renderPass,
-                .attachmentCount = 1,
-                .pAttachments = &view,
+                .attachmentCount = 2,
+                .pAttachments = attachments,
                 .width = extent.width,
                 .height = extent.height,
                 .layers = 1
@@ -232,23 +438,6 @@ public:
             framebuffers.push_back(framebuffer);
         }
 
-        // create image acquire semaphore for use with vkAcquire
-        VkSemaphoreCreateInfo semaphoreCreateInfo {
-            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-            .pNext = nullptr,
-            .flags = 0
-        };
-        result = vkCreateSemaphore(
-            vulkanDevice,
-            &semaphoreCreateInfo,
-            nullptr,
-            &acquire
-        );
-        if(result != VK_SUCCESS) {
-            logError("could not create swapchain image acquire semaphore");
-            return false;
-        }
-
         // create image submission semaphores for use with submit + present
         submit.reserve(imgCount);
         for(std::size_t i = 0; i < imgCount; ++i) {
@@ -274,116 +463,173 @@ public:
         return true;
     }
 
-    bool recreateSwapchain(uint32_t queueFamilyIndex, VkSurfaceKHR surface) noexcept {
-        // do not recreate image available semaphore
-        // frames may be in-flight when we want to cleanup our resources
-        vkDeviceWaitIdle(vulkanDevice);
-        destroyFramebuffers();
-        destroyRenderPass();
-        destroySwapchainImageViews();
-        destroySwapchain();
-        // create new swapchain
-        return createSwapchain(queueFamilyIndex, surface);
-    }
-
-    VkRenderPass getRenderPass() const noexcept {
-        return renderPass;
-    }
-
-    std::vector<VkFramebuffer> getFramebuffers() const noexcept {
-        return framebuffers;
-    }
-
-    VkExtent2D getExtent() const noexcept {
-        return extent;
-    }
-
-    // query a physical device for swapchain capabilities, formats, and present modes for a specified surface and queueFamilyIndex
-    std::optional<SwapchainSupport> getSwapchainSupport(uint32_t queueFamilyIndex, VkSurfaceKHR surface) const noexcept {
-        std::optional<SwapchainSupport> support{};
-
-        VkBool32 presentOK{false};
-        VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(
-            physicalDevice,
-            queueFamilyIndex,
-            surface,
-            &presentOK
-        );
-
-        if(result != VK_SUCCESS) {
-            logError("could not query physical device for (%lu) presentation support", physicalDeviceHandle.id);
-            return support;
-        }
-        if(presentOK == false) {
-            logInfo("queueFamilyIndex (%lu) does not support presenting to specified surface on physical device (%lu)",
-                queueFamilyIndex, physicalDeviceHandle.id);
-            return support;
+    // first depth format the device can attach, one of these is always supported
+    VkFormat pickDepthFormat() const noexcept {
+        const VkFormat candidates[4] = {
+            VK_FORMAT_D32_SFLOAT,
+            VK_FORMAT_X8_D24_UNORM_PACK32,
+            VK_FORMAT_D32_SFLOAT_S8_UINT,
+            VK_FORMAT_D24_UNORM_S8_UINT
+        };
+        for(VkFormat candidate : candidates) {
+            VkFormatProperties properties{};
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, candidate, &properties);
+            if(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+                return candidate;
+            }
         }
+        return VK_FORMAT_UNDEFINED;
+    }
 
-        VkSurfaceCapabilitiesKHR caps{};
-        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &caps);
-
-        uint32_t formatCount{0};
-        std::vector<VkSurfaceFormatKHR> formats{};
-        result = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, nullptr);
-        if(result != VK_SUCCESS) {
-            logError("could not query physical device (%lu) for specified surface's count of supported color formats", physicalDeviceHandle.id);
-            return support;
+    // depth buffer at the current extent, its format is picked once and kept for the render pass
+    bool createDepth() noexcept {
+        if(depthFormat == VK_FORMAT_UNDEFINED) {
+            depthFormat = pickDepthFormat();
+            if(depthFormat == VK_FORMAT_UNDEFINED) {
+                logError("physical device (%lu) has no depth attachment format", physicalDeviceHandle.id);
+                return false;
+            }
         }
-        formats.resize(formatCount);
-        result = vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &formatCount, formats.data());
-        if(result != VK_SUCCESS) {
-            logError("could not query physical device (%lu) for specified surface's supported color formats", physicalDeviceHandle.id);
-            return support;
+        depth = manager.createDepthImage(extent.width, extent.height, depthFormat);
+        if(!depth.has_value()) {
+            logError("could not create a (%ux%u) depth buffer", extent.width, extent.height);
+            return false;
         }
+        return true;
+    }
 
-        uint32_t presentCount{0};
-        std::vector<VkPresentModeKHR> modes{};
-        result = vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentCount, nullptr);
-        if(result != VK_SUCCESS) {
-            logError("could not query physical device (%lu) for specified surface's count of supported present modes", physicalDeviceHandle.id);
-            return support;
-        }
-        modes.resize(presentCount);
-        result = vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentCount, modes.data());
-        if(result != VK_SUCCESS) {
-            logError("could not query physical device (%lu) for specified surface's supported present modes", physicalDeviceHandle.id);
-            return support;
+    void destroyDepth() noexcept {
+        if(depth.has_value()) {
+            manager.destroyImage(*depth);
+            depth.reset();
         }
-        support.emplace(caps,formats,modes);
-        return support;
     }
 
-    // signals imageAvailable, not const
-    uint32_t acquireImage() noexcept {
-        uint32_t imageIndex{ 0 };
-        VkResult result = vkAcquireNextImageKHR(
+    bool createRenderPass() noexcept {
+        VkAttachmentDescription attachments[2] = {
+            {
+                .flags = 0,
+                .format = format,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+            },
+            // cleared every frame and not kept past the pass
+            {
+                .flags = 0,
+                .format = depthFormat,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+                .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+            }
+        };
+        VkAttachmentReference colorReference {
+            .attachment = 0,
+            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+        };
+        VkAttachmentReference depthReference {
+            .attachment = 1,
+            .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+        };
+        VkSubpassDescription subpass {
+            .flags = 0,
+            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+            .inputAttachmentCount = 0,
+            .pInputAttachments = nullptr,
+            .colorAttachmentCount = 1,
+            .pColorAttachments = &colorReference,
+            .pResolveAttachments = nullptr,
+            .pDepthStencilAttachment = &depthReference,
+            .preserveAttachmentCount = 0,
+            .pPreserveAttachments = nullptr
+        };
+        // the depth buffer is shared by every frame in flight: its clear waits on the previous
+        // frame's depth writes, as the color write waits on the acquire
+        VkSubpassDependency subpassDep {
+            .srcSubpass = VK_SUBPASS_EXTERNAL,
+            .dstSubpass = 0,
+            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dependencyFlags = 0
+        };
+        VkRenderPassCreateInfo renderPassCreateInfo {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .attachmentCount = 2,
+            .pAttachments = attachments,
+            .subpassCount = 1,
+            .pSubpasses = &subpass,
+            .dependencyCount = 1,
+            .pDependencies = &subpassDep
+        };
+        VkResult result = vkCreateRenderPass(
             vulkanDevice,
-            active,
-            UINT64_MAX,
-            acquire,
-            VK_NULL_HANDLE,
-            &imageIndex
+            &renderPassCreateInfo,
+            nullptr,
+            &renderPass
         );
         if(result != VK_SUCCESS) {
-            logError("could not acquire next swapchain image");
+            logError("failed to create render pass");
+            renderPass = VK_NULL_HANDLE;
+            return false;
         }
-        return imageIndex;
-    }
-
-    VkSwapchainKHR get() const noexcept {
-        return active;
+        logInfo("created a render pass");
+        return true;
     }
 
-    VkSemaphore getAcquireSemaphore() const noexcept  {
-        return acquire;
+    // the policy's present modes, first supported wins
+    VkPresentModeKHR pickPresentMode(std::span<const VkPresentModeKHR> supported) const noexcept {
+        VkPresentModeKHR preference[2] = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_KHR };
+        switch(request.presentPolicy) {
+            case PresentPolicy::Relaxed:
+                preference[0] = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+                break;
+            case PresentPolicy::LowLatency:
+                preference[0] = VK_PRESENT_MODE_MAILBOX_KHR;
+                preference[1] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+                break;
+            case PresentPolicy::Immediate:
+                preference[0] = VK_PRESENT_MODE_IMMEDIATE_KHR;
+                preference[1] = VK_PRESENT_MODE_MAILBOX_KHR;
+                break;
+            default:
+                break;
+        }
+        for(VkPresentModeKHR mode : preference) {
+            if(std::find(supported.begin(), supported.end(), mode) != supported.end()) {
+                return mode;
+            }
+        }
+        return VK_PRESENT_MODE_FIFO_KHR;
     }
 
-    VkSemaphore getSubmitSemaphore(uint32_t index) const noexcept {
-        return submit[index];
+    void destroyRetired(Retired& r) noexcept {
+        for(VkSemaphore semaphore : r.submit) {
+            vkDestroySemaphore(vulkanDevice, semaphore, nullptr);
+        }
+        for(VkFramebuffer framebuffer : r.framebuffers) {
+            vkDestroyFramebuffer(vulkanDevice, framebuffer, nullptr);
+        }
+        for(VkImageView view : r.views) {
+            vkDestroyImageView(vulkanDevice, view, nullptr);
+        }
+        if(r.swapchain != VK_NULL_HANDLE) {
+            vkDestroySwapchainKHR(vulkanDevice, r.swapchain, nullptr);
+        }
+        logInfo("destroyed a retired swapchain with (%lu) framebuffers", r.framebuffers.size());
     }
 
-private:
     void destroySemaphores() noexcept {
         for(std::size_t i = 0; i < submit.size(); ++i) {
             vkDestroySemaphore(
@@ -393,12 +639,7 @@ private:
             );
         }
         submit.resize(0);
-        vkDestroySemaphore(
-            vulkanDevice,
-            acquire,
-            nullptr
-        );
-        logInfo("destroyed swapchain image acquire and submit semaphores");
+        logInfo("destroyed swapchain image submit semaphores");
     }
 
     void destroyFramebuffers() noexcept {
@@ -439,6 +680,9 @@ private:
     }
 
     void destroySwapchain() noexcept {
+        if(active == VK_NULL_HANDLE) {
+            return;
+        }
         vkDestroySwapchainKHR(
             vulkanDevice,
             active,
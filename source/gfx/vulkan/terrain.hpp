@@ -0,0 +1,475 @@
+// terrain.hpp: defines the TerrainRenderer, which draws every visible chunk over the shared GridMesh
+//     with a single vkCmdDrawIndexedIndirectCount where the device has VK_KHR_draw_indirect_count, and
+//     one instanced indirect draw per lod otherwise: per-instance data carries the chunk origin and
+//     its heightmap layer, and the vertex shader samples heights out of the HeightmapArray, registered
+//     once in the DescriptorHeap and found through a push constant
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "core/log/logging.hpp"
+#include "gfx/geometry/grid_mesh.hpp"
+#include "gfx/vulkan/command.hpp"
+#include "gfx/vulkan/descriptor_heap.hpp"
+#include "gfx/vulkan/heightmaps.hpp"
+#include "gfx/vulkan/pipeline_cache.hpp"
+#include "gfx/vulkan/resources.hpp"
+#include "gfx/vulkan/shader.hpp"
+#include "gfx/vulkan/terrain_cull.hpp"
+#include "gfx/vulkan/upload.hpp"
+
+namespace gfx::vulkan {
+
+class TerrainRenderer {
+    // matches the push constant block of terrain.vert
+    struct PushConstants {
+        glm::mat4 viewProj{ 1.f };
+        // world space distance between neighbouring heightmap samples
+        float sampleSpacing{ 1.f };
+        // heightmap array in the heap's images
+        core::u32 heightmapIndex{ 0 };
+    };
+
+    core::log::Logger& log;
+    const VkDevice device;
+    ResourceManager& manager;
+    const HeightmapArray& heightmaps;
+    DescriptorHeap& heap;
+    const PipelineCache& pipelineCache;
+    ShaderCache& shaders;
+
+    // shared grid mesh, uploaded once
+    std::optional<BufferHandle> gridX{};
+    std::optional<BufferHandle> gridZ{};
+    std::optional<BufferHandle> gridIndices{};
+    core::u32 indexCount{ 0 };
+    float sampleSpacing{ 1.f };
+
+    // picks this frame's instances and draw parameters out of the loaded chunks
+    TerrainCuller culler;
+
+    // heightmap array, one heap entry for the whole draw
+    VkSampler sampler{ VK_NULL_HANDLE };
+    std::optional<core::u32> heightmapIndex{};
+
+    VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+    VkPipeline pipeline{ VK_NULL_HANDLE };
+
+public:
+    // stages the grid mesh into uploader, submitted with its next flush
+    // note: no pipelines are built until createCullPipeline and createPipeline
+    TerrainRenderer(core::log::Logger& log, VkDevice device, ResourceManager& manager, UploadBatcher& uploader,
+        const PipelineCache& pipelineCache, ShaderCache& shaders, const HeightmapArray& heightmaps, DescriptorHeap& heap,
+        const gfx::geometry::GridMesh& gridMesh, float sampleSpacing, core::u32 maxInstances, core::u32 framesInFlight)
+        : log(log), device(device), manager(manager), heightmaps(heightmaps), heap(heap), pipelineCache(pipelineCache), shaders(shaders),
+          indexCount(gridMesh.indexCount), sampleSpacing(sampleSpacing),
+          culler(log, device, manager, pipelineCache, shaders, maxInstances, framesInFlight, gridMesh.lods,
+              sampleSpacing * static_cast<float>(heightmaps.getResolution() - 1))
+    {
+        const std::size_t vertexBytes = gridMesh.vertexCount * sizeof(core::u16);
+        const std::size_t indexBytes = gridMesh.indexCount * sizeof(core::u16);
+        gridX = manager.createDeviceLocalVertexBuffer(vertexBytes);
+        gridZ = manager.createDeviceLocalVertexBuffer(vertexBytes);
+        gridIndices = manager.createDeviceLocalIndexBuffer(indexBytes);
+        if(!gridX.has_value() || !gridZ.has_value() || !gridIndices.has_value()) {
+            logError("could not create terrain grid mesh buffers");
+            return;
+        }
+        uploader.upload(*gridX, gridMesh.vertexBufferX.data(), vertexBytes);
+        uploader.upload(*gridZ, gridMesh.vertexBufferZ.data(), vertexBytes);
+        uploader.upload(*gridIndices, gridMesh.indexBuffer.data(), indexBytes);
+
+        createDescriptors();
+    }
+
+    ~TerrainRenderer() {
+        // frames in flight may still be drawing terrain
+        vkDeviceWaitIdle(device);
+        destroyPipeline();
+        if(heightmapIndex.has_value()) {
+            heap.releaseImage(*heightmapIndex);
+        }
+        if(sampler != VK_NULL_HANDLE) {
+            vkDestroySampler(device, sampler, nullptr);
+        }
+        for(const std::optional<BufferHandle>& handle : { gridX, gridZ, gridIndices }) {
+            if(handle.has_value()) {
+                manager.destroyBuffer(*handle);
+            }
+        }
+        logInfo("destroyed terrain renderer");
+    }
+
+    TerrainRenderer(const TerrainRenderer&) = delete;
+    TerrainRenderer& operator=(const TerrainRenderer&) = delete;
+    TerrainRenderer(TerrainRenderer&&) = delete;
+    TerrainRenderer& operator=(TerrainRenderer&&) = delete;
+
+    core::u32 getMaxInstances() const noexcept {
+        return culler.getMaxInstances();
+    }
+
+    // independent of the render pass, built once; may run on another thread than createPipeline
+    bool createCullPipeline() noexcept {
+        return culler.createPipeline();
+    }
+
+    // depends on the render pass, so it is recreated along with the swapchain
+    bool createPipeline(VkRenderPass renderPass) noexcept {
+        destroyPipeline();
+
+        const VkShaderModule vert = shaders.get("terrain.vert.spv");
+        const VkShaderModule frag = shaders.get("terrain.frag.spv");
+        if(vert == VK_NULL_HANDLE || frag == VK_NULL_HANDLE) {
+            logError("terrain pipeline is missing its shaders");
+            return false;
+        }
+        if(!heap.valid() || !heightmapIndex.has_value()) {
+            logError("terrain pipeline needs the heightmap array in the descriptor heap");
+            return false;
+        }
+
+        // constant_id 0: size of the heap's image array
+        const core::u32 heapImages = heap.getImageCapacity();
+        VkSpecializationMapEntry heapImagesEntry {
+            .constantID = 0,
+            .offset = 0,
+            .size = sizeof(core::u32)
+        };
+        VkSpecializationInfo vertSpecialization {
+            .mapEntryCount = 1,
+            .pMapEntries = &heapImagesEntry,
+            .dataSize = sizeof(core::u32),
+            .pData = &heapImages
+        };
+
+        // vertex -> frag
+        VkPipelineShaderStageCreateInfo stages[2] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .stage = VK_SHADER_STAGE_VERTEX_BIT,
+                .module = vert,
+                .pName = "main",
+                .pSpecializationInfo = &vertSpecialization
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+                .module = frag,
+                .pName = "main",
+                .pSpecializationInfo = nullptr
+            }
+        };
+
+        // bindings 0, 1: grid x and z per vertex, binding 2: visible chunk per instance
+        VkVertexInputBindingDescription bindings[3] = {
+            { .binding = 0, .stride = sizeof(core::u16), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
+            { .binding = 1, .stride = sizeof(core::u16), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX },
+            { .binding = 2, .stride = sizeof(TerrainInstance), .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE }
+        };
+        VkVertexInputAttributeDescription attributes[5] = {
+            { .location = 0, .binding = 0, .format = VK_FORMAT_R16_UINT, .offset = 0 },
+            { .location = 1, .binding = 1, .format = VK_FORMAT_R16_UINT, .offset = 0 },
+            { .location = 2, .binding = 2, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(TerrainInstance, originX) },
+            { .location = 3, .binding = 2, .format = VK_FORMAT_R32_UINT, .offset = offsetof(TerrainInstance, layer) },
+            { .location = 4, .binding = 2, .format = VK_FORMAT_R32_SFLOAT, .offset = offsetof(TerrainInstance, minHeight) }
+        };
+        VkPipelineVertexInputStateCreateInfo vertexInput {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .vertexBindingDescriptionCount = 3,
+            .pVertexBindingDescriptions = bindings,
+            .vertexAttributeDescriptionCount = 5,
+            .pVertexAttributeDescriptions = attributes
+        };
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+            .primitiveRestartEnable = 0
+        };
+
+        // scissor and viewport are dynamic - do not specify pointers
+        VkPipelineViewportStateCreateInfo viewportState {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .viewportCount = 1,
+            .pViewports = nullptr,
+            .scissorCount = 1,
+            .pScissors = nullptr
+        };
+
+        VkPipelineRasterizationStateCreateInfo rasterizer {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .depthClampEnable = 0,
+            .rasterizerDiscardEnable = 0,
+            .polygonMode = VK_POLYGON_MODE_FILL,
+            .cullMode = VK_CULL_MODE_NONE,
+            .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+            .depthBiasEnable = 0,
+            .depthBiasConstantFactor = 0.f,
+            .depthBiasClamp = 0.f,
+            .depthBiasSlopeFactor = 0.f,
+            .lineWidth = 1.f
+        };
+
+        VkPipelineMultisampleStateCreateInfo multisample {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+            .sampleShadingEnable = 0,
+            .minSampleShading = 0.f,
+            .pSampleMask = nullptr,
+            .alphaToCoverageEnable = 0,
+            .alphaToOneEnable = 0
+        };
+
+        // instances arrive in whatever order the cull appended them, the depth test sorts out what hides what
+        VkPipelineDepthStencilStateCreateInfo depthStencil {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .depthTestEnable = VK_TRUE,
+            .depthWriteEnable = VK_TRUE,
+            .depthCompareOp = VK_COMPARE_OP_LESS,
+            .depthBoundsTestEnable = VK_FALSE,
+            .stencilTestEnable = VK_FALSE,
+            .front = {},
+            .back = {},
+            .minDepthBounds = 0.f,
+            .maxDepthBounds = 1.f
+        };
+
+        VkPipelineColorBlendAttachmentState colorBlendAttachment {
+            .blendEnable = 0,
+            .srcColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .colorBlendOp = VK_BLEND_OP_ADD,
+            .srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+            .alphaBlendOp = VK_BLEND_OP_ADD,
+            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+                VK_COLOR_COMPONENT_G_BIT |
+                VK_COLOR_COMPONENT_B_BIT |
+                VK_COLOR_COMPONENT_A_BIT
+        };
+
+        VkPipelineColorBlendStateCreateInfo colorBlend {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .logicOpEnable = 0,
+            .logicOp = VK_LOGIC_OP_CLEAR,
+            .attachmentCount = 1,
+            .pAttachments = &colorBlendAttachment,
+            .blendConstants = {0.f, 0.f, 0.f, 0.f}
+        };
+
+        VkDynamicState dynamics[] = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR
+        };
+
+        VkPipelineDynamicStateCreateInfo dynamicState {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .dynamicStateCount = 2,
+            .pDynamicStates = dynamics
+        };
+
+        VkPushConstantRange pushConstantRange {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(PushConstants)
+        };
+        const VkDescriptorSetLayout heapLayout = heap.getLayout();
+        VkPipelineLayoutCreateInfo layoutInfo {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .setLayoutCount = 1,
+            .pSetLayouts = &heapLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange
+        };
+
+        VkResult result = vkCreatePipelineLayout(
+            device,
+            &layoutInfo,
+            nullptr,
+            &pipelineLayout
+        );
+        if(result != VK_SUCCESS) {
+            logError("could not create terrain pipeline layout");
+            pipelineLayout = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkGraphicsPipelineCreateInfo pipelineInfo {
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stageCount = 2,
+            .pStages = stages,
+            .pVertexInputState = &vertexInput,
+            .pInputAssemblyState = &inputAssembly,
+            .pTessellationState = nullptr,
+            .pViewportState = &viewportState,
+            .pRasterizationState = &rasterizer,
+            .pMultisampleState = &multisample,
+            .pDepthStencilState = &depthStencil,
+            .pColorBlendState = &colorBlend,
+            .pDynamicState = &dynamicState,
+            .layout = pipelineLayout,
+            .renderPass = renderPass,
+            .subpass = 0,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = 0
+        };
+
+        result = vkCreateGraphicsPipelines(
+            device,
+            pipelineCache.get(),
+            1,
+            &pipelineInfo,
+            nullptr,
+            &pipeline
+        );
+        if(result != VK_SUCCESS) {
+            logError("could not create terrain pipeline");
+            pipeline = VK_NULL_HANDLE;
+            return false;
+        }
+        logInfo("created terrain pipeline");
+        return true;
+    }
+
+    void destroyPipeline() noexcept {
+        if(pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, pipeline, nullptr);
+            pipeline = VK_NULL_HANDLE;
+        }
+        if(pipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+            pipelineLayout = VK_NULL_HANDLE;
+        }
+    }
+
+    // cull the loaded chunks into this frame's draw, call outside the render pass after the
+    // frame's fence wait
+    void cull(Commander& cmd, std::span<const TerrainInstance> chunks, const TerrainView& view) noexcept {
+        culler.record(cmd, chunks, view);
+    }
+
+    // whatever cull() left visible, call inside the render pass
+    void draw(Commander& cmd, const TerrainView& view) noexcept {
+        if(pipeline == VK_NULL_HANDLE || !culler.valid()) {
+            return;
+        }
+        const std::size_t frameIndex = cmd.getFrameIndex();
+        const PushConstants constants {
+            .viewProj = view.viewProj,
+            .sampleSpacing = sampleSpacing,
+            .heightmapIndex = *heightmapIndex
+        };
+        const BufferHandle vertexBuffers[3] = { *gridX, *gridZ, culler.getVisible(frameIndex) };
+
+        cmd.bindPipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+        cmd.bindDescriptorSet(VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, heap.get());
+        cmd.pushConstants(pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, &constants, sizeof(PushConstants));
+        cmd.bindIndexBuffer(*gridIndices, VK_INDEX_TYPE_UINT16);
+        // one draw per visible chunk, as many as the cull counted, each finding its instance through firstInstance
+        if(cmd.hasDrawIndirectCount()) {
+            const VkDeviceSize offsets[3] = { 0, 0, 0 };
+            cmd.bindVertexBuffers(vertexBuffers, offsets);
+            cmd.drawIndexedIndirectCount(culler.getChunkDraws(frameIndex), 0,
+                culler.getDraw(frameIndex), culler.getChunkDrawCountOffset(), culler.getMaxInstances());
+            return;
+        }
+        // instances start at their lod's region, rebinding them keeps firstInstance 0
+        // (no drawIndirectFirstInstance needed); index ranges and counts are written by the cull
+        for(core::u32 lod = 0; lod < TERRAIN_LOD_COUNT; ++lod) {
+            const VkDeviceSize offsets[3] = { 0, 0, culler.getVisibleOffset(lod) };
+            cmd.bindVertexBuffers(vertexBuffers, offsets);
+            cmd.drawIndexedIndirect(culler.getDraw(frameIndex), culler.getDrawOffset(lod));
+        }
+    }
+
+private:
+    // one combined image sampler over the whole heightmap array, in the heap's images
+    void createDescriptors() noexcept {
+        // integer texels are read with texelFetch, so no filtering
+        VkSamplerCreateInfo samplerInfo {
+            .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .magFilter = VK_FILTER_NEAREST,
+            .minFilter = VK_FILTER_NEAREST,
+            .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+            .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+            .mipLodBias = 0.f,
+            .anisotropyEnable = VK_FALSE,
+            .maxAnisotropy = 1.f,
+            .compareEnable = VK_FALSE,
+            .compareOp = VK_COMPARE_OP_ALWAYS,
+            .minLod = 0.f,
+            .maxLod = 0.f,
+            .borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK,
+            .unnormalizedCoordinates = VK_FALSE
+        };
+        VkResult result = vkCreateSampler(device, &samplerInfo, nullptr, &sampler);
+        if(result != VK_SUCCESS) {
+            logError("could not create heightmap sampler");
+            sampler = VK_NULL_HANDLE;
+            return;
+        }
+
+        // the array never changes, only its layers' contents: registered once
+        heightmapIndex = heap.addImage(heightmaps.getView(), sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        if(!heightmapIndex.has_value()) {
+            logError("could not register the heightmap array in the descriptor heap");
+            return;
+        }
+        logInfo("bound (%u) layer heightmap array at heap index (%u)", heightmaps.getLayerCount(), *heightmapIndex);
+    }
+
+    // log convenience
+    template<typename... Args>
+    void logError(const char* msg, Args... args) const noexcept {
+        log.error("gfx/vulkan/terrain", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logDebug(const char* msg, Args... args) const noexcept {
+        log.debug("gfx/vulkan/terrain", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logInfo(const char* msg, Args... args) const noexcept {
+        log.info("gfx/vulkan/terrain", msg, std::forward<Args>(args)...);
+    }
+};
+
+}
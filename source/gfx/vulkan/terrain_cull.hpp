@@ -0,0 +1,467 @@
+// terrain_cull.hpp: defines the TerrainCuller, a compute pass that frustum culls the loaded chunks
+//     on the GPU and picks each visible one's lod by screen-space error: it compacts them into a
+//     vertex buffer per lod and counts them into one VkDrawIndexedIndirectCommand per lod, and also
+//     writes one VkDrawIndexedIndirectCommand per visible chunk plus their count for devices with
+//     VK_KHR_draw_indirect_count, so the terrain draw needs no per-chunk work on the CPU
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "core/log/logging.hpp"
+#include "gfx/geometry/grid_mesh.hpp"
+#include "gfx/vulkan/command.hpp"
+#include "gfx/vulkan/pipeline_cache.hpp"
+#include "gfx/vulkan/resources.hpp"
+#include "gfx/vulkan/shader.hpp"
+
+namespace gfx::vulkan {
+
+// lods of the terrain grid mesh the cull picks between, fixed by terrain_cull.comp
+constexpr const core::u32 TERRAIN_LOD_COUNT = 4;
+
+// one loaded chunk, matches TerrainInstance in terrain_cull.comp and the instance attributes of terrain.vert
+struct TerrainInstance {
+    // chunk origin in horizontal world space
+    float originX{ 0.f };
+    float originZ{ 0.f };
+    // height range of the chunk, bounds it vertically for culling
+    float minHeight{ 0.f };
+    float maxHeight{ 0.f };
+    // HeightmapArray layer, the chunk's pool index
+    core::u32 layer{ 0 };
+    // geometric error of lods 1.. against the full resolution heights, see MeshGenerator::lodErrors
+    float lodError[TERRAIN_LOD_COUNT - 1]{};
+};
+
+// camera the terrain is culled and drawn for
+struct TerrainView {
+    glm::mat4 viewProj{ 1.f };
+    glm::vec3 eye{ 0.f };
+    // pixels a unit of geometric error at unit distance may cover, a lod is used while
+    // lodError * errorScale / distance <= 1
+    float errorScale{ 1.f };
+};
+
+class TerrainCuller {
+    // matches the push constant block of terrain_cull.comp
+    struct PushConstants {
+        // left, right, bottom, top, near, far: inside where dot(plane.xyz, p) + plane.w >= 0
+        std::array<glm::vec4, 6> planes{};
+        // xyz: eye, w: errorScale
+        glm::vec4 eye{ 0.f };
+        core::u32 count{ 0 };
+        // horizontal extent of a chunk in world space
+        float chunkExtent{ 0.f };
+        // instances per lod region of the visible buffer
+        core::u32 capacity{ 0 };
+    };
+
+    static constexpr const core::u32 groupSize = 64;
+
+    // matches Draws in terrain_cull.comp
+    struct DrawCounts {
+        // one per lod, instanceCount is the cull's append counter for the lod
+        std::array<VkDrawIndexedIndirectCommand, TERRAIN_LOD_COUNT> lods{};
+        // draws written to the chunk draws
+        core::u32 chunkDrawCount{ 0 };
+    };
+
+    // buffers a frame in flight culls through, reused once its fence is waited on
+    struct Frame {
+        // written by the CPU: every loaded chunk
+        std::optional<BufferHandle> candidates{};
+        // written by compute, read as per-instance vertex input: the visible ones, maxInstances per lod
+        std::optional<BufferHandle> visible{};
+        // written by compute: DrawCounts
+        std::optional<BufferHandle> draw{};
+        // written by compute: one VkDrawIndexedIndirectCommand per visible chunk, maxInstances of them
+        std::optional<BufferHandle> chunkDraws{};
+        VkDescriptorSet set{ VK_NULL_HANDLE };
+    };
+
+    core::log::Logger& log;
+    const VkDevice device;
+    ResourceManager& manager;
+    const PipelineCache& pipelineCache;
+    ShaderCache& shaders;
+
+    const core::u32 maxInstances;
+    const float chunkExtent;
+    // draw of each lod before the cull appends its instances, and no chunk draws
+    DrawCounts emptyDraws{};
+    std::vector<Frame> frames{};
+
+    VkDescriptorSetLayout setLayout{ VK_NULL_HANDLE };
+    VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
+    VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+    VkPipeline pipeline{ VK_NULL_HANDLE };
+
+public:
+    // lods: index ranges of the mesh each lod's instances are drawn with, a mesh with fewer than
+    // TERRAIN_LOD_COUNT lods draws its coarsest in their place
+    // note: the pipeline is built by createPipeline, which may run on a background thread
+    TerrainCuller(core::log::Logger& log, VkDevice device, ResourceManager& manager, const PipelineCache& pipelineCache,
+        ShaderCache& shaders, core::u32 maxInstances, core::u32 framesInFlight, std::span<const gfx::geometry::GridLod> lods,
+        float chunkExtent)
+        : log(log), device(device), manager(manager), pipelineCache(pipelineCache), shaders(shaders),
+          maxInstances(maxInstances), chunkExtent(chunkExtent), frames(framesInFlight)
+    {
+        if(lods.empty()) {
+            logError("terrain culling needs a mesh with at least one lod");
+            return;
+        }
+        for(core::u32 lod = 0; lod < TERRAIN_LOD_COUNT; ++lod) {
+            const gfx::geometry::GridLod& range = lods[std::min<std::size_t>(lod, lods.size() - 1)];
+            emptyDraws.lods[lod] = {
+                .indexCount = range.indexCount,
+                .instanceCount = 0,
+                .firstIndex = range.firstIndex,
+                .vertexOffset = 0,
+                .firstInstance = 0
+            };
+        }
+
+        const std::size_t instanceBytes = static_cast<std::size_t>(maxInstances) * sizeof(TerrainInstance);
+        for(Frame& f : frames) {
+            f.candidates = manager.createMappedStorageBuffer(instanceBytes);
+            f.visible = manager.createDeviceLocalStorageBuffer(TERRAIN_LOD_COUNT * instanceBytes, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+            f.draw = manager.createDeviceLocalStorageBuffer(sizeof(DrawCounts),
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+            f.chunkDraws = manager.createDeviceLocalStorageBuffer(maxInstances * sizeof(VkDrawIndexedIndirectCommand),
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+            if(!f.candidates.has_value() || !f.visible.has_value() || !f.draw.has_value() || !f.chunkDraws.has_value()) {
+                logError("could not create terrain culling buffers");
+                return;
+            }
+        }
+        createDescriptors();
+    }
+
+    ~TerrainCuller() {
+        if(pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+        if(pipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        }
+        if(descriptorPool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        }
+        if(setLayout != VK_NULL_HANDLE) {
+            vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+        }
+        for(const Frame& f : frames) {
+            for(const std::optional<BufferHandle>& handle : { f.candidates, f.visible, f.draw, f.chunkDraws }) {
+                if(handle.has_value()) {
+                    manager.destroyBuffer(*handle);
+                }
+            }
+        }
+        logInfo("destroyed terrain culler");
+    }
+
+    TerrainCuller(const TerrainCuller&) = delete;
+    TerrainCuller& operator=(const TerrainCuller&) = delete;
+    TerrainCuller(TerrainCuller&&) = delete;
+    TerrainCuller& operator=(TerrainCuller&&) = delete;
+
+    // independent of the render pass, created once
+    bool createPipeline() noexcept {
+        if(pipeline != VK_NULL_HANDLE) {
+            return true;
+        }
+        const VkShaderModule comp = shaders.get("terrain_cull.comp.spv");
+        if(setLayout == VK_NULL_HANDLE || comp == VK_NULL_HANDLE) {
+            logError("terrain culling pipeline has no descriptor set layout or shader");
+            return false;
+        }
+
+        VkPushConstantRange pushConstantRange {
+            .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+            .offset = 0,
+            .size = sizeof(PushConstants)
+        };
+        VkPipelineLayoutCreateInfo layoutInfo {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .setLayoutCount = 1,
+            .pSetLayouts = &setLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange
+        };
+        VkResult result = vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout);
+        if(result != VK_SUCCESS) {
+            logError("could not create terrain culling pipeline layout");
+            pipelineLayout = VK_NULL_HANDLE;
+            return false;
+        }
+
+        VkComputePipelineCreateInfo pipelineInfo {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .stage = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .pNext = nullptr,
+                .flags = 0,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = comp,
+                .pName = "main",
+                .pSpecializationInfo = nullptr
+            },
+            .layout = pipelineLayout,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = 0
+        };
+        result = vkCreateComputePipelines(
+            device,
+            pipelineCache.get(),
+            1,
+            &pipelineInfo,
+            nullptr,
+            &pipeline
+        );
+        if(result != VK_SUCCESS) {
+            logError("could not create terrain culling pipeline");
+            pipeline = VK_NULL_HANDLE;
+            return false;
+        }
+        logInfo("created terrain culling pipeline, (%u) instances per frame", maxInstances);
+        return true;
+    }
+
+    bool valid() const noexcept {
+        return pipeline != VK_NULL_HANDLE;
+    }
+
+    core::u32 getMaxInstances() const noexcept {
+        return maxInstances;
+    }
+
+    // per-instance vertex input of the frame's draws, lod l's at getVisibleOffset(l)
+    BufferHandle getVisible(std::size_t frameIndex) const noexcept {
+        return *frames[frameIndex].visible;
+    }
+
+    VkDeviceSize getVisibleOffset(core::u32 lod) const noexcept {
+        return static_cast<VkDeviceSize>(lod) * maxInstances * sizeof(TerrainInstance);
+    }
+
+    // VkDrawIndexedIndirectCommand of the frame's draws, lod l's at getDrawOffset(l)
+    BufferHandle getDraw(std::size_t frameIndex) const noexcept {
+        return *frames[frameIndex].draw;
+    }
+
+    VkDeviceSize getDrawOffset(core::u32 lod) const noexcept {
+        return static_cast<VkDeviceSize>(lod) * sizeof(VkDrawIndexedIndirectCommand);
+    }
+
+    // offset into getDraw of the number of chunk draws
+    VkDeviceSize getChunkDrawCountOffset() const noexcept {
+        return offsetof(DrawCounts, chunkDrawCount);
+    }
+
+    // VkDrawIndexedIndirectCommand of every visible chunk, firstInstance indexes getVisible from offset 0
+    BufferHandle getChunkDraws(std::size_t frameIndex) const noexcept {
+        return *frames[frameIndex].chunkDraws;
+    }
+
+    // write the frame's candidates and record the cull, outside a render pass and after the
+    // frame's fence wait; the recorded draw then reads getVisible/getDraw of the same frame
+    void record(Commander& cmd, std::span<const TerrainInstance> chunks, const TerrainView& view) noexcept {
+        if(!valid()) {
+            return;
+        }
+        const Frame& f = frames[cmd.getFrameIndex() % frames.size()];
+        const core::u32 count = std::min<core::u32>(static_cast<core::u32>(chunks.size()), maxInstances);
+        if(count < chunks.size()) {
+            logError("(%lu) terrain instances, culling the first (%u)", chunks.size(), maxInstances);
+        }
+        if(count > 0) {
+            const Buffer& candidates = *manager.getBuffer(*f.candidates);
+            std::memcpy(candidates.allocationInfo.pMappedData, chunks.data(), count * sizeof(TerrainInstance));
+            manager.flushBuffer(*f.candidates, 0, count * sizeof(TerrainInstance));
+        }
+
+        // instanceCount is the compute pass's append counter for each lod, chunkDrawCount for the chunk draws
+        cmd.updateBuffer(*f.draw, 0, sizeof(emptyDraws), &emptyDraws);
+        const VkBufferMemoryBarrier resetBarrier = bufferBarrier(*f.draw,
+            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        cmd.barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, {}, {},
+            std::span<const VkBufferMemoryBarrier>(&resetBarrier, 1));
+
+        if(count > 0) {
+            const PushConstants constants {
+                .planes = frustumPlanes(view.viewProj),
+                .eye = glm::vec4(view.eye, view.errorScale),
+                .count = count,
+                .chunkExtent = chunkExtent,
+                .capacity = maxInstances
+            };
+            cmd.bindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            cmd.bindDescriptorSet(VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, f.set);
+            cmd.pushConstants(pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, &constants, sizeof(PushConstants));
+            cmd.dispatch((count + groupSize - 1) / groupSize, 1, 1);
+        }
+
+        // the draw reads the counts and chunk draws as its parameters and the compacted instances as vertex input
+        const VkBufferMemoryBarrier cullBarriers[3] = {
+            bufferBarrier(*f.draw, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+            bufferBarrier(*f.chunkDraws, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT),
+            bufferBarrier(*f.visible, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT)
+        };
+        cmd.barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, {}, {}, cullBarriers);
+    }
+
+private:
+    // Gribb/Hartmann: planes are sums of clip space rows, unnormalized since only their sign is tested
+    // near is taken as w + z >= 0, conservative for both the [-1,1] and [0,1] depth conventions
+    static std::array<glm::vec4, 6> frustumPlanes(const glm::mat4& m) noexcept {
+        const glm::vec4 row0{ m[0][0], m[1][0], m[2][0], m[3][0] };
+        const glm::vec4 row1{ m[0][1], m[1][1], m[2][1], m[3][1] };
+        const glm::vec4 row2{ m[0][2], m[1][2], m[2][2], m[3][2] };
+        const glm::vec4 row3{ m[0][3], m[1][3], m[2][3], m[3][3] };
+        return {
+            row3 + row0,
+            row3 - row0,
+            row3 + row1,
+            row3 - row1,
+            row3 + row2,
+            row3 - row2
+        };
+    }
+
+    // whole buffer, same queue family
+    VkBufferMemoryBarrier bufferBarrier(BufferHandle handle, VkAccessFlags srcAccess, VkAccessFlags dstAccess) const noexcept {
+        return VkBufferMemoryBarrier {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = srcAccess,
+            .dstAccessMask = dstAccess,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = manager.getBuffer(handle)->buffer,
+            .offset = 0,
+            .size = VK_WHOLE_SIZE
+        };
+    }
+
+    // per frame: candidates, visible, draw, chunk draws as storage buffers 0, 1, 2, 3
+    bool createDescriptors() noexcept {
+        constexpr core::u32 bindingCount = 4;
+        VkDescriptorSetLayoutBinding bindings[bindingCount]{};
+        for(core::u32 i = 0; i < bindingCount; ++i) {
+            bindings[i] = {
+                .binding = i,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                .pImmutableSamplers = nullptr
+            };
+        }
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .bindingCount = bindingCount,
+            .pBindings = bindings
+        };
+        VkResult result = vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout);
+        if(result != VK_SUCCESS) {
+            logError("could not create terrain culling descriptor set layout");
+            setLayout = VK_NULL_HANDLE;
+            return false;
+        }
+
+        const core::u32 setCount = static_cast<core::u32>(frames.size());
+        VkDescriptorPoolSize poolSize {
+            .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = bindingCount * setCount
+        };
+        VkDescriptorPoolCreateInfo poolInfo {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = 0,
+            .maxSets = setCount,
+            .poolSizeCount = 1,
+            .pPoolSizes = &poolSize
+        };
+        result = vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
+        if(result != VK_SUCCESS) {
+            logError("could not create terrain culling descriptor pool");
+            descriptorPool = VK_NULL_HANDLE;
+            return false;
+        }
+
+        for(Frame& f : frames) {
+            VkDescriptorSetAllocateInfo allocInfo {
+                .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .pNext = nullptr,
+                .descriptorPool = descriptorPool,
+                .descriptorSetCount = 1,
+                .pSetLayouts = &setLayout
+            };
+            result = vkAllocateDescriptorSets(device, &allocInfo, &f.set);
+            if(result != VK_SUCCESS) {
+                logError("could not allocate terrain culling descriptor set");
+                f.set = VK_NULL_HANDLE;
+                return false;
+            }
+
+            const VkDescriptorBufferInfo infos[bindingCount] = {
+                { .buffer = manager.getBuffer(*f.candidates)->buffer, .offset = 0, .range = VK_WHOLE_SIZE },
+                { .buffer = manager.getBuffer(*f.visible)->buffer, .offset = 0, .range = VK_WHOLE_SIZE },
+                { .buffer = manager.getBuffer(*f.draw)->buffer, .offset = 0, .range = VK_WHOLE_SIZE },
+                { .buffer = manager.getBuffer(*f.chunkDraws)->buffer, .offset = 0, .range = VK_WHOLE_SIZE }
+            };
+            VkWriteDescriptorSet writes[bindingCount]{};
+            for(core::u32 i = 0; i < bindingCount; ++i) {
+                writes[i] = {
+                    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .pNext = nullptr,
+                    .dstSet = f.set,
+                    .dstBinding = i,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pImageInfo = nullptr,
+                    .pBufferInfo = &infos[i],
+                    .pTexelBufferView = nullptr
+                };
+            }
+            vkUpdateDescriptorSets(device, bindingCount, writes, 0, nullptr);
+        }
+        return true;
+    }
+
+    // log convenience
+    template<typename... Args>
+    void logError(const char* msg, Args... args) const noexcept {
+        log.error("gfx/vulkan/terrain_cull", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logDebug(const char* msg, Args... args) const noexcept {
+        log.debug("gfx/vulkan/terrain_cull", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logInfo(const char* msg, Args... args) const noexcept {
+        log.info("gfx/vulkan/terrain_cull", msg, std::forward<Args>(args)...);
+    }
+};
+
+}
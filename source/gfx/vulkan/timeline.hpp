@@ -0,0 +1,147 @@
+// timeline.hpp: RAII owner for a VK_KHR_timeline_semaphore semaphore, a monotonically increasing
+//     counter the GPU signals on submit and the host or other queues can wait on by value
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "core/log/logging.hpp"
+
+namespace gfx::vulkan {
+
+class TimelineSemaphore {
+    core::log::Logger& log;
+    const VkDevice device;
+
+    VkSemaphore semaphore{ VK_NULL_HANDLE };
+    // last value handed out by next()
+    core::u64 issued{ 0 };
+
+    // extension entry points, vulkan 1.0 loaders do not export these
+    PFN_vkGetSemaphoreCounterValueKHR getCounterValue{ nullptr };
+    PFN_vkWaitSemaphoresKHR waitSemaphores{ nullptr };
+
+public:
+    TimelineSemaphore(core::log::Logger& log, VkDevice device)
+        : log(log), device(device)
+    {
+        getCounterValue = reinterpret_cast<PFN_vkGetSemaphoreCounterValueKHR>(
+            vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR"));
+        waitSemaphores = reinterpret_cast<PFN_vkWaitSemaphoresKHR>(
+            vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR"));
+        if(getCounterValue == nullptr || waitSemaphores == nullptr) {
+            logError("VK_KHR_timeline_semaphore entry points are not available");
+            return;
+        }
+
+        VkSemaphoreTypeCreateInfoKHR typeInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR,
+            .pNext = nullptr,
+            .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR,
+            .initialValue = 0
+        };
+        VkSemaphoreCreateInfo createInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+            .pNext = &typeInfo,
+            .flags = 0
+        };
+        VkResult result = vkCreateSemaphore(
+            device,
+            &createInfo,
+            nullptr,
+            &semaphore
+        );
+        if(result != VK_SUCCESS) {
+            semaphore = VK_NULL_HANDLE;
+            logError("could not create a timeline semaphore");
+            return;
+        }
+        logInfo("created a timeline semaphore");
+    }
+
+    ~TimelineSemaphore() {
+        if(semaphore == VK_NULL_HANDLE) {
+            return;
+        }
+        // nothing may still be waiting on or signaling the semaphore
+        wait(issued);
+        vkDestroySemaphore(
+            device,
+            semaphore,
+            nullptr
+        );
+        logInfo("destroyed a timeline semaphore");
+    }
+
+    TimelineSemaphore(const TimelineSemaphore&) = delete;
+    TimelineSemaphore& operator=(const TimelineSemaphore&) = delete;
+    TimelineSemaphore(TimelineSemaphore&&) = delete;
+    TimelineSemaphore& operator=(TimelineSemaphore&&) = delete;
+
+    bool valid() const noexcept {
+        return semaphore != VK_NULL_HANDLE;
+    }
+
+    VkSemaphore get() const noexcept {
+        return semaphore;
+    }
+
+    // reserve the value the next submit should signal
+    core::u64 next() noexcept {
+        return ++issued;
+    }
+
+    core::u64 lastIssued() const noexcept {
+        return issued;
+    }
+
+    // value the GPU has signaled so far
+    core::u64 completed() const noexcept {
+        core::u64 value{ 0 };
+        if(getCounterValue(device, semaphore, &value) != VK_SUCCESS) {
+            logError("could not read timeline semaphore value");
+        }
+        return value;
+    }
+
+    bool isComplete(core::u64 value) const noexcept {
+        return completed() >= value;
+    }
+
+    // block the host until the GPU has signaled at least value
+    bool wait(core::u64 value, core::u64 timeout = UINT64_MAX) const noexcept {
+        VkSemaphoreWaitInfoKHR waitInfo {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR,
+            .pNext = nullptr,
+            .flags = 0,
+            .semaphoreCount = 1,
+            .pSemaphores = &semaphore,
+            .pValues = &value
+        };
+        VkResult result = waitSemaphores(device, &waitInfo, timeout);
+        if(result != VK_SUCCESS) {
+            logError("timeline semaphore wait for value (%lu) did not complete", value);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // log convenience
+    template<typename... Args>
+    void logError(const char* msg, Args... args) const noexcept {
+        log.error("gfx/vulkan/timeline", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logDebug(const char* msg, Args... args) const noexcept {
+        log.debug("gfx/vulkan/timeline", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logInfo(const char* msg, Args... args) const noexcept {
+        log.info("gfx/vulkan/timeline", msg, std::forward<Args>(args)...);
+    }
+};
+
+}
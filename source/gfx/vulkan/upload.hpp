@@ -0,0 +1,386 @@
+// upload.hpp: defines the UploadBatcher, which sub-allocates CPU -> GPU uploads out of the
+//     ResourceManager's staging ring and records every barrier and copy into one command buffer,
+//     so a batch of uploads costs one submit and one fence wait
+//     with a transfer commander and timeline semaphore, flushAsync() submits a batch on its own queue
+//     and hands back a ticket the frames that read the uploads wait on, instead of the host
+#pragma once
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vulkan_core.h>
+
+#include "core/log/logging.hpp"
+#include "gfx/vulkan/command.hpp"
+#include "gfx/vulkan/resources.hpp"
+#include "gfx/vulkan/timeline.hpp"
+
+namespace gfx::vulkan {
+
+// completion of an async upload batch: the graphics submit reading the uploads waits for value,
+// and records the acquire half of any queue family ownership transfer first
+// value 0 is already complete (synchronous fallback)
+struct UploadTicket {
+    core::u64 value{ 0 };
+    std::vector<VkImageMemoryBarrier> imageAcquires{};
+    std::vector<VkBufferMemoryBarrier> bufferAcquires{};
+};
+
+class UploadBatcher {
+    core::log::Logger& log;
+    ResourceManager& manager;
+    Commander& cmd;
+
+    // regions are aligned to this inside the staging buffer
+    // (covers the texel size and 4-byte rule of vkCmdCopyBufferToImage)
+    static constexpr const VkDeviceSize regionAlignment = 16;
+
+    struct BufferUpload {
+        BufferHandle dst{};
+        StagingAllocation src{};
+    };
+
+    struct ImageUpload {
+        ImageHandle dst{};
+        StagingAllocation src{};
+        core::u32 width{ 0 };
+        core::u32 height{ 0 };
+        core::u32 layer{ 0 };
+    };
+
+    // bytes staged by the current batch
+    VkDeviceSize used{ 0 };
+
+    std::vector<BufferUpload> bufferUploads{};
+    std::vector<ImageUpload> imageUploads{};
+
+    // async uploads, unset until enableAsync()
+    Commander* transfer{ nullptr };
+    TimelineSemaphore* timeline{ nullptr };
+    core::u32 graphicsFamily{ 0 };
+    // batches submitted since the last flushAsync(), handed out with the next ticket
+    UploadTicket carried{};
+
+public:
+    // stagingCapacity bounds the host-visible memory used by uploads, whatever their number
+    UploadBatcher(core::log::Logger& log, ResourceManager& manager, Commander& cmd, VkDeviceSize stagingCapacity = 4 * 1024 * 1024)
+        : log(log), manager(manager), cmd(cmd)
+    {
+        manager.createStagingRing(stagingCapacity);
+    }
+
+    UploadBatcher(const UploadBatcher&) = delete;
+    UploadBatcher& operator=(const UploadBatcher&) = delete;
+    UploadBatcher(UploadBatcher&&) = delete;
+    UploadBatcher& operator=(UploadBatcher&&) = delete;
+
+    // route flushAsync() batches through a transfer queue, handing ownership to graphicsQueueFamily
+    void enableAsync(Commander& transferCmd, TimelineSemaphore& uploadTimeline, core::u32 graphicsQueueFamily) noexcept {
+        transfer = &transferCmd;
+        timeline = &uploadTimeline;
+        graphicsFamily = graphicsQueueFamily;
+        logInfo("async uploads on queue family (%u), released to queue family (%u)",
+            transfer->getQueueFamilyIndex(), graphicsFamily);
+    }
+
+    bool isAsync() const noexcept {
+        return transfer != nullptr;
+    }
+
+    // stage bytes for a device-local buffer, copied on the next flush
+    bool upload(BufferHandle dst, const void* data, std::size_t size) noexcept {
+        std::optional<StagingAllocation> region = stage(data, size);
+        if(!region.has_value()) {
+            return false;
+        }
+        bufferUploads.push_back({ .dst = dst, .src = *region });
+        return true;
+    }
+
+    // stage tightly packed texels for the whole of one image layer, copied on the next flush
+    // the layer's previous contents are discarded, it is left readable from shaders
+    bool upload(ImageHandle dst, const void* data, std::size_t size, core::u32 width, core::u32 height, core::u32 layer = 0) noexcept {
+        std::optional<StagingAllocation> region = stage(data, size);
+        if(!region.has_value()) {
+            return false;
+        }
+        imageUploads.push_back({ .dst = dst, .src = *region, .width = width, .height = height, .layer = layer });
+        return true;
+    }
+
+    // record every staged upload into one command buffer, submit once and wait for it
+    bool flush() noexcept {
+        if(bufferUploads.empty() && imageUploads.empty()) {
+            return true;
+        }
+        flushStaging();
+
+        cmd.awaitAndResetFrameFence();
+        if(!cmd.begin()) {
+            return false;
+        }
+        recordCopies(cmd);
+
+        // make copies visible to vertex input and shader reads
+        std::vector<VkImageMemoryBarrier> imageBarriers{};
+        imageBarriers.reserve(imageUploads.size());
+        for(const ImageUpload& upload : imageUploads) {
+            imageBarriers.push_back(imageBarrier(upload.dst, upload.layer,
+                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+        }
+        const VkMemoryBarrier bufferBarrier {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = bufferReadAccess
+        };
+        cmd.barrier(
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            std::span<const VkMemoryBarrier>(&bufferBarrier, bufferUploads.empty() ? 0 : 1),
+            imageBarriers
+        );
+
+        if(!cmd.submit()) {
+            return false;
+        }
+        // the staging regions are free as soon as the submit is
+        cmd.awaitFrameFence();
+        manager.retireStaging(0);
+        manager.reclaimStaging(0);
+
+        logInfo("flushed (%lu) buffer and (%lu) image uploads, (%lu) staged bytes in one submit",
+            bufferUploads.size(), imageUploads.size(), used);
+
+        clear();
+        return true;
+    }
+
+    // submit every staged upload on the transfer queue without waiting for it
+    // the returned ticket must be handed to the first graphics submit that reads the uploads,
+    // it also covers any batch submitted early because the staging ring filled up
+    // falls back to flush() (and an already complete ticket) until enableAsync()
+    std::optional<UploadTicket> flushAsync() noexcept {
+        if(!isAsync()) {
+            if(!flush()) {
+                return std::nullopt;
+            }
+            return UploadTicket{};
+        }
+        if(!submitAsync()) {
+            return std::nullopt;
+        }
+        return std::exchange(carried, UploadTicket{});
+    }
+
+private:
+    // every access a buffer upload may be read with
+    static constexpr const VkAccessFlags bufferReadAccess =
+        VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+    // record and submit the staged batch on the transfer queue, folding its ticket into carried
+    bool submitAsync() noexcept {
+        if(bufferUploads.empty() && imageUploads.empty()) {
+            return true;
+        }
+        flushStaging();
+
+        // batches take turns in the transfer commander's frames, only the batch that last recorded
+        // into this one must be done with it
+        transfer->awaitAndResetFrameFence();
+        if(!transfer->begin()) {
+            return false;
+        }
+        recordCopies(*transfer);
+
+        // release: with distinct families, ownership moves to the graphics queue and the acquire
+        // barriers in the ticket complete the transfer (and the layout transition) there
+        // otherwise the timeline wait alone makes the copies visible to the graphics submit
+        const core::u32 transferFamily = transfer->getQueueFamilyIndex();
+        const bool ownershipTransfer = transferFamily != graphicsFamily;
+        const core::u32 srcFamily = ownershipTransfer ? transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        const core::u32 dstFamily = ownershipTransfer ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+
+        UploadTicket ticket{};
+        std::vector<VkImageMemoryBarrier> imageReleases{};
+        imageReleases.reserve(imageUploads.size());
+        for(const ImageUpload& upload : imageUploads) {
+            VkImageMemoryBarrier release = imageBarrier(upload.dst, upload.layer,
+                VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+            release.srcQueueFamilyIndex = srcFamily;
+            release.dstQueueFamilyIndex = dstFamily;
+            imageReleases.push_back(release);
+            if(ownershipTransfer) {
+                VkImageMemoryBarrier acquire = release;
+                acquire.srcAccessMask = 0;
+                acquire.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                ticket.imageAcquires.push_back(acquire);
+            }
+        }
+        std::vector<VkBufferMemoryBarrier> bufferReleases{};
+        if(ownershipTransfer) {
+            bufferReleases.reserve(bufferUploads.size());
+            for(const BufferUpload& upload : bufferUploads) {
+                VkBufferMemoryBarrier release {
+                    .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                    .pNext = nullptr,
+                    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .dstAccessMask = 0,
+                    .srcQueueFamilyIndex = srcFamily,
+                    .dstQueueFamilyIndex = dstFamily,
+                    .buffer = manager.getBuffer(upload.dst)->buffer,
+                    .offset = 0,
+                    .size = VK_WHOLE_SIZE
+                };
+                bufferReleases.push_back(release);
+                VkBufferMemoryBarrier acquire = release;
+                acquire.srcAccessMask = 0;
+                acquire.dstAccessMask = bufferReadAccess;
+                ticket.bufferAcquires.push_back(acquire);
+            }
+        }
+        transfer->barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            {}, imageReleases, bufferReleases);
+
+        ticket.value = timeline->next();
+        if(!transfer->submit(timeline->get(), ticket.value)) {
+            return false;
+        }
+        transfer->nextFrame();
+        // the batch's staging regions are reclaimed once the transfer queue signals its value
+        manager.retireStaging(ticket.value);
+
+        logInfo("submitted (%lu) buffer and (%lu) image uploads, (%lu) staged bytes, as timeline value (%lu)",
+            bufferUploads.size(), imageUploads.size(), used, ticket.value);
+
+        carried.value = ticket.value;
+        carried.imageAcquires.insert(carried.imageAcquires.end(), ticket.imageAcquires.begin(), ticket.imageAcquires.end());
+        carried.bufferAcquires.insert(carried.bufferAcquires.end(), ticket.bufferAcquires.begin(), ticket.bufferAcquires.end());
+
+        clear();
+        return true;
+    }
+
+    // copy bytes into the next aligned region of the staging ring
+    // a full ring submits the current batch and reclaims regions of earlier ones, waiting if it must
+    std::optional<StagingAllocation> stage(const void* data, std::size_t size) noexcept {
+        std::optional<StagingAllocation> region = manager.allocateStaging(size, regionAlignment);
+        if(!region.has_value()) {
+            if(size > manager.getStagingCapacity()) {
+                logError("(%lu) byte upload does not fit the (%lu) byte staging ring", size, manager.getStagingCapacity());
+                return std::nullopt;
+            }
+            // the current batch holds ring space too, submit it so it can be retired
+            if(!bufferUploads.empty() || !imageUploads.empty()) {
+                if(!(isAsync() ? submitAsync() : flush())) {
+                    return std::nullopt;
+                }
+            }
+            if(isAsync()) {
+                manager.reclaimStaging(timeline->completed());
+            }
+            region = manager.allocateStaging(size, regionAlignment);
+        }
+        // still full: block on the oldest batch still reading from the ring
+        while(!region.has_value()) {
+            std::optional<core::u64> oldest = manager.getOldestStagingRetirement();
+            if(!oldest.has_value()) {
+                logError("staging ring exhausted with nothing left to reclaim");
+                return std::nullopt;
+            }
+            if(isAsync()) {
+                timeline->wait(*oldest);
+            }
+            manager.reclaimStaging(*oldest);
+            region = manager.allocateStaging(size, regionAlignment);
+        }
+
+        std::memcpy(region->pMapped, data, size);
+        used += size;
+        return region;
+    }
+
+    // make this batch's host writes visible to the device (no-op on coherent memory)
+    void flushStaging() noexcept {
+        for(const BufferUpload& upload : bufferUploads) {
+            manager.flushBuffer(upload.src.buffer, upload.src.offset, upload.src.size);
+        }
+        for(const ImageUpload& upload : imageUploads) {
+            manager.flushBuffer(upload.src.buffer, upload.src.offset, upload.src.size);
+        }
+    }
+
+    // transition images to copy destinations in one barrier, then record every copy
+    void recordCopies(Commander& target) noexcept {
+        std::vector<VkImageMemoryBarrier> imageBarriers{};
+        imageBarriers.reserve(imageUploads.size());
+        // every upload overwrites a whole layer, so its old contents (and layout) can be discarded
+        for(const ImageUpload& upload : imageUploads) {
+            imageBarriers.push_back(imageBarrier(upload.dst, upload.layer,
+                0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+        }
+        target.barrier(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, {}, imageBarriers);
+
+        for(const BufferUpload& upload : bufferUploads) {
+            target.copy(upload.src.buffer, upload.src.offset, upload.dst, 0, upload.src.size);
+        }
+        for(const ImageUpload& upload : imageUploads) {
+            target.copy(upload.src.buffer, upload.src.offset, upload.dst, upload.width, upload.height, upload.layer);
+        }
+    }
+
+    void clear() noexcept {
+        bufferUploads.clear();
+        imageUploads.clear();
+        used = 0;
+    }
+
+    // the tracked layout is the image's as a whole: uploaded layers all end up shader readable
+    VkImageMemoryBarrier imageBarrier(ImageHandle handle, core::u32 layer, VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+        VkImageLayout oldLayout, VkImageLayout newLayout) noexcept
+    {
+        const Image& img = *manager.getImage(handle);
+        manager.updateImageLayout(handle, newLayout);
+        return VkImageMemoryBarrier {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = srcAccess,
+            .dstAccessMask = dstAccess,
+            .oldLayout = oldLayout,
+            .newLayout = newLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = img.image,
+            .subresourceRange = VkImageSubresourceRange {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = layer,
+                .layerCount = 1
+            }
+        };
+    }
+
+    // log convenience
+    template<typename... Args>
+    void logError(const char* msg, Args... args) const noexcept {
+        log.error("gfx/vulkan/upload", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logDebug(const char* msg, Args... args) const noexcept {
+        log.debug("gfx/vulkan/upload", msg, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    void logInfo(const char* msg, Args... args) const noexcept {
+        log.info("gfx/vulkan/upload", msg, std::forward<Args>(args)...);
+    }
+};
+
+}
@@ -19,6 +19,8 @@ class Window {
     uint32_t extensionsCount{ 0 };
     std::vector<std::string> extensionNames{};
     bool glfwInitialized{ false };
+    // framebuffer size changed since the last takeResized
+    bool resized{ false };
 
 public:
     Window(core::log::Logger& log, core::u32 width, core::u32 height)
@@ -48,6 +50,12 @@ public:
             return;
         }
         log.info("gfx/vulkan/window","created GLFW window");
+
+        // not every platform reports a resized surface through acquire/present (e.g. Wayland)
+        glfwSetWindowUserPointer(pWindow, this);
+        glfwSetFramebufferSizeCallback(pWindow, [](GLFWwindow* resizedWindow, int, int) {
+            static_cast<Window*>(glfwGetWindowUserPointer(resizedWindow))->resized = true;
+        });
     }
 
     ~Window() {
@@ -73,6 +81,13 @@ public:
     GLFWwindow* get() const noexcept {
         return pWindow;
     }
+
+    // whether the framebuffer was resized since the last call
+    bool takeResized() noexcept {
+        const bool was = resized;
+        resized = false;
+        return was;
+    }
 };
 
 // RAII wrap the Vulkan Surface
@@ -0,0 +1,272 @@
+// tools/chunk_bench/chunk_bench.hpp: defines the StreamingBench, a headless driver for the chunk
+//     streaming path: a scripted camera (straight flyover, spiral, random teleports) requests the
+//     chunks around it every frame, just like the engine's main loop, through a fresh Chonker per run
+//     and measures chunks/sec, request -> Loaded latency percentiles, evictions, cancellations, failed reads and the
+//     resident set high-water mark, so throughput regressions show up without a window or a GPU
+#pragma once
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <numbers>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "engine/world/camera.hpp"
+#include "engine/world/chonker.hpp"
+#include "engine/world/chunk.hpp"
+
+namespace tools {
+
+enum class CameraPath : core::u32 {
+    // straight line across the world, back and forth
+    Flyover = 0,
+    // outward spiral from the world's center
+    Spiral = 1,
+    // a jump to a random chunk every teleportInterval frames
+    Teleport = 2
+};
+
+inline const char* cameraPathName(CameraPath path) noexcept {
+    switch(path) {
+        case CameraPath::Flyover:
+            return "flyover";
+        case CameraPath::Spiral:
+            return "spiral";
+        default:
+            return "teleport";
+    }
+}
+
+struct BenchParams {
+    CameraPath path{ CameraPath::Flyover };
+    std::size_t frames{ 1800 };
+    // frames per second the loop is paced to, 0 runs unpaced
+    double fps{ 60.0 };
+    // world units the camera moves per frame
+    float speed{ 16.f };
+    core::u32 teleportInterval{ 120 };
+    // chunks requested around the camera every frame, as in the engine's main loop
+    core::i32 viewRadius{ 3 };
+    std::size_t poolCapacity{ 256 };
+    engine::world::ChunkReadMode readMode{ engine::world::ChunkReadMode::Copy };
+    // 0: one per hardware thread
+    std::size_t workers{ 0 };
+    core::u32 seed{ 1 };
+};
+
+struct BenchResult {
+    std::size_t frames{ 0 };
+    double seconds{ 0.0 };
+    // requests that reached Loaded during the run
+    std::size_t loaded{ 0 };
+    // requests that went back to Unloaded (cancelled or out of range) before they loaded
+    std::size_t abandoned{ 0 };
+    double chunksPerSecond{ 0.0 };
+    // request -> Loaded, milliseconds
+    double latencyP50{ 0.0 };
+    double latencyP90{ 0.0 };
+    double latencyP99{ 0.0 };
+    double latencyMax{ 0.0 };
+    std::size_t evictions{ 0 };
+    std::size_t cancellations{ 0 };
+    // loads the world couldn't supply (read failed or malformed record)
+    std::size_t failures{ 0 };
+    // most pool slots held (Loading or Loaded) at once, out of poolCapacity
+    std::size_t residentHighWater{ 0 };
+    // resident set size high-water of the process, bytes
+    std::size_t memoryHighWater{ 0 };
+};
+
+// resident set size of this process in bytes, the peak where the current one isn't available
+inline std::size_t residentBytes() noexcept {
+#if defined(__linux__)
+    // statm: total and resident pages
+    if(std::FILE* f = std::fopen("/proc/self/statm", "r")) {
+        unsigned long long pages = 0, resident = 0;
+        const bool read = std::fscanf(f, "%llu %llu", &pages, &resident) == 2;
+        std::fclose(f);
+        if(read) {
+            return static_cast<std::size_t>(resident) * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        }
+    }
+#endif
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return static_cast<std::size_t>(usage.ru_maxrss);
+#else
+    // kilobytes everywhere else
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+// nearest rank, sorted must be sorted ascending
+inline double percentile(const std::vector<double>& sorted, double p) noexcept {
+    if(sorted.empty()) {
+        return 0.0;
+    }
+    const std::size_t rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+    return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+class StreamingBench {
+    using Clock = std::chrono::steady_clock;
+
+    const char* worldFilename;
+
+public:
+    explicit StreamingBench(const char* worldFilename)
+        : worldFilename(worldFilename)
+    {}
+
+    BenchResult run(const BenchParams& params) const {
+        using namespace engine::world;
+
+        Chonker chonker(params.poolCapacity, params.readMode, params.workers, worldFilename);
+        const ChunkWorld& world = chonker.getWorld();
+        BenchResult result{};
+        if(world.size() == 0) {
+            printf("chunk bench: no chunks in '%s'\n", worldFilename);
+            return result;
+        }
+
+        // the path stays inside the world's chunk grid, in world units
+        const float2 lo = chunkToWorldPositionXZ(world.getOrigin());
+        const float2 extent {
+            .x = static_cast<float>(world.getWidth() * CHUNK_SIZE),
+            .y = static_cast<float>(world.getHeight() * CHUNK_SIZE)
+        };
+        const float2 center{ .x = lo.x + 0.5f * extent.x, .y = lo.y + 0.5f * extent.y };
+
+        std::mt19937 rng(params.seed);
+        std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+        Camera camera{};
+        camera.position = { center.x, 0.f, center.y };
+        float2 teleport = center;
+        float spiralAngle = 0.f;
+
+        // request time of every chunk not yet Loaded, keyed by packed chunk coordinate
+        std::unordered_map<core::u64, Clock::time_point> requested{};
+        std::vector<double> latencies{};
+
+        const Clock::duration frameTime = params.fps > 0.0
+            ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / params.fps))
+            : Clock::duration::zero();
+        const Clock::time_point start = Clock::now();
+        Clock::time_point next = start;
+
+        for(std::size_t frame = 0; frame < params.frames; ++frame) {
+            const glm::vec3 previous = camera.position;
+            const float2 position = pathPosition(params, static_cast<float>(frame), lo, extent, center,
+                spiralAngle, teleport, rng, unit);
+            camera.position = { position.x, 0.f, position.y };
+            const glm::vec3 motion = camera.position - previous;
+            // face where we're going, teleports keep looking the way they did
+            if(glm::dot(motion, motion) > 0.f && glm::dot(motion, motion) < params.speed * params.speed * 4.f) {
+                camera.look = glm::normalize(motion);
+            }
+
+            const Chunk cameraChunk = worldPositionXZToChunk(position);
+            const Clock::time_point now = Clock::now();
+            for(core::i32 dz = -params.viewRadius; dz <= params.viewRadius; ++dz) {
+                for(core::i32 dx = -params.viewRadius; dx <= params.viewRadius; ++dx) {
+                    const Chunk c{ .x = cameraChunk.x + dx, .z = cameraChunk.z + dz };
+                    const bool fresh = chonker.getStatus(c) == ChunkStatus::Unloaded;
+                    if(chonker.request(c) && fresh) {
+                        requested.try_emplace(chunkKey(c), now);
+                    }
+                }
+            }
+            chonker.update(camera);
+
+            // resolve the requests that finished, or were given up on, since the last frame
+            // latency runs to when the chunk became Loaded, not to this poll, so it isn't rounded up to frames
+            for(auto it = requested.begin(); it != requested.end();) {
+                const Chunk c = chunkFromKey(it->first);
+                const ChunkStatus status = chonker.getStatus(c);
+                if(status == ChunkStatus::Loaded) {
+                    const Clock::time_point done = chonker.getLoadedTime(c).value_or(Clock::now());
+                    latencies.push_back(std::chrono::duration<double, std::milli>(done - it->second).count());
+                    it = requested.erase(it);
+                }
+                else if(status == ChunkStatus::Unloaded) {
+                    ++result.abandoned;
+                    it = requested.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+
+            result.residentHighWater = std::max(result.residentHighWater, chonker.getPool().getRequestedChunkIds().size());
+            result.memoryHighWater = std::max(result.memoryHighWater, residentBytes());
+
+            if(frameTime != Clock::duration::zero()) {
+                next += frameTime;
+                std::this_thread::sleep_until(next);
+            }
+        }
+
+        result.frames = params.frames;
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        result.loaded = latencies.size();
+        result.chunksPerSecond = result.seconds > 0.0 ? static_cast<double>(result.loaded) / result.seconds : 0.0;
+        std::sort(latencies.begin(), latencies.end());
+        result.latencyP50 = percentile(latencies, 0.50);
+        result.latencyP90 = percentile(latencies, 0.90);
+        result.latencyP99 = percentile(latencies, 0.99);
+        result.latencyMax = latencies.empty() ? 0.0 : latencies.back();
+        result.evictions = chonker.getEvictionCount();
+        result.cancellations = chonker.getCancellationCount();
+        result.failures = chonker.getFailureCount();
+        return result;
+    }
+
+private:
+    // camera position on the path at a frame, in world units
+    static engine::world::float2 pathPosition(const BenchParams& params, float frame,
+        engine::world::float2 lo, engine::world::float2 extent, engine::world::float2 center,
+        float& spiralAngle, engine::world::float2& teleport,
+        std::mt19937& rng, std::uniform_real_distribution<float>& unit) noexcept
+    {
+        using namespace engine::world;
+        switch(params.path) {
+            case CameraPath::Flyover: {
+                // along x through the center, bouncing off the world's edges
+                const float span = std::max(extent.x, 1.f);
+                const float travelled = std::fmod(frame * params.speed, 2.f * span);
+                const float x = travelled < span ? travelled : 2.f * span - travelled;
+                return { .x = lo.x + x, .y = center.y };
+            }
+            case CameraPath::Spiral: {
+                // archimedean spiral, r = spacing * angle / 2pi, walked at constant speed
+                // restarting from the center once it reaches the world's edge
+                const float spacing = static_cast<float>(2 * params.viewRadius + 1) * CHUNK_SIZE;
+                const float maxRadius = 0.5f * std::min(extent.x, extent.y);
+                float radius = spacing * spiralAngle / (2.f * std::numbers::pi_v<float>);
+                if(radius > maxRadius) {
+                    spiralAngle = 0.f;
+                    radius = 0.f;
+                }
+                spiralAngle += params.speed / std::max(radius, spacing);
+                return { .x = center.x + radius * std::cos(spiralAngle), .y = center.y + radius * std::sin(spiralAngle) };
+            }
+            default: {
+                if(static_cast<core::u64>(frame) % std::max(1u, params.teleportInterval) == 0) {
+                    teleport = { .x = lo.x + unit(rng) * extent.x, .y = lo.y + unit(rng) * extent.y };
+                }
+                return teleport;
+            }
+        }
+    }
+};
+
+}
@@ -0,0 +1,107 @@
+// tools/chunk_bench/main.cpp: main for the headless streaming benchmark, runs scripted camera paths
+//     through Chonker and prints throughput, latency, eviction and memory figures per path
+//
+// usage: ChunkBench [--path flyover|spiral|teleport|all] [--mode copy|mapped|async] [--frames N]
+//                   [--fps F] [--speed S] [--radius R] [--pool N] [--workers N] [--seed N] [world]
+//        world: a .world index or a single .chunk file, defaulting to assets/N40W106.chunk
+//        --fps 0 runs the frames back to back instead of paced
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "tools/chunk_bench/chunk_bench.hpp"
+
+int main(int argc, char* argv[]) {
+    tools::BenchParams params{};
+    std::vector<tools::CameraPath> paths{ tools::CameraPath::Flyover, tools::CameraPath::Spiral, tools::CameraPath::Teleport };
+    const char* worldName = "assets/N40W106.chunk";
+
+    auto usage = []() {
+        std::cout << "usage: ChunkBench [--path flyover|spiral|teleport|all] [--mode copy|mapped|async] [--frames N]\n"
+                     "                  [--fps F] [--speed S] [--radius R] [--pool N] [--workers N] [--seed N] [world]\n";
+        return -1;
+    };
+
+    for(int arg = 1; arg < argc; ++arg) {
+        const char* flag = argv[arg];
+        if(flag[0] != '-') {
+            worldName = flag;
+            continue;
+        }
+        if(arg + 1 >= argc) {
+            return usage();
+        }
+        const char* value = argv[++arg];
+        if(std::strcmp(flag, "--path") == 0) {
+            if(std::strcmp(value, "flyover") == 0) {
+                paths = { tools::CameraPath::Flyover };
+            }
+            else if(std::strcmp(value, "spiral") == 0) {
+                paths = { tools::CameraPath::Spiral };
+            }
+            else if(std::strcmp(value, "teleport") == 0) {
+                paths = { tools::CameraPath::Teleport };
+            }
+            else if(std::strcmp(value, "all") != 0) {
+                return usage();
+            }
+        }
+        else if(std::strcmp(flag, "--mode") == 0) {
+            if(std::strcmp(value, "copy") == 0) {
+                params.readMode = engine::world::ChunkReadMode::Copy;
+            }
+            else if(std::strcmp(value, "mapped") == 0) {
+                params.readMode = engine::world::ChunkReadMode::Mapped;
+            }
+            else if(std::strcmp(value, "async") == 0) {
+                params.readMode = engine::world::ChunkReadMode::Async;
+            }
+            else {
+                return usage();
+            }
+        }
+        else if(std::strcmp(flag, "--frames") == 0) {
+            params.frames = std::strtoul(value, nullptr, 10);
+        }
+        else if(std::strcmp(flag, "--fps") == 0) {
+            params.fps = std::strtod(value, nullptr);
+        }
+        else if(std::strcmp(flag, "--speed") == 0) {
+            params.speed = std::strtof(value, nullptr);
+        }
+        else if(std::strcmp(flag, "--radius") == 0) {
+            params.viewRadius = static_cast<core::i32>(std::strtol(value, nullptr, 10));
+        }
+        else if(std::strcmp(flag, "--pool") == 0) {
+            params.poolCapacity = std::strtoul(value, nullptr, 10);
+        }
+        else if(std::strcmp(flag, "--workers") == 0) {
+            params.workers = std::strtoul(value, nullptr, 10);
+        }
+        else if(std::strcmp(flag, "--seed") == 0) {
+            params.seed = static_cast<core::u32>(std::strtoul(value, nullptr, 10));
+        }
+        else {
+            return usage();
+        }
+    }
+    if(params.poolCapacity == 0 || params.viewRadius < 0) {
+        return usage();
+    }
+
+    const tools::StreamingBench bench(worldName);
+    for(tools::CameraPath path : paths) {
+        params.path = path;
+        const tools::BenchResult result = bench.run(params);
+        printf("%-8s %zu frames in %.2fs: %zu chunks loaded (%.1f chunks/s), %zu abandoned\n",
+            tools::cameraPathName(path), result.frames, result.seconds, result.loaded, result.chunksPerSecond, result.abandoned);
+        printf("         latency ms p50 %.2f p90 %.2f p99 %.2f max %.2f\n",
+            result.latencyP50, result.latencyP90, result.latencyP99, result.latencyMax);
+        printf("         evictions %zu, cancellations %zu, failed reads %zu, pool high-water %zu/%zu slots, rss high-water %.1f MiB\n",
+            result.evictions, result.cancellations, result.failures, result.residentHighWater, params.poolCapacity,
+            static_cast<double>(result.memoryHighWater) / (1024.0 * 1024.0));
+    }
+    return 0;
+}
@@ -0,0 +1,608 @@
+// tools/dem_chunk_builder/chunk_builder.hpp: defines the ChunkBuilder, which turns a mapped NASA DEM
+//     tile (.hgt) into a chunked heightmap file (.chunk): rows of chunks are byte-swapped, cut out of
+//     the tile and encoded in parallel, each row claiming the next stretch of the output in row order
+//     and streamed straight to it, and the header + TOC are written in one go once every chunk is out
+//     chunks sit CHUNK_SIZE samples apart on the world's sample grid, sharing edge samples with
+//     their neighbours (and across tile seams), so chunk borders line up without gaps or overlaps
+//     chunks of a ChunkTraits other than one sample per DEM sample are resampled (bilinear) off that grid
+//     buildWorld shards a directory of tiles into one .chunk per tile plus a world index (.world)
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "engine/world/chunk_codec.hpp"
+#include "engine/world/chunk_data.hpp"
+#include "engine/world/chunk_file.hpp"
+#include "engine/world/chunk_surface.hpp"
+#include "engine/world/chunk_world.hpp"
+
+namespace tools {
+
+// big-endian .hgt samples -> native i16, 8 samples per vector where we have one
+inline void byteSwap16(const std::byte* in, core::i16* out, std::size_t count) noexcept {
+    std::size_t i = 0;
+#if defined(__ARM_NEON)
+    for(; i + 8 <= count; i += 8) {
+        const uint8x16_t v = vld1q_u8(reinterpret_cast<const std::uint8_t*>(in) + 2 * i);
+        vst1q_u8(reinterpret_cast<std::uint8_t*>(out + i), vrev16q_u8(v));
+    }
+#elif defined(__SSE2__)
+    for(; i + 8 <= count; i += 8) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+    }
+#endif
+    for(; i < count; ++i) {
+        const core::u16 hi = static_cast<core::u16>(in[2 * i]);
+        const core::u16 lo = static_cast<core::u16>(in[2 * i + 1]);
+        out[i] = static_cast<core::i16>((hi << 8) | lo);
+    }
+}
+
+template<engine::world::ChunkGeometry Traits>
+class BasicChunkBuilder {
+    // DEM samples of apron read around every chunk: one chunk sample past each edge, for normals
+    static constexpr std::size_t APRON = std::max<std::size_t>(1, static_cast<std::size_t>(Traits::spacing));
+
+    // samples along an edge of the (square) tile: 3601 at 1 arc-second, 1201 at 3 arc-second
+    // neighbouring tiles share their edge samples, so tiles sit tileSize - 1 samples apart
+    const std::size_t tileSize;
+    // how chunk records are written
+    const engine::world::ChunkEncoding encoding;
+    // CHUNK_SECTION_* precomputed ahead of every record's heights
+    const core::u32 sections;
+    std::size_t numWorkers;
+
+    // mapped tiles west -> east, north -> south, null where there is no tile
+    struct TileGrid {
+        std::size_t width{ 0 };
+        std::size_t height{ 0 };
+        std::vector<const std::byte*> tiles{};
+
+        const std::byte* at(std::size_t tx, std::size_t tz) const noexcept {
+            return tx < width && tz < height ? tiles[tz * width + tx] : nullptr;
+        }
+    };
+
+    // chunks written to one shard, in world chunk coordinates, and their record offsets (cz-major)
+    struct ShardLayout {
+        std::size_t chunkX{ 0 };
+        std::size_t chunkZ{ 0 };
+        std::size_t chunksWide{ 0 };
+        std::size_t chunksHigh{ 0 };
+        std::vector<core::u64> offsets{};
+    };
+
+public:
+    // numWorkers = 0 spawns one worker per hardware thread
+    explicit BasicChunkBuilder(
+        std::size_t tileSize,
+        engine::world::ChunkEncoding encoding = engine::world::ChunkEncoding::Delta,
+        core::u32 sections = engine::world::CHUNK_SECTION_BOUNDS,
+        std::size_t numWorkers = 0
+    ) noexcept
+        : tileSize(tileSize),
+          encoding(encoding),
+          sections(sections),
+          numWorkers(numWorkers)
+    {
+        if(this->numWorkers == 0) {
+            this->numWorkers = std::max(1u, std::thread::hardware_concurrency());
+        }
+    }
+
+    // first chunk (along either axis) whose first sample lies in tile t, so tile t holds chunks
+    // [getFirstChunk(t), getFirstChunk(t + 1))
+    // note: chunks sit CHUNK_SIZE samples apart and share their edge samples with their neighbours,
+    // so sample s of the world is sample s - c * CHUNK_SIZE of chunk c
+    std::size_t getFirstChunk(std::size_t t) const noexcept {
+        return (t * (tileSize - 1) + engine::world::CHUNK_SIZE - 1) / engine::world::CHUNK_SIZE;
+    }
+
+    // a single tile as a world of one: its north-west chunk is (0,0)
+    // full-sized chunks are written even where the tile runs out, padded with its edge samples
+    // returns every chunk's record offset, cz-major, or nullopt on failure
+    std::optional<std::vector<core::u64>> build(const char* inFilename, const char* outFilename) const noexcept {
+        const std::byte* tile = mapTile(inFilename);
+        if(tile == nullptr) {
+            return std::nullopt;
+        }
+        const TileGrid grid{ .width = 1, .height = 1, .tiles = { tile } };
+        std::optional<ShardLayout> layout = buildShard(grid, 0, 0, outFilename);
+        unmapTile(tile);
+        if(!layout.has_value()) {
+            return std::nullopt;
+        }
+        return std::move(layout->offsets);
+    }
+
+    // every .hgt tile in inDir -> outDir/<tile>.chunk, indexed by outDir/world.world
+    // tiles are laid out by latitude/longitude on one sample grid: the north-west tile's north-west
+    // chunk is (0,0), x runs east and z south. Chunks straddling two tiles read across the seam, and
+    // belong to the shard of the tile their first sample lies in
+    bool buildWorld(const char* inDir, const char* outDir) const noexcept {
+        namespace fs = std::filesystem;
+        struct Tile {
+            fs::path path;
+            std::string name;
+            core::i32 lat{};
+            core::i32 lon{};
+        };
+        std::vector<Tile> tiles{};
+        std::error_code ec{};
+        for(const fs::directory_entry& entry : fs::directory_iterator(inDir, ec)) {
+            if(entry.path().extension() != ".hgt") {
+                continue;
+            }
+            const std::string name = entry.path().stem().string();
+            std::optional<std::pair<core::i32, core::i32>> latLon = parseTileName(name);
+            if(!latLon.has_value()) {
+                printf("chunk builder: skipping '%s', not a tile name like N40W106\n", entry.path().c_str());
+                continue;
+            }
+            tiles.push_back({ .path = entry.path(), .name = name, .lat = latLon->first, .lon = latLon->second });
+        }
+        if(ec || tiles.empty()) {
+            printf("chunk builder: no .hgt tiles in '%s'\n", inDir);
+            return false;
+        }
+        std::sort(tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b) { return a.name < b.name; });
+        fs::create_directories(outDir, ec);
+
+        core::i32 north = tiles.front().lat, south = north;
+        core::i32 west = tiles.front().lon, east = west;
+        for(const Tile& tile : tiles) {
+            north = std::max(north, tile.lat);
+            south = std::min(south, tile.lat);
+            west = std::min(west, tile.lon);
+            east = std::max(east, tile.lon);
+        }
+
+        // every tile stays mapped until the end, chunks on a seam read from both sides of it
+        TileGrid grid{
+            .width = static_cast<std::size_t>(east - west + 1),
+            .height = static_cast<std::size_t>(north - south + 1)
+        };
+        grid.tiles.assign(grid.width * grid.height, nullptr);
+        auto unmapAll = [&]() {
+            for(const std::byte* tile : grid.tiles) {
+                unmapTile(tile);
+            }
+        };
+        for(const Tile& tile : tiles) {
+            const std::byte* mapped = mapTile(tile.path.c_str());
+            if(mapped == nullptr) {
+                unmapAll();
+                return false;
+            }
+            grid.tiles[static_cast<std::size_t>(north - tile.lat) * grid.width + static_cast<std::size_t>(tile.lon - west)] = mapped;
+        }
+
+        engine::world::ChunkWorldHeader header {
+            .originX = 0,
+            .originZ = 0,
+            .width = static_cast<core::u32>(getFirstChunk(grid.width)),
+            .height = static_cast<core::u32>(getFirstChunk(grid.height)),
+            .numShards = static_cast<core::u32>(tiles.size())
+        };
+        std::vector<core::u64> cells(static_cast<std::size_t>(header.width) * header.height, 0);
+
+        // shards are built one after another, each across every worker
+        for(core::u32 shard = 0; shard < tiles.size(); ++shard) {
+            const Tile& tile = tiles[shard];
+            const fs::path outPath = fs::path(outDir) / (tile.name + ".chunk");
+            std::optional<ShardLayout> layout = buildShard(
+                grid,
+                static_cast<std::size_t>(tile.lon - west),
+                static_cast<std::size_t>(north - tile.lat),
+                outPath.c_str()
+            );
+            if(!layout.has_value()) {
+                unmapAll();
+                return false;
+            }
+            for(std::size_t cz = 0; cz < layout->chunksHigh; ++cz) {
+                for(std::size_t cx = 0; cx < layout->chunksWide; ++cx) {
+                    cells[(layout->chunkZ + cz) * header.width + layout->chunkX + cx] =
+                        engine::world::packChunkWorldCell(shard, layout->offsets[cz * layout->chunksWide + cx]);
+                }
+            }
+        }
+        unmapAll();
+
+        const fs::path indexPath = fs::path(outDir) / "world.world";
+        std::FILE* f = std::fopen(indexPath.c_str(), "wb");
+        if(f == nullptr) {
+            printf("chunk builder: cannot write world index: '%s'\n", indexPath.c_str());
+            return false;
+        }
+        bool written = std::fwrite(&header, sizeof(header), 1, f) == 1;
+        for(const Tile& tile : tiles) {
+            const std::string name = tile.name + ".chunk";
+            const core::u32 length = static_cast<core::u32>(name.size());
+            written = written && std::fwrite(&length, sizeof(length), 1, f) == 1;
+            written = written && std::fwrite(name.data(), 1, length, f) == length;
+        }
+        written = written && std::fwrite(cells.data(), sizeof(core::u64), cells.size(), f) == cells.size();
+        written = std::fclose(f) == 0 && written;
+        if(!written) {
+            printf("chunk builder: could not write world index: '%s'\n", indexPath.c_str());
+            return false;
+        }
+        printf("chunk builder: indexed %zu tiles, (%ux%u) chunks in '%s'\n", tiles.size(), header.width, header.height, indexPath.c_str());
+        return true;
+    }
+
+private:
+    // read-only mapping of a whole (tileSize x tileSize) tile, null on failure
+    const std::byte* mapTile(const char* filename) const noexcept {
+        const std::size_t tileBytes = tileSize * tileSize * sizeof(core::i16);
+        if(tileSize <= static_cast<std::size_t>(engine::world::CHUNK_SIZE) + 1) {
+            printf("chunk builder: tile size %zu is not larger than a chunk\n", tileSize);
+            return nullptr;
+        }
+        int in = ::open(filename, O_RDONLY);
+        if(in < 0) {
+            printf("chunk builder: cannot read asset file: '%s'\n", filename);
+            return nullptr;
+        }
+        struct stat st{};
+        if(fstat(in, &st) != 0 || static_cast<std::size_t>(st.st_size) != tileBytes) {
+            printf("chunk builder: '%s' is not a (%zux%zu) tile\n", filename, tileSize, tileSize);
+            ::close(in);
+            return nullptr;
+        }
+        void* ptr = mmap(nullptr, tileBytes, PROT_READ, MAP_PRIVATE, in, 0);
+        ::close(in);
+        if(ptr == MAP_FAILED) {
+            printf("chunk builder: could not map '%s'\n", filename);
+            return nullptr;
+        }
+        // every row is read front to back, once per chunk row that holds it
+        madvise(ptr, tileBytes, MADV_SEQUENTIAL);
+        return static_cast<const std::byte*>(ptr);
+    }
+
+    void unmapTile(const std::byte* tile) const noexcept {
+        if(tile != nullptr) {
+            munmap(const_cast<std::byte*>(tile), tileSize * tileSize * sizeof(core::i16));
+        }
+    }
+
+    // the chunks whose first sample lies in tile (tx, tz) -> outFilename
+    // rows of chunks are cut and encoded in parallel, each worker claiming the next stretch of
+    // the output in row order, and the header + TOC are written once every chunk is out
+    std::optional<ShardLayout> buildShard(const TileGrid& grid, std::size_t tx, std::size_t tz, const char* outFilename) const noexcept {
+        int out = ::open(outFilename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(out < 0) {
+            printf("chunk builder: cannot write to chunked file: '%s'\n", outFilename);
+            return std::nullopt;
+        }
+
+        ShardLayout layout{
+            .chunkX = getFirstChunk(tx),
+            .chunkZ = getFirstChunk(tz),
+            .chunksWide = getFirstChunk(tx + 1) - getFirstChunk(tx),
+            .chunksHigh = getFirstChunk(tz + 1) - getFirstChunk(tz)
+        };
+
+        // the header + TOC size is fixed, encoded record sizes are not: rows are appended after it in
+        // row order, each worker claiming its stretch once the row before has claimed its own
+        const engine::world::ChunkFileHeader header {
+            .encoding = encoding,
+            .numChunks = layout.chunksWide * layout.chunksHigh,
+            .sections = sections,
+            .resolution = static_cast<core::u32>(Traits::resolution)
+        };
+        const std::size_t dataBegin = sizeof(header) + header.numChunks * sizeof(engine::world::ChunkTOC);
+        layout.offsets.resize(header.numChunks);
+        std::vector<core::u32> sizes(header.numChunks);
+
+        std::atomic<std::size_t> nextRow{ 0 };
+        std::atomic<bool> failed{ false };
+        std::mutex tailMutex{};
+        std::condition_variable tailCondition{};
+        std::size_t nextCommit{ 0 };
+        std::size_t tail{ dataBegin };
+        {
+            std::vector<std::jthread> workers;
+            workers.reserve(numWorkers);
+            for(std::size_t i = 0; i < numWorkers; ++i) {
+                workers.emplace_back([&]() {
+                    constexpr std::size_t N = Traits::resolution;
+                    constexpr std::size_t S = engine::world::CHUNK_SIZE;
+                    // APRON DEM samples all around, for normals across chunk edges
+                    std::vector<core::i16> rows((S + 2 * APRON + 1) * (layout.chunksWide * S + 2 * APRON + 1));
+                    // one chunk resampled off the DEM grid, apron included
+                    std::vector<core::i16> resampled(Traits::spacing == 1.f ? 0 : (N + 2) * (N + 2));
+                    std::vector<core::i16> chunks(layout.chunksWide * N * N);
+                    std::vector<core::u16> normals(layout.chunksWide * N * N);
+                    std::vector<engine::world::ChunkBounds> bounds(layout.chunksWide * engine::world::CHUNK_BOUNDS_CELLS);
+                    std::vector<std::byte> encoded{};
+                    std::vector<std::size_t> recordEnds(layout.chunksWide);
+                    for(std::size_t row = nextRow.fetch_add(1); row < layout.chunksHigh && !failed.load(); row = nextRow.fetch_add(1)) {
+                        buildRow(grid, tx, tz, layout.chunkX, layout.chunkZ + row, rows, resampled, chunks, normals, bounds);
+                        encodeRow(chunks, normals, bounds, encoded, recordEnds);
+
+                        std::size_t rowOffset{};
+                        {
+                            std::unique_lock lock(tailMutex);
+                            tailCondition.wait(lock, [&]() { return nextCommit == row || failed.load(); });
+                            if(failed.load()) {
+                                break;
+                            }
+                            rowOffset = tail;
+                            tail += encoded.size();
+                            ++nextCommit;
+                        }
+                        tailCondition.notify_all();
+
+                        for(std::size_t cx = 0; cx < layout.chunksWide; ++cx) {
+                            const std::size_t begin = cx == 0 ? 0 : recordEnds[cx - 1];
+                            layout.offsets[row * layout.chunksWide + cx] = rowOffset + begin;
+                            sizes[row * layout.chunksWide + cx] = static_cast<core::u32>(recordEnds[cx] - begin);
+                        }
+                        if(!writeAll(out, encoded.data(), encoded.size(), rowOffset)) {
+                            {
+                                std::lock_guard lock(tailMutex);
+                                failed.store(true);
+                            }
+                            tailCondition.notify_all();
+                        }
+                    }
+                });
+            }
+        }
+
+        // header + TOC, cz-major like the chunks themselves
+        std::vector<std::byte> toc(dataBegin);
+        std::memcpy(toc.data(), &header, sizeof(header));
+        for(std::size_t cz = 0; cz < layout.chunksHigh; ++cz) {
+            for(std::size_t cx = 0; cx < layout.chunksWide; ++cx) {
+                const std::size_t i = cz * layout.chunksWide + cx;
+                const engine::world::ChunkTOC chunkTOC {
+                    .chunkX = static_cast<core::i32>(layout.chunkX + cx),
+                    .chunkZ = static_cast<core::i32>(layout.chunkZ + cz),
+                    .offset = layout.offsets[i],
+                    .bytes = sizes[i]
+                };
+                std::memcpy(toc.data() + sizeof(header) + i * sizeof(chunkTOC), &chunkTOC, sizeof(chunkTOC));
+            }
+        }
+        if(!failed.load() && !writeAll(out, toc.data(), toc.size(), 0)) {
+            failed.store(true);
+        }
+
+        ::close(out);
+        if(failed.load()) {
+            printf("chunk builder: could not write '%s'\n", outFilename);
+            return std::nullopt;
+        }
+        printf("chunk builder: wrote %lu chunks (%zu bytes) to '%s'\n", header.numChunks, tail, outFilename);
+        return layout;
+    }
+
+    // "N40W106" -> (40, -106): latitude of the tile's south edge, longitude of its west edge
+    static std::optional<std::pair<core::i32, core::i32>> parseTileName(const std::string& name) noexcept {
+        if(name.size() != 7 || (name[0] != 'N' && name[0] != 'S') || (name[3] != 'E' && name[3] != 'W')) {
+            return std::nullopt;
+        }
+        for(std::size_t i : { 1, 2, 4, 5, 6 }) {
+            if(name[i] < '0' || name[i] > '9') {
+                return std::nullopt;
+            }
+        }
+        const core::i32 lat = (name[1] - '0') * 10 + (name[2] - '0');
+        const core::i32 lon = (name[4] - '0') * 100 + (name[5] - '0') * 10 + (name[6] - '0');
+        return std::pair{ name[0] == 'N' ? lat : -lat, name[3] == 'E' ? lon : -lon };
+    }
+
+    // world sample row gz from column xs on, byte-swapped, for a chunk of tile (tx, tz)
+    // samples past the world's edges repeat its edge samples, samples in a missing tile come from
+    // tile (tx, tz) instead, clamped into it
+    void readRow(
+        const TileGrid& grid,
+        std::size_t tx,
+        std::size_t tz,
+        std::int64_t gz,
+        std::int64_t xs,
+        std::span<core::i16> out
+    ) const noexcept {
+        const std::int64_t stride = static_cast<std::int64_t>(tileSize) - 1;
+        const std::int64_t gridWidth = static_cast<std::int64_t>(grid.width);
+        const std::int64_t gridHeight = static_cast<std::int64_t>(grid.height);
+        const std::int64_t ownX = static_cast<std::int64_t>(tx) * stride;
+        const std::int64_t ownZ = static_cast<std::int64_t>(tz) * stride;
+
+        gz = std::clamp<std::int64_t>(gz, 0, gridHeight * stride);
+        const std::int64_t row = std::min(gz / stride, gridHeight - 1);
+        const std::int64_t lz = gz - row * stride;
+        const std::byte* own = grid.at(tx, tz) + std::clamp<std::int64_t>(gz - ownZ, 0, stride) * tileSize * sizeof(core::i16);
+
+        const std::int64_t end = xs + static_cast<std::int64_t>(out.size());
+        const std::int64_t first = std::max<std::int64_t>(xs, 0);
+        const std::int64_t last = std::min(end - 1, gridWidth * stride);
+        std::size_t i = static_cast<std::size_t>(first - xs);
+        for(std::int64_t x = first; x <= last;) {
+            const std::int64_t column = std::min(x / stride, gridWidth - 1);
+            const std::int64_t lx = x - column * stride;
+            // up to and including the tile's shared east column
+            const std::int64_t run = std::min(last - x + 1, static_cast<std::int64_t>(tileSize) - lx);
+            const std::byte* tile = grid.at(static_cast<std::size_t>(column), static_cast<std::size_t>(row));
+            if(tile != nullptr) {
+                byteSwap16(tile + (lz * tileSize + lx) * sizeof(core::i16), out.data() + i, static_cast<std::size_t>(run));
+            }
+            else {
+                for(std::int64_t k = 0; k < run; ++k) {
+                    const std::int64_t ownLx = std::clamp<std::int64_t>(x + k - ownX, 0, stride);
+                    byteSwap16(own + ownLx * sizeof(core::i16), out.data() + i + k, 1);
+                }
+            }
+            x += run;
+            i += static_cast<std::size_t>(run);
+        }
+        // past the world's west/east edges
+        std::fill(out.begin(), out.begin() + (first - xs), out[static_cast<std::size_t>(first - xs)]);
+        std::fill(out.begin() + static_cast<std::ptrdiff_t>(i), out.end(), out[i - 1]);
+    }
+
+    // the CHUNK_SIZE + 1 world rows under chunk row cz of tile (tx, tz) plus APRON rows either side,
+    // swapped once, then cut into chunks CHUNK_SIZE samples apart starting at chunk column cxBegin
+    // (resampled to Traits::resolution where that isn't CHUNK_SIZE + 1) with normals and bounds for each
+    void buildRow(
+        const TileGrid& grid,
+        std::size_t tx,
+        std::size_t tz,
+        std::size_t cxBegin,
+        std::size_t cz,
+        std::span<core::i16> rows,
+        std::span<core::i16> resampled,
+        std::span<core::i16> chunks,
+        std::span<core::u16> normals,
+        std::span<engine::world::ChunkBounds> bounds
+    ) const noexcept {
+        constexpr std::size_t N = Traits::resolution;
+        constexpr std::size_t S = engine::world::CHUNK_SIZE;
+        constexpr std::size_t rowCount = S + 2 * APRON + 1;
+        constexpr std::size_t cells = engine::world::CHUNK_BOUNDS_CELLS;
+        const std::size_t rowWidth = rows.size() / rowCount;
+        for(std::size_t lz = 0; lz < rowCount; ++lz) {
+            readRow(
+                grid,
+                tx,
+                tz,
+                static_cast<std::int64_t>(cz * S + lz) - static_cast<std::int64_t>(APRON),
+                static_cast<std::int64_t>(cxBegin * S) - static_cast<std::int64_t>(APRON),
+                rows.subspan(lz * rowWidth, rowWidth)
+            );
+        }
+        const std::size_t chunksWide = chunks.size() / (N * N);
+        for(std::size_t cx = 0; cx < chunksWide; ++cx) {
+            // sample (-1, -1) of chunk cx, and the distance between its rows
+            const core::i16* apron = rows.data() + cx * S;
+            std::size_t apronWidth = rowWidth;
+            if constexpr(Traits::spacing != 1.f) {
+                resample(rows.data() + cx * S, rowWidth, resampled);
+                apron = resampled.data();
+                apronWidth = N + 2;
+            }
+            std::span<core::i16> chunk = chunks.subspan(cx * N * N, N * N);
+            for(std::size_t lz = 0; lz < N; ++lz) {
+                std::memcpy(chunk.data() + lz * N, apron + (lz + 1) * apronWidth + 1, N * sizeof(core::i16));
+            }
+            if(sections & engine::world::CHUNK_SECTION_NORMALS) {
+                engine::world::computeChunkNormals<Traits>([&](core::i32 x, core::i32 z) {
+                    return apron[static_cast<std::size_t>(z + 1) * apronWidth + static_cast<std::size_t>(x + 1)];
+                }, normals.subspan(cx * N * N, N * N));
+            }
+            if(sections & engine::world::CHUNK_SECTION_BOUNDS) {
+                engine::world::computeChunkBounds<Traits>(chunk, bounds.subspan(cx * cells, cells));
+            }
+        }
+    }
+
+    // bilinear samples of a chunk every Traits::spacing DEM samples, one chunk sample of apron all around
+    // dem: the chunk's (CHUNK_SIZE + 2 * APRON + 1)^2 DEM samples, rows stride apart, starting APRON
+    // samples before its first one
+    // out: (N + 2)^2, sample (-1, -1) first
+    static void resample(const core::i16* dem, std::size_t stride, std::span<core::i16> out) noexcept {
+        constexpr std::size_t N = Traits::resolution;
+        constexpr std::size_t last = engine::world::CHUNK_SIZE + 2 * APRON;
+        // chunk sample i - 1 -> its DEM sample and the fraction of the way to the next
+        auto axis = [last](std::size_t i) {
+            const float p = static_cast<float>(APRON) + (static_cast<float>(i) - 1.f) * Traits::spacing;
+            const std::size_t p0 = std::min(static_cast<std::size_t>(p), last);
+            return std::pair{ p0, p - static_cast<float>(p0) };
+        };
+        for(std::size_t j = 0; j < N + 2; ++j) {
+            const auto [z0, fz] = axis(j);
+            const core::i16* row0 = dem + z0 * stride;
+            const core::i16* row1 = dem + std::min(z0 + 1, last) * stride;
+            for(std::size_t i = 0; i < N + 2; ++i) {
+                const auto [x0, fx] = axis(i);
+                const std::size_t x1 = std::min(x0 + 1, last);
+                const float h0 = static_cast<float>(row0[x0]) + (static_cast<float>(row0[x1]) - static_cast<float>(row0[x0])) * fx;
+                const float h1 = static_cast<float>(row1[x0]) + (static_cast<float>(row1[x1]) - static_cast<float>(row1[x0])) * fx;
+                out[j * (N + 2) + i] = static_cast<core::i16>(std::lround(h0 + (h1 - h0) * fz));
+            }
+        }
+    }
+
+    // a row of chunks -> their records back to back in the builder's encoding, recordEnds[cx] past each
+    // every record is its sections (bounds, then normals) followed by its heights
+    void encodeRow(
+        std::span<const core::i16> chunks,
+        std::span<const core::u16> normals,
+        std::span<const engine::world::ChunkBounds> bounds,
+        std::vector<std::byte>& encoded,
+        std::span<std::size_t> recordEnds
+    ) const {
+        constexpr std::size_t samples = Traits::samples;
+        constexpr std::size_t cells = engine::world::CHUNK_BOUNDS_CELLS;
+        auto append = [&](const void* data, std::size_t bytes) {
+            const std::size_t begin = encoded.size();
+            encoded.resize(begin + bytes);
+            std::memcpy(encoded.data() + begin, data, bytes);
+        };
+        encoded.clear();
+        for(std::size_t cx = 0; cx < recordEnds.size(); ++cx) {
+            if(sections & engine::world::CHUNK_SECTION_BOUNDS) {
+                append(bounds.data() + cx * cells, engine::world::CHUNK_BOUNDS_BYTES);
+            }
+            if(sections & engine::world::CHUNK_SECTION_NORMALS) {
+                append(normals.data() + cx * samples, engine::world::chunkNormalsBytes(Traits::resolution));
+            }
+            std::span<const core::i16> chunk = chunks.subspan(cx * samples, samples);
+            if(encoding == engine::world::ChunkEncoding::Delta) {
+                engine::world::encodeChunkDelta<Traits>(chunk, encoded);
+            }
+            else {
+                append(chunk.data(), chunk.size_bytes());
+            }
+            recordEnds[cx] = encoded.size();
+        }
+    }
+
+    static bool writeAll(int fd, const void* data, std::size_t bytes, std::size_t offset) noexcept {
+        const std::byte* p = static_cast<const std::byte*>(data);
+        while(bytes > 0) {
+            const ssize_t written = pwrite(fd, p, bytes, static_cast<off_t>(offset));
+            if(written <= 0) {
+                return false;
+            }
+            p += written;
+            bytes -= static_cast<std::size_t>(written);
+            offset += static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+};
+
+using ChunkBuilder = BasicChunkBuilder<engine::world::DefaultChunkTraits>;
+
+}
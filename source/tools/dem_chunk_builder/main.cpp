@@ -2,129 +2,95 @@
 //     turning NASA DEM (.hgt) files into chunk-ready heightmaps (.chunk)
 //
 // Chunk Binary File Format (.chunk)
-// [HEADER] - uint64_t of number of chunks
-// [TOC RECORDS] - a ChunkTOC for each Chunk, see engine/world/chunk_data.hpp
-// [CHUNK] - Chunk Heightmap
-
+// [HEADER] - ChunkFileHeader: magic, version, encoding, number of chunks, sections, chunk resolution,
+//     see engine/world/chunk_data.hpp
+// [TOC RECORDS] - a ChunkTOC for each Chunk: coordinate, offset and size of its record
+// [CHUNK] - Chunk record: the header's sections, then the heightmap
+//     [BOUNDS] - min/max height pyramid, CHUNK_BOUNDS_CELLS ChunkBounds (see engine/world/chunk_surface.hpp)
+//     [NORMALS] - octahedral packed u16 per sample, only with --normals
+//     [HEIGHTS] - raw i16 or Delta encoded (see engine/world/chunk_codec.hpp)
+//     chunks sit CHUNK_SIZE samples apart and share edge samples with their neighbours (version 2 on)
+// version 2 files (no sections) and version 3 files (no resolution, always 33) are still read, version 0
+// files (a bare uint64_t chunk count, 16 byte TOC records) and version 1 files tile at a CHUNK_RESOLUTION
+// stride without shared edges and are rejected on open: rebuild them
+//
+// a sharded world is a .chunk per tile plus a world index (.world), see engine/world/chunk_world.hpp
+//
+// usage: ChunkBuilder [--raw] [--normals] [--resolution 17|33|65] [in.hgt] [out.chunk] [tile size]
+//        ChunkBuilder [--raw] [--normals] [--resolution 17|33|65] --world <tile dir> <out dir> [tile size]
+// --normals: store per-sample normals, 2 bytes a sample is more than a Delta record's heights, so by
+//     default the engine derives them on load
+// --resolution: samples along a chunk edge (see engine/world/chunk.hpp ChunkTraits), 33 by default
+
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <fstream>
-
-#include "engine/world/chunk_data.hpp"
-
-int main(int argc, char* argv[]) {
-    using namespace engine::world;
-    // todo: program arguments for DEM parameters
-    // 3-arcsecond DEM is 1201 x 1201 ints
-    //const std::size_t fileBlockSize = 3601;
-    // 1-arcsecond DEM is 3601 x 3601 ints
-    const std::size_t fileBlockSize = 3601;
-    constexpr std::size_t chunkSize = CHUNK_RESOLUTION;
 
-    const char * inFilename = "assets/N40W106.hgt";
-    std::ifstream fin(inFilename, std::ios_base::binary);
+#include "tools/dem_chunk_builder/chunk_builder.hpp"
 
-    const char * outFilename = "assets/N40W106.chunk";
-    std::ofstream fout(outFilename, std::ios_base::binary);
+template<engine::world::ChunkGeometry Traits>
+bool buildChunks(bool world, const char* inName, const char* outName, std::size_t tileSize, bool raw, bool normals) {
+    tools::BasicChunkBuilder<Traits> builder(
+        tileSize,
+        raw ? engine::world::ChunkEncoding::Raw : engine::world::ChunkEncoding::Delta,
+        engine::world::CHUNK_SECTION_BOUNDS | (normals ? engine::world::CHUNK_SECTION_NORMALS : 0u)
+    );
+    return world ? builder.buildWorld(inName, outName) : builder.build(inName, outName).has_value();
+}
 
-    if(!fin.good()) {
-        std::cout << "cannot read asset file: '" << inFilename << "'\n";
+int main(int argc, char* argv[]) {
+    bool raw = false;
+    bool normals = false;
+    unsigned long resolution = engine::world::CHUNK_RESOLUTION;
+    int flag = 1;
+    for(; flag < argc; ++flag) {
+        if(std::strcmp(argv[flag], "--raw") == 0) {
+            raw = true;
+        }
+        else if(std::strcmp(argv[flag], "--normals") == 0) {
+            normals = true;
+        }
+        else if(std::strcmp(argv[flag], "--resolution") == 0 && flag + 1 < argc) {
+            resolution = std::strtoul(argv[++flag], nullptr, 10);
+        }
+        else {
+            break;
+        }
+    }
+    const bool world = argc > flag && std::strcmp(argv[flag], "--world") == 0;
+    const int arg = world ? flag + 1 : flag;
+    if(world && argc < arg + 2) {
+        std::cout << "usage: ChunkBuilder [--raw] [--normals] [--resolution 17|33|65] --world <tile dir> <out dir> [tile size]\n";
         return -1;
     }
 
-    if(!fout.good()) {
-        std::cout << "cannot write to chunked file: '" << outFilename << "'\n";
+    // 3-arcsecond DEM is 1201 x 1201 ints
+    // 1-arcsecond DEM is 3601 x 3601 ints
+    const char * inName = argc > arg ? argv[arg] : "assets/N40W106.hgt";
+    const char * outName = argc > arg + 1 ? argv[arg + 1] : "assets/N40W106.chunk";
+    const std::size_t fileBlockSize = argc > arg + 2 ? std::strtoul(argv[arg + 2], nullptr, 10) : 3601;
+    if(fileBlockSize == 0) {
+        std::cout << "invalid tile size: '" << argv[arg + 2] << "'\n";
         return -1;
     }
 
-    // we write full-sized chunks even when there isn't enough data in a chunk
-    // at the file scope. we just use the last sampled height.
-    const std::size_t numChunksWide = std::ceill(
-        static_cast<float>(fileBlockSize) / static_cast<float>(chunkSize)
-    );
-
-    // total number of chunks we will write into the .chunk file
-    std::uint64_t numChunks = numChunksWide * numChunksWide;
-
-    // write header - number of chunks
-    fout.write(reinterpret_cast<char*>(&numChunks), sizeof(numChunks));
-
-    // write TOCs first, update the chunk coordinates and offsets
-    // as we generate the chunks
-    ChunkTOC chunkTOC{};
-    for(std::size_t cy = 0; cy < numChunksWide; ++cy) {
-        for(std::size_t cx = 0; cx < numChunksWide; ++cx) {
-            fout.write(reinterpret_cast<char*>(&chunkTOC), sizeof(chunkTOC));
-        }
+    bool built = false;
+    switch(resolution) {
+        case engine::world::FarChunkTraits::resolution:
+            built = buildChunks<engine::world::FarChunkTraits>(world, inName, outName, fileBlockSize, raw, normals);
+            break;
+        case engine::world::DefaultChunkTraits::resolution:
+            built = buildChunks<engine::world::DefaultChunkTraits>(world, inName, outName, fileBlockSize, raw, normals);
+            break;
+        case engine::world::NearChunkTraits::resolution:
+            built = buildChunks<engine::world::NearChunkTraits>(world, inName, outName, fileBlockSize, raw, normals);
+            break;
+        default:
+            std::cout << "unsupported chunk resolution: " << resolution << ", expected 17, 33 or 65\n";
+            return -1;
     }
-
-    // file offset: start at first cell
-    std::size_t offset = 0;
-    fin.seekg(offset);
-
-    // chunk TOC offset
-    std::size_t offsetTOC = sizeof(numChunks);
-    // fill and write each chunk's heightmap data (cx,cy)
-    int16_t lastHeight = 0;
-    for(std::size_t cy = 0; cy < numChunksWide; ++cy) {
-        for(std::size_t cx = 0; cx < numChunksWide; ++cx) {
-
-            // read chunk from file
-            // chunk local coords
-            std::array<std::int16_t, chunkSize * chunkSize> chunk;
-            for(std::size_t ly = 0; ly < chunkSize; ++ly) {
-                for(std::size_t lx = 0; lx < chunkSize; ++lx) {
-                    // compute global gx in chunkspace
-                    std::size_t gx = cx * chunkSize + lx;
-                    std::size_t gy = cy * chunkSize + ly;
-
-                    // compute chunk heightmap index to write
-                    std::size_t writeIndex = ly * chunkSize + lx;
-
-                    // are we out of bounds?
-                    if(gx >= fileBlockSize || gy >= fileBlockSize) {
-                        // use last sample
-                        chunk[writeIndex] = lastHeight;
-                        continue;
-                    }
-
-                    // where are we in the actual file
-                    offset = gy * fileBlockSize + gx;
-                    // todo: could be doing bulk reads per chunk
-                    fin.seekg(2*offset, std::ios::beg);
-
-                    // read big-endian signed 16-bit integers
-                    unsigned char buffer[2]{};
-                    fin.read(reinterpret_cast<char*>(buffer), 2);
-                    uint16_t hiByte = static_cast<uint16_t>(buffer[0]);
-                    uint16_t loByte = static_cast<uint16_t>(buffer[1]);
-
-                    uint16_t bytes = (hiByte << 8) | loByte;
-                    int16_t height = static_cast<int16_t>(bytes);
-
-                    // store last read height for (x,y) out of boundaries
-                    chunk[writeIndex] = height;
-                    lastHeight = height;
-                }
-            }
-
-            // go back and update the chunkTOC with this offset
-            std::uint64_t chunkOffset = fout.tellp();
-            fout.seekp(offsetTOC, std::ios::beg);
-            chunkTOC.chunkX = cx;
-            chunkTOC.chunkZ = cy;
-            chunkTOC.offset = chunkOffset;
-            fout.write(reinterpret_cast<char*>(&chunkTOC), sizeof(chunkTOC));
-
-            // seek back to where we were going to write the chunk
-            fout.seekp(chunkOffset, std::ios::beg);
-            // write chunked heights to file as raw int16_t
-            fout.write(
-                reinterpret_cast<const char*>(chunk.data()),
-                chunk.size() * sizeof(int16_t)
-            );
-
-            // update TOC offset
-            offsetTOC += sizeof(ChunkTOC);
-        }
+    if(!built) {
+        return -1;
     }
+    return 0;
 }